@@ -23,9 +23,13 @@
 #include <glib.h>
 
 #define uint32_t guint32
-
-#define _X_BE_32(x)	GUINT32_FROM_BE(*x)
-#define _X_LE_32(x)	GUINT32_FROM_LE(*x)
-#define _X_BE_16(x)	GUINT16_FROM_BE(*x)
-#define _X_LE_16(x)	GUINT16_FROM_LE(*x)
+#define uint64_t guint64
+
+/* x points at unaligned bytes; assemble the value rather than dereference
+ * it, which would only read (and sign-extend) a single char */
+#define _X_BYTE(x, n)	((guint32) ((const guint8 *) (x))[n])
+#define _X_BE_32(x)	(_X_BYTE (x, 0) << 24 | _X_BYTE (x, 1) << 16 | _X_BYTE (x, 2) << 8 | _X_BYTE (x, 3))
+#define _X_LE_32(x)	(_X_BYTE (x, 3) << 24 | _X_BYTE (x, 2) << 16 | _X_BYTE (x, 1) << 8 | _X_BYTE (x, 0))
+#define _X_BE_16(x)	(_X_BYTE (x, 0) << 8 | _X_BYTE (x, 1))
+#define _X_LE_16(x)	(_X_BYTE (x, 1) << 8 | _X_BYTE (x, 0))
 
@@ -0,0 +1,612 @@
+#include "config.h"
+
+#include <locale.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <gio/gio.h>
+
+#include "xplayer-pl-parser.h"
+#include "xplayer-pl-parser-mini.h"
+#include "test-support.h"
+
+/* How much of a playlist the parser sniffs, and how many times */
+#define SNIFF_SIZE 1024
+#define SNIFF_ITERATIONS 10000
+
+#define ENTRY_URI "file:///media/benchmark/%u.mp3"
+#define ENTRY_TITLE "Track %u"
+#define NO_SAVE -1
+
+static const guint sizes[] = { 10, 1000, 100000, 1000000 };
+
+static int option_max_entries = 1000000;
+static int option_max_save_entries = 10000;
+static char *option_format = NULL;
+static char *option_output = NULL;
+static FILE *output = NULL;
+
+/* Generators */
+
+typedef void (*BenchmarkGenerator) (GString *out, guint n_entries);
+
+static void
+generate_m3u (GString *out, guint n_entries)
+{
+	guint i;
+
+	g_string_append (out, "#EXTM3U\n");
+	for (i = 0; i < n_entries; i++) {
+		g_string_append_printf (out, "#EXTINF:180," ENTRY_TITLE "\n", i % 1000);
+		g_string_append_printf (out, ENTRY_URI "\n", i);
+	}
+}
+
+static void
+generate_hls (GString *out, guint n_entries)
+{
+	guint i;
+
+	g_string_append (out, "#EXTM3U\n"
+			 "#EXT-X-VERSION:3\n"
+			 "#EXT-X-TARGETDURATION:10\n"
+			 "#EXT-X-MEDIA-SEQUENCE:0\n");
+	for (i = 0; i < n_entries; i++)
+		g_string_append_printf (out, "#EXTINF:10.0,\nsegment%u.ts\n", i);
+	g_string_append (out, "#EXT-X-ENDLIST\n");
+}
+
+static void
+generate_pls (GString *out, guint n_entries)
+{
+	guint i;
+
+	g_string_append_printf (out, "[playlist]\nNumberOfEntries=%u\n", n_entries);
+	for (i = 0; i < n_entries; i++) {
+		g_string_append_printf (out, "File%u=" ENTRY_URI "\n", i + 1, i);
+		g_string_append_printf (out, "Title%u=" ENTRY_TITLE "\n", i + 1, i % 1000);
+		g_string_append_printf (out, "Length%u=180\n", i + 1);
+	}
+	g_string_append (out, "Version=2\n");
+}
+
+static void
+generate_xspf (GString *out, guint n_entries)
+{
+	guint i;
+
+	g_string_append (out, "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+			 "<playlist version=\"1\" xmlns=\"http://xspf.org/ns/0/\">\n"
+			 "<title>Benchmark</title>\n<trackList>\n");
+	for (i = 0; i < n_entries; i++) {
+		g_string_append_printf (out, "<track><location>" ENTRY_URI "</location>"
+					"<title>" ENTRY_TITLE "</title><duration>180000</duration></track>\n",
+					i, i % 1000);
+	}
+	g_string_append (out, "</trackList>\n</playlist>\n");
+}
+
+static void
+generate_asx (GString *out, guint n_entries)
+{
+	guint i;
+
+	g_string_append (out, "<asx version=\"3.0\">\n<title>Benchmark</title>\n");
+	for (i = 0; i < n_entries; i++) {
+		g_string_append_printf (out, "<entry><title>" ENTRY_TITLE "</title>"
+					"<ref href=\"" ENTRY_URI "\"/></entry>\n",
+					i % 1000, i);
+	}
+	g_string_append (out, "</asx>\n");
+}
+
+static void
+generate_smil (GString *out, guint n_entries)
+{
+	guint i;
+
+	g_string_append (out, "<?wpl version=\"1.0\"?>\n<smil>\n"
+			 "<head><title>Benchmark</title></head>\n<body><seq>\n");
+	for (i = 0; i < n_entries; i++)
+		g_string_append_printf (out, "<media src=\"" ENTRY_URI "\"/>\n", i);
+	g_string_append (out, "</seq></body>\n</smil>\n");
+}
+
+static void
+generate_rss (GString *out, guint n_entries)
+{
+	guint i;
+
+	g_string_append (out, "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+			 "<rss version=\"2.0\"><channel>\n<title>Benchmark</title>\n");
+	for (i = 0; i < n_entries; i++) {
+		g_string_append_printf (out, "<item><title>" ENTRY_TITLE "</title>"
+					"<enclosure url=\"" ENTRY_URI "\" type=\"audio/mpeg\" length=\"1\"/>"
+					"<pubDate>Mon, 05 Jan 2009 12:00:00 +0000</pubDate></item>\n",
+					i % 1000, i);
+	}
+	g_string_append (out, "</channel></rss>\n");
+}
+
+static void
+generate_atom (GString *out, guint n_entries)
+{
+	guint i;
+
+	g_string_append (out, "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+			 "<feed xmlns=\"http://www.w3.org/2005/Atom\">\n<title>Benchmark</title>\n");
+	for (i = 0; i < n_entries; i++) {
+		g_string_append_printf (out, "<entry><title>" ENTRY_TITLE "</title>"
+					"<link rel=\"enclosure\" href=\"" ENTRY_URI "\" type=\"audio/mpeg\"/></entry>\n",
+					i % 1000, i);
+	}
+	g_string_append (out, "</feed>\n");
+}
+
+static void
+generate_opml (GString *out, guint n_entries)
+{
+	guint i;
+
+	g_string_append (out, "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+			 "<opml version=\"1.1\"><head><title>Benchmark</title></head><body>\n");
+	for (i = 0; i < n_entries; i++) {
+		g_string_append_printf (out, "<outline text=\"" ENTRY_TITLE "\" type=\"rss\" "
+					"xmlUrl=\"file:///media/benchmark/%u.rss\"/>\n",
+					i % 1000, i);
+	}
+	g_string_append (out, "</body></opml>\n");
+}
+
+static void
+generate_pla (GString *out, guint n_entries)
+{
+	char record[512];
+	guint i;
+
+	/* A header block, then one block per entry with a
+	 * big-endian UTF-16 path using backslashes */
+	memset (record, 0, sizeof (record));
+	record[0] = (n_entries >> 24) & 0xff;
+	record[1] = (n_entries >> 16) & 0xff;
+	record[2] = (n_entries >> 8) & 0xff;
+	record[3] = n_entries & 0xff;
+	strcpy (record + 4, "iriver UMS PLA");
+	strcpy (record + 32, "Benchmark");
+	g_string_append_len (out, record, sizeof (record));
+
+	for (i = 0; i < n_entries; i++) {
+		char *path;
+		guint j, name;
+
+		path = g_strdup_printf ("\\media\\benchmark\\%u.mp3", i);
+		name = strrchr (path, '\\') - path + 2;
+
+		memset (record, 0, sizeof (record));
+		record[0] = (name >> 8) & 0xff;
+		record[1] = name & 0xff;
+		for (j = 0; path[j] != '\0'; j++)
+			record[2 + j * 2 + 1] = path[j];
+		g_string_append_len (out, record, sizeof (record));
+		g_free (path);
+	}
+}
+
+static void
+generate_ram (GString *out, guint n_entries)
+{
+	guint i;
+
+	for (i = 0; i < n_entries; i++)
+		g_string_append_printf (out, "file:///media/benchmark/%u.rm\n", i);
+}
+
+static void
+generate_binary_word (GString *out, guint32 word)
+{
+	word = GUINT32_TO_LE (word);
+	g_string_append_len (out, (const char *) &word, sizeof (word));
+}
+
+static void
+generate_binary (GString *out, guint n_entries)
+{
+	GString *strings;
+	guint32 *titles;
+	guint32 records, size;
+	guint i;
+
+	/* Version 1 of the binary format, with URI and title fields,
+	 * see xplayer-pl-parser-binary.c */
+	strings = g_string_new (NULL);
+	g_string_append_len (strings, "url\0title\0Benchmark", strlen ("url title Benchmark") + 1);
+
+	titles = g_new0 (guint32, MIN (n_entries, 1000));
+	records = 12 * sizeof (guint32) + 2 * sizeof (guint32);
+
+	g_string_append (out, "XPLB");
+	generate_binary_word (out, 1);
+	generate_binary_word (out, 0);
+	generate_binary_word (out, n_entries);
+	generate_binary_word (out, 2);
+	generate_binary_word (out, strlen ("url title "));
+	generate_binary_word (out, 12 * sizeof (guint32));
+	generate_binary_word (out, records);
+	/* The string table is written last, after the records */
+	generate_binary_word (out, records + n_entries * 2 * sizeof (guint32));
+	generate_binary_word (out, 0);
+	generate_binary_word (out, 0);
+	generate_binary_word (out, 0);
+
+	generate_binary_word (out, 0);
+	generate_binary_word (out, strlen ("url "));
+
+	for (i = 0; i < n_entries; i++) {
+		generate_binary_word (out, strings->len);
+		g_string_append_printf (strings, ENTRY_URI, i);
+		g_string_append_c (strings, '\0');
+
+		if (titles[i % 1000] == 0) {
+			titles[i % 1000] = strings->len;
+			g_string_append_printf (strings, ENTRY_TITLE, i % 1000);
+			g_string_append_c (strings, '\0');
+		}
+		generate_binary_word (out, titles[i % 1000]);
+	}
+
+	/* Fill in the size of the string table in the header */
+	size = GUINT32_TO_LE (strings->len);
+	memcpy (out->str + 9 * sizeof (guint32), &size, sizeof (size));
+	g_string_append_len (out, strings->str, strings->len);
+
+	g_string_free (strings, TRUE);
+	g_free (titles);
+}
+
+typedef struct {
+	const char *name;
+	const char *suffix;
+	BenchmarkGenerator generate;
+	int save_type;
+} BenchmarkFormat;
+
+static const BenchmarkFormat formats[] = {
+	{ "m3u", "m3u", generate_m3u, XPLAYER_PL_PARSER_M3U },
+	{ "m3u8", "m3u8", generate_hls, NO_SAVE },
+	{ "pls", "pls", generate_pls, XPLAYER_PL_PARSER_PLS },
+	{ "xspf", "xspf", generate_xspf, XPLAYER_PL_PARSER_XSPF },
+	{ "asx", "asx", generate_asx, NO_SAVE },
+	{ "smil", "wpl", generate_smil, NO_SAVE },
+	{ "rss", "rss", generate_rss, NO_SAVE },
+	{ "atom", "atom", generate_atom, NO_SAVE },
+	{ "opml", "opml", generate_opml, NO_SAVE },
+	{ "pla", "pla", generate_pla, XPLAYER_PL_PARSER_IRIVER_PLA },
+	{ "ram", "ram", generate_ram, NO_SAVE },
+	{ "binary", "xplb", generate_binary, XPLAYER_PL_PARSER_BINARY },
+};
+
+/* Measurements */
+
+typedef struct {
+	const BenchmarkFormat *format;
+	guint n_entries;
+	const char *operation;
+	gint64 start;
+	gint64 first_entry;
+	gint64 end;
+	guint entries;
+	guint iterations;
+	goffset bytes;
+	gsize allocations;
+	XplayerPlParserResult result;
+	GMainLoop *loop;
+} BenchmarkRun;
+
+static void
+benchmark_run_start (BenchmarkRun *run,
+		     const BenchmarkFormat *format,
+		     guint n_entries,
+		     const char *operation)
+{
+	memset (run, 0, sizeof (*run));
+	run->format = format;
+	run->n_entries = n_entries;
+	run->operation = operation;
+	run->first_entry = -1;
+	run->iterations = 1;
+
+	test_support_reset_peak_rss ();
+	run->allocations = test_support_allocations ();
+	run->start = g_get_monotonic_time ();
+}
+
+static void
+benchmark_print_double (const char *name, double value, gboolean valid)
+{
+	char buf[G_ASCII_DTOSTR_BUF_SIZE];
+
+	if (valid == FALSE) {
+		fprintf (output, ",\"%s\":null", name);
+		return;
+	}
+	fprintf (output, ",\"%s\":%s", name, g_ascii_formatd (buf, sizeof (buf), "%.6f", value));
+}
+
+static void
+benchmark_run_end (BenchmarkRun *run)
+{
+	gint64 peak_rss;
+	gsize allocs;
+	double seconds;
+
+	if (run->end == 0)
+		run->end = g_get_monotonic_time ();
+	allocs = test_support_allocations () - run->allocations;
+	peak_rss = test_support_peak_rss ();
+	seconds = (run->end - run->start) / (double) G_USEC_PER_SEC;
+
+	/* One JSON object per line */
+	fprintf (output, "{\"format\":\"%s\",\"size\":%u,\"operation\":\"%s\",\"result\":%d,\"iterations\":%u,\"entries\":%u",
+		 run->format->name, run->n_entries, run->operation, run->result, run->iterations, run->entries);
+	fprintf (output, ",\"bytes\":%" G_GINT64_FORMAT, (gint64) run->bytes);
+	benchmark_print_double ("seconds", seconds, TRUE);
+	benchmark_print_double ("entries_per_second", run->entries / seconds, seconds > 0 && run->entries > 0);
+	benchmark_print_double ("mb_per_second", run->iterations * run->bytes / seconds / (1024 * 1024), seconds > 0);
+	benchmark_print_double ("calls_per_second", run->iterations / seconds, seconds > 0 && run->iterations > 1);
+	benchmark_print_double ("first_entry_seconds", (run->first_entry - run->start) / (double) G_USEC_PER_SEC, run->first_entry >= 0);
+	if (peak_rss >= 0)
+		fprintf (output, ",\"peak_rss_kib\":%" G_GINT64_FORMAT, peak_rss);
+	else
+		fprintf (output, ",\"peak_rss_kib\":null");
+#ifdef HAVE_ALLOCATION_COUNT
+	fprintf (output, ",\"allocations\":%" G_GSIZE_FORMAT "}\n", allocs);
+#else
+	(void) allocs;
+	fprintf (output, ",\"allocations\":null}\n");
+#endif
+	fflush (output);
+}
+
+static void
+entry_parsed_cb (XplayerPlParser *parser,
+		 const char *uri,
+		 GHashTable *metadata,
+		 BenchmarkRun *run)
+{
+	if (run->entries == 0)
+		run->first_entry = g_get_monotonic_time ();
+	run->entries++;
+}
+
+static XplayerPlParser *
+benchmark_parser_new (BenchmarkRun *run)
+{
+	XplayerPlParser *parser;
+
+	/* Only the playlist itself is parsed, nothing it points to */
+	parser = xplayer_pl_parser_new ();
+	g_object_set (parser, "recurse", FALSE, NULL);
+	g_signal_connect (G_OBJECT (parser), "entry-parsed",
+			  G_CALLBACK (entry_parsed_cb), run);
+
+	return parser;
+}
+
+static void
+benchmark_parse (const BenchmarkFormat *format, guint n_entries, const char *uri, goffset bytes)
+{
+	XplayerPlParser *parser;
+	BenchmarkRun run;
+
+	benchmark_run_start (&run, format, n_entries, "parse");
+	run.bytes = bytes;
+	parser = benchmark_parser_new (&run);
+	run.result = xplayer_pl_parser_parse (parser, uri, FALSE);
+	run.end = g_get_monotonic_time ();
+	g_object_unref (parser);
+	benchmark_run_end (&run);
+}
+
+static void
+parse_async_cb (GObject *source_object,
+		GAsyncResult *result,
+		BenchmarkRun *run)
+{
+	run->result = xplayer_pl_parser_parse_finish (XPLAYER_PL_PARSER (source_object), result, NULL);
+	run->end = g_get_monotonic_time ();
+	g_main_loop_quit (run->loop);
+}
+
+static void
+benchmark_parse_async (const BenchmarkFormat *format, guint n_entries, const char *uri, goffset bytes)
+{
+	XplayerPlParser *parser;
+	BenchmarkRun run;
+
+	benchmark_run_start (&run, format, n_entries, "parse-async");
+	run.bytes = bytes;
+	run.loop = g_main_loop_new (NULL, FALSE);
+	parser = benchmark_parser_new (&run);
+	xplayer_pl_parser_parse_async (parser, uri, FALSE, NULL,
+				     (GAsyncReadyCallback) parse_async_cb, &run);
+	g_main_loop_run (run.loop);
+	g_main_loop_unref (run.loop);
+	g_object_unref (parser);
+	benchmark_run_end (&run);
+}
+
+static void
+benchmark_can_parse (const BenchmarkFormat *format, guint n_entries, const char *data, gsize len)
+{
+	BenchmarkRun run;
+	guint i;
+
+	benchmark_run_start (&run, format, n_entries, "can-parse-from-data");
+	run.iterations = SNIFF_ITERATIONS;
+	run.bytes = MIN (len, SNIFF_SIZE);
+	for (i = 0; i < SNIFF_ITERATIONS; i++) {
+		if (xplayer_pl_parser_can_parse_from_data (data, run.bytes, FALSE) != FALSE)
+			run.result = XPLAYER_PL_PARSER_RESULT_SUCCESS;
+	}
+	benchmark_run_end (&run);
+}
+
+static void
+benchmark_save (const BenchmarkFormat *format, guint n_entries, const char *dir)
+{
+	XplayerPlParser *parser;
+	XplayerPlPlaylist *playlist;
+	XplayerPlPlaylistIter iter;
+	BenchmarkRun run;
+	GFile *file;
+	GFileInfo *info;
+	char *path;
+	guint i;
+
+	playlist = xplayer_pl_playlist_new ();
+	for (i = 0; i < n_entries; i++) {
+		char *uri, *title;
+
+		uri = g_strdup_printf (ENTRY_URI, i);
+		title = g_strdup_printf (ENTRY_TITLE, i % 1000);
+		xplayer_pl_playlist_append (playlist, &iter);
+		xplayer_pl_playlist_set (playlist, &iter,
+				       XPLAYER_PL_PARSER_FIELD_URI, uri,
+				       XPLAYER_PL_PARSER_FIELD_TITLE, title,
+				       NULL);
+		g_free (uri);
+		g_free (title);
+	}
+
+	path = g_strdup_printf ("%s/saved.%s", dir, format->suffix);
+	file = g_file_new_for_path (path);
+	parser = xplayer_pl_parser_new ();
+
+	benchmark_run_start (&run, format, n_entries, "save");
+	if (xplayer_pl_parser_save (parser, playlist, file, "Benchmark", format->save_type, NULL) != FALSE) {
+		run.result = XPLAYER_PL_PARSER_RESULT_SUCCESS;
+		run.entries = n_entries;
+	} else {
+		run.result = XPLAYER_PL_PARSER_RESULT_ERROR;
+	}
+	run.end = g_get_monotonic_time ();
+
+	info = g_file_query_info (file, G_FILE_ATTRIBUTE_STANDARD_SIZE, G_FILE_QUERY_INFO_NONE, NULL, NULL);
+	if (info != NULL) {
+		run.bytes = g_file_info_get_size (info);
+		g_object_unref (info);
+	}
+	benchmark_run_end (&run);
+
+	g_object_unref (parser);
+	g_object_unref (playlist);
+	g_unlink (path);
+	g_object_unref (file);
+	g_free (path);
+}
+
+static void
+benchmark_format (const BenchmarkFormat *format, const char *dir)
+{
+	guint i;
+
+	for (i = 0; i < G_N_ELEMENTS (sizes); i++) {
+		GString *data;
+		GFile *file;
+		GError *error = NULL;
+		char *path, *uri;
+
+		if (sizes[i] > (guint) option_max_entries)
+			break;
+
+		data = g_string_new (NULL);
+		format->generate (data, sizes[i]);
+		path = g_strdup_printf ("%s/playlist.%s", dir, format->suffix);
+		if (g_file_set_contents (path, data->str, data->len, &error) == FALSE) {
+			g_printerr ("Couldn't write '%s': %s\n", path, error->message);
+			g_error_free (error);
+			g_string_free (data, TRUE);
+			g_free (path);
+			continue;
+		}
+		file = g_file_new_for_path (path);
+		uri = g_file_get_uri (file);
+
+		/* Sniffing only ever looks at the start of the file */
+		if (i == 0)
+			benchmark_can_parse (format, sizes[i], data->str, data->len);
+		benchmark_parse (format, sizes[i], uri, data->len);
+		benchmark_parse_async (format, sizes[i], uri, data->len);
+
+		/* XplayerPlPlaylist iterators are checked by walking the whole
+		 * list, so saving gets slower with the square of the size */
+		if (format->save_type != NO_SAVE && sizes[i] <= (guint) option_max_save_entries)
+			benchmark_save (format, sizes[i], dir);
+
+		g_unlink (path);
+		g_object_unref (file);
+		g_free (uri);
+		g_free (path);
+		g_string_free (data, TRUE);
+	}
+}
+
+int
+main (int argc, char *argv[])
+{
+	GError *error = NULL;
+	GOptionContext *context;
+	char *dir;
+	guint i;
+	const GOptionEntry entries[] = {
+		{ "max-entries", 'n', 0, G_OPTION_ARG_INT, &option_max_entries, "Largest playlist to benchmark", "ENTRIES" },
+		{ "max-save-entries", 's', 0, G_OPTION_ARG_INT, &option_max_save_entries, "Largest playlist to save", "ENTRIES" },
+		{ "format", 'f', 0, G_OPTION_ARG_STRING, &option_format, "Only benchmark this format", "FORMAT" },
+		{ "output", 'o', 0, G_OPTION_ARG_FILENAME, &option_output, "Write the results to this file", "FILE" },
+		{ NULL }
+	};
+
+	setlocale (LC_ALL, "");
+
+	g_type_init ();
+
+	context = g_option_context_new ("- benchmark the playlist parser");
+	g_option_context_add_main_entries (context, entries, GETTEXT_PACKAGE);
+
+	if (g_option_context_parse (context, &argc, &argv, &error) == FALSE) {
+		g_print ("Option parsing failed: %s\n", error->message);
+		return 1;
+	}
+	g_option_context_free (context);
+
+	output = stdout;
+	if (option_output != NULL) {
+		output = fopen (option_output, "w");
+		if (output == NULL) {
+			g_print ("Couldn't open '%s'\n", option_output);
+			return 1;
+		}
+	}
+
+	dir = g_dir_make_tmp ("xplayer-pl-parser-benchmark-XXXXXX", &error);
+	if (dir == NULL) {
+		g_print ("Couldn't create a temporary directory: %s\n", error->message);
+		return 1;
+	}
+
+	for (i = 0; i < G_N_ELEMENTS (formats); i++) {
+		if (option_format != NULL && g_strcmp0 (option_format, formats[i].name) != 0)
+			continue;
+		benchmark_format (&formats[i], dir);
+	}
+
+	g_rmdir (dir);
+	g_free (dir);
+
+	if (output != stdout)
+		fclose (output);
+
+	return 0;
+}
@@ -11,6 +11,8 @@
 #endif /* HAVE_UNISTD_H */
 #include <stdlib.h>
 #include <time.h>
+#include <glib/gstdio.h>
+#include <libsoup/soup.h>
 
 #include "xplayer-pl-parser.h"
 #include "xplayer-pl-parser-mini.h"
@@ -202,6 +204,20 @@ test_videosite (void)
 	g_test_message ("Testing data parsing \"%s\"...", uri);
 	g_assert (xplayer_pl_parser_can_parse_from_uri (uri, TRUE));
 }
+
+static void
+test_videosite_cache (void)
+{
+	guint64 hits, misses, new_hits, new_misses;
+
+	/* Same site, so only the first check should need the helper */
+	g_assert (xplayer_pl_parser_can_parse_from_uri ("http://www.youtube.com/watch?v=oMLCrzy9TEs", TRUE));
+	xplayer_pl_parser_get_videosite_cache_stats (&hits, &misses);
+	g_assert (xplayer_pl_parser_can_parse_from_uri ("http://www.youtube.com/watch?v=5AYQdCgnGQI", TRUE));
+	xplayer_pl_parser_get_videosite_cache_stats (&new_hits, &new_misses);
+	g_assert_cmpuint (new_hits, ==, hits + 1);
+	g_assert_cmpuint (new_misses, ==, misses);
+}
 #endif
 
 static void
@@ -318,6 +334,26 @@ parser_test_get_num_entries (const char *uri)
 	return ret;
 }
 
+static guint
+parser_test_get_num_feed_entries (const char *uri, guint max_items, guint64 min_date)
+{
+	guint ret = 0;
+	XplayerPlParser *pl = xplayer_pl_parser_new ();
+
+	g_object_set (pl, "recurse", FALSE,
+			  "debug", option_debug,
+			  "max-items", max_items,
+			  "min-date", min_date,
+			  NULL);
+	g_signal_connect (G_OBJECT (pl), "entry-parsed",
+			  G_CALLBACK (entry_parsed_num_cb), &ret);
+
+	xplayer_pl_parser_parse_with_base (pl, uri, option_base_uri, FALSE);
+	g_object_unref (pl);
+
+	return ret;
+}
+
 typedef struct {
 	gboolean pl_started;
 	gboolean parsed_item;
@@ -630,6 +666,17 @@ test_m3u_leading_tabs (void)
 	g_free (uri);
 }
 
+static void
+test_m3u_mixed_line_endings (void)
+{
+	char *uri;
+	/* CR, LF and CRLF line endings, and no newline at the end */
+	uri = get_relative_uri (TEST_SRCDIR "mixed-line-endings.m3u");
+	g_assert_cmpuint (parser_test_get_num_entries (uri), ==, 2);
+	g_assert_cmpstr (parser_test_get_entry_field (uri, XPLAYER_PL_PARSER_FIELD_TITLE), ==, "First");
+	g_free (uri);
+}
+
 static void
 test_directory_recurse (void)
 {
@@ -647,6 +694,139 @@ test_directory_recurse (void)
 	g_free (uri);
 }
 
+static void
+entry_parsed_uris_cb (XplayerPlParser *parser,
+		      const char *uri,
+		      GHashTable *metadata,
+		      GPtrArray *uris)
+{
+	g_ptr_array_add (uris, g_path_get_basename (uri));
+}
+
+/* Creates a temporary directory holding a small MP3 file for each
+ * of @names, which can be in subdirectories */
+static char *
+make_media_dir (const char * const *names, guint n_names)
+{
+	GError *error = NULL;
+	char *dir;
+	guint i;
+
+	dir = g_dir_make_tmp ("xplayer-pl-parser-dir-XXXXXX", &error);
+	g_assert_no_error (error);
+	for (i = 0; i < n_names; i++) {
+		char *path, *parent;
+
+		path = g_build_filename (dir, names[i], NULL);
+		parent = g_path_get_dirname (path);
+		g_mkdir_with_parents (parent, 0755);
+		g_file_set_contents (path, "ID3\3\0\0\0\0\0\0", 10, &error);
+		g_assert_no_error (error);
+		g_free (parent);
+		g_free (path);
+	}
+
+	return dir;
+}
+
+static void
+remove_dir_recursive (const char *dir)
+{
+	GDir *gdir;
+	const char *name;
+
+	gdir = g_dir_open (dir, 0, NULL);
+	if (gdir != NULL) {
+		while ((name = g_dir_read_name (gdir)) != NULL) {
+			char *path;
+
+			path = g_build_filename (dir, name, NULL);
+			if (g_file_test (path, G_FILE_TEST_IS_DIR) != FALSE &&
+			    g_file_test (path, G_FILE_TEST_IS_SYMLINK) == FALSE)
+				remove_dir_recursive (path);
+			else
+				g_unlink (path);
+			g_free (path);
+		}
+		g_dir_close (gdir);
+	}
+	g_rmdir (dir);
+}
+
+static void
+test_directory_order (void)
+{
+	const char *names[] = { "b.mp3", ".hidden.mp3", "a10.mp3", "a2.mp3" };
+	const char *sorted[] = { "a2.mp3", "a10.mp3", "b.mp3", ".hidden.mp3" };
+	XplayerPlParser *pl;
+	GPtrArray *uris;
+	char *dir, *uri;
+	guint i;
+
+	dir = make_media_dir (names, G_N_ELEMENTS (names));
+	uri = g_filename_to_uri (dir, NULL, NULL);
+
+	/* Sorted like a file manager would, hidden files last */
+	pl = xplayer_pl_parser_new ();
+	g_object_set (pl, "recurse", TRUE, "debug", option_debug, NULL);
+	uris = g_ptr_array_new_with_free_func (g_free);
+	g_signal_connect (G_OBJECT (pl), "entry-parsed",
+			  G_CALLBACK (entry_parsed_uris_cb), uris);
+	g_assert (xplayer_pl_parser_parse (pl, uri, FALSE) == XPLAYER_PL_PARSER_RESULT_SUCCESS);
+	g_assert_cmpuint (uris->len, ==, G_N_ELEMENTS (sorted));
+	for (i = 0; i < uris->len; i++)
+		g_assert_cmpstr (g_ptr_array_index (uris, i), ==, sorted[i]);
+
+	/* Unsorted, all the entries are still there */
+	g_ptr_array_set_size (uris, 0);
+	g_object_set (pl, "sort-directories", FALSE, NULL);
+	g_assert (xplayer_pl_parser_parse (pl, uri, FALSE) == XPLAYER_PL_PARSER_RESULT_SUCCESS);
+	g_assert_cmpuint (uris->len, ==, G_N_ELEMENTS (sorted));
+
+	g_ptr_array_free (uris, TRUE);
+	g_object_unref (pl);
+	g_free (uri);
+
+	remove_dir_recursive (dir);
+	g_free (dir);
+}
+
+static void
+test_directory_workers (void)
+{
+	const char *names[] = { "b/y.mp3", "a/x.mp3", "a/c/z.mp3", "w.mp3" };
+	const char *sorted[] = { "z.mp3", "x.mp3", "y.mp3", "w.mp3" };
+	XplayerPlParser *pl;
+	GPtrArray *uris;
+	char *dir, *uri;
+	guint i, workers;
+
+	dir = make_media_dir (names, G_N_ELEMENTS (names));
+	uri = g_filename_to_uri (dir, NULL, NULL);
+
+	/* Listing subdirectories in parallel doesn't change the order */
+	pl = xplayer_pl_parser_new ();
+	g_object_set (pl, "recurse", TRUE, "debug", option_debug, NULL);
+	uris = g_ptr_array_new_with_free_func (g_free);
+	g_signal_connect (G_OBJECT (pl), "entry-parsed",
+			  G_CALLBACK (entry_parsed_uris_cb), uris);
+	for (workers = 1; workers <= 4; workers++) {
+		g_ptr_array_set_size (uris, 0);
+		g_object_set (pl, "directory-workers", workers, NULL);
+		g_assert (xplayer_pl_parser_parse (pl, uri, FALSE) == XPLAYER_PL_PARSER_RESULT_SUCCESS);
+		g_assert_cmpuint (uris->len, ==, G_N_ELEMENTS (sorted));
+		for (i = 0; i < uris->len; i++)
+			g_assert_cmpstr (g_ptr_array_index (uris, i), ==, sorted[i]);
+	}
+
+	g_ptr_array_free (uris, TRUE);
+	g_object_unref (pl);
+	g_free (uri);
+
+	remove_dir_recursive (dir);
+	g_free (dir);
+}
+
 static void
 test_empty_asx (void)
 {
@@ -875,6 +1055,22 @@ test_parsing_live_streaming (void)
 	g_free (uri);
 }
 
+static void
+test_parsing_iso_image (void)
+{
+	char *uri, *mrl, *title;
+
+	/* DVD image with a VIDEO_TS/VIDEO_TS.IFO file, labelled "MY_DVD" */
+	uri = get_relative_uri (TEST_SRCDIR "dvd-image.iso");
+	mrl = parser_test_get_entry_field (uri, XPLAYER_PL_PARSER_FIELD_URI);
+	g_assert_cmpstr (mrl, ==, "dvd://" TEST_SRCDIR "dvd-image.iso");
+	title = parser_test_get_entry_field (uri, XPLAYER_PL_PARSER_FIELD_TITLE);
+	g_assert_cmpstr (title, ==, "MY_DVD");
+	g_free (title);
+	g_free (mrl);
+	g_free (uri);
+}
+
 static void
 test_parsing_xml_mixed_cdata (void)
 {
@@ -886,6 +1082,33 @@ test_parsing_xml_mixed_cdata (void)
 	g_free (uri);
 }
 
+static void
+test_parsing_rss_streaming (void)
+{
+	char *uri;
+
+	/* Items are sent as soon as they're parsed, after the channel metadata */
+	uri = get_relative_uri (TEST_SRCDIR "585407.rss");
+	g_assert (parser_test_get_order_result (uri));
+	g_assert_cmpuint (parser_test_get_num_entries (uri), ==, 29);
+	g_assert_cmpstr (parser_test_get_playlist_field (uri, XPLAYER_PL_PARSER_FIELD_TITLE), ==, "David Allen Company Podcast");
+	g_free (uri);
+}
+
+static void
+test_parsing_feed_window (void)
+{
+	char *uri;
+
+	/* Items are newest first, 5 of them after 2009-10-01 */
+	uri = get_relative_uri (TEST_SRCDIR "585407.rss");
+	g_assert_cmpuint (parser_test_get_num_feed_entries (uri, 3, 0), ==, 3);
+	g_assert_cmpuint (parser_test_get_num_feed_entries (uri, 0, 1254355200), ==, 5);
+	g_assert_cmpuint (parser_test_get_num_feed_entries (uri, 3, 1254355200), ==, 3);
+	g_assert_cmpuint (parser_test_get_num_feed_entries (uri, 100, 0), ==, 29);
+	g_free (uri);
+}
+
 static void
 test_parsing_m3u_streaming (void)
 {
@@ -898,6 +1121,15 @@ test_parsing_m3u_streaming (void)
 	g_free (uri);
 }
 
+static void
+test_parsing_rss_html_entities (void)
+{
+	char *uri;
+	uri = get_relative_uri (TEST_SRCDIR "html-entities.rss");
+	g_assert_cmpstr (parser_test_get_entry_field (uri, XPLAYER_PL_PARSER_FIELD_TITLE), ==, "Caf\xc3\xa9\xc2\xa0&\xc2\xa0" "Bar \xe2\x80\x93 \xe2\x98\xba &bogus;");
+	g_free (uri);
+}
+
 #ifdef HAVE_QUVI
 static void
 test_parsing_rss_id (void)
@@ -918,6 +1150,26 @@ test_parsing_rss_link (void)
 }
 #endif /* HAVE_QUVI */
 
+static void
+test_parsing_nul_in_name (void)
+{
+	char *uri;
+	/* Names with nuls in them used to be read past the end of
+	 * the shorter names they were compared with */
+	uri = get_relative_uri (TEST_SRCDIR "nul-in-name.rss");
+	g_assert_cmpuint (parser_test_get_num_entries (uri), ==, 0);
+	g_free (uri);
+}
+
+static void
+test_parsing_rss_no_root (void)
+{
+	char *uri;
+	uri = get_relative_uri (TEST_SRCDIR "no-root.rss");
+	g_assert (simple_parser_test (uri) == XPLAYER_PL_PARSER_RESULT_ERROR);
+	g_free (uri);
+}
+
 static void
 test_parsing_not_asx_playlist (void)
 {
@@ -986,6 +1238,92 @@ parse_async_ready (GObject *pl, GAsyncResult *result, gpointer userdata)
 	g_object_unref (pl);
 }
 
+static void
+watch_entry_added_cb (XplayerPlParser *parser,
+		      const char *uri,
+		      GHashTable *metadata,
+		      AsyncParseData *data)
+{
+	g_free (data->uri);
+	data->uri = g_path_get_basename (uri);
+	data->count++;
+	g_main_loop_quit (data->mainloop);
+}
+
+static void
+watch_entry_removed_cb (XplayerPlParser *parser,
+			const char *uri,
+			AsyncParseData *data)
+{
+	g_free (data->uri);
+	data->uri = g_path_get_basename (uri);
+	data->count--;
+	g_main_loop_quit (data->mainloop);
+}
+
+static gboolean
+watch_timeout_cb (AsyncParseData *data)
+{
+	g_main_loop_quit (data->mainloop);
+	return G_SOURCE_REMOVE;
+}
+
+static void
+watch_wait (AsyncParseData *data)
+{
+	guint id;
+
+	id = g_timeout_add_seconds (5, (GSourceFunc) watch_timeout_cb, data);
+	g_main_loop_run (data->mainloop);
+	g_source_remove (id);
+}
+
+static void
+test_watch (void)
+{
+	const char *names[] = { "a.mp3" };
+	AsyncParseData data = { 0, NULL, NULL };
+	XplayerPlParser *pl;
+	GError *error = NULL;
+	char *dir, *uri, *path;
+
+	dir = make_media_dir (names, G_N_ELEMENTS (names));
+	uri = g_filename_to_uri (dir, NULL, NULL);
+
+	pl = xplayer_pl_parser_new ();
+	g_object_set (pl, "recurse", TRUE, "debug", option_debug, NULL);
+	g_signal_connect (G_OBJECT (pl), "entry-added",
+			  G_CALLBACK (watch_entry_added_cb), &data);
+	g_signal_connect (G_OBJECT (pl), "entry-removed",
+			  G_CALLBACK (watch_entry_removed_cb), &data);
+	data.mainloop = g_main_loop_new (NULL, FALSE);
+	g_assert (xplayer_pl_parser_watch (pl, uri) == XPLAYER_PL_PARSER_RESULT_SUCCESS);
+
+	/* New files show up... */
+	path = g_build_filename (dir, "b.mp3", NULL);
+	g_file_set_contents (path, "ID3\3\0\0\0\0\0\0", 10, &error);
+	g_assert_no_error (error);
+	watch_wait (&data);
+	g_assert_cmpint (data.count, ==, 1);
+	g_assert_cmpstr (data.uri, ==, "b.mp3");
+
+	/* ...and disappear */
+	g_unlink (path);
+	g_free (path);
+	watch_wait (&data);
+	g_assert_cmpint (data.count, ==, 0);
+	g_assert_cmpstr (data.uri, ==, "b.mp3");
+
+	xplayer_pl_parser_unwatch (pl, uri);
+	g_object_unref (pl);
+	g_main_loop_unref (data.mainloop);
+	g_free (data.uri);
+	g_free (uri);
+
+	remove_dir_recursive (dir);
+	g_free (dir);
+}
+
 static gboolean
 block_main_loop_idle (gpointer data)
 {
@@ -1030,6 +1368,482 @@ test_async_parsing_signal_order (void)
 	g_main_loop_unref (data.mainloop);
 }
 
+static void
+parse_stats_cb (XplayerPlParser *parser,
+		XplayerPlParserStats *stats,
+		XplayerPlParserStats **ret)
+{
+	g_assert (*ret == NULL);
+	*ret = xplayer_pl_parser_stats_copy (stats);
+}
+
+static void
+parse_stats_async_ready (GObject *pl, GAsyncResult *result, gpointer userdata)
+{
+	XplayerPlParserStats **ret = userdata;
+
+	g_assert_cmpint (xplayer_pl_parser_parse_finish (XPLAYER_PL_PARSER (pl), result, NULL), ==, XPLAYER_PL_PARSER_RESULT_SUCCESS);
+	*ret = xplayer_pl_parser_parse_get_stats (XPLAYER_PL_PARSER (pl), result);
+}
+
+static void
+test_parsing_stats (void)
+{
+	XplayerPlParser *pl;
+	XplayerPlParserStats *stats, *sync_stats, *async_stats;
+	char *uri;
+
+	uri = get_relative_uri (TEST_SRCDIR "mixed-line-endings.m3u");
+	pl = xplayer_pl_parser_new ();
+	g_object_set (pl, "recurse", FALSE, NULL);
+	stats = NULL;
+	g_signal_connect (G_OBJECT (pl), "parse-stats",
+			  G_CALLBACK (parse_stats_cb), &stats);
+
+	g_assert_cmpint (xplayer_pl_parser_parse (pl, uri, FALSE), ==, XPLAYER_PL_PARSER_RESULT_SUCCESS);
+	g_assert (stats != NULL);
+	g_assert_cmpuint (stats->entries_emitted, ==, 2);
+	g_assert_cmpuint (stats->entries_ignored, ==, 0);
+	g_assert_cmpuint (stats->playlists_visited, ==, 0);
+	g_assert_cmpuint (stats->files_opened, >=, 1);
+	g_assert_cmpuint (stats->bytes_read, >, 0);
+	g_assert_cmpuint (stats->http_requests, ==, 0);
+	/* The stages don't overlap */
+	g_assert_cmpint (stats->total_time, ==, stats->sniff_time + stats->load_time + stats->xml_time +
+			 stats->resolve_time + stats->dispatch_time + stats->parse_time);
+
+	/* The same stats come with asynchronous parses, through the
+	 * signal as well as from the result */
+	sync_stats = stats;
+	stats = NULL;
+	async_stats = NULL;
+	xplayer_pl_parser_parse_async (g_object_ref (pl), uri, FALSE, NULL, parse_stats_async_ready, &async_stats);
+	while (async_stats == NULL || stats == NULL)
+		g_main_context_iteration (NULL, TRUE);
+	g_assert_cmpuint (async_stats->entries_emitted, ==, sync_stats->entries_emitted);
+	g_assert_cmpuint (async_stats->bytes_read, ==, sync_stats->bytes_read);
+	g_assert_cmpint (async_stats->total_time, ==, stats->total_time);
+	xplayer_pl_parser_stats_free (async_stats);
+	xplayer_pl_parser_stats_free (sync_stats);
+	xplayer_pl_parser_stats_free (stats);
+
+	/* Entries dropped by the ignore rules are counted */
+	stats = NULL;
+	xplayer_pl_parser_add_ignored_scheme (pl, "file");
+	g_assert_cmpint (xplayer_pl_parser_parse (pl, uri, FALSE), ==, XPLAYER_PL_PARSER_RESULT_UNHANDLED);
+	g_assert (stats != NULL);
+	g_assert_cmpuint (stats->entries_ignored, ==, 1);
+	g_assert_cmpuint (stats->entries_emitted, ==, 0);
+	xplayer_pl_parser_stats_free (stats);
+
+	g_object_unref (pl);
+	g_free (uri);
+}
+
+#ifdef HAVE_SOUP_SERVER_LISTEN
+#define CACHE_TEST_ETAG "\"xplayer-cache-test\""
+#define CACHE_TEST_PLAYLIST "[playlist]\nNumberOfEntries=2\nFile1=http://example.com/1.ogg\nFile2=http://example.com/2.ogg\n"
+
+typedef struct {
+	guint probes;
+	guint requests;
+	guint not_modified;
+} CacheServerData;
+
+static void
+cache_server_cb (SoupServer *server,
+		 SoupMessage *msg,
+		 const char *path,
+		 GHashTable *query,
+		 SoupClientContext *client,
+		 CacheServerData *data)
+{
+	/* Ranged requests only sniff the type */
+	if (soup_message_headers_get_one (msg->request_headers, "Range") != NULL)
+		data->probes++;
+	else
+		data->requests++;
+
+	soup_message_headers_replace (msg->response_headers, "ETag", CACHE_TEST_ETAG);
+	if (g_strcmp0 (soup_message_headers_get_one (msg->request_headers, "If-None-Match"), CACHE_TEST_ETAG) == 0) {
+		data->not_modified++;
+		soup_message_set_status (msg, SOUP_STATUS_NOT_MODIFIED);
+		return;
+	}
+
+	soup_message_set_status (msg, SOUP_STATUS_OK);
+	soup_message_set_response (msg, "audio/x-scpls", SOUP_MEMORY_STATIC,
+				   CACHE_TEST_PLAYLIST, strlen (CACHE_TEST_PLAYLIST));
+}
+
+static void
+test_parsing_http_cache (void)
+{
+	CacheServerData server_data = { 0, 0, 0 };
+	AsyncParseData data;
+	XplayerPlParser *pl;
+	SoupServer *server;
+	GSList *uris;
+	SoupURI *base, *playlist;
+	GError *error = NULL;
+	char *cache_dir;
+	guint i;
+
+	cache_dir = make_media_dir (NULL, 0);
+
+	/* The parse happens in a thread, and the server answers from the main loop */
+	server = soup_server_new (NULL, NULL);
+	soup_server_add_handler (server, NULL, (SoupServerCallback) cache_server_cb, &server_data, NULL);
+	soup_server_listen_local (server, 0, 0, &error);
+	g_assert_no_error (error);
+	uris = soup_server_get_uris (server);
+	base = uris->data;
+	playlist = soup_uri_new_with_base (base, "/playlist.pls");
+	data.uri = soup_uri_to_string (playlist, FALSE);
+	g_slist_free_full (uris, (GDestroyNotify) soup_uri_free);
+	soup_uri_free (playlist);
+
+	pl = xplayer_pl_parser_new ();
+	g_object_set (pl, "recurse", FALSE,
+			  "debug", option_debug,
+			  "cache-dir", cache_dir,
+			  NULL);
+	g_signal_connect (G_OBJECT (pl), "entry-parsed",
+			  G_CALLBACK (entry_parsed_num_cb), &data.count);
+
+	/* The second parse revalidates the cached copy, and gets a 304 */
+	data.mainloop = g_main_loop_new (NULL, FALSE);
+	for (i = 0; i < 2; i++) {
+		data.count = 0;
+		xplayer_pl_parser_parse_async (g_object_ref (pl), data.uri, FALSE, NULL, parse_async_ready, &data);
+		g_main_loop_run (data.mainloop);
+		g_assert_cmpint (data.count, ==, 2);
+	}
+	g_assert_cmpuint (server_data.probes, ==, 2);
+	g_assert_cmpuint (server_data.requests, ==, 2);
+	g_assert_cmpuint (server_data.not_modified, ==, 1);
+
+	g_object_unref (pl);
+	g_main_loop_unref (data.mainloop);
+	g_free (data.uri);
+	soup_server_disconnect (server);
+	g_object_unref (server);
+
+	remove_dir_recursive (cache_dir);
+	g_free (cache_dir);
+}
+
+#define CACHE_TEST_STREAM_SIZE (1024 * 1024)
+
+static void
+stream_server_cb (SoupServer *server,
+		  SoupMessage *msg,
+		  const char *path,
+		  GHashTable *query,
+		  SoupClientContext *client,
+		  CacheServerData *data)
+{
+	char *body;
+
+	if (soup_message_headers_get_one (msg->request_headers, "Range") != NULL)
+		data->probes++;
+	else
+		data->requests++;
+
+	/* Stands in for a radio stream, which would never end */
+	body = g_malloc0 (CACHE_TEST_STREAM_SIZE);
+	memcpy (body, "ID3\3\0\0\0\0\0\0", 10);
+	soup_message_headers_replace (msg->response_headers, "ETag", CACHE_TEST_ETAG);
+	soup_message_set_status (msg, SOUP_STATUS_OK);
+	soup_message_set_response (msg, "audio/mpeg", SOUP_MEMORY_TAKE,
+				   body, CACHE_TEST_STREAM_SIZE);
+}
+
+static void
+parse_async_result_ready (GObject *pl, GAsyncResult *result, gpointer userdata)
+{
+	AsyncParseData *data = userdata;
+
+	xplayer_pl_parser_parse_finish (XPLAYER_PL_PARSER (pl), result, NULL);
+	g_main_loop_quit (data->mainloop);
+	g_object_unref (pl);
+}
+
+static void
+test_parsing_http_cache_media (void)
+{
+	CacheServerData server_data = { 0, 0, 0 };
+	AsyncParseData data;
+	XplayerPlParser *pl;
+	SoupServer *server;
+	GSList *uris;
+	SoupURI *base, *stream;
+	GError *error = NULL;
+	GDir *dir;
+	char *cache_dir;
+
+	cache_dir = make_media_dir (NULL, 0);
+
+	server = soup_server_new (NULL, NULL);
+	soup_server_add_handler (server, NULL, (SoupServerCallback) stream_server_cb, &server_data, NULL);
+	soup_server_listen_local (server, 0, 0, &error);
+	g_assert_no_error (error);
+	uris = soup_server_get_uris (server);
+	base = uris->data;
+	stream = soup_uri_new_with_base (base, "/stream");
+	data.uri = soup_uri_to_string (stream, FALSE);
+	g_slist_free_full (uris, (GDestroyNotify) soup_uri_free);
+	soup_uri_free (stream);
+
+	pl = xplayer_pl_parser_new ();
+	g_object_set (pl, "recurse", FALSE,
+			  "debug", option_debug,
+			  "cache-dir", cache_dir,
+			  NULL);
+	g_signal_connect (G_OBJECT (pl), "entry-parsed",
+			  G_CALLBACK (entry_parsed_num_cb), &data.count);
+
+	/* Media files are only sniffed, never fetched whole nor cached */
+	data.count = 0;
+	data.mainloop = g_main_loop_new (NULL, FALSE);
+	xplayer_pl_parser_parse_async (g_object_ref (pl), data.uri, FALSE, NULL, parse_async_result_ready, &data);
+	g_main_loop_run (data.mainloop);
+	g_assert_cmpint (data.count, ==, 0);
+	g_assert_cmpuint (server_data.probes, ==, 1);
+	g_assert_cmpuint (server_data.requests, ==, 0);
+
+	dir = g_dir_open (cache_dir, 0, NULL);
+	if (dir != NULL) {
+		g_assert (g_dir_read_name (dir) == NULL);
+		g_dir_close (dir);
+	}
+
+	g_object_unref (pl);
+	g_main_loop_unref (data.mainloop);
+	g_free (data.uri);
+	soup_server_disconnect (server);
+	g_object_unref (server);
+
+	remove_dir_recursive (cache_dir);
+	g_free (cache_dir);
+}
+#endif /* HAVE_SOUP_SERVER_LISTEN */
+
+static void
+test_parsing_result_cache (void)
+{
+	const char *first = "#EXTM3U\na.mp3\nb.mp3\n";
+	const char *second = "#EXTM3U\nc.mp3\nd.mp3\n";
+	const char *third = "#EXTM3U\ne.mp3\n";
+	XplayerPlParser *pl;
+	GFileIOStream *stream;
+	GFileInfo *info;
+	GPtrArray *uris;
+	GFile *file;
+	GError *error = NULL;
+	char *dir, *cache_dir, *path, *uri;
+
+	dir = make_media_dir (NULL, 0);
+	cache_dir = make_media_dir (NULL, 0);
+	path = g_build_filename (dir, "list.m3u", NULL);
+	g_file_set_contents (path, first, -1, &error);
+	g_assert_no_error (error);
+	file = g_file_new_for_path (path);
+	uri = g_file_get_uri (file);
+
+	pl = xplayer_pl_parser_new ();
+	g_object_set (pl, "recurse", FALSE,
+			  "debug", option_debug,
+			  "result-cache-dir", cache_dir,
+			  NULL);
+	uris = g_ptr_array_new_with_free_func (g_free);
+	g_signal_connect (G_OBJECT (pl), "entry-parsed",
+			  G_CALLBACK (entry_parsed_uris_cb), uris);
+
+	g_assert (xplayer_pl_parser_parse (pl, uri, FALSE) == XPLAYER_PL_PARSER_RESULT_SUCCESS);
+	g_assert_cmpuint (uris->len, ==, 2);
+	g_assert_cmpstr (g_ptr_array_index (uris, 0), ==, "a.mp3");
+
+	/* Rewrite the playlist in place, and put its modification time back,
+	 * so that the cached entries are replayed without reading it */
+	info = g_file_query_info (file, G_FILE_ATTRIBUTE_TIME_MODIFIED","G_FILE_ATTRIBUTE_TIME_MODIFIED_USEC,
+				  G_FILE_QUERY_INFO_NONE, NULL, &error);
+	g_assert_no_error (error);
+	stream = g_file_open_readwrite (file, NULL, &error);
+	g_assert_no_error (error);
+	g_output_stream_write_all (g_io_stream_get_output_stream (G_IO_STREAM (stream)),
+				   second, strlen (second), NULL, NULL, &error);
+	g_assert_no_error (error);
+	g_io_stream_close (G_IO_STREAM (stream), NULL, &error);
+	g_assert_no_error (error);
+	g_object_unref (stream);
+	g_file_set_attributes_from_info (file, info, G_FILE_QUERY_INFO_NONE, NULL, &error);
+	g_assert_no_error (error);
+	g_object_unref (info);
+
+	g_ptr_array_set_size (uris, 0);
+	g_assert (xplayer_pl_parser_parse (pl, uri, FALSE) == XPLAYER_PL_PARSER_RESULT_SUCCESS);
+	g_assert_cmpuint (uris->len, ==, 2);
+	g_assert_cmpstr (g_ptr_array_index (uris, 0), ==, "a.mp3");
+
+	/* Any real change to the playlist is picked up */
+	g_file_set_contents (path, third, -1, &error);
+	g_assert_no_error (error);
+	g_ptr_array_set_size (uris, 0);
+	g_assert (xplayer_pl_parser_parse (pl, uri, FALSE) == XPLAYER_PL_PARSER_RESULT_SUCCESS);
+	g_assert_cmpuint (uris->len, ==, 1);
+	g_assert_cmpstr (g_ptr_array_index (uris, 0), ==, "e.mp3");
+
+	g_ptr_array_free (uris, TRUE);
+	g_object_unref (pl);
+	g_object_unref (file);
+	g_free (uri);
+	g_free (path);
+
+	remove_dir_recursive (dir);
+	g_free (dir);
+	remove_dir_recursive (cache_dir);
+	g_free (cache_dir);
+}
+
+typedef struct {
+	GPtrArray *uris;
+	XplayerPlParser *nested;
+	char *nested_uri;
+} NestedParseData;
+
+static void
+entry_parsed_nested_cb (XplayerPlParser *parser,
+			const char *uri,
+			GHashTable *metadata,
+			NestedParseData *data)
+{
+	g_ptr_array_add (data->uris, g_path_get_basename (uri));
+	if (data->nested != NULL)
+		xplayer_pl_parser_parse (data->nested, data->nested_uri, FALSE);
+}
+
+static void
+test_parsing_result_cache_nested (void)
+{
+	NestedParseData data;
+	XplayerPlParser *pl;
+	GError *error = NULL;
+	char *dir, *cache_dir, *path, *uri;
+
+	dir = make_media_dir (NULL, 0);
+	cache_dir = make_media_dir (NULL, 0);
+	path = g_build_filename (dir, "outer.m3u", NULL);
+	g_file_set_contents (path, "#EXTM3U\na.mp3\nb.mp3\n", -1, &error);
+	g_assert_no_error (error);
+	uri = g_filename_to_uri (path, NULL, NULL);
+	g_free (path);
+	path = g_build_filename (dir, "inner.m3u", NULL);
+	g_file_set_contents (path, "#EXTM3U\nx.mp3\n", -1, &error);
+	g_assert_no_error (error);
+	data.nested_uri = g_filename_to_uri (path, NULL, NULL);
+	g_free (path);
+
+	pl = xplayer_pl_parser_new ();
+	g_object_set (pl, "recurse", FALSE,
+			  "debug", option_debug,
+			  "result-cache-dir", cache_dir,
+			  NULL);
+	data.uris = g_ptr_array_new_with_free_func (g_free);
+	data.nested = xplayer_pl_parser_new ();
+	g_signal_connect (G_OBJECT (pl), "entry-parsed",
+			  G_CALLBACK (entry_parsed_nested_cb), &data);
+
+	/* A parse started from a handler isn't recorded as part of the
+	 * playlist being parsed, so it isn't replayed with it either */
+	g_assert (xplayer_pl_parser_parse (pl, uri, FALSE) == XPLAYER_PL_PARSER_RESULT_SUCCESS);
+	g_assert_cmpuint (data.uris->len, ==, 2);
+	g_clear_object (&data.nested);
+
+	g_ptr_array_set_size (data.uris, 0);
+	g_assert (xplayer_pl_parser_parse (pl, uri, FALSE) == XPLAYER_PL_PARSER_RESULT_SUCCESS);
+	g_assert_cmpuint (data.uris->len, ==, 2);
+	g_assert_cmpstr (g_ptr_array_index (data.uris, 0), ==, "a.mp3");
+	g_assert_cmpstr (g_ptr_array_index (data.uris, 1), ==, "b.mp3");
+
+	g_ptr_array_free (data.uris, TRUE);
+	g_object_unref (pl);
+	g_free (data.nested_uri);
+	g_free (uri);
+
+	remove_dir_recursive (dir);
+	g_free (dir);
+	remove_dir_recursive (cache_dir);
+	g_free (cache_dir);
+}
+
+static void
+test_saving_binary (void)
+{
+	const char *names[] = { "a.mp3", "b.mp3", "c.mp3" };
+	XplayerPlParser *pl;
+	XplayerPlPlaylist *playlist;
+	XplayerPlPlaylistIter iter;
+	GPtrArray *uris;
+	GFile *file;
+	GError *error = NULL;
+	char *dir, *path, *uri, *title;
+	guint i;
+
+	dir = make_media_dir (NULL, 0);
+	path = g_build_filename (dir, "list.xplb", NULL);
+	file = g_file_new_for_path (path);
+	uri = g_file_get_uri (file);
+
+	/* The album is shared, and only stored once */
+	playlist = xplayer_pl_playlist_new ();
+	for (i = 0; i < G_N_ELEMENTS (names); i++) {
+		char *entry_uri;
+
+		entry_uri = g_strdup_printf ("file:///music/%s", names[i]);
+		xplayer_pl_playlist_append (playlist, &iter);
+		xplayer_pl_playlist_set (playlist, &iter,
+				       XPLAYER_PL_PARSER_FIELD_URI, entry_uri,
+				       XPLAYER_PL_PARSER_FIELD_ALBUM, "Album",
+				       NULL);
+		if (i == 0)
+			xplayer_pl_playlist_set (playlist, &iter, XPLAYER_PL_PARSER_FIELD_TITLE, "First", NULL);
+		g_free (entry_uri);
+	}
+
+	pl = xplayer_pl_parser_new ();
+	g_object_set (pl, "recurse", FALSE,
+			  "debug", option_debug,
+			  NULL);
+	g_assert (xplayer_pl_parser_save (pl, playlist, file, "Binary", XPLAYER_PL_PARSER_BINARY, &error) != FALSE);
+	g_assert_no_error (error);
+	g_object_unref (playlist);
+
+	uris = g_ptr_array_new_with_free_func (g_free);
+	g_signal_connect (G_OBJECT (pl), "entry-parsed",
+			  G_CALLBACK (entry_parsed_uris_cb), uris);
+	g_assert (xplayer_pl_parser_parse (pl, uri, FALSE) == XPLAYER_PL_PARSER_RESULT_SUCCESS);
+	g_assert_cmpuint (uris->len, ==, G_N_ELEMENTS (names));
+	for (i = 0; i < G_N_ELEMENTS (names); i++)
+		g_assert_cmpstr (g_ptr_array_index (uris, i), ==, names[i]);
+	g_ptr_array_free (uris, TRUE);
+	g_object_unref (pl);
+
+	title = parser_test_get_entry_field (uri, XPLAYER_PL_PARSER_FIELD_TITLE);
+	g_assert_cmpstr (title, ==, "First");
+	g_free (title);
+	title = parser_test_get_playlist_field (uri, XPLAYER_PL_PARSER_FIELD_TITLE);
+	g_assert_cmpstr (title, ==, "Binary");
+	g_free (title);
+
+	g_object_unref (file);
+	g_free (uri);
+	g_free (path);
+
+	remove_dir_recursive (dir);
+	g_free (dir);
+}
+
 #define MAX_DESCRIPTION_LEN 128
 #define DATE_BUFSIZE 512
 #define PRINT_DATE_FORMAT "%Y-%m-%dT%H:%M:%SZ"
@@ -1271,13 +2085,20 @@ main (int argc, char *argv[])
 		g_test_add_func ("/parser/parsing/single_line_rtsptext", test_parsing_rtsp_text);
 		g_test_add_func ("/parser/parsing/podcast_content_type", test_parsing_content_type);
 		g_test_add_func ("/parser/parsing/live_streaming", test_parsing_live_streaming);
+		g_test_add_func ("/parser/parsing/iso_image", test_parsing_iso_image);
 		g_test_add_func ("/parser/parsing/xml_mixed_cdata", test_parsing_xml_mixed_cdata);
+		g_test_add_func ("/parser/parsing/rss_streaming", test_parsing_rss_streaming);
+		g_test_add_func ("/parser/parsing/feed_window", test_parsing_feed_window);
 		g_test_add_func ("/parser/parsing/m3u_streaming", test_parsing_m3u_streaming);
+		g_test_add_func ("/parser/parsing/rss_html_entities", test_parsing_rss_html_entities);
 #ifdef HAVE_QUVI
 		g_test_add_func ("/parser/videosite", test_videosite);
+		g_test_add_func ("/parser/videosite_cache", test_videosite_cache);
 		g_test_add_func ("/parser/parsing/rss_id", test_parsing_rss_id);
 		g_test_add_func ("/parser/parsing/rss_link", test_parsing_rss_link);
 #endif /* HAVE_QUVI */
+		g_test_add_func ("/parser/parsing/nul_in_name", test_parsing_nul_in_name);
+		g_test_add_func ("/parser/parsing/rss_no_root", test_parsing_rss_no_root);
 		g_test_add_func ("/parser/parsing/not_asx_playlist", test_parsing_not_asx_playlist);
 		g_test_add_func ("/parser/parsing/not_really_php", test_parsing_not_really_php);
 		g_test_add_func ("/parser/parsing/not_really_php_but_html_instead", test_parsing_not_really_php_but_html_instead);
@@ -1291,10 +2112,22 @@ main (int argc, char *argv[])
 		g_test_add_func ("/parser/parsing/m3u_separator", test_m3u_separator);
 		g_test_add_func ("/parser/parsing/smi_starttime", test_smi_starttime);
 		g_test_add_func ("/parser/parsing/m3u_leading_tabs", test_m3u_leading_tabs);
+		g_test_add_func ("/parser/parsing/m3u_mixed_line_endings", test_m3u_mixed_line_endings);
 		g_test_add_func ("/parser/parsing/empty-asx.asx", test_empty_asx);
 		g_test_add_func ("/parser/parsing/emptyplaylist.pls", test_empty_pls);
 		g_test_add_func ("/parser/parsing/dir_recurse", test_directory_recurse);
+		g_test_add_func ("/parser/parsing/dir_order", test_directory_order);
+		g_test_add_func ("/parser/parsing/dir_workers", test_directory_workers);
+		g_test_add_func ("/parser/parsing/watch", test_watch);
 		g_test_add_func ("/parser/parsing/async_signal_order", test_async_parsing_signal_order);
+		g_test_add_func ("/parser/parsing/stats", test_parsing_stats);
+#ifdef HAVE_SOUP_SERVER_LISTEN
+		g_test_add_func ("/parser/parsing/http_cache", test_parsing_http_cache);
+		g_test_add_func ("/parser/parsing/http_cache_media", test_parsing_http_cache_media);
+#endif
+		g_test_add_func ("/parser/parsing/result_cache", test_parsing_result_cache);
+		g_test_add_func ("/parser/parsing/result_cache_nested", test_parsing_result_cache_nested);
+		g_test_add_func ("/parser/saving/binary", test_saving_binary);
 		g_test_add_func ("/parser/parsing/wma_asf", test_parsing_wma_asf);
 
 		return g_test_run ();
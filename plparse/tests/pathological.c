@@ -0,0 +1,293 @@
+#include "config.h"
+
+#include <locale.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <gio/gio.h>
+
+#include "xplayer-pl-parser.h"
+#include "test-support.h"
+
+/* Every input is generated with SMALL_SIZE repetitions of its hostile
+ * part, then SCALE times that. Parsing the larger one must not make
+ * more than SCALE * SLACK times as many allocations, nor, in slow mode,
+ * take more than SCALE * SLACK times as long: a quadratic path would
+ * need SCALE * SCALE times as much. Counts below MIN_ALLOCATIONS and
+ * timings below MIN_SECONDS are noise. */
+#define SMALL_SIZE 4096
+#define SCALE 16
+#define SLACK 4
+#define MIN_ALLOCATIONS 1000
+#define MIN_SECONDS 0.002
+#define RUNS 3
+
+/* The memory used while parsing must stay within this many times
+ * the size of the input, give or take MEMORY_SLACK KiB */
+#define MEMORY_FACTOR 64
+#define MEMORY_SLACK (64 * 1024)
+
+typedef void (*CorpusGenerator) (GString *out, guint n);
+
+typedef struct {
+	const char *name;
+	const char *suffix;
+	CorpusGenerator generate;
+} CorpusCase;
+
+/* Generators */
+
+#define XSPF_HEADER "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n" \
+	"<playlist version=\"1\" xmlns=\"http://xspf.org/ns/0/\"><trackList>\n"
+#define XSPF_TRACK "<track><location>file:///media/%u.mp3</location></track>\n"
+
+static void
+generate_xspf_comments (GString *out, guint n)
+{
+	guint i;
+
+	g_string_append (out, XSPF_HEADER);
+	for (i = 0; i < n; i++) {
+		g_string_append_printf (out, "<!-- comment %u -->", i);
+		g_string_append_printf (out, XSPF_TRACK, i);
+	}
+	g_string_append (out, "</trackList></playlist>\n");
+}
+
+static void
+generate_xspf_unterminated_comment (GString *out, guint n)
+{
+	guint i;
+
+	g_string_append (out, XSPF_HEADER);
+	g_string_append_printf (out, XSPF_TRACK, 0);
+	for (i = 0; i < n; i++)
+		g_string_append (out, "<!-- -- - ");
+}
+
+static void
+generate_rss_comments (GString *out, guint n)
+{
+	guint i;
+
+	g_string_append (out, "<?xml version=\"1.0\"?>\n<rss version=\"2.0\"><channel>\n");
+	for (i = 0; i < n; i++) {
+		g_string_append_printf (out, "<!-- comment %u --><item><title><!-- - -->Item</title>"
+					"<enclosure url=\"file:///media/%u.mp3\" type=\"audio/mpeg\"/></item>\n",
+					i, i);
+	}
+	g_string_append (out, "</channel></rss>\n");
+}
+
+static void
+generate_rss_unterminated_comment (GString *out, guint n)
+{
+	guint i;
+
+	g_string_append (out, "<?xml version=\"1.0\"?>\n<rss version=\"2.0\"><channel><!--");
+	for (i = 0; i < n; i++)
+		g_string_append (out, "-- - <!-- ");
+}
+
+static void
+generate_asx_deep_nesting (GString *out, guint n)
+{
+	guint i;
+
+	g_string_append (out, "<asx version=\"3.0\">");
+	for (i = 0; i < n; i++)
+		g_string_append (out, "<entry>");
+	g_string_append (out, "<ref href=\"file:///media/0.mp3\"/>");
+	for (i = 0; i < n; i++)
+		g_string_append (out, "</entry>");
+	g_string_append (out, "</asx>\n");
+}
+
+static void
+generate_asx_many_attributes (GString *out, guint n)
+{
+	guint i;
+
+	g_string_append (out, "<asx version=\"3.0\"><entry><ref ");
+	for (i = 0; i < n; i++)
+		g_string_append_printf (out, "a%u=\"x\" ", i);
+	g_string_append (out, "href=\"file:///media/0.mp3\"/></entry></asx>\n");
+}
+
+static void
+generate_pls_sparse (GString *out, guint n)
+{
+	guint i;
+
+	g_string_append_printf (out, "[playlist]\nNumberOfEntries=%u\n", n);
+	for (i = 0; i < n; i++)
+		g_string_append_printf (out, "File%u=file:///media/%u.mp3\n", i * 30000 + 1, i);
+	g_string_append (out, "Version=2\n");
+}
+
+static void
+generate_pls_repeated (GString *out, guint n)
+{
+	guint i;
+
+	g_string_append (out, "[playlist]\n");
+	for (i = 0; i < n; i++)
+		g_string_append_printf (out, "File1=file:///media/%u.mp3\nFile=x\n", i);
+}
+
+static void
+generate_m3u_long_line (GString *out, guint n)
+{
+	guint i;
+
+	g_string_append (out, "#EXTM3U\n#EXTINF:1,");
+	for (i = 0; i < n; i++)
+		g_string_append (out, "title title title title title title title title ");
+	g_string_append (out, "\nfile:///media/");
+	for (i = 0; i < n; i++)
+		g_string_append (out, "aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaa");
+	g_string_append (out, ".mp3\n");
+}
+
+static void
+generate_m3u_line_breaks (GString *out, guint n)
+{
+	guint i;
+
+	g_string_append (out, "#EXTM3U");
+	for (i = 0; i < n; i++)
+		g_string_append (out, "\r\r\n\n\r\n\r\r\r\n\n\n\r\n\r");
+	g_string_append (out, "file:///media/0.mp3\n");
+}
+
+static const CorpusCase corpus[] = {
+	{ "xspf-comments", "xspf", generate_xspf_comments },
+	{ "xspf-unterminated-comment", "xspf", generate_xspf_unterminated_comment },
+	{ "rss-comments", "rss", generate_rss_comments },
+	{ "rss-unterminated-comment", "rss", generate_rss_unterminated_comment },
+	{ "asx-deep-nesting", "asx", generate_asx_deep_nesting },
+	{ "asx-many-attributes", "asx", generate_asx_many_attributes },
+	{ "pls-sparse", "pls", generate_pls_sparse },
+	{ "pls-repeated", "pls", generate_pls_repeated },
+	{ "m3u-long-line", "m3u", generate_m3u_long_line },
+	{ "m3u-line-breaks", "m3u", generate_m3u_line_breaks },
+};
+
+/* Measurements */
+
+typedef struct {
+	double seconds;
+	gsize allocations;
+	gint64 memory;
+} Measurement;
+
+static void
+measure (const CorpusCase *corpus_case, guint n, const char *dir, Measurement *m)
+{
+	XplayerPlParser *parser;
+	GString *data;
+	GFile *file;
+	GError *error = NULL;
+	char *path, *uri;
+	guint run;
+
+	data = g_string_new (NULL);
+	corpus_case->generate (data, n);
+	path = g_strdup_printf ("%s/%s.%s", dir, corpus_case->name, corpus_case->suffix);
+	g_file_set_contents (path, data->str, data->len, &error);
+	g_assert_no_error (error);
+	file = g_file_new_for_path (path);
+	uri = g_file_get_uri (file);
+
+	parser = xplayer_pl_parser_new ();
+	g_object_set (parser, "recurse", FALSE, NULL);
+
+	m->seconds = G_MAXDOUBLE;
+	m->allocations = G_MAXSIZE;
+	m->memory = -1;
+	for (run = 0; run < RUNS; run++) {
+		gboolean peak_reset;
+		gint64 start, rss;
+		gsize allocations;
+
+		peak_reset = test_support_reset_peak_rss ();
+		rss = test_support_read_status ("VmRSS:");
+		allocations = test_support_allocations ();
+		start = g_get_monotonic_time ();
+
+		/* Whatever the result, it has to come quickly */
+		xplayer_pl_parser_parse (parser, uri, FALSE);
+
+		m->seconds = MIN (m->seconds, (g_get_monotonic_time () - start) / (double) G_USEC_PER_SEC);
+		m->allocations = MIN (m->allocations, test_support_allocations () - allocations);
+		if (peak_reset != FALSE && rss >= 0) {
+			gint64 peak;
+
+			peak = test_support_read_status ("VmHWM:");
+			if (peak >= 0 && (m->memory < 0 || peak - rss < m->memory))
+				m->memory = MAX (peak - rss, 0);
+		}
+	}
+
+	g_test_message ("%s: %u repetitions, %" G_GSIZE_FORMAT " bytes, %f seconds, %" G_GSIZE_FORMAT " allocations, %" G_GINT64_FORMAT " KiB",
+			corpus_case->name, n, data->len, m->seconds, m->allocations, m->memory);
+
+	if (m->memory >= 0)
+		g_assert_cmpint (m->memory, <=, MEMORY_FACTOR * (gint64) data->len / 1024 + MEMORY_SLACK);
+
+	g_object_unref (parser);
+	g_unlink (path);
+	g_object_unref (file);
+	g_free (uri);
+	g_free (path);
+	g_string_free (data, TRUE);
+}
+
+static void
+test_pathological (gconstpointer data)
+{
+	const CorpusCase *corpus_case = data;
+	Measurement small, large;
+	GError *error = NULL;
+	char *dir;
+
+	dir = g_dir_make_tmp ("xplayer-pl-parser-pathological-XXXXXX", &error);
+	g_assert_no_error (error);
+
+	measure (corpus_case, SMALL_SIZE, dir, &small);
+	measure (corpus_case, SMALL_SIZE * SCALE, dir, &large);
+
+#ifdef HAVE_ALLOCATION_COUNT
+	g_assert_cmpuint (large.allocations, <=, MAX (small.allocations, MIN_ALLOCATIONS) * SCALE * SLACK);
+#endif
+
+	/* Too noisy on loaded machines, or under valgrind or a sanitizer */
+	if (g_test_slow ())
+		g_assert_cmpfloat (large.seconds, <=, MAX (small.seconds, MIN_SECONDS) * SCALE * SLACK);
+
+	g_rmdir (dir);
+	g_free (dir);
+}
+
+int
+main (int argc, char *argv[])
+{
+	guint i;
+
+	setlocale (LC_ALL, "");
+
+	g_type_init ();
+	g_test_init (&argc, &argv, NULL);
+
+	for (i = 0; i < G_N_ELEMENTS (corpus); i++) {
+		char *path;
+
+		path = g_strdup_printf ("/pathological/%s", corpus[i].name);
+		g_test_add_data_func (path, &corpus[i], test_pathological);
+		g_free (path);
+	}
+
+	return g_test_run ();
+}
@@ -0,0 +1,107 @@
+#include "config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <glib.h>
+
+#ifdef G_OS_UNIX
+#include <sys/resource.h>
+#endif /* G_OS_UNIX */
+
+#include "test-support.h"
+
+/* Count the allocations by interposing the C library's allocator,
+ * which GLib's own allocator ends up calling */
+#ifdef HAVE_ALLOCATION_COUNT
+extern void *__libc_malloc (size_t size);
+extern void *__libc_calloc (size_t nmemb, size_t size);
+extern void *__libc_realloc (void *ptr, size_t size);
+
+static volatile gsize allocations = 0;
+
+void *
+malloc (size_t size)
+{
+	__sync_fetch_and_add (&allocations, 1);
+	return __libc_malloc (size);
+}
+
+void *
+calloc (size_t nmemb, size_t size)
+{
+	__sync_fetch_and_add (&allocations, 1);
+	return __libc_calloc (nmemb, size);
+}
+
+void *
+realloc (void *ptr, size_t size)
+{
+	__sync_fetch_and_add (&allocations, 1);
+	return __libc_realloc (ptr, size);
+}
+#endif /* HAVE_ALLOCATION_COUNT */
+
+/* The number of allocations made so far, or 0 if they aren't counted */
+gsize
+test_support_allocations (void)
+{
+#ifdef HAVE_ALLOCATION_COUNT
+	return __sync_fetch_and_add (&allocations, 0);
+#else
+	return 0;
+#endif
+}
+
+/* Returns whether the peak resident set size could be reset */
+gboolean
+test_support_reset_peak_rss (void)
+{
+#ifdef __linux__
+	FILE *clear_refs;
+
+	/* Writing 5 resets the peak resident set size, since Linux 4.0 */
+	clear_refs = fopen ("/proc/self/clear_refs", "w");
+	if (clear_refs == NULL)
+		return FALSE;
+	fputs ("5", clear_refs);
+	return fclose (clear_refs) == 0;
+#else
+	return FALSE;
+#endif /* __linux__ */
+}
+
+/* A field of /proc/self/status, in KiB, or -1 if unknown */
+gint64
+test_support_read_status (const char *field)
+{
+	char *status, *line;
+	gint64 value = -1;
+
+	if (g_file_get_contents ("/proc/self/status", &status, NULL, NULL) != FALSE) {
+		line = strstr (status, field);
+		if (line != NULL)
+			value = g_ascii_strtoll (line + strlen (field), NULL, 10);
+		g_free (status);
+	}
+
+	return value;
+}
+
+/* In KiB, or -1 if unknown */
+gint64
+test_support_peak_rss (void)
+{
+#ifdef __linux__
+	return test_support_read_status ("VmHWM:");
+#elif defined (G_OS_UNIX)
+	struct rusage usage;
+
+	if (getrusage (RUSAGE_SELF, &usage) != 0)
+		return -1;
+	return usage.ru_maxrss;
+#else
+	return -1;
+#endif
+}
@@ -0,0 +1,21 @@
+#ifndef TEST_SUPPORT_H
+#define TEST_SUPPORT_H
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/* Allocations are counted by interposing the C library's allocator,
+ * which doesn't mix with the one of the address sanitizer */
+#if defined (__GLIBC__) && !defined (__SANITIZE_ADDRESS__)
+#define HAVE_ALLOCATION_COUNT 1
+#endif
+
+gsize test_support_allocations (void);
+gboolean test_support_reset_peak_rss (void);
+gint64 test_support_read_status (const char *field);
+gint64 test_support_peak_rss (void);
+
+G_END_DECLS
+
+#endif /* TEST_SUPPORT_H */
@@ -22,6 +22,9 @@
 #include "config.h"
 
 #include <locale.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
 
 #include <glib.h>
 #include <quvi.h>
@@ -31,26 +34,21 @@
 
 static char *url = NULL;
 static gboolean check = FALSE;
+static gboolean server = FALSE;
 static gboolean debug = FALSE;
 
 const GOptionEntry options[] = {
 	{ "url", 'u', 0, G_OPTION_ARG_FILENAME, &url, "URL of the video site page", NULL },
 	{ "check", 'c', 0, G_OPTION_ARG_NONE, &check, "Check whether this URL is supported", NULL },
+	{ "server", 's', 0, G_OPTION_ARG_NONE, &server, "Answer requests read from stdin, one per line", NULL },
 	{ "debug", 'd', 0, G_OPTION_ARG_NONE, &debug, "Turn on debug mode", NULL },
 	{ NULL }
 };
 
 static gboolean
-supports_uri (const char *uri)
+supports_uri (quvi_t q, const char *uri)
 {
-	quvi_t q;
-	QuviBoolean r;
-
-	q = quvi_new ();
-	r = quvi_supports (q, uri, QUVI_SUPPORTS_MODE_OFFLINE, QUVI_SUPPORTS_TYPE_ANY);
-	quvi_free (q);
-
-	return r;
+	return quvi_supports (q, uri, QUVI_SUPPORTS_MODE_OFFLINE, QUVI_SUPPORTS_TYPE_ANY);
 }
 
 static struct {
@@ -83,13 +81,28 @@ print (const char *name,
 	if (value == NULL)
 		return;
 
+	/* Replies are line-based in server mode */
+	if (server && strchr (value, '\n') != NULL) {
+		char *tmp;
+
+		tmp = g_strdelimit (g_strdup (value), "\r\n", ' ');
+		g_print ("%s=%s\n", name, tmp);
+		g_free (tmp);
+		return;
+	}
+
 	g_print ("%s=%s\n", name, value);
 }
 
 static void
-parse_videosite (const char *uri)
+print_result (const char *result)
+{
+	g_print ("%s%s", result, server ? "\n" : "");
+}
+
+static void
+parse_videosite (quvi_t q, const char *uri)
 {
-	quvi_t q;
 	quvi_media_t qm;
 	/* properties */
 	const char *video_uri;
@@ -103,20 +116,19 @@ parse_videosite (const char *uri)
 	char *duration_str = NULL;
 	char *starttime_str = NULL;
 
-	if (!supports_uri (uri)) {
-		g_print ("XPLAYER_PL_PARSER_RESULT_UNHANDLED");
+	if (!supports_uri (q, uri)) {
+		print_result ("XPLAYER_PL_PARSER_RESULT_UNHANDLED");
 		return;
 	}
 
-	q = quvi_new ();
 	qm = quvi_media_new (q, uri);
 
 	/* Empty results list? */
 	if (quvi_media_stream_next(qm) != QUVI_TRUE) {
 		if (debug)
-			g_print ("Parsing '%s' failed with error: %s\n",
-				 uri, quvi_errmsg (q));
-		g_print ("XPLAYER_PL_PARSER_RESULT_ERROR");
+			g_printerr ("Parsing '%s' failed with error: %s\n",
+				    uri, quvi_errmsg (q));
+		print_result ("XPLAYER_PL_PARSER_RESULT_ERROR");
 		goto out;
 	}
 
@@ -153,12 +165,45 @@ parse_videosite (const char *uri)
 
 out:
 	quvi_media_free (qm);
-	quvi_free (q);
+}
+
+/* Requests are "check <url>" or "parse <url>" lines, and each reply
+ * is terminated by an empty line. libquvi and its scripts are only
+ * loaded once for the lifetime of the helper, and it exits when the
+ * other end of stdin goes away */
+static void
+serve (quvi_t q)
+{
+	GIOChannel *channel;
+	char *line;
+
+	channel = g_io_channel_unix_new (STDIN_FILENO);
+	g_io_channel_set_encoding (channel, NULL, NULL);
+
+	while (g_io_channel_read_line (channel, &line, NULL, NULL, NULL) == G_IO_STATUS_NORMAL) {
+		char **request;
+
+		request = g_strsplit (g_strchomp (line), " ", 2);
+		if (g_strcmp0 (request[0], "check") == 0 && request[1] != NULL)
+			g_print ("%s\n", supports_uri (q, request[1]) ? "TRUE" : "FALSE");
+		else if (g_strcmp0 (request[0], "parse") == 0 && request[1] != NULL)
+			parse_videosite (q, request[1]);
+		else
+			print_result ("XPLAYER_PL_PARSER_RESULT_ERROR");
+		g_print ("\n");
+		fflush (stdout);
+
+		g_strfreev (request);
+		g_free (line);
+	}
+
+	g_io_channel_unref (channel);
 }
 
 int main (int argc, char **argv)
 {
 	GOptionContext *context;
+	quvi_t q;
 
 	setlocale (LC_ALL, "");
 
@@ -167,7 +212,7 @@ int main (int argc, char **argv)
 	g_option_context_add_main_entries (context, options, NULL);
 	g_option_context_parse (context, &argc, &argv, NULL);
 
-	if (url == NULL) {
+	if (url == NULL && !server) {
 		char *txt;
 
 		txt = g_option_context_get_help (context, FALSE, NULL);
@@ -180,12 +225,16 @@ int main (int argc, char **argv)
 	}
 	g_option_context_free (context);
 
-	if (check) {
-		g_print ("%s", supports_uri (url) ? "TRUE" : "FALSE");
-		return 0;
-	}
+	q = quvi_new ();
+
+	if (server)
+		serve (q);
+	else if (check)
+		g_print ("%s", supports_uri (q, url) ? "TRUE" : "FALSE");
+	else
+		parse_videosite (q, url);
 
-	parse_videosite (url);
+	quvi_free (q);
 
 	return 0;
 }
@@ -0,0 +1,350 @@
+/*
+ *  Copyright (C) 2002-2003,2007 the xine project
+ *
+ *  This file is part of xine, a free video player.
+ *
+ * The xine-lib XML parser is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * The xine-lib XML parser is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with the Gnome Library; see the file COPYING.LIB.  If not,
+ * write to the Free Software Foundation, Inc., 51 Franklin Street, Fifth
+ * Floor, Boston, MA 02110, USA
+ */
+
+/*
+ * Named character entities: the five XML ones plus the HTML 4 set, which
+ * feeds routinely embed in text even though it isn't well-formed XML.
+ *
+ * Lookup is a two-level perfect hash over lexer_entity_hash() (FNV-1a with
+ * the seed folded into the offset basis):
+ *   bucket = lexer_entity_hash (name, 0) % LEXER_ENTITY_BUCKETS
+ *   slot   = lexer_entity_hash (name, lexer_entity_seeds[bucket])
+ *            % LEXER_ENTITY_SLOTS
+ * lexer_entity_slots[slot] is an index into lexer_entity_names, or
+ * LEXER_ENTITY_EMPTY; the name must still be compared, since unknown names
+ * hash to arbitrary slots.  The seeds were picked, largest bucket first, as
+ * the smallest value placing every name of the bucket in free slots; both
+ * tables have to be regenerated whenever the name list changes.
+ *
+ * No name is shorter than the UTF-8 encoding of its character minus the
+ * '&' and ';', so decoding never makes the text grow.
+ */
+
+#ifndef XML_ENTITIES_H
+#define XML_ENTITIES_H
+
+#define LEXER_ENTITY_MAXLEN   8
+#define LEXER_ENTITY_BUCKETS  64
+#define LEXER_ENTITY_SLOTS    512
+#define LEXER_ENTITY_EMPTY    0xFF
+
+static const struct {
+  char name[LEXER_ENTITY_MAXLEN + 1];
+  uint32_t code;
+} lexer_entity_names[] = {
+  { "AElig",    0x00C6 },
+  { "Aacute",   0x00C1 },
+  { "Acirc",    0x00C2 },
+  { "Agrave",   0x00C0 },
+  { "Alpha",    0x0391 },
+  { "Aring",    0x00C5 },
+  { "Atilde",   0x00C3 },
+  { "Auml",     0x00C4 },
+  { "Beta",     0x0392 },
+  { "Ccedil",   0x00C7 },
+  { "Chi",      0x03A7 },
+  { "Dagger",   0x2021 },
+  { "Delta",    0x0394 },
+  { "ETH",      0x00D0 },
+  { "Eacute",   0x00C9 },
+  { "Ecirc",    0x00CA },
+  { "Egrave",   0x00C8 },
+  { "Epsilon",  0x0395 },
+  { "Eta",      0x0397 },
+  { "Euml",     0x00CB },
+  { "Gamma",    0x0393 },
+  { "Iacute",   0x00CD },
+  { "Icirc",    0x00CE },
+  { "Igrave",   0x00CC },
+  { "Iota",     0x0399 },
+  { "Iuml",     0x00CF },
+  { "Kappa",    0x039A },
+  { "Lambda",   0x039B },
+  { "Mu",       0x039C },
+  { "Ntilde",   0x00D1 },
+  { "Nu",       0x039D },
+  { "OElig",    0x0152 },
+  { "Oacute",   0x00D3 },
+  { "Ocirc",    0x00D4 },
+  { "Ograve",   0x00D2 },
+  { "Omega",    0x03A9 },
+  { "Omicron",  0x039F },
+  { "Oslash",   0x00D8 },
+  { "Otilde",   0x00D5 },
+  { "Ouml",     0x00D6 },
+  { "Phi",      0x03A6 },
+  { "Pi",       0x03A0 },
+  { "Prime",    0x2033 },
+  { "Psi",      0x03A8 },
+  { "Rho",      0x03A1 },
+  { "Scaron",   0x0160 },
+  { "Sigma",    0x03A3 },
+  { "THORN",    0x00DE },
+  { "Tau",      0x03A4 },
+  { "Theta",    0x0398 },
+  { "Uacute",   0x00DA },
+  { "Ucirc",    0x00DB },
+  { "Ugrave",   0x00D9 },
+  { "Upsilon",  0x03A5 },
+  { "Uuml",     0x00DC },
+  { "Xi",       0x039E },
+  { "Yacute",   0x00DD },
+  { "Yuml",     0x0178 },
+  { "Zeta",     0x0396 },
+  { "aacute",   0x00E1 },
+  { "acirc",    0x00E2 },
+  { "acute",    0x00B4 },
+  { "aelig",    0x00E6 },
+  { "agrave",   0x00E0 },
+  { "alefsym",  0x2135 },
+  { "alpha",    0x03B1 },
+  { "amp",      0x0026 },
+  { "and",      0x2227 },
+  { "ang",      0x2220 },
+  { "apos",     0x0027 },
+  { "aring",    0x00E5 },
+  { "asymp",    0x2248 },
+  { "atilde",   0x00E3 },
+  { "auml",     0x00E4 },
+  { "bdquo",    0x201E },
+  { "beta",     0x03B2 },
+  { "brvbar",   0x00A6 },
+  { "bull",     0x2022 },
+  { "cap",      0x2229 },
+  { "ccedil",   0x00E7 },
+  { "cedil",    0x00B8 },
+  { "cent",     0x00A2 },
+  { "chi",      0x03C7 },
+  { "circ",     0x02C6 },
+  { "clubs",    0x2663 },
+  { "cong",     0x2245 },
+  { "copy",     0x00A9 },
+  { "crarr",    0x21B5 },
+  { "cup",      0x222A },
+  { "curren",   0x00A4 },
+  { "dArr",     0x21D3 },
+  { "dagger",   0x2020 },
+  { "darr",     0x2193 },
+  { "deg",      0x00B0 },
+  { "delta",    0x03B4 },
+  { "diams",    0x2666 },
+  { "divide",   0x00F7 },
+  { "eacute",   0x00E9 },
+  { "ecirc",    0x00EA },
+  { "egrave",   0x00E8 },
+  { "empty",    0x2205 },
+  { "emsp",     0x2003 },
+  { "ensp",     0x2002 },
+  { "epsilon",  0x03B5 },
+  { "equiv",    0x2261 },
+  { "eta",      0x03B7 },
+  { "eth",      0x00F0 },
+  { "euml",     0x00EB },
+  { "euro",     0x20AC },
+  { "exist",    0x2203 },
+  { "fnof",     0x0192 },
+  { "forall",   0x2200 },
+  { "frac12",   0x00BD },
+  { "frac14",   0x00BC },
+  { "frac34",   0x00BE },
+  { "frasl",    0x2044 },
+  { "gamma",    0x03B3 },
+  { "ge",       0x2265 },
+  { "gt",       0x003E },
+  { "hArr",     0x21D4 },
+  { "harr",     0x2194 },
+  { "hearts",   0x2665 },
+  { "hellip",   0x2026 },
+  { "iacute",   0x00ED },
+  { "icirc",    0x00EE },
+  { "iexcl",    0x00A1 },
+  { "igrave",   0x00EC },
+  { "image",    0x2111 },
+  { "infin",    0x221E },
+  { "int",      0x222B },
+  { "iota",     0x03B9 },
+  { "iquest",   0x00BF },
+  { "isin",     0x2208 },
+  { "iuml",     0x00EF },
+  { "kappa",    0x03BA },
+  { "lArr",     0x21D0 },
+  { "lambda",   0x03BB },
+  { "lang",     0x2329 },
+  { "laquo",    0x00AB },
+  { "larr",     0x2190 },
+  { "lceil",    0x2308 },
+  { "ldquo",    0x201C },
+  { "le",       0x2264 },
+  { "lfloor",   0x230A },
+  { "lowast",   0x2217 },
+  { "loz",      0x25CA },
+  { "lrm",      0x200E },
+  { "lsaquo",   0x2039 },
+  { "lsquo",    0x2018 },
+  { "lt",       0x003C },
+  { "macr",     0x00AF },
+  { "mdash",    0x2014 },
+  { "micro",    0x00B5 },
+  { "middot",   0x00B7 },
+  { "minus",    0x2212 },
+  { "mu",       0x03BC },
+  { "nabla",    0x2207 },
+  { "nbsp",     0x00A0 },
+  { "ndash",    0x2013 },
+  { "ne",       0x2260 },
+  { "ni",       0x220B },
+  { "not",      0x00AC },
+  { "notin",    0x2209 },
+  { "nsub",     0x2284 },
+  { "ntilde",   0x00F1 },
+  { "nu",       0x03BD },
+  { "oacute",   0x00F3 },
+  { "ocirc",    0x00F4 },
+  { "oelig",    0x0153 },
+  { "ograve",   0x00F2 },
+  { "oline",    0x203E },
+  { "omega",    0x03C9 },
+  { "omicron",  0x03BF },
+  { "oplus",    0x2295 },
+  { "or",       0x2228 },
+  { "ordf",     0x00AA },
+  { "ordm",     0x00BA },
+  { "oslash",   0x00F8 },
+  { "otilde",   0x00F5 },
+  { "otimes",   0x2297 },
+  { "ouml",     0x00F6 },
+  { "para",     0x00B6 },
+  { "part",     0x2202 },
+  { "permil",   0x2030 },
+  { "perp",     0x22A5 },
+  { "phi",      0x03C6 },
+  { "pi",       0x03C0 },
+  { "piv",      0x03D6 },
+  { "plusmn",   0x00B1 },
+  { "pound",    0x00A3 },
+  { "prime",    0x2032 },
+  { "prod",     0x220F },
+  { "prop",     0x221D },
+  { "psi",      0x03C8 },
+  { "quot",     0x0022 },
+  { "rArr",     0x21D2 },
+  { "radic",    0x221A },
+  { "rang",     0x232A },
+  { "raquo",    0x00BB },
+  { "rarr",     0x2192 },
+  { "rceil",    0x2309 },
+  { "rdquo",    0x201D },
+  { "real",     0x211C },
+  { "reg",      0x00AE },
+  { "rfloor",   0x230B },
+  { "rho",      0x03C1 },
+  { "rlm",      0x200F },
+  { "rsaquo",   0x203A },
+  { "rsquo",    0x2019 },
+  { "sbquo",    0x201A },
+  { "scaron",   0x0161 },
+  { "sdot",     0x22C5 },
+  { "sect",     0x00A7 },
+  { "shy",      0x00AD },
+  { "sigma",    0x03C3 },
+  { "sigmaf",   0x03C2 },
+  { "sim",      0x223C },
+  { "spades",   0x2660 },
+  { "sub",      0x2282 },
+  { "sube",     0x2286 },
+  { "sum",      0x2211 },
+  { "sup",      0x2283 },
+  { "sup1",     0x00B9 },
+  { "sup2",     0x00B2 },
+  { "sup3",     0x00B3 },
+  { "supe",     0x2287 },
+  { "szlig",    0x00DF },
+  { "tau",      0x03C4 },
+  { "there4",   0x2234 },
+  { "theta",    0x03B8 },
+  { "thetasym", 0x03D1 },
+  { "thinsp",   0x2009 },
+  { "thorn",    0x00FE },
+  { "tilde",    0x02DC },
+  { "times",    0x00D7 },
+  { "trade",    0x2122 },
+  { "uArr",     0x21D1 },
+  { "uacute",   0x00FA },
+  { "uarr",     0x2191 },
+  { "ucirc",    0x00FB },
+  { "ugrave",   0x00F9 },
+  { "uml",      0x00A8 },
+  { "upsih",    0x03D2 },
+  { "upsilon",  0x03C5 },
+  { "uuml",     0x00FC },
+  { "weierp",   0x2118 },
+  { "xi",       0x03BE },
+  { "yacute",   0x00FD },
+  { "yen",      0x00A5 },
+  { "yuml",     0x00FF },
+  { "zeta",     0x03B6 },
+  { "zwj",      0x200D },
+  { "zwnj",     0x200C }
+};
+
+static const unsigned char lexer_entity_seeds[LEXER_ENTITY_BUCKETS] = {
+    1,   3,   4,   2,   1,   9,   1,   3,   1,   6,   2,   1,   4,   2,   1,   1,
+    1,   4,   2,   4,   6,   1,   3,   3,   1,   2,   2,   1,   1,   1,   2,   1,
+    6,   1,   5,   4,   7,   1,   4,   1,   1,   3,   7,   1,  12,   2,   1,   2,
+   10,   6,   3,   4,   2,  11,  13,   2,   3,   0,   3,   5,   1,   3,   3,   3
+};
+
+static const unsigned char lexer_entity_slots[LEXER_ENTITY_SLOTS] = {
+  107,  76, 144, 255, 255, 255, 151, 255, 255,  40, 255, 255, 255, 180, 255, 112,
+  115, 145, 255, 255,  49, 255, 255,  68, 187,  32, 213, 255, 250, 163, 255, 120,
+  148, 255, 255,   0, 188, 147,  91, 255, 179,  83, 255, 118, 255,  39, 173, 255,
+  222, 175,  10,  59,  90, 255, 255, 255, 255, 215, 221, 158,   7, 207, 201, 255,
+  255, 255,  15, 204,  75, 255, 255, 211, 198, 255, 214, 255, 255, 255, 255, 255,
+  252,  97, 255, 255,  41, 255,  16, 255,   4, 255, 255, 110, 234, 255, 209,  53,
+  255, 255, 101, 255, 255, 255, 255, 238,  50, 255, 113,  20, 105,  33, 164, 255,
+  255,  14, 255, 255, 255, 255, 103, 255,  79, 176,  11, 114, 156, 255, 255, 224,
+  227,  70, 255, 241, 122,  92, 255, 255, 169, 255, 255, 255, 152, 255,  46, 255,
+  255, 255, 255,  36, 255,  21, 255, 106, 165, 255, 255, 190,  43, 154, 255, 149,
+  202, 255, 216,  62, 140, 125, 255,  87, 129, 255, 255, 255, 245,   1, 255, 255,
+  233, 255, 255, 255,  31,  85,  96,  35,  65, 255,  82, 255, 255, 255, 255, 243,
+   12, 255, 255, 255, 255,  77, 255, 255,  78, 205, 181,  57, 255, 183, 255,  26,
+   30, 197, 126, 167, 255, 160, 255, 255, 255, 255, 210, 255,  71,  38, 255, 255,
+   27, 255, 255, 132, 133,  73, 255, 255, 255, 223, 255,   3, 255, 153,  58,  37,
+  255, 186, 255, 255, 168, 157, 128,  13,  98, 206, 255, 255, 255,  52, 182, 111,
+   64, 255, 255,  54,  23,  19, 255, 200, 255, 255, 255, 178, 255, 255, 228,  61,
+  255, 242, 255, 131, 255, 255, 249, 171,  29,  25, 123,  80, 116, 142,  34, 255,
+   99, 159, 119, 255, 255,  56, 255, 255,  93,  69, 255, 235,  28, 255, 255, 134,
+  255, 255, 255, 255, 255, 236,   8, 220,  17, 219, 138, 226, 255, 146, 189, 255,
+   88, 255, 255, 255,   2, 100, 255,  22, 255, 255, 255, 255, 255, 255, 255, 255,
+  255, 255, 255, 255, 255, 255,   9, 255, 255, 255,   5, 255, 255, 255, 247, 117,
+  255, 255,  18, 255, 166, 255, 203,  66, 255, 255, 255,  48, 255, 102, 255, 109,
+  130, 255, 255, 255, 255, 255, 255, 255, 255, 174,  81, 255,  89, 255, 255, 217,
+  255, 184, 248, 141,   6, 255, 139, 255, 229, 255, 255, 255, 255, 255, 255, 225,
+  255, 255,  94, 255, 255, 255, 255, 255, 137, 195, 255, 240, 255, 232,  42, 255,
+  255, 255, 121, 255,  60, 194, 255, 124, 255, 136,  67, 127,  55, 255, 255, 150,
+   74, 255, 255, 255, 255, 255, 255, 255, 230, 239, 255,  95, 255, 255, 193, 135,
+  255, 255, 255,  44, 255,  24, 255, 208, 161,  86, 255,  63,  84, 255, 162, 177,
+  255, 255, 255, 255, 255,  72, 255, 108, 251, 255, 255, 255,  45, 255, 255, 255,
+  255, 143, 170, 244, 255, 246, 218, 192,  51, 212, 104, 196, 255, 255, 191, 185,
+  237, 155, 255, 172, 255, 255, 255, 255, 255, 199, 255, 231, 255, 255,  47, 255
+};
+
+#endif
@@ -44,49 +44,178 @@
 #endif
 
 #include "bswap.h"
+#include "xmlentities.h"
 
 /* private constants*/
 
 /* private global variables */
 struct lexer * static_lexer;
 
-enum utf { UTF32BE, UTF32LE, UTF16BE, UTF16LE };
+#define LEX_UTF_UNIT(utf) ((utf) >= LEXER_UTF16BE ? 2 : 4)
 
-static void lex_convert (struct lexer * lexer, const char * buf, int size, enum utf utf)
+/*
+ * An 8-byte block is plain ASCII when ANDing it with the mask gives 0 (every
+ * code unit is below 0x80) and, with the fill ORed in, it has no zero byte
+ * (no code unit is NUL); lane is the offset of the ASCII byte in a unit.
+ * Both are byte arrays so that the test doesn't depend on host endianness.
+ */
+static const struct {
+  unsigned char mask[8], fill[8];
+  int lane;
+} lex_ascii_blocks[] = {
+  [LEXER_UTF32BE] = { { 0xFF, 0xFF, 0xFF, 0x80, 0xFF, 0xFF, 0xFF, 0x80 },
+		      { 1, 1, 1, 0, 1, 1, 1, 0 }, 3 },
+  [LEXER_UTF32LE] = { { 0x80, 0xFF, 0xFF, 0xFF, 0x80, 0xFF, 0xFF, 0xFF },
+		      { 0, 1, 1, 1, 0, 1, 1, 1 }, 0 },
+  [LEXER_UTF16BE] = { { 0xFF, 0x80, 0xFF, 0x80, 0xFF, 0x80, 0xFF, 0x80 },
+		      { 1, 0, 1, 0, 1, 0, 1, 0 }, 1 },
+  [LEXER_UTF16LE] = { { 0x80, 0xFF, 0x80, 0xFF, 0x80, 0xFF, 0x80, 0xFF },
+		      { 0, 1, 0, 1, 0, 1, 0, 1 }, 0 },
+};
+
+static int lex_ascii_block (const char *buf, enum lexer_utf utf)
+{
+  uint64_t block, mask, fill;
+
+  memcpy (&block, buf, 8);
+  memcpy (&mask, lex_ascii_blocks[utf].mask, 8);
+  memcpy (&fill, lex_ascii_blocks[utf].fill, 8);
+  if (block & mask)
+    return 0;
+  block |= fill;
+  return !((block - 0x0101010101010101ULL) & ~block & 0x8080808080808080ULL);
+}
+
+/*
+ * Read the character at buf, size bytes being left, and return how many bytes
+ * it takes.  Surrogate pairs are combined; lone surrogates and values outside
+ * the Unicode range become U+FFFD.
+ */
+static int lex_utf_char (const char *buf, int size, enum lexer_utf utf, uint32_t *c)
+{
+  uint32_t u, low;
+
+  switch (utf)
+  {
+  case LEXER_UTF32BE: u = _X_BE_32 (buf); break;
+  case LEXER_UTF32LE: u = _X_LE_32 (buf); break;
+  case LEXER_UTF16BE: u = _X_BE_16 (buf); break;
+  case LEXER_UTF16LE: u = _X_LE_16 (buf); break;
+  default: /* erk! */ abort ();
+  }
+
+  if (u >= 0xD800 && u < 0xDC00 && utf >= LEXER_UTF16BE && size >= 4)
+  {
+    low = utf == LEXER_UTF16BE ? _X_BE_16 (buf + 2) : _X_LE_16 (buf + 2);
+    if (low >= 0xDC00 && low < 0xE000)
+    {
+      *c = 0x10000 + ((u - 0xD800) << 10) + (low - 0xDC00);
+      return 4;
+    }
+  }
+  if ((u >= 0xD800 && u < 0xE000) || u > 0x10FFFF)
+    u = 0xFFFD;
+  *c = u;
+  return LEX_UTF_UNIT (utf);
+}
+
+/*
+ * Transcode up to the first NUL into out, or only measure the result if out
+ * is NULL; returns the UTF-8 length.
+ */
+static int lex_utf_transcode (const char *buf, int size, enum lexer_utf utf, char *out)
 {
-  char *utf8 = malloc (size * (utf >= UTF16BE ? 3 : 6) + 1);
-  char *bp = utf8;
+  const int unit = LEX_UTF_UNIT (utf), lane = lex_ascii_blocks[utf].lane;
+  char *bp = out;
+  int len = 0;
+
+  size -= size % unit; /* drop a trailing partial code unit */
   while (size > 0)
   {
-    uint32_t c = 0;
-    switch (utf)
+    uint32_t c;
+    int used;
+
+    if (size >= 8 && lex_ascii_block (buf, utf))
     {
-    case UTF32BE: c = _X_BE_32 (buf); buf += 4; break;
-    case UTF32LE: c = _X_LE_32 (buf); buf += 4; break;
-    case UTF16BE: c = _X_BE_16 (buf); buf += 2; break;
-    case UTF16LE: c = _X_LE_16 (buf); buf += 2; break;
-    default: /* erk! */ abort ();
+      if (bp)
+      {
+	int i;
+	for (i = lane; i < 8; i += unit)
+	  *bp++ = buf[i];
+      }
+      len += 8 / unit;
+      buf += 8;
+      size -= 8;
+      continue;
     }
+
+    used = lex_utf_char (buf, size, utf, &c);
     if (!c)
       break; /* embed a NUL, get a truncated string */
-    if (c < 128)
-      *bp++ = c;
+    buf += used;
+    size -= used;
+
+    if (c < 0x80)
+    {
+      len += 1;
+      if (bp)
+	*bp++ = c;
+    }
+    else if (c < 0x800)
+    {
+      len += 2;
+      if (bp)
+      {
+	*bp++ = 0xC0 | (c >> 6);
+	*bp++ = 0x80 | (c & 0x3F);
+      }
+    }
+    else if (c < 0x10000)
+    {
+      len += 3;
+      if (bp)
+      {
+	*bp++ = 0xE0 | (c >> 12);
+	*bp++ = 0x80 | ((c >> 6) & 0x3F);
+	*bp++ = 0x80 | (c & 0x3F);
+      }
+    }
     else
     {
-      int count = (c >= 0x04000000) ? 5 :
-		  (c >= 0x00200000) ? 4 :
-		  (c >= 0x00010000) ? 3 :
-		  (c >= 0x00000800) ? 2 : 1;
-      *bp = (char)(0x1F80 >> count);
-      count *= 6;
-      *bp++ |= c >> count;
-      while ((count -= 6) >= 0)
-	*bp++ = 128 | ((c >> count) & 0x3F);
+      len += 4;
+      if (bp)
+      {
+	*bp++ = 0xF0 | (c >> 18);
+	*bp++ = 0x80 | ((c >> 12) & 0x3F);
+	*bp++ = 0x80 | ((c >> 6) & 0x3F);
+	*bp++ = 0x80 | (c & 0x3F);
+      }
     }
   }
-  *bp = 0;
-  lexer->lexbuf_size = bp - utf8;
-  lexer->lexbuf = lexer->lex_malloc = realloc (utf8, lexer->lexbuf_size + 1);
+  return len;
+}
+
+/*
+ * Convert BOM-less UTF-16 or UTF-32 text to a newly allocated, NUL-terminated
+ * UTF-8 string, stopping at the first NUL character.  The output is measured
+ * first so that it is allocated at its exact size.  If utf8_len isn't NULL,
+ * the length of the result is stored there.
+ */
+char *lexer_utf_to_utf8 (const char *buf, int size, enum lexer_utf utf, int *utf8_len)
+{
+  int len = lex_utf_transcode (buf, size, utf, NULL);
+  char *utf8 = malloc (len + 1);
+
+  lex_utf_transcode (buf, size, utf, utf8);
+  utf8[len] = 0;
+  if (utf8_len)
+    *utf8_len = len;
+  return utf8;
+}
+
+static void lex_convert (struct lexer * lexer, const char * buf, int size, enum lexer_utf utf)
+{
+  lexer->lexbuf = lexer->lex_malloc = lexer_utf_to_utf8 (buf, size, utf, &lexer->lexbuf_size);
 }
 
 /* for ABI compatibility */
@@ -106,18 +235,18 @@ struct lexer *lexer_init_r(const char * buf, int size) {
   lexer->lexbuf_size = size;
 
   if (size >= 4 && !memcmp (buf, boms + 2, 4))
-    lex_convert (lexer, buf + 4, size - 4, UTF32BE);
+    lex_convert (lexer, buf + 4, size - 4, LEXER_UTF32BE);
   else if (size >= 4 && !memcmp (buf, boms, 4))
-    lex_convert (lexer, buf + 4, size - 4, UTF32LE);
+    lex_convert (lexer, buf + 4, size - 4, LEXER_UTF32LE);
   else if (size >= 3 && !memcmp (buf, bom_utf8, 3))
   {
     lexer->lexbuf += 3;
     lexer->lexbuf_size -= 3;
   }
   else if (size >= 2 && !memcmp (buf, boms + 4, 2))
-    lex_convert (lexer, buf + 2, size - 2, UTF16BE);
+    lex_convert (lexer, buf + 2, size - 2, LEXER_UTF16BE);
   else if (size >= 2 && !memcmp (buf, boms, 2))
-    lex_convert (lexer, buf + 2, size - 2, UTF16LE);
+    lex_convert (lexer, buf + 2, size - 2, LEXER_UTF16LE);
 
   lexer->lexbuf_pos  = 0;
   lexer->lex_mode    = NORMAL;
@@ -157,536 +286,561 @@ int lexer_get_token_d(char ** _tok, int * _tok_size, int fixed) {
 }
 
 int lexer_get_token_d_r(struct lexer * lexer, char ** _tok, int * _tok_size, int fixed) {
-  char *tok = *_tok;
-  int tok_size = *_tok_size;
+  const char *tok;
+  int tok_len, res;
 
-  int tok_pos = 0;
+  if (!*_tok) {
+    lprintf("token buffer is null\n");
+    return T_ERROR;
+  }
+
+  res = lexer_get_token_slice_r(lexer, &tok, &tok_len);
+
+  if (tok_len >= *_tok_size) {
+    char *tmp_tok;
+    int new_size = *_tok_size > 0 ? *_tok_size : 64;
+
+    if (fixed)
+      return T_ERROR;
+    while (new_size <= tok_len)
+      new_size *= 2;
+    lprintf("token buffer is too small (need %d)\n", tok_len + 1);
+    lprintf("increasing buffer size to %d bytes\n", new_size);
+    tmp_tok = realloc (*_tok, new_size);
+    if (!tmp_tok)
+      return T_ERROR;
+    *_tok = tmp_tok;
+    *_tok_size = new_size;
+  }
+
+  memcpy (*_tok, tok, tok_len);
+  (*_tok)[tok_len] = '\0';
+  return res;
+}
+
+/* position just past the "-->" ending the comment whose body starts at pos
+ * (the end of the buffer if the comment is unterminated) */
+static int lexer_skip_comment (const struct lexer * lexer, int pos) {
+  const char *p = lexer->lexbuf + pos;
+  const char *end = lexer->lexbuf + lexer->lexbuf_size;
+
+  while (end - p >= 3) {
+    p = memchr (p, '-', end - p - 2);
+    if (!p)
+      break;
+    if (p[1] == '-' && p[2] == '>')
+      return p + 3 - lexer->lexbuf;
+    p++;
+  }
+  return lexer->lexbuf_size;
+}
+
+/* Zero-copy variant of lexer_get_token_d_r(): *_tok is set to point into the
+ * lexer buffer (it is NOT nul-terminated) and *_tok_len to the token length.
+ * The slice remains valid until lexer_finalize_r() is called.
+ * Comments are skipped over as a whole: text on either side of one comes
+ * back as separate T_DATA tokens, and T_C_START/T_C_STOP are never returned.
+ */
+#define SLICE(t) do { *_tok = lexer->lexbuf + tok_start; *_tok_len = tok_len; return (t); } while (0)
+
+int lexer_get_token_slice_r(struct lexer * lexer, const char ** _tok, int * _tok_len) {
+  int tok_start = lexer->lexbuf_pos;
+  int tok_len = 0;
   lexer_state_t state = STATE_IDLE;
   char c;
 
-  if (tok) {
-    while ((tok_pos < tok_size) && (lexer->lexbuf_pos < lexer->lexbuf_size)) {
-      c = lexer->lexbuf[lexer->lexbuf_pos];
-      lprintf("c=%c, state=%d, in_comment=%d\n", c, state, lexer->in_comment);
-
-      switch (lexer->lex_mode) {
-      case NORMAL:
-	switch (state) {
-	  /* init state */
-	case STATE_IDLE:
-	  switch (c) {
-	  case '\n':
-	  case '\r':
-	    state = STATE_EOL;
-	    tok[tok_pos] = c;
-	    tok_pos++;
-	    break;
-
-	  case ' ':
-	  case '\t':
-	    state = STATE_SEPAR;
-	    tok[tok_pos] = c;
-	    tok_pos++;
-	    break;
-
-	  case '<':
-	    state = STATE_T_M_START;
-	    tok[tok_pos] = c;
-	    tok_pos++;
-	    break;
-
-	  case '>':
-	    state = STATE_T_M_STOP_1;
-	    tok[tok_pos] = c;
-	    tok_pos++;
-	    break;
-
-	  case '/':
-	    if (!lexer->in_comment)
-	      state = STATE_T_M_STOP_2;
-	    tok[tok_pos] = c;
-	    tok_pos++;
-	    break;
-
-	  case '=':
-	    state = STATE_T_EQUAL;
-	    tok[tok_pos] = c;
-	    tok_pos++;
-	    break;
-
-	  case '\"': /* " */
-	    state = STATE_T_STRING_DOUBLE;
-	    break;
-
-	  case '\'': /* " */
-	    state = STATE_T_STRING_SINGLE;
-	    break;
-
-	  case '-':
-	    state = STATE_T_DASHDASH;
-	    tok[tok_pos] = c;
-	    tok_pos++;
-	    break;
-
-	  case '?':
-	    if (!lexer->in_comment)
-	      state = STATE_T_TI_STOP;
-	    tok[tok_pos] = c;
-	    tok_pos++;
-	    break;
-
-	  default:
-	    state = STATE_IDENT;
-	    tok[tok_pos] = c;
-	    tok_pos++;
-	    break;
-	  }
-	  lexer->lexbuf_pos++;
+  while (lexer->lexbuf_pos < lexer->lexbuf_size) {
+    c = lexer->lexbuf[lexer->lexbuf_pos];
+    lprintf("c=%c, state=%d, in_comment=%d\n", c, state, lexer->in_comment);
+
+    switch (lexer->lex_mode) {
+    case NORMAL:
+      switch (state) {
+	/* init state */
+      case STATE_IDLE:
+	switch (c) {
+	case '\n':
+	case '\r':
+	  state = STATE_EOL;
+	  tok_len++;
 	  break;
 
-	  /* end of line */
-	case STATE_EOL:
-	  if (c == '\n' || (c == '\r')) {
-	    tok[tok_pos] = c;
-	    lexer->lexbuf_pos++;
-	    tok_pos++;
-	  } else {
-	    tok[tok_pos] = '\0';
-	    return T_EOL;
-	  }
+	case ' ':
+	case '\t':
+	  state = STATE_SEPAR;
+	  tok_len++;
 	  break;
 
-	  /* T_SEPAR */
-	case STATE_SEPAR:
-	  if (c == ' ' || (c == '\t')) {
-	    tok[tok_pos] = c;
-	    lexer->lexbuf_pos++;
-	    tok_pos++;
-	  } else {
-	    tok[tok_pos] = '\0';
-	    return T_SEPAR;
-	  }
+	case '<':
+	  state = STATE_T_M_START;
+	  tok_len++;
 	  break;
 
-	  /* T_M_START < or </ or <! or <? */
-	case STATE_T_M_START:
-	  switch (c) {
-	  case '/':
-	    tok[tok_pos] = c;
-	    lexer->lexbuf_pos++;
-	    tok_pos++; /* FIXME */
-	    tok[tok_pos] = '\0';
-	    return T_M_START_2;
-	    break;
-	  case '!':
-	    tok[tok_pos] = c;
-	    lexer->lexbuf_pos++;
-	    tok_pos++;
-	    state = STATE_T_COMMENT;
-	    break;
-	  case '?':
-	    tok[tok_pos] = c;
-	    lexer->lexbuf_pos++;
-	    tok_pos++; /* FIXME */
-	    tok[tok_pos] = '\0';
-	    return T_TI_START;
-	    break;
-	  default:
-	    tok[tok_pos] = '\0';
-	    return T_M_START_1;
-	  }
+	case '>':
+	  state = STATE_T_M_STOP_1;
+	  tok_len++;
 	  break;
 
-	  /* T_M_STOP_1 */
-	case STATE_T_M_STOP_1:
-	  tok[tok_pos] = '\0';
+	case '/':
 	  if (!lexer->in_comment)
-	    lexer->lex_mode = DATA;
-	  return T_M_STOP_1;
+	    state = STATE_T_M_STOP_2;
+	  tok_len++;
 	  break;
 
-	  /* T_M_STOP_2 */
-	case STATE_T_M_STOP_2:
-	  if (c == '>') {
-	    tok[tok_pos] = c;
-	    lexer->lexbuf_pos++;
-	    tok_pos++; /* FIXME */
-	    tok[tok_pos] = '\0';
-	    if (!lexer->in_comment)
-	      lexer->lex_mode = DATA;
-	    return T_M_STOP_2;
-	  } else {
-	    tok[tok_pos] = '\0';
-	    return T_ERROR;
-	  }
+	case '=':
+	  state = STATE_T_EQUAL;
+	  tok_len++;
 	  break;
 
-	  /* T_EQUAL */
-	case STATE_T_EQUAL:
-	  tok[tok_pos] = '\0';
-	  return T_EQUAL;
+	case '\"': /* " */
+	  state = STATE_T_STRING_DOUBLE;
+	  tok_start++; /* strings don't include their quotes */
 	  break;
 
-	  /* T_STRING */
-	case STATE_T_STRING_DOUBLE:
-	  tok[tok_pos] = c;
-	  lexer->lexbuf_pos++;
-	  if (c == '\"') { /* " */
-	    tok[tok_pos] = '\0'; /* FIXME */
-	    return T_STRING;
-	  }
-	  tok_pos++;
+	case '\'': /* " */
+	  state = STATE_T_STRING_SINGLE;
+	  tok_start++;
 	  break;
 
-	  /* T_C_START or T_DOCTYPE_START or T_CDATA_START */
-	case STATE_T_COMMENT:
-	  switch (c) {
-	  case '-':
-	    lexer->lexbuf_pos++;
-	    if (lexer->lexbuf[lexer->lexbuf_pos] == '-')
-	      {
-		lexer->lexbuf_pos++;
-		tok[tok_pos++] = '-'; /* FIXME */
-		tok[tok_pos++] = '-';
-		tok[tok_pos] = '\0';
-		lexer->in_comment = 1;
-		return T_C_START;
-	      }
-	    break;
-	  case 'D':
-	    lexer->lexbuf_pos++;
-	    if (strncmp(lexer->lexbuf + lexer->lexbuf_pos, "OCTYPE", 6) == 0) {
-	      strncpy(tok + tok_pos, "DOCTYPE", 7); /* FIXME */
-	      lexer->lexbuf_pos += 6;
-	      return T_DOCTYPE_START;
-	    } else {
-	      return T_ERROR;
-	    }
-	    break;
-	  case '[':
-	    lexer->lexbuf_pos++;
-	    if (strncmp(lexer->lexbuf + lexer->lexbuf_pos, "CDATA[", 6) == 0) {
-	      strncpy (tok + tok_pos, "[CDATA[", 7); /* FIXME */
-	      lexer->lexbuf_pos += 6;
-	      lexer->lex_mode = CDATA;
-	      return T_CDATA_START;
-	    } else{
-	      return T_ERROR;
-	    }
-	    break;
-	  default:
-	    /* error */
-	    return T_ERROR;
-	  }
+	case '-':
+	  state = STATE_T_DASHDASH;
+	  tok_len++;
 	  break;
 
-	  /* T_TI_STOP */
-	case STATE_T_TI_STOP:
-	  if (c == '>') {
-	    tok[tok_pos] = c;
-	    lexer->lexbuf_pos++;
-	    tok_pos++; /* FIXME */
-	    tok[tok_pos] = '\0';
-	    if (!lexer->in_comment)
-	      lexer->lex_mode = DATA;
-	    return T_TI_STOP;
-	  } else {
-	    tok[tok_pos] = '\0';
-	    return T_ERROR;
-	  }
+	case '?':
+	  if (!lexer->in_comment)
+	    state = STATE_T_TI_STOP;
+	  tok_len++;
 	  break;
 
-	  /* -- */
-	case STATE_T_DASHDASH:
-	  switch (c) {
-	  case '-':
-	    tok[tok_pos] = c;
-	    tok_pos++;
-	    lexer->lexbuf_pos++;
-	    state = STATE_T_C_STOP;
-	    break;
-	  default:
-	    tok[tok_pos] = c;
-	    tok_pos++;
-	    lexer->lexbuf_pos++;
-	    state = STATE_IDENT;
-	  }
+	default:
+	  state = STATE_IDENT;
+	  tok_len++;
 	  break;
+	}
+	lexer->lexbuf_pos++;
+	break;
 
-	  /* --> */
-	case STATE_T_C_STOP:
-	  switch (c) {
-	  case '>':
-	    tok[tok_pos] = c;
-	    tok_pos++;
-	    lexer->lexbuf_pos++;
-	    tok[tok_pos] = '\0'; /* FIX ME */
-	    if (strlen(tok) != 3) {
-	      tok[tok_pos - 3] = '\0';
-	      lexer->lexbuf_pos -= 3;
-	      return T_IDENT;
-	    } else {
-	      lexer->in_comment = 0;
-	      return T_C_STOP;
-	    }
-	    break;
-	  default:
-	    tok[tok_pos] = c;
-	    tok_pos++;
-	    lexer->lexbuf_pos++;
-	    state = STATE_IDENT;
-	  }
+	/* end of line */
+      case STATE_EOL:
+	if (c == '\n' || (c == '\r')) {
+	  lexer->lexbuf_pos++;
+	  tok_len++;
+	} else {
+	  SLICE(T_EOL);
+	}
+	break;
+
+	/* T_SEPAR */
+      case STATE_SEPAR:
+	if (c == ' ' || (c == '\t')) {
+	  lexer->lexbuf_pos++;
+	  tok_len++;
+	} else {
+	  SLICE(T_SEPAR);
+	}
+	break;
+
+	/* T_M_START < or </ or <! or <? */
+      case STATE_T_M_START:
+	switch (c) {
+	case '/':
+	  lexer->lexbuf_pos++;
+	  tok_len++;
+	  SLICE(T_M_START_2);
+	case '!':
+	  lexer->lexbuf_pos++;
+	  tok_len++;
+	  state = STATE_T_COMMENT;
 	  break;
+	case '?':
+	  lexer->lexbuf_pos++;
+	  tok_len++;
+	  SLICE(T_TI_START);
+	default:
+	  SLICE(T_M_START_1);
+	}
+	break;
+
+	/* T_M_STOP_1 */
+      case STATE_T_M_STOP_1:
+	if (!lexer->in_comment)
+	  lexer->lex_mode = DATA;
+	SLICE(T_M_STOP_1);
 
-	  /* T_STRING (single quotes) */
-	case STATE_T_STRING_SINGLE:
-	  tok[tok_pos] = c;
+	/* T_M_STOP_2 */
+      case STATE_T_M_STOP_2:
+	if (c == '>') {
 	  lexer->lexbuf_pos++;
-	  if (c == '\'') { /* " */
-	    tok[tok_pos] = '\0'; /* FIXME */
-	    return T_STRING;
+	  tok_len++;
+	  if (!lexer->in_comment)
+	    lexer->lex_mode = DATA;
+	  SLICE(T_M_STOP_2);
+	} else {
+	  SLICE(T_ERROR);
+	}
+	break;
+
+	/* T_EQUAL */
+      case STATE_T_EQUAL:
+	SLICE(T_EQUAL);
+
+	/* T_STRING */
+      case STATE_T_STRING_DOUBLE:
+	lexer->lexbuf_pos++;
+	if (c == '\"') /* " */
+	  SLICE(T_STRING);
+	tok_len++;
+	break;
+
+	/* T_C_START or T_DOCTYPE_START or T_CDATA_START */
+      case STATE_T_COMMENT:
+	switch (c) {
+	case '-':
+	  lexer->lexbuf_pos++;
+	  tok_len++;
+	  if (lexer->lexbuf_pos < lexer->lexbuf_size &&
+	      lexer->lexbuf[lexer->lexbuf_pos] == '-')
+	    {
+	      lexer->lexbuf_pos = lexer_skip_comment (lexer, lexer->lexbuf_pos + 1);
+	      tok_start = lexer->lexbuf_pos;
+	      tok_len = 0;
+	      state = STATE_IDLE;
+	    }
+	  break;
+	case 'D':
+	  lexer->lexbuf_pos++;
+	  if (lexer->lexbuf_size - lexer->lexbuf_pos >= 6 &&
+	      strncmp(lexer->lexbuf + lexer->lexbuf_pos, "OCTYPE", 6) == 0) {
+	    lexer->lexbuf_pos += 6;
+	    tok_len += 7;
+	    SLICE(T_DOCTYPE_START);
+	  } else {
+	    SLICE(T_ERROR);
 	  }
-	  tok_pos++;
 	  break;
-
-	  /* IDENT */
-	case STATE_IDENT:
-	  switch (c) {
-	  case '<':
-	  case '>':
-	  case '\\':
-	  case '\"': /* " */
-	  case ' ':
-	  case '\t':
-	  case '\n':
-	  case '\r':
-	  case '=':
-	  case '/':
-	    tok[tok_pos] = '\0';
-	    return T_IDENT;
-	    break;
-	  case '?':
-	    tok[tok_pos] = c;
-	    tok_pos++;
-	    lexer->lexbuf_pos++;
-	    state = STATE_T_TI_STOP;
-	    break;
-	  case '-':
-	    tok[tok_pos] = c;
-	    tok_pos++;
-	    lexer->lexbuf_pos++;
-	    state = STATE_T_DASHDASH;
-	    break;
-	  default:
-	    tok[tok_pos] = c;
-	    tok_pos++;
-	    lexer->lexbuf_pos++;
+	case '[':
+	  lexer->lexbuf_pos++;
+	  if (lexer->lexbuf_size - lexer->lexbuf_pos >= 6 &&
+	      strncmp(lexer->lexbuf + lexer->lexbuf_pos, "CDATA[", 6) == 0) {
+	    lexer->lexbuf_pos += 6;
+	    tok_len += 7;
+	    lexer->lex_mode = CDATA;
+	    SLICE(T_CDATA_START);
+	  } else {
+	    SLICE(T_ERROR);
 	  }
 	  break;
-	case STATE_UNKNOWN:
 	default:
-	  lprintf("expected char \'%c\'\n", tok[tok_pos - 1]); /* FIX ME */
-	  return T_ERROR;
+	  /* error */
+	  SLICE(T_ERROR);
 	}
 	break;
 
-      case DATA:		/* data mode, stop if char equal '<' */
-        switch (c)
-        {
-        case '<':
-	  tok[tok_pos] = '\0';
-	  lexer->lex_mode = NORMAL;
-	  return T_DATA;
+	/* T_TI_STOP */
+      case STATE_T_TI_STOP:
+	if (c == '>') {
+	  lexer->lexbuf_pos++;
+	  tok_len++;
+	  if (!lexer->in_comment)
+	    lexer->lex_mode = DATA;
+	  SLICE(T_TI_STOP);
+	} else {
+	  SLICE(T_ERROR);
+	}
+	break;
+
+	/* -- */
+      case STATE_T_DASHDASH:
+	switch (c) {
+	case '-':
+	  tok_len++;
+	  lexer->lexbuf_pos++;
+	  state = STATE_T_C_STOP;
+	  break;
 	default:
-	  tok[tok_pos] = c;
-	  tok_pos++;
+	  tok_len++;
 	  lexer->lexbuf_pos++;
+	  state = STATE_IDENT;
 	}
 	break;
 
-      case CDATA:		/* cdata mode, stop if next token is "]]>" */
-        switch (c)
-        {
-	case ']':
-	  if (strncmp(lexer->lexbuf + lexer->lexbuf_pos, "]]>", 3) == 0) {
-	    lexer->lexbuf_pos += 3;
-	    lexer->lex_mode = DATA;
-	    return T_CDATA_STOP;
+	/* --> */
+      case STATE_T_C_STOP:
+	switch (c) {
+	case '>':
+	  tok_len++;
+	  lexer->lexbuf_pos++;
+	  if (tok_len != 3) {
+	    tok_len -= 3;
+	    lexer->lexbuf_pos -= 3;
+	    SLICE(T_IDENT);
 	  } else {
-	    tok[tok_pos] = c;
-	    tok_pos++;
-	    lexer->lexbuf_pos++;
+	    lexer->in_comment = 0;
+	    SLICE(T_C_STOP);
 	  }
 	  break;
 	default:
-	  tok[tok_pos] = c;
-	  tok_pos++;
+	  tok_len++;
 	  lexer->lexbuf_pos++;
+	  state = STATE_IDENT;
 	}
 	break;
 
-      default:
-        lprintf ("Unexpected mode: %u\n", lexer->lex_mode);
-        return T_ERROR;
-      }
-    }
-    lprintf ("loop done tok_pos = %d, tok_size=%d, lexbuf_pos=%d, lexbuf_size=%d\n",
-	     tok_pos, tok_size, lexer->lexbuf_pos, lexer->lexbuf_size);
-
-    /* pb */
-    if (tok_pos >= tok_size) {
-      char *tmp_tok;
-      int new_size;
-      if (fixed)
-        return T_ERROR;
-      new_size = *_tok_size * 2;
-      tmp_tok = realloc (*_tok, new_size);
-      lprintf("token buffer is too small (need %d)\n", tok_pos);
-      lprintf("increasing buffer size to %d bytes\n", *_tok_size);
-      if (tmp_tok) {
-	  *_tok = tmp_tok;
-	  memset (*_tok + tok_size, 0, new_size - tok_size);
-	  *_tok_size = new_size;
-          return lexer_get_token_d_r (lexer, _tok, _tok_size, 0);
-      } else {
-          return T_ERROR;
-      }
-    } else {
-      if (lexer->lexbuf_pos >= lexer->lexbuf_size) {
-				/* Terminate the current token */
-	tok[tok_pos] = '\0';
-	switch (state) {
-	case STATE_IDLE:
-	case STATE_EOL:
-	case STATE_SEPAR:
-	  return T_EOF;
-	  break;
-	case STATE_T_M_START:
-	  return T_M_START_1;
-	  break;
-	case STATE_T_M_STOP_1:
-	  return T_M_STOP_1;
-	  break;
-	case STATE_T_M_STOP_2:
-	  return T_ERROR;
+	/* T_STRING (single quotes) */
+      case STATE_T_STRING_SINGLE:
+	lexer->lexbuf_pos++;
+	if (c == '\'') /* " */
+	  SLICE(T_STRING);
+	tok_len++;
+	break;
+
+	/* IDENT */
+      case STATE_IDENT:
+	switch (c) {
+	case '<':
+	case '>':
+	case '\\':
+	case '\"': /* " */
+	case ' ':
+	case '\t':
+	case '\n':
+	case '\r':
+	case '=':
+	case '/':
+	  SLICE(T_IDENT);
+	case '?':
+	  tok_len++;
+	  lexer->lexbuf_pos++;
+	  state = STATE_T_TI_STOP;
 	  break;
-	case STATE_T_EQUAL:
-	  return T_EQUAL;
+	case '-':
+	  tok_len++;
+	  lexer->lexbuf_pos++;
+	  state = STATE_T_DASHDASH;
 	  break;
-	case STATE_T_STRING_SINGLE:
-	case STATE_T_STRING_DOUBLE:
-	  return T_STRING;
+	default:
+	  tok_len++;
+	  lexer->lexbuf_pos++;
+	}
+	break;
+      case STATE_UNKNOWN:
+      default:
+	lprintf("expected char \'%c\'\n", c); /* FIX ME */
+	SLICE(T_ERROR);
+      }
+      break;
+
+    case DATA:		/* data mode, stop if char equal '<' */
+      {
+	/* the whole text run up to the next markup is one token */
+	const char *lt = memchr (lexer->lexbuf + lexer->lexbuf_pos, '<',
+				 lexer->lexbuf_size - lexer->lexbuf_pos);
+	if (!lt) {
+	  tok_len += lexer->lexbuf_size - lexer->lexbuf_pos;
+	  lexer->lexbuf_pos = lexer->lexbuf_size;
 	  break;
-	case STATE_IDENT:
-	  return T_DATA;
+	}
+	tok_len += lt - (lexer->lexbuf + lexer->lexbuf_pos);
+	lexer->lexbuf_pos = lt - lexer->lexbuf;
+	if (lexer->lexbuf_size - lexer->lexbuf_pos >= 4 && !strncmp (lt, "<!--", 4)) {
+	  /* the text so far, then carry on after the comment */
+	  if (tok_len > 0)
+	    SLICE(T_DATA);
+	  lexer->lexbuf_pos = lexer_skip_comment (lexer, lexer->lexbuf_pos + 4);
+	  tok_start = lexer->lexbuf_pos;
 	  break;
-	case STATE_UNKNOWN:
-	case STATE_T_COMMENT:
-	case STATE_T_TI_STOP:
-	case STATE_T_DASHDASH:
-	case STATE_T_C_STOP:
-	default:
-	  lprintf("unknown state, state=%d\n", state);
 	}
-      } else {
-	lprintf("abnormal end of buffer, state=%d\n", state);
+	lexer->lex_mode = NORMAL;
+	SLICE(T_DATA);
+      }
+
+    case CDATA:		/* cdata mode, stop if next token is "]]>" */
+      switch (c)
+      {
+      case ']':
+	if (lexer->lexbuf_size - lexer->lexbuf_pos >= 3 &&
+	    strncmp(lexer->lexbuf + lexer->lexbuf_pos, "]]>", 3) == 0) {
+	  lexer->lexbuf_pos += 3;
+	  lexer->lex_mode = DATA;
+	  SLICE(T_CDATA_STOP);
+	} else {
+	  tok_len++;
+	  lexer->lexbuf_pos++;
+	}
+	break;
+      default:
+	tok_len++;
+	lexer->lexbuf_pos++;
       }
+      break;
+
+    default:
+      lprintf ("Unexpected mode: %u\n", lexer->lex_mode);
+      SLICE(T_ERROR);
     }
-    return T_ERROR;
   }
-  /* tok == null */
-  lprintf("token buffer is null\n");
-  return T_ERROR;
+  lprintf ("loop done tok_len = %d, lexbuf_pos=%d, lexbuf_size=%d\n",
+	   tok_len, lexer->lexbuf_pos, lexer->lexbuf_size);
+
+  /* end of buffer: terminate the current token */
+  switch (state) {
+  case STATE_IDLE:
+  case STATE_EOL:
+  case STATE_SEPAR:
+    SLICE(T_EOF);
+  case STATE_T_M_START:
+    SLICE(T_M_START_1);
+  case STATE_T_M_STOP_1:
+    SLICE(T_M_STOP_1);
+  case STATE_T_M_STOP_2:
+    SLICE(T_ERROR);
+  case STATE_T_EQUAL:
+    SLICE(T_EQUAL);
+  case STATE_T_STRING_SINGLE:
+  case STATE_T_STRING_DOUBLE:
+    SLICE(T_STRING);
+  case STATE_IDENT:
+    SLICE(T_DATA);
+  case STATE_UNKNOWN:
+  case STATE_T_COMMENT:
+  case STATE_T_TI_STOP:
+  case STATE_T_DASHDASH:
+  case STATE_T_C_STOP:
+  default:
+    lprintf("unknown state, state=%d\n", state);
+  }
+  SLICE(T_ERROR);
 }
 
+#undef SLICE
+
 /* for ABI compatibility */
 int lexer_get_token (char *tok, int tok_size)
 {
   return lexer_get_token_d (&tok, &tok_size, 1);
 }
 
-static struct {
-  char code;
-  unsigned char namelen;
-  char name[6];
-} lexer_entities[] = {
-  { '"',  4, "quot" },
-  { '&',  3, "amp" },
-  { '\'', 4, "apos" },
-  { '<',  2, "lt" },
-  { '>',  2, "gt" },
-  { '\0', 0, "" }
-};
+static uint32_t lexer_entity_hash (const char *name, int len, uint32_t seed)
+{
+  uint32_t h = 2166136261u ^ seed;
+  while (len--)
+    h = (h ^ (unsigned char) *name++) * 16777619u;
+  return h;
+}
 
-char *lexer_decode_entities (const char *tok)
+/* look up a named entity; returns 0 if it isn't known */
+static uint32_t lexer_entity_lookup (const char *name, int len)
 {
-  char *buf = calloc (strlen (tok) + 1, sizeof(char));
-  char *bp = buf;
-  char c;
+  uint32_t seed, slot;
+  int i;
+
+  if (len > LEXER_ENTITY_MAXLEN)
+    return 0;
+  seed = lexer_entity_seeds[lexer_entity_hash (name, len, 0) % LEXER_ENTITY_BUCKETS];
+  slot = lexer_entity_hash (name, len, seed) % LEXER_ENTITY_SLOTS;
+  i = lexer_entity_slots[slot];
+  if (i == LEXER_ENTITY_EMPTY
+      || strncmp (lexer_entity_names[i].name, name, len)
+      || lexer_entity_names[i].name[len])
+    return 0;
+  return lexer_entity_names[i].code;
+}
 
-  while ((c = *tok++))
-  {
-    if (c != '&')
-      *bp++ = c;
-    else
-    {
-      /* parse the character entity (on failure, treat it as literal text) */
-      const char *tp = tok;
-      signed long i;
+/*
+ * Decode the character entities in buf[0..len) in place and return the new
+ * length; the result is not NUL-terminated.  Text without any '&' is left
+ * untouched.  Unknown or malformed entities are kept as literal text.
+ * Every entity is at least as long as its UTF-8 encoding, so the output
+ * can never overtake the input.
+ */
+int lexer_decode_entities_r (char *buf, int len)
+{
+  const char *tp = memchr (buf, '&', len);
+  const char *end = buf + len;
+  char *bp;
 
-      for (i = 0; lexer_entities[i].code; ++i)
-	if (!strncmp (lexer_entities[i].name, tok, lexer_entities[i].namelen)
-	    && tok[lexer_entities[i].namelen] == ';')
-	  break;
-      if (lexer_entities[i].code)
-      {
-        tok += lexer_entities[i].namelen + 1;
-	*bp++ = lexer_entities[i].code;
-	continue;
-      }
+  if (!tp)
+    return len;
 
-      if (*tp++ != '#')
-      {
-        /* not a recognised name and not numeric */
-	*bp++ = '&';
-	continue;
-      }
+  bp = (char *) tp;
+  while (tp < end)
+  {
+    const char *np;
+    uint32_t i = 0;
 
-      /* entity is a number
-       * (note: strtol() allows "0x" prefix for hexadecimal, but we don't)
+    if (*tp != '&')
+    {
+      *bp++ = *tp++;
+      continue;
+    }
+
+    /* parse the character entity (on failure, treat it as literal text) */
+    np = tp + 1;
+    if (np < end && *np == '#')
+    {
+      /* entity is a number; digits are parsed here rather than by strtol()
+       * since the text isn't NUL-terminated (and a "0x" prefix isn't valid)
        */
-      if (*tp == 'x' && tp[1] && tp[2] != 'x')
-	i = strtol (tp + 1, (char **)&tp, 16);
-      else
-	i = strtol (tp, (char **)&tp, 10);
+      const char *digits;
+      int hex = ++np < end && *np == 'x';
 
-      if (*tp != ';' || i < 1)
+      digits = np += hex;
+
+      for (; np < end && i <= 0x7FFFFFF; ++np)
       {
-        /* out of range, or format error */
-	*bp++ = '&';
-	continue;
+	int d = (*np >= '0' && *np <= '9') ? *np - '0' :
+		!hex ? -1 :
+		(*np >= 'a' && *np <= 'f') ? *np - 'a' + 10 :
+		(*np >= 'A' && *np <= 'F') ? *np - 'A' + 10 : -1;
+	if (d < 0)
+	  break;
+	i = i * (hex ? 16 : 10) + d;
       }
+      if (np == digits || i > 0x7FFFFFFF)
+	i = 0; /* out of range, or format error */
+    }
+    else
+    {
+      while (np < end && np - tp <= LEXER_ENTITY_MAXLEN && isalnum ((unsigned char) *np))
+	++np;
+      i = lexer_entity_lookup (tp + 1, np - tp - 1);
+    }
 
-      tok = tp + 1;
+    if (np >= end || *np != ';' || i < 1)
+    {
+      *bp++ = *tp++;
+      continue;
+    }
+    tp = np + 1;
 
-      if (i < 128)
-        /* ASCII - store as-is */
-	*bp++ = i;
-      else
-      {
-	/* Non-ASCII, so convert to UTF-8 */
-	int count = (i >= 0x04000000) ? 5 :
-		    (i >= 0x00200000) ? 4 :
-		    (i >= 0x00010000) ? 3 :
-		    (i >= 0x00000800) ? 2 : 1;
-	*bp = (char)(0x1F80 >> count);
-	count *= 6;
-	*bp++ |= i >> count;
-	while ((count -= 6) >= 0)
-	  *bp++ = 128 | ((i >> count) & 0x3F);
-      }
+    if (i < 128)
+      /* ASCII - store as-is */
+      *bp++ = i;
+    else
+    {
+      /* Non-ASCII, so convert to UTF-8 */
+      int count = (i >= 0x04000000) ? 5 :
+		  (i >= 0x00200000) ? 4 :
+		  (i >= 0x00010000) ? 3 :
+		  (i >= 0x00000800) ? 2 : 1;
+      *bp = (char)(0x1F80 >> count);
+      count *= 6;
+      *bp++ |= i >> count;
+      while ((count -= 6) >= 0)
+	*bp++ = 128 | ((i >> count) & 0x3F);
     }
   }
-  *bp = 0;
+  return bp - buf;
+}
+
+/* for ABI compatibility */
+char *lexer_decode_entities (const char *tok)
+{
+  int len = strlen (tok);
+  char *buf = malloc (len + 1);
+
+  memcpy (buf, tok, len);
+  buf[lexer_decode_entities_r (buf, len)] = 0;
   return buf;
 }
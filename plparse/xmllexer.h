@@ -55,6 +55,14 @@
 #define T_CDATA_STOP    19   /* ]]> */
 
 
+/* encodings accepted by lexer_utf_to_utf8 */
+enum lexer_utf {
+  LEXER_UTF32BE,
+  LEXER_UTF32LE,
+  LEXER_UTF16BE,
+  LEXER_UTF16LE
+};
+
 typedef enum {
   NORMAL,
   DATA,
@@ -79,7 +87,10 @@ struct lexer *lexer_init_r(const char * buf, int size) XINE_PROTECTED;
 void lexer_finalize_r(struct lexer * lexer) XINE_PROTECTED;
 int lexer_get_token_d_r(struct lexer * lexer, char ** tok, int * tok_size, int fixed) XINE_PROTECTED;
 int lexer_get_token_d(char ** tok, int * tok_size, int fixed) XINE_DEPRECATED XINE_PROTECTED;
+int lexer_get_token_slice_r(struct lexer * lexer, const char ** tok, int * tok_len) XINE_PROTECTED;
 int lexer_get_token(char * tok, int tok_size) XINE_DEPRECATED XINE_PROTECTED;
 char *lexer_decode_entities (const char *tok) XINE_PROTECTED;
+int lexer_decode_entities_r (char *buf, int len) XINE_PROTECTED;
+char *lexer_utf_to_utf8 (const char *buf, int size, enum lexer_utf utf, int *utf8_len) XINE_PROTECTED;
 
 #endif
@@ -54,8 +54,6 @@
 #include "xmlparser.h"
 
 
-#define TOKEN_SIZE  64 * 1024
-#define DATA_SIZE   64 * 1024
 #define MAX_RECURSION 26
 
 /* private global variables */
@@ -63,14 +61,89 @@ xml_parser_t * static_xml_parser;
 
 /* private functions */
 
-static char * strtoupper(char * str) {
-  int i = 0;
+/* copy a name out of the lexer buffer, upper-casing it if required */
+static char *xml_parser_name_dup (const xml_parser_t *xml_parser, const char *name, int len, int q) {
+  char *buf = malloc (len + q + 1);
+  char *bp = buf;
+  int i;
+
+  if (q)
+    *bp++ = '?';
+  if (xml_parser->mode == XML_PARSER_CASE_INSENSITIVE)
+    for (i = 0; i < len; i++)
+      *bp++ = (char)toupper((int)name[i]);
+  else {
+    memcpy (bp, name, len);
+    bp += len;
+  }
+  *bp = '\0';
+  return buf;
+}
+
+/* compare a name in the lexer buffer with a (nul-terminated) node name;
+ * the name can contain nuls, so the lengths have to match first */
+static int xml_parser_name_equal (const xml_parser_t *xml_parser, const char *name, int len, const char *node_name) {
+  if (strlen (node_name) != (size_t) len)
+    return 0;
+  if (xml_parser->mode == XML_PARSER_CASE_INSENSITIVE)
+    return !strncasecmp (name, node_name, len);
+  return !memcmp (name, node_name, len);
+}
+
+/* order a name in the lexer buffer against a (nul-terminated) word,
+ * without reading past the end of either */
+static int xml_parser_name_compare (const char *name, int len, const char *word) {
+  int i;
 
-  while (str[i] != '\0') {
-    str[i] = (char)toupper((int)str[i]);
-    i++;
+  for (i = 0; i < len; i++) {
+    int a = tolower ((unsigned char) name[i]);
+    int b = tolower ((unsigned char) word[i]);
+
+    if (!b)
+      return 1;
+    if (a != b)
+      return a - b;
+  }
+  return word[len] ? -1 : 0;
+}
+
+/* look a name in the lexer buffer up in the parser's vocabulary */
+static int xml_parser_name_id (const xml_parser_t *xml_parser, const char *name, int len) {
+  const xml_vocabulary_t *vocabulary = xml_parser->vocabulary;
+  int lo, hi;
+
+  if (!vocabulary)
+    return XML_ID_UNKNOWN;
+
+  lo = 0;
+  hi = vocabulary->count;
+  while (lo < hi) {
+    int mid = (lo + hi) / 2;
+    const char *word = vocabulary->names[mid];
+    int cmp = xml_parser_name_compare (name, len, word);
+
+    if (cmp < 0)
+      hi = mid;
+    else if (cmp > 0)
+      lo = mid + 1;
+    else if (xml_parser->mode == XML_PARSER_CASE_SENSITIVE && memcmp (name, word, len))
+      return XML_ID_UNKNOWN;
+    else
+      return mid + 1;
   }
-  return str;
+
+  return XML_ID_UNKNOWN;
+}
+
+/* copy text out of the lexer buffer, decoding entities in the copy */
+static char *xml_parser_text_dup (const char *text, int len, int decode) {
+  char *buf = malloc (len + 1);
+
+  memcpy (buf, text, len);
+  if (decode)
+    len = lexer_decode_entities_r (buf, len);
+  buf[len] = '\0';
+  return buf;
 }
 
 static xml_node_t * new_xml_node(void) {
@@ -82,6 +155,7 @@ static xml_node_t * new_xml_node(void) {
   new_node->props = NULL;
   new_node->child = NULL;
   new_node->next  = NULL;
+  new_node->id    = XML_ID_UNKNOWN;
   return new_node;
 }
 
@@ -101,6 +175,7 @@ static xml_property_t *XINE_MALLOC new_xml_property(void) {
   new_property->name  = NULL;
   new_property->value = NULL;
   new_property->next  = NULL;
+  new_property->id    = XML_ID_UNKNOWN;
   return new_property;
 }
 
@@ -122,22 +197,39 @@ xml_parser_t *xml_parser_init_r(const char * buf, int size, int mode) {
   xml_parser_t *xml_parser = malloc(sizeof(*xml_parser));
   xml_parser->lexer = lexer_init_r(buf, size);
   xml_parser->mode = mode;
+  xml_parser->vocabulary = NULL;
   return xml_parser;
 }
 
+/* check that a vocabulary is in the order xml_parser_name_id() searches it */
+int xml_vocabulary_is_sorted(const xml_vocabulary_t *vocabulary) {
+  int i;
+
+  for (i = 1; i < vocabulary->count; i++) {
+    const char *prev = vocabulary->names[i - 1];
+
+    if (xml_parser_name_compare (prev, strlen (prev), vocabulary->names[i]) >= 0)
+      return 0;
+  }
+  return 1;
+}
+
+void xml_parser_set_vocabulary_r(xml_parser_t *xml_parser, const xml_vocabulary_t *vocabulary) {
+  xml_parser->vocabulary = vocabulary;
+}
+
 void xml_parser_finalize_r(xml_parser_t *xml_parser) {
   lexer_finalize_r(xml_parser->lexer);
   free(xml_parser);
 }
 
 static void xml_parser_free_props(xml_property_t *current_property) {
-  if (current_property) {
-    if (!current_property->next) {
-      free_xml_property(current_property);
-    } else {
-      xml_parser_free_props(current_property->next);
-      free_xml_property(current_property);
-    }
+  /* not recursive, an element can have any number of properties */
+  while (current_property) {
+    xml_property_t *next_property = current_property->next;
+
+    free_xml_property(current_property);
+    current_property = next_property;
   }
 }
 
@@ -202,10 +294,13 @@ typedef enum {
   STATE_CDATA,
 } parser_state_t;
 
-static xml_node_t *xml_parser_append_text (xml_node_t *node, xml_node_t *subnode, const char *text, int flags)
+/* text is consumed */
+static xml_node_t *xml_parser_append_text (xml_node_t *node, xml_node_t *subnode, char *text, int flags)
 {
-  if (!text || !*text)
+  if (!text || !*text) {
+    free (text);
     return subnode; /* empty string -> nothing to do */
+  }
 
   if ((flags & XML_PARSER_MULTI_TEXT) && subnode) {
     /* we have a subtree, so we can't use node->data */
@@ -219,8 +314,8 @@ static xml_node_t *xml_parser_append_text (xml_node_t *node, xml_node_t *subnode
       /* most recent node is not CDATA - add a sibling */
       subnode->next = new_xml_node ();
       subnode->next->name = (char*) cdata; /* we never free cdata */
-      subnode->next->data = strdup (text);
-      subnode = subnode->next;
+      subnode->next->data = text;
+      return subnode->next;
     }
   } else if (node->data) {
     /* "no" subtree, but we have existing text - append to it */
@@ -229,485 +324,511 @@ static xml_node_t *xml_parser_append_text (xml_node_t *node, xml_node_t *subnode
     free (node->data);
     node->data = newtext;
   } else {
-    /* no text, "no" subtree - duplicate & assign */
-    while (isspace (*text))
-      ++text;
-    if (*text)
-      node->data = strdup (text);
+    /* no text, "no" subtree - strip leading white space & assign */
+    const char *start = text;
+    while (isspace (*start))
+      ++start;
+    if (*start) {
+      if (start != text)
+        memmove (text, start, strlen (start) + 1);
+      node->data = text;
+      return subnode;
+    }
   }
 
+  free (text);
   return subnode;
 }
 
 #define Q_STATE(CURRENT,NEW) (STATE_##NEW + state - STATE_##CURRENT)
 
 
-static int xml_parser_get_node_internal (xml_parser_t *xml_parser,
-				 char ** token_buffer, int * token_buffer_size,
-                                 char ** pname_buffer, int * pname_buffer_size,
-                                 char ** nname_buffer, int * nname_buffer_size,
-                                 xml_node_t *current_node, char *root_names[], int rec, int flags)
+/* an element whose content is being parsed */
+typedef struct {
+  xml_node_t *node;
+  xml_node_t *subtree; /* most recently attached child */
+} xml_parser_frame_t;
+
+/* report a finished element, then attach it to its parent unless discarded */
+static int xml_parser_end_element (xml_parser_frame_t *parent, xml_node_t *node,
+                                   const xml_parser_callbacks_t *callbacks, void *user_data)
 {
-  char *tok = *token_buffer;
-  char *property_name = *pname_buffer;
-  char *node_name = *nname_buffer;
+  int res = XML_PARSER_CONTINUE;
+
+  if (callbacks && callbacks->end_element)
+    res = callbacks->end_element (user_data, node);
+
+  if (res == XML_PARSER_DISCARD) {
+    xml_parser_free_tree (node);
+    return XML_PARSER_CONTINUE;
+  }
+
+  if (parent->subtree == NULL)
+    parent->node->child = node;
+  else
+    parent->subtree->next = node;
+  parent->subtree = node;
+  return res;
+}
+
+static int xml_parser_get_node (xml_parser_t *xml_parser, xml_node_t *root_node, int flags,
+                                const xml_parser_callbacks_t *callbacks, void *user_data)
+{
+  /* tokens and names are slices of the lexer buffer, not nul-terminated */
+  const char *tok = NULL;
+  int tok_len = 0;
+  const char *property_name = NULL;
+  int property_name_len = 0;
+  const char *node_name = NULL;
+  int node_name_len = 0;
   parser_state_t state = STATE_IDLE;
   int res = 0;
-  int parse_res;
   int bypass_get_token = 0;
-  int retval = 0; /* used when state==4; non-0 if there are missing </...> */
+  /* open elements; frames[0] is the (nameless) document node */
+  xml_parser_frame_t frames[MAX_RECURSION];
+  int rec = 0;
+  int close_to = 0; /* outermost element closed by the current </...> */
   xml_node_t *subtree = NULL;
-  xml_node_t *current_subtree = NULL;
   xml_property_t *current_property = NULL;
   xml_property_t *properties = NULL;
 
-  if (rec < MAX_RECURSION) {
-
-    memset (tok, 0, *token_buffer_size);
-
-    while ((bypass_get_token) || (res = lexer_get_token_d_r(xml_parser->lexer, token_buffer, token_buffer_size, 0)) != T_ERROR) {
-      tok = *token_buffer;
-      bypass_get_token = 0;
-      lprintf("info: %d - %d : '%s'\n", state, res, tok);
-
-      switch (state) {
-      case STATE_IDLE:
-	switch (res) {
-	case (T_EOL):
-	case (T_SEPAR):
-	  /* do nothing */
-	  break;
-	case (T_EOF):
-	  return retval; /* normal end */
-	  break;
-	case (T_M_START_1):
-	  state = STATE_NODE;
-	  break;
-	case (T_M_START_2):
-	  state = STATE_NODE_CLOSE;
-	  break;
-	case (T_C_START):
-	  state = STATE_COMMENT;
-	  break;
-	case (T_TI_START):
-	  state = STATE_Q_NODE;
-	  break;
-	case (T_DOCTYPE_START):
-	  state = STATE_DOCTYPE;
-	  break;
-	case (T_CDATA_START):
-	  state = STATE_CDATA;
-	  break;
-	case (T_DATA):
-	  /* current data */
-	  {
-	    char *decoded = lexer_decode_entities (tok);
-	    current_subtree = xml_parser_append_text (current_node, current_subtree, decoded, flags);
-	    free (decoded);
-	  }
-	  lprintf("info: node data : %s\n", current_node->data);
-	  break;
-	default:
-	  lprintf("error: unexpected token \"%s\", state %d\n", tok, state);
-	  return -1;
-	  break;
-	}
-	break;
+  frames[0].node = root_node;
+  frames[0].subtree = NULL;
 
-      case STATE_NODE:
-      case STATE_Q_NODE:
-	switch (res) {
-	case (T_IDENT):
-	  properties = NULL;
-	  current_property = NULL;
+  while ((bypass_get_token) || (res = lexer_get_token_slice_r(xml_parser->lexer, &tok, &tok_len)) != T_ERROR) {
+    bypass_get_token = 0;
+    lprintf("info: %d - %d : '%.*s'\n", state, res, tok_len, tok);
 
-	  /* save node name */
-	  if (xml_parser->mode == XML_PARSER_CASE_INSENSITIVE) {
-	    strtoupper(tok);
-	  }
-	  if (state == STATE_Q_NODE) {
-	    asprintf (&node_name, "?%s", tok);
-	    free (*nname_buffer);
-	    *nname_buffer = node_name;
-	    *nname_buffer_size = strlen (node_name) + 1;
-	    state = STATE_Q_ATTRIBUTE;
-	  } else {
-	    free (*nname_buffer);
-	    *nname_buffer = node_name = strdup (tok);
-	    *nname_buffer_size = strlen (node_name) + 1;
-	    state = STATE_ATTRIBUTE;
+    switch (state) {
+    case STATE_IDLE:
+      switch (res) {
+      case (T_EOL):
+      case (T_SEPAR):
+	/* do nothing */
+	break;
+      case (T_EOF):
+	goto done; /* normal end */
+	break;
+      case (T_M_START_1):
+	state = STATE_NODE;
+	break;
+      case (T_M_START_2):
+	state = STATE_NODE_CLOSE;
+	break;
+      case (T_C_START):
+	state = STATE_COMMENT;
+	break;
+      case (T_TI_START):
+	state = STATE_Q_NODE;
+	break;
+      case (T_DOCTYPE_START):
+	state = STATE_DOCTYPE;
+	break;
+      case (T_CDATA_START):
+	state = STATE_CDATA;
+	break;
+      case (T_DATA):
+	/* current data */
+	if (tok_len > 0) {
+	  char *text = xml_parser_text_dup (tok, tok_len, 1);
+	  if (callbacks && callbacks->text &&
+	      callbacks->text (user_data, frames[rec].node, text) == XML_PARSER_STOP) {
+	    free (text);
+	    goto stop;
 	  }
-	  lprintf("info: current node name \"%s\"\n", node_name);
-	  break;
-	default:
-	  lprintf("error: unexpected token \"%s\", state %d\n", tok, state);
-	  return -1;
-	  break;
+	  frames[rec].subtree = xml_parser_append_text (frames[rec].node, frames[rec].subtree, text, flags);
 	}
+	lprintf("info: node data : %s\n", frames[rec].node->data);
 	break;
+      default:
+	lprintf("error: unexpected token \"%.*s\", state %d\n", tok_len, tok, state);
+	goto error;
+	break;
+      }
+      break;
+
+    case STATE_NODE:
+    case STATE_Q_NODE:
+      switch (res) {
+      case (T_IDENT):
+	properties = NULL;
+	current_property = NULL;
+
+	/* save node name */
+	node_name = tok;
+	node_name_len = tok_len;
+	state = Q_STATE(NODE, ATTRIBUTE);
+	lprintf("info: current node name \"%.*s\"\n", node_name_len, node_name);
+	break;
+      default:
+	lprintf("error: unexpected token \"%.*s\", state %d\n", tok_len, tok, state);
+	goto error;
+	break;
+      }
+      break;
 
-      case STATE_ATTRIBUTE:
-	switch (res) {
-	case (T_EOL):
-	case (T_SEPAR):
-	  /* nothing */
-	  break;
-	case (T_M_STOP_1):
-	  /* new subtree */
-	  subtree = new_xml_node();
-
-	  /* set node name */
-	  subtree->name = strdup(node_name);
-
-	  /* set node propertys */
-	  subtree->props = properties;
-	  lprintf("info: rec %d new subtree %s\n", rec, node_name);
-	  root_names[rec + 1] = strdup (node_name);
-	  parse_res = xml_parser_get_node_internal (xml_parser, token_buffer, token_buffer_size,
-						    pname_buffer, pname_buffer_size,
-						    nname_buffer, nname_buffer_size,
-						    subtree, root_names, rec + 1, flags);
-	  tok = *token_buffer;
-	  free (root_names[rec + 1]);
-	  if (parse_res == -1 || parse_res > 0) {
-	    return parse_res;
-	  }
-	  if (current_subtree == NULL) {
-	    current_node->child = subtree;
-	    current_subtree = subtree;
-	  } else {
-	    current_subtree->next = subtree;
-	    current_subtree = subtree;
-	  }
-	  if (parse_res < -1) {
-	    /* badly-formed XML (missing close tag) */
-	    return parse_res + 1 + (parse_res == -2);
-	  }
-	  state = STATE_IDLE;
-	  break;
-	case (T_M_STOP_2):
-	  /* new leaf */
-	  /* new subtree */
-	  new_leaf:
-	  subtree = new_xml_node();
-
-	  /* set node name */
-	  subtree->name = strdup (node_name);
-
-	  /* set node propertys */
-	  subtree->props = properties;
-
-	  lprintf("info: rec %d new subtree %s\n", rec, node_name);
-
-	  if (current_subtree == NULL) {
-	    current_node->child = subtree;
-	    current_subtree = subtree;
-	  } else {
-	    current_subtree->next = subtree;
-	    current_subtree = subtree;
-	  }
-	  state = STATE_IDLE;
-	  break;
-	case (T_IDENT):
-	  /* save property name */
-	  new_prop:
-	  if (xml_parser->mode == XML_PARSER_CASE_INSENSITIVE) {
-	    strtoupper(tok);
-	  }
-	  /* make sure the buffer for the property name is big enough */
-	  if (*token_buffer_size > *pname_buffer_size) {
-	    char *tmp_prop;
-	    *pname_buffer_size = *token_buffer_size;
-	    tmp_prop = realloc (*pname_buffer, *pname_buffer_size);
-	    if (!tmp_prop)
-	      return -1;
-	    *pname_buffer = tmp_prop;
-	    property_name = tmp_prop;
-	  } else {
-	    property_name = *pname_buffer;
-	  }
-	  strcpy(property_name, tok);
-	  state = Q_STATE(ATTRIBUTE, ATTRIBUTE_EQUALS);
-	  lprintf("info: current property name \"%s\"\n", property_name);
-	  break;
-	default:
-	  lprintf("error: unexpected token \"%s\", state %d\n", tok, state);
-	  return -1;
-	  break;
+    case STATE_ATTRIBUTE:
+      switch (res) {
+      case (T_EOL):
+      case (T_SEPAR):
+	/* nothing */
+	break;
+      case (T_M_STOP_1):
+	/* new subtree */
+	subtree = new_xml_node();
+
+	/* set node name */
+	subtree->name = xml_parser_name_dup (xml_parser, node_name, node_name_len, 0);
+	subtree->id = xml_parser_name_id (xml_parser, node_name, node_name_len);
+
+	/* set node propertys */
+	subtree->props = properties;
+	properties = NULL;
+	lprintf("info: rec %d new subtree %s\n", rec, subtree->name);
+
+	if (rec + 1 >= MAX_RECURSION) {
+	  /* max recursion */
+	  lprintf("error: max recursion\n");
+	  xml_parser_free_tree (subtree);
+	  goto error;
+	}
+	if (callbacks && callbacks->start_element &&
+	    callbacks->start_element (user_data, subtree) == XML_PARSER_STOP) {
+	  xml_parser_free_tree (subtree);
+	  goto stop;
 	}
+	rec++;
+	frames[rec].node = subtree;
+	frames[rec].subtree = NULL;
+	state = STATE_IDLE;
 	break;
-
-      case STATE_Q_ATTRIBUTE:
-	switch (res) {
-	case (T_EOL):
-	case (T_SEPAR):
-	  /* nothing */
-	  break;
-	case (T_TI_STOP):
-	  goto new_leaf;
-	case (T_IDENT):
-	  goto new_prop;
-	default:
-	  lprintf("error: unexpected token \"%s\", state %d\n", tok, state);
-	  return -1;
-	  break;
+      case (T_M_STOP_2):
+	/* new leaf */
+	/* new subtree */
+	new_leaf:
+	subtree = new_xml_node();
+
+	/* set node name */
+	subtree->name = xml_parser_name_dup (xml_parser, node_name, node_name_len,
+					     state == STATE_Q_ATTRIBUTE);
+	if (state != STATE_Q_ATTRIBUTE)
+	  subtree->id = xml_parser_name_id (xml_parser, node_name, node_name_len);
+
+	/* set node propertys */
+	subtree->props = properties;
+	properties = NULL;
+
+	lprintf("info: rec %d new subtree %s\n", rec, subtree->name);
+
+	if (callbacks && callbacks->start_element &&
+	    callbacks->start_element (user_data, subtree) == XML_PARSER_STOP) {
+	  xml_parser_free_tree (subtree);
+	  goto stop;
 	}
+	if (xml_parser_end_element (&frames[rec], subtree, callbacks, user_data) == XML_PARSER_STOP)
+	  goto stop;
+	state = STATE_IDLE;
+	break;
+      case (T_IDENT):
+	/* save property name */
+	new_prop:
+	property_name = tok;
+	property_name_len = tok_len;
+	state = Q_STATE(ATTRIBUTE, ATTRIBUTE_EQUALS);
+	lprintf("info: current property name \"%.*s\"\n", property_name_len, property_name);
 	break;
+      default:
+	lprintf("error: unexpected token \"%.*s\", state %d\n", tok_len, tok, state);
+	goto error;
+	break;
+      }
+      break;
 
-      case STATE_NODE_CLOSE:
-	switch (res) {
-	case (T_IDENT):
-	  /* must be equal to root_name */
-	  if (xml_parser->mode == XML_PARSER_CASE_INSENSITIVE) {
-	    strtoupper(tok);
-	  }
-	  if (strcmp(tok, root_names[rec]) == 0) {
-	    state = STATE_TAG_TERM;
-	  } else if (flags & XML_PARSER_RELAXED) {
-	    int r = rec;
-	    while (--r >= 0)
-	      if (strcmp(tok, root_names[r]) == 0) {
-		lprintf("warning: wanted %s, got %s - assuming missing close tags\n", root_names[rec], tok);
-		retval = r - rec - 1; /* -1 - (no. of implied close tags) */
-		state = STATE_TAG_TERM;
-		break;
-	      }
-	    /* relaxed parsing, ignoring extra close tag (but we don't handle out-of-order) */
-	    if (r < 0) {
-	      lprintf("warning: extra close tag %s - ignoring\n", tok);
-	      state = STATE_TAG_TERM_IGNORE;
+    case STATE_Q_ATTRIBUTE:
+      switch (res) {
+      case (T_EOL):
+      case (T_SEPAR):
+	/* nothing */
+	break;
+      case (T_TI_STOP):
+	goto new_leaf;
+      case (T_IDENT):
+	goto new_prop;
+      default:
+	lprintf("error: unexpected token \"%.*s\", state %d\n", tok_len, tok, state);
+	goto error;
+	break;
+      }
+      break;
+
+    case STATE_NODE_CLOSE:
+      switch (res) {
+      case (T_IDENT):
+	/* must be equal to the name of the current node */
+	if (rec > 0 && xml_parser_name_equal (xml_parser, tok, tok_len, frames[rec].node->name)) {
+	  close_to = rec;
+	  state = STATE_TAG_TERM;
+	} else if (flags & XML_PARSER_RELAXED) {
+	  int r = rec;
+	  while (--r > 0)
+	    if (xml_parser_name_equal (xml_parser, tok, tok_len, frames[r].node->name)) {
+	      lprintf("warning: wanted %s, got %.*s - assuming missing close tags\n", frames[rec].node->name, tok_len, tok);
+	      close_to = r;
+	      state = STATE_TAG_TERM;
+	      break;
 	    }
+	  /* relaxed parsing, ignoring extra close tag (but we don't handle out-of-order) */
+	  if (r <= 0) {
+	    lprintf("warning: extra close tag %.*s - ignoring\n", tok_len, tok);
+	    state = STATE_TAG_TERM_IGNORE;
 	  }
-	  else
-	  {
-	    lprintf("error: xml struct, tok=%s, waited_tok=%s\n", tok, root_names[rec]);
-	    return -1;
-	  }
-	  break;
-	default:
-	  lprintf("error: unexpected token \"%s\", state %d\n", tok, state);
-	  return -1;
-	  break;
 	}
+	else
+	{
+	  lprintf("error: xml struct, tok=%.*s, waited_tok=%s\n", tok_len, tok, rec > 0 ? frames[rec].node->name : "");
+	  goto error;
+	}
+	break;
+      default:
+	lprintf("error: unexpected token \"%.*s\", state %d\n", tok_len, tok, state);
+	goto error;
 	break;
+      }
+      break;
 
 				/* > expected */
-      case STATE_TAG_TERM:
-	switch (res) {
-	case (T_M_STOP_1):
-	  return retval;
-	  break;
-	default:
-	  lprintf("error: unexpected token \"%s\", state %d\n", tok, state);
-	  return -1;
-	  break;
+    case STATE_TAG_TERM:
+      switch (res) {
+      case (T_M_STOP_1):
+	/* close the element, and any whose close tags are missing */
+	while (rec >= close_to) {
+	  subtree = frames[rec--].node;
+	  if (xml_parser_end_element (&frames[rec], subtree, callbacks, user_data) == XML_PARSER_STOP)
+	    goto stop;
 	}
+	state = STATE_IDLE;
+	break;
+      default:
+	lprintf("error: unexpected token \"%.*s\", state %d\n", tok_len, tok, state);
+	goto error;
 	break;
+      }
+      break;
 
 				/* = or > or ident or separator expected */
-      case STATE_ATTRIBUTE_EQUALS:
-	switch (res) {
-	case (T_EOL):
-	case (T_SEPAR):
-	  /* do nothing */
-	  break;
-	case (T_EQUAL):
-	  state = STATE_STRING;
-	  break;
-	case (T_IDENT):
-	  bypass_get_token = 1; /* jump to state 2 without get a new token */
-	  state = STATE_ATTRIBUTE;
-	  break;
-	case (T_M_STOP_1):
-	  /* add a new property without value */
-	  if (current_property == NULL) {
-	    properties = new_xml_property();
-	    current_property = properties;
-	  } else {
-	    current_property->next = new_xml_property();
-	    current_property = current_property->next;
-	  }
-	  current_property->name = strdup (property_name);
-	  lprintf("info: new property %s\n", current_property->name);
-	  bypass_get_token = 1; /* jump to state 2 without get a new token */
-	  state = STATE_ATTRIBUTE;
-	  break;
-	default:
-	  lprintf("error: unexpected token \"%s\", state %d\n", tok, state);
-	  return -1;
-	  break;
+    case STATE_ATTRIBUTE_EQUALS:
+      switch (res) {
+      case (T_EOL):
+      case (T_SEPAR):
+	/* do nothing */
+	break;
+      case (T_EQUAL):
+	state = STATE_STRING;
+	break;
+      case (T_IDENT):
+	bypass_get_token = 1; /* jump to state 2 without get a new token */
+	state = STATE_ATTRIBUTE;
+	break;
+      case (T_M_STOP_1):
+	/* add a new property without value */
+	if (current_property == NULL) {
+	  properties = new_xml_property();
+	  current_property = properties;
+	} else {
+	  current_property->next = new_xml_property();
+	  current_property = current_property->next;
 	}
+	current_property->name = xml_parser_name_dup (xml_parser, property_name, property_name_len, 0);
+	current_property->id = xml_parser_name_id (xml_parser, property_name, property_name_len);
+	lprintf("info: new property %s\n", current_property->name);
+	bypass_get_token = 1; /* jump to state 2 without get a new token */
+	state = STATE_ATTRIBUTE;
+	break;
+      default:
+	lprintf("error: unexpected token \"%.*s\", state %d\n", tok_len, tok, state);
+	goto error;
 	break;
+      }
+      break;
 
 				/* = or ?> or ident or separator expected */
-      case STATE_Q_ATTRIBUTE_EQUALS:
-	switch (res) {
-	case (T_EOL):
-	case (T_SEPAR):
-	  /* do nothing */
-	  break;
-	case (T_EQUAL):
-	  state = STATE_Q_STRING;
-	  break;
-	case (T_IDENT):
-	  bypass_get_token = 1; /* jump to state 2 without get a new token */
-	  state = STATE_Q_ATTRIBUTE;
-	  break;
-	case (T_TI_STOP):
-	  /* add a new property without value */
-	  if (current_property == NULL) {
-	    properties = new_xml_property();
-	    current_property = properties;
-	  } else {
-	    current_property->next = new_xml_property();
-	    current_property = current_property->next;
-	  }
-	  current_property->name = strdup (property_name);
-	  lprintf("info: new property %s\n", current_property->name);
-	  bypass_get_token = 1; /* jump to state 2 without get a new token */
-	  state = STATE_Q_ATTRIBUTE;
-	  break;
-	default:
-	  lprintf("error: unexpected token \"%s\", state %d\n", tok, state);
-	  return -1;
-	  break;
+    case STATE_Q_ATTRIBUTE_EQUALS:
+      switch (res) {
+      case (T_EOL):
+      case (T_SEPAR):
+	/* do nothing */
+	break;
+      case (T_EQUAL):
+	state = STATE_Q_STRING;
+	break;
+      case (T_IDENT):
+	bypass_get_token = 1; /* jump to state 2 without get a new token */
+	state = STATE_Q_ATTRIBUTE;
+	break;
+      case (T_TI_STOP):
+	/* add a new property without value */
+	if (current_property == NULL) {
+	  properties = new_xml_property();
+	  current_property = properties;
+	} else {
+	  current_property->next = new_xml_property();
+	  current_property = current_property->next;
 	}
+	current_property->name = xml_parser_name_dup (xml_parser, property_name, property_name_len, 0);
+	current_property->id = xml_parser_name_id (xml_parser, property_name, property_name_len);
+	lprintf("info: new property %s\n", current_property->name);
+	bypass_get_token = 1; /* jump to state 2 without get a new token */
+	state = STATE_Q_ATTRIBUTE;
 	break;
+      default:
+	lprintf("error: unexpected token \"%.*s\", state %d\n", tok_len, tok, state);
+	goto error;
+	break;
+      }
+      break;
 
 				/* string or ident or separator expected */
-      case STATE_STRING:
-      case STATE_Q_STRING:
-	switch (res) {
-	case (T_EOL):
-	case (T_SEPAR):
-	  /* do nothing */
-	  break;
-	case (T_STRING):
-	case (T_IDENT):
-	  /* add a new property */
-	  if (current_property == NULL) {
-	    properties = new_xml_property();
-	    current_property = properties;
-	  } else {
-	    current_property->next = new_xml_property();
-	    current_property = current_property->next;
-	  }
-	  current_property->name = strdup(property_name);
-	  current_property->value = lexer_decode_entities(tok);
-	  lprintf("info: new property %s=%s\n", current_property->name, current_property->value);
-	  state = Q_STATE(STRING, ATTRIBUTE);
-	  break;
-	default:
-	  lprintf("error: unexpected token \"%s\", state %d\n", tok, state);
-	  return -1;
-	  break;
+    case STATE_STRING:
+    case STATE_Q_STRING:
+      switch (res) {
+      case (T_EOL):
+      case (T_SEPAR):
+	/* do nothing */
+	break;
+      case (T_STRING):
+      case (T_IDENT):
+	/* add a new property */
+	if (current_property == NULL) {
+	  properties = new_xml_property();
+	  current_property = properties;
+	} else {
+	  current_property->next = new_xml_property();
+	  current_property = current_property->next;
 	}
+	current_property->name = xml_parser_name_dup (xml_parser, property_name, property_name_len, 0);
+	current_property->id = xml_parser_name_id (xml_parser, property_name, property_name_len);
+	current_property->value = xml_parser_text_dup (tok, tok_len, 1);
+	lprintf("info: new property %s=%s\n", current_property->name, current_property->value);
+	state = Q_STATE(STRING, ATTRIBUTE);
+	break;
+      default:
+	lprintf("error: unexpected token \"%.*s\", state %d\n", tok_len, tok, state);
+	goto error;
 	break;
+      }
+      break;
 
 				/* --> expected */
-      case STATE_COMMENT:
-	switch (res) {
-	case (T_C_STOP):
-	  state = STATE_IDLE;
-	  break;
-	default:
-	  break;
-	}
+    case STATE_COMMENT:
+      switch (res) {
+      case (T_C_STOP):
+	state = STATE_IDLE;
 	break;
+      case (T_EOF):
+	goto done; /* unterminated comment */
+      default:
+	break;
+      }
+      break;
 
 				/* > expected */
-      case STATE_DOCTYPE:
-	switch (res) {
-	case (T_M_STOP_1):
-	  state = 0;
-	  break;
-	default:
-	  break;
-	}
+    case STATE_DOCTYPE:
+      switch (res) {
+      case (T_M_STOP_1):
+	state = 0;
 	break;
+      case (T_EOF):
+	goto done;
+      default:
+	break;
+      }
+      break;
 
 				/* ]]> expected */
-      case STATE_CDATA:
-	switch (res) {
-	case (T_CDATA_STOP):
-	  current_subtree = xml_parser_append_text (current_node, current_subtree, tok, flags);
-	  lprintf("info: node cdata : %s\n", tok);
-	  state = STATE_IDLE;
-	  break;
-        default:
-	  lprintf("error: unexpected token \"%s\", state %d\n", tok, state);
-	  return -1;
-	  break;
+    case STATE_CDATA:
+      switch (res) {
+      case (T_CDATA_STOP):
+	{
+	  char *text = xml_parser_text_dup (tok, tok_len, 0);
+	  if (callbacks && callbacks->text &&
+	      callbacks->text (user_data, frames[rec].node, text) == XML_PARSER_STOP) {
+	    free (text);
+	    goto stop;
+	  }
+	  frames[rec].subtree = xml_parser_append_text (frames[rec].node, frames[rec].subtree, text, flags);
 	}
+	lprintf("info: node cdata : %.*s\n", tok_len, tok);
+	state = STATE_IDLE;
+	break;
+      default:
+	lprintf("error: unexpected token \"%.*s\", state %d\n", tok_len, tok, state);
+	goto error;
 	break;
+      }
+      break;
 
 				/* > expected (following unmatched "</...") */
-      case STATE_TAG_TERM_IGNORE:
-	switch (res) {
-	case (T_M_STOP_1):
-	  state = STATE_IDLE;
-	  break;
-	default:
-	  lprintf("error: unexpected token \"%s\", state %d\n", tok, state);
-	  return -1;
-	  break;
-	}
+    case STATE_TAG_TERM_IGNORE:
+      switch (res) {
+      case (T_M_STOP_1):
+	state = STATE_IDLE;
 	break;
-
-
-      case STATE_Q_NODE_CLOSE:
-      case STATE_Q_TAG_TERM:
       default:
-	lprintf("error: unknown parser state, state=%d\n", state);
-	return -1;
+	lprintf("error: unexpected token \"%.*s\", state %d\n", tok_len, tok, state);
+	goto error;
+	break;
       }
-    }
-    /* lex error */
-    lprintf("error: lexer error\n");
-    return -1;
-  } else {
-    /* max recursion */
-    lprintf("error: max recursion\n");
-    return -1;
-  }
-}
+      break;
 
-static int xml_parser_get_node (xml_parser_t *xml_parser, xml_node_t *current_node, int flags)
-{
-  int res = 0;
-  int token_buffer_size = TOKEN_SIZE;
-  int pname_buffer_size = TOKEN_SIZE;
-  int nname_buffer_size = TOKEN_SIZE;
-  char *token_buffer = calloc(1, token_buffer_size);
-  char *pname_buffer = calloc(1, pname_buffer_size);
-  char *nname_buffer = calloc(1, nname_buffer_size);
-  char *root_names[MAX_RECURSION + 1];
-  root_names[0] = (char*) ""; /* xml_parser_get_node_internal() only frees names which it allocates */
-
-  res = xml_parser_get_node_internal (xml_parser,
-			     &token_buffer, &token_buffer_size,
-                             &pname_buffer, &pname_buffer_size,
-                             &nname_buffer, &nname_buffer_size,
-                             current_node, root_names, 0, flags);
-
-  free (token_buffer);
-  free (pname_buffer);
-  free (nname_buffer);
 
-  return res;
-}
+    case STATE_Q_NODE_CLOSE:
+    case STATE_Q_TAG_TERM:
+    default:
+      lprintf("error: unknown parser state, state=%d\n", state);
+      goto error;
+    }
+  }
+  /* lex error */
+  lprintf("error: lexer error\n");
+
+ error:
+  /* elements which are still open are dropped */
+  xml_parser_free_props (properties);
+  while (rec > 0)
+    xml_parser_free_tree (frames[rec--].node);
+  return -1;
+
+ done:
+  /* end of document: close any elements left open */
+  while (rec > 0) {
+    subtree = frames[rec--].node;
+    if (xml_parser_end_element (&frames[rec], subtree, callbacks, user_data) == XML_PARSER_STOP)
+      break;
+  }
 
-/* for ABI compatibility */
-int xml_parser_build_tree_with_options(xml_node_t **root_node, int flags) {
-  return xml_parser_build_tree_with_options_r(static_xml_parser, root_node, flags);
+ stop:
+  /* attach what we have, without reporting it */
+  xml_parser_free_props (properties);
+  while (rec > 0) {
+    subtree = frames[rec--].node;
+    xml_parser_end_element (&frames[rec], subtree, NULL, NULL);
+  }
+  return 0;
 }
 
-int xml_parser_build_tree_with_options_r(xml_parser_t *xml_parser, xml_node_t **root_node, int flags) {
+static int xml_parser_build_tree_internal (xml_parser_t *xml_parser, xml_node_t **root_node, int flags,
+                                           const xml_parser_callbacks_t *callbacks, void *user_data) {
   xml_node_t *tmp_node, *pri_node, *q_node;
   int res;
 
   tmp_node = new_xml_node();
-  res = xml_parser_get_node(xml_parser, tmp_node, flags);
+  res = xml_parser_get_node(xml_parser, tmp_node, flags, callbacks, user_data);
+
+  if (root_node == NULL) {
+    /* streaming only */
+    xml_parser_free_tree (tmp_node);
+    return res < 0 ? -1 : 0;
+  }
 
   /* delete any top-level [CDATA] nodes */;
   pri_node = tmp_node->child;
@@ -750,6 +871,20 @@ int xml_parser_build_tree_with_options_r(xml_parser_t *xml_parser, xml_node_t **
   return res;
 }
 
+/* for ABI compatibility */
+int xml_parser_build_tree_with_options(xml_node_t **root_node, int flags) {
+  return xml_parser_build_tree_with_options_r(static_xml_parser, root_node, flags);
+}
+
+int xml_parser_build_tree_with_options_r(xml_parser_t *xml_parser, xml_node_t **root_node, int flags) {
+  return xml_parser_build_tree_internal (xml_parser, root_node, flags, NULL, NULL);
+}
+
+int xml_parser_build_tree_with_callbacks_r(xml_parser_t *xml_parser, xml_node_t **root_node, int flags,
+                                           const xml_parser_callbacks_t *callbacks, void *user_data) {
+  return xml_parser_build_tree_internal (xml_parser, root_node, flags, callbacks, user_data);
+}
+
 /* for ABI compatibility */
 int xml_parser_build_tree(xml_node_t **root_node) {
   return xml_parser_build_tree_with_options_r (static_xml_parser, root_node, 0);
@@ -779,6 +914,20 @@ const char *xml_parser_get_property (const xml_node_t *node, const char *name) {
   return NULL;
 }
 
+const char *xml_parser_get_property_by_id (const xml_node_t *node, int id) {
+
+  xml_property_t *prop;
+
+  if (id == XML_ID_UNKNOWN)
+    return NULL;
+
+  for (prop = node->props; prop; prop = prop->next)
+    if (prop->id == id)
+      return prop->value;
+
+  return NULL;
+}
+
 int xml_parser_get_property_int (const xml_node_t *node, const char *name,
 				 int def_value) {
 
@@ -50,6 +50,7 @@ typedef struct xml_property_s {
 	char *name;
 	char *value;
 	struct xml_property_s *next;
+	int id;
 } xml_property_t;
 
 /* xml node */
@@ -67,17 +68,40 @@ typedef struct xml_node_s {
 	struct xml_property_s *props;
 	struct xml_node_s *child;
 	struct xml_node_s *next;
+	int id;
 } xml_node_t;
 
+/* vocabulary:
+ * the element and property names a caller is interested in, sorted as by
+ * strcasecmp(). Once a parser has one, each node and property it creates
+ * gets the (1-based) index of its name in the table in .id, or
+ * XML_ID_UNKNOWN, so callers can switch on ids instead of comparing names.
+ * Declare the names once, as an X-macro list of (ID, "name") pairs, and
+ * expand it with XML_VOCABULARY_ID into the ids' enum (after an
+ * XML_ID_UNKNOWN entry) and with XML_VOCABULARY_NAME into the table.
+ */
+#define XML_ID_UNKNOWN               0
+
+#define XML_VOCABULARY_ID(id, name)   id,
+#define XML_VOCABULARY_NAME(id, name) name,
+
+typedef struct xml_vocabulary_s {
+	const char * const *names;
+	int count;
+} xml_vocabulary_t;
+
 /* xml parser */
 typedef struct xml_parser_s {
 	struct lexer *lexer;
 	int mode;
+	const xml_vocabulary_t *vocabulary;
 } xml_parser_t;
 
 void xml_parser_init(const char * buf, int size, int mode) XINE_DEPRECATED XINE_PROTECTED;
 xml_parser_t *xml_parser_init_r(const char * buf, int size, int mode) XINE_PROTECTED;
 void xml_parser_finalize_r(xml_parser_t *xml_parser) XINE_PROTECTED;
+void xml_parser_set_vocabulary_r(xml_parser_t *xml_parser, const xml_vocabulary_t *vocabulary) XINE_PROTECTED;
+int xml_vocabulary_is_sorted(const xml_vocabulary_t *vocabulary) XINE_PROTECTED;
 
 int xml_parser_build_tree(xml_node_t **root_node) XINE_DEPRECATED XINE_PROTECTED;
 int xml_parser_build_tree_r(xml_parser_t *xml_parser, xml_node_t **root_node) XINE_PROTECTED;
@@ -85,9 +109,35 @@ int xml_parser_build_tree_r(xml_parser_t *xml_parser, xml_node_t **root_node) XI
 int xml_parser_build_tree_with_options(xml_node_t **root_node, int flags) XINE_DEPRECATED XINE_PROTECTED;
 int xml_parser_build_tree_with_options_r(xml_parser_t *xml_parser, xml_node_t **root_node, int flags) XINE_PROTECTED;
 
+/* streaming interface:
+ * start_element is called as soon as an element's start tag has been read,
+ * with its name and properties set; end_element once its close tag (or, in
+ * relaxed mode, an implied one) has been seen, with its whole subtree built.
+ * text is called with each (decoded) text or CDATA chunk before it is added
+ * to the element it belongs to.
+ * Each callback may return XML_PARSER_STOP to abort parsing; end_element may
+ * also return XML_PARSER_DISCARD to have the element freed rather than
+ * attached to its parent, which keeps memory use bounded by the size of the
+ * largest kept subtree.
+ * If root_node is NULL, the tree is freed once parsing is finished.
+ */
+#define XML_PARSER_CONTINUE          0
+#define XML_PARSER_DISCARD           1
+#define XML_PARSER_STOP              2
+
+typedef struct xml_parser_callbacks_s {
+	int (*start_element) (void *user_data, xml_node_t *node);
+	int (*text) (void *user_data, xml_node_t *node, const char *text);
+	int (*end_element) (void *user_data, xml_node_t *node);
+} xml_parser_callbacks_t;
+
+int xml_parser_build_tree_with_callbacks_r(xml_parser_t *xml_parser, xml_node_t **root_node, int flags,
+					   const xml_parser_callbacks_t *callbacks, void *user_data) XINE_PROTECTED;
+
 void xml_parser_free_tree(xml_node_t *root_node) XINE_PROTECTED;
 
 const char *xml_parser_get_property (const xml_node_t *node, const char *name) XINE_PROTECTED;
+const char *xml_parser_get_property_by_id (const xml_node_t *node, int id) XINE_PROTECTED;
 int   xml_parser_get_property_int (const xml_node_t *node, const char *name,
 				   int def_value) XINE_PROTECTED;
 int xml_parser_get_property_bool (const xml_node_t *node, const char *name,
@@ -0,0 +1,773 @@
+/*
+   The Gnome Library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Library General Public License as
+   published by the Free Software Foundation; either version 2 of the
+   License, or (at your option) any later version.
+
+   The Gnome Library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Library General Public License for more details.
+
+   You should have received a copy of the GNU Library General Public
+   License along with the Gnome Library; see the file COPYING.LIB.  If not,
+   write to the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+   Boston, MA 02110-1301  USA.
+ */
+
+/* A minimal ISO9660 and UDF reader, just enough to get the volume
+ * label of a disc image and find out whether it's a video disc,
+ * looking only at the volume descriptors and a couple of directories
+ * rather than walking the whole image. */
+
+#include "config.h"
+
+#include <string.h>
+#include <glib.h>
+
+#include "xplayer-disc-iso.h"
+
+#define SECTOR_SIZE 2048
+#define FIRST_DESCRIPTOR_SECTOR 16
+#define MAX_DESCRIPTORS 64
+
+/* Don't read directories bigger than that */
+#define MAX_DIRECTORY_SIZE (1024 * 1024)
+
+#define UDF_TAG_PRIMARY_VOLUME_DESCRIPTOR	1
+#define UDF_TAG_ANCHOR_VOLUME_DESCRIPTOR	2
+#define UDF_TAG_PARTITION_DESCRIPTOR		5
+#define UDF_TAG_LOGICAL_VOLUME_DESCRIPTOR	6
+#define UDF_TAG_TERMINATING_DESCRIPTOR		8
+#define UDF_TAG_FILE_SET_DESCRIPTOR		256
+#define UDF_TAG_FILE_IDENTIFIER_DESCRIPTOR	257
+#define UDF_TAG_FILE_ENTRY			261
+#define UDF_TAG_EXTENDED_FILE_ENTRY		266
+
+#define UDF_ANCHOR_SECTOR 256
+#define UDF_MAX_PARTITIONS 4
+
+#define UDF_FILE_DIRECTORY	(1 << 1)
+#define UDF_FILE_DELETED	(1 << 2)
+#define UDF_FILE_PARENT		(1 << 3)
+
+typedef struct {
+	const guchar *data;
+	gsize length;
+	/* Raw images have sync and header bytes around each sector's data */
+	gsize sector_size;
+	gsize sector_offset;
+} IsoImage;
+
+typedef struct {
+	guint32 position;
+	guint32 blocks;
+} UdfExtent;
+
+typedef struct {
+	guint32 start;
+	/* For metadata partitions, where the blocks of the metadata
+	 * file are in the partition above */
+	GArray *extents;
+} UdfPartition;
+
+typedef struct {
+	IsoImage *image;
+	UdfPartition partitions[UDF_MAX_PARTITIONS];
+	guint n_partitions;
+} UdfVolume;
+
+/* Files whose presence tells us what kind of disc we have, as per
+ * shared-mime-info's treemagic */
+static const struct {
+	const char *dir;
+	const char *file;
+	const char *content_type;
+} disc_types[] = {
+	{ "VIDEO_TS", "VIDEO_TS.IFO", "x-content/video-dvd" },
+	{ "MPEGAV", "AVSEQ01.DAT", "x-content/video-vcd" },
+	{ "MPEG2", "AVSEQ01.MPG", "x-content/video-svcd" },
+	{ "BDMV", NULL, "x-content/video-bluray" },
+	{ "BDAV", NULL, "x-content/video-bluray" },
+};
+
+static guint16
+read_le16 (const guchar *p)
+{
+	return p[0] | (p[1] << 8);
+}
+
+static guint32
+read_le32 (const guchar *p)
+{
+	return p[0] | (p[1] << 8) | (p[2] << 16) | ((guint32) p[3] << 24);
+}
+
+static const guchar *
+iso_image_get_sector (IsoImage *image,
+		      guint64 sector,
+		      gsize len)
+{
+	guint64 offset;
+
+	if (len > SECTOR_SIZE)
+		return NULL;
+	offset = sector * image->sector_size + image->sector_offset;
+	if (offset + len > image->length)
+		return NULL;
+
+	return image->data + offset;
+}
+
+static char *
+make_label (char *label)
+{
+	g_strstrip (label);
+	if (!g_utf8_validate (label, -1, NULL)) {
+		g_free (label);
+		return g_strdup ("");
+	}
+
+	return label;
+}
+
+/* ISO9660 */
+
+static gboolean
+iso9660_name_equal (const guchar *id,
+		    guint len,
+		    const char *name)
+{
+	const guchar *end;
+
+	/* Ignore the version, and the dot of extension-less files */
+	end = memchr (id, ';', len);
+	if (end != NULL)
+		len = end - id;
+	if (len > 0 && id[len - 1] == '.')
+		len--;
+
+	return (len == strlen (name) &&
+		g_ascii_strncasecmp ((const char *) id, name, len) == 0);
+}
+
+/* Looks for @name in the directory described by the directory
+ * record @dir, and returns its directory record */
+static const guchar *
+iso9660_dir_find (IsoImage *image,
+		  const guchar *dir,
+		  gboolean high_sierra,
+		  const char *name,
+		  gboolean is_dir)
+{
+	guint32 extent, size, sector;
+	guint flags_offset;
+
+	flags_offset = high_sierra ? 24 : 25;
+	extent = read_le32 (dir + 2);
+	size = MIN (read_le32 (dir + 10), MAX_DIRECTORY_SIZE);
+
+	for (sector = 0; sector * SECTOR_SIZE < size; sector++) {
+		const guchar *data;
+		guint offset;
+
+		data = iso_image_get_sector (image, (guint64) extent + sector, SECTOR_SIZE);
+		if (data == NULL)
+			return NULL;
+
+		/* Records don't cross sector boundaries, and the rest of
+		 * the sector is zero-filled after the last one */
+		for (offset = 0; offset + 34 <= SECTOR_SIZE && data[offset] != 0; offset += data[offset]) {
+			const guchar *record = data + offset;
+			guint name_len;
+
+			if (record[0] < 34 || offset + record[0] > SECTOR_SIZE)
+				break;
+			name_len = record[32];
+			if (33 + name_len > record[0])
+				continue;
+			if (((record[flags_offset] & 0x02) != 0) != is_dir)
+				continue;
+			if (iso9660_name_equal (record + 33, name_len, name))
+				return record;
+		}
+	}
+
+	return NULL;
+}
+
+static const char *
+iso9660_get_content_type (IsoImage *image,
+			  const guchar *root,
+			  gboolean high_sierra)
+{
+	guint i;
+
+	for (i = 0; i < G_N_ELEMENTS (disc_types); i++) {
+		const guchar *dir;
+
+		dir = iso9660_dir_find (image, root, high_sierra, disc_types[i].dir, TRUE);
+		if (dir == NULL)
+			continue;
+		if (disc_types[i].file == NULL ||
+		    iso9660_dir_find (image, dir, high_sierra, disc_types[i].file, FALSE) != NULL)
+			return disc_types[i].content_type;
+	}
+
+	return NULL;
+}
+
+/* Finds the primary volume descriptor, trying the layouts of cooked
+ * images first, then those of raw Mode 1, Mode 2 and Mode 2 without
+ * sync images */
+static const guchar *
+iso9660_find_pvd (IsoImage *image,
+		  gboolean *high_sierra)
+{
+	const struct {
+		gsize size;
+		gsize offset;
+	} layouts[] = {
+		{ 2048, 0 },
+		{ 2352, 16 },
+		{ 2352, 24 },
+		{ 2336, 8 },
+	};
+	guint i, j;
+
+	for (i = 0; i < G_N_ELEMENTS (layouts); i++) {
+		image->sector_size = layouts[i].size;
+		image->sector_offset = layouts[i].offset;
+
+		for (j = FIRST_DESCRIPTOR_SECTOR; j < FIRST_DESCRIPTOR_SECTOR + MAX_DESCRIPTORS; j++) {
+			const guchar *desc;
+
+			desc = iso_image_get_sector (image, j, SECTOR_SIZE);
+			if (desc == NULL)
+				break;
+
+			if (memcmp (desc + 1, "CD001", 5) == 0) {
+				if (desc[0] == 1) {
+					*high_sierra = FALSE;
+					return desc;
+				}
+				/* Volume descriptor set terminator */
+				if (desc[0] == 255)
+					break;
+			} else if (memcmp (desc + 9, "CDROM", 5) == 0) {
+				if (desc[8] == 1) {
+					*high_sierra = TRUE;
+					return desc;
+				}
+				if (desc[8] == 255)
+					break;
+			} else if (j == FIRST_DESCRIPTOR_SECTOR) {
+				break;
+			}
+		}
+	}
+
+	image->sector_size = SECTOR_SIZE;
+	image->sector_offset = 0;
+
+	return NULL;
+}
+
+static char *
+iso9660_get_label (const guchar *pvd,
+		   gboolean high_sierra)
+{
+	return make_label (g_strndup ((const char *) pvd + (high_sierra ? 48 : 40), 32));
+}
+
+/* UDF */
+
+static char *
+udf_decode_chars (const guchar *chars,
+		  guint len)
+{
+	GString *str;
+	guint i;
+
+	if (len == 0)
+		return g_strdup ("");
+
+	str = g_string_new (NULL);
+	/* Compression IDs 8 and 16 are Latin-1 and UCS-2BE */
+	if (chars[0] == 8) {
+		for (i = 1; i < len; i++)
+			g_string_append_unichar (str, chars[i]);
+	} else if (chars[0] == 16) {
+		for (i = 1; i + 1 < len; i += 2)
+			g_string_append_unichar (str, (chars[i] << 8) | chars[i + 1]);
+	}
+
+	return g_string_free (str, FALSE);
+}
+
+static gboolean
+udf_name_equal (const guchar *id,
+		guint len,
+		const char *name)
+{
+	char *str;
+	gboolean retval;
+
+	str = udf_decode_chars (id, len);
+	retval = (g_ascii_strcasecmp (str, name) == 0);
+	g_free (str);
+
+	return retval;
+}
+
+static const guchar *
+udf_volume_get_block (UdfVolume *volume,
+		      guint16 partition_ref,
+		      guint32 block)
+{
+	UdfPartition *partition;
+	guint i;
+
+	if (partition_ref >= volume->n_partitions)
+		return NULL;
+	partition = &volume->partitions[partition_ref];
+
+	if (partition->extents == NULL)
+		return iso_image_get_sector (volume->image, (guint64) partition->start + block, SECTOR_SIZE);
+
+	for (i = 0; i < partition->extents->len; i++) {
+		UdfExtent *extent = &g_array_index (partition->extents, UdfExtent, i);
+
+		if (block < extent->blocks)
+			return iso_image_get_sector (volume->image,
+						     (guint64) partition->start + extent->position + block,
+						     SECTOR_SIZE);
+		block -= extent->blocks;
+	}
+
+	return NULL;
+}
+
+/* Gets the allocation descriptors of a file entry */
+static gboolean
+udf_parse_file_entry (const guchar *entry,
+		      const guchar **ads,
+		      guint32 *ads_len,
+		      guint *ad_type)
+{
+	guint32 ea_len, offset;
+
+	switch (read_le16 (entry)) {
+	case UDF_TAG_FILE_ENTRY:
+		ea_len = read_le32 (entry + 168);
+		*ads_len = read_le32 (entry + 172);
+		offset = 176;
+		break;
+	case UDF_TAG_EXTENDED_FILE_ENTRY:
+		ea_len = read_le32 (entry + 208);
+		*ads_len = read_le32 (entry + 212);
+		offset = 216;
+		break;
+	default:
+		return FALSE;
+	}
+
+	if ((guint64) offset + ea_len + *ads_len > SECTOR_SIZE)
+		return FALSE;
+
+	*ads = entry + offset + ea_len;
+	/* From the flags of the ICB tag */
+	*ad_type = read_le16 (entry + 16 + 18) & 0x07;
+
+	return TRUE;
+}
+
+static GByteArray *
+udf_volume_read_file (UdfVolume *volume,
+		      guint16 partition_ref,
+		      guint32 block)
+{
+	const guchar *entry, *ads;
+	guint32 ads_len, offset;
+	guint ad_type, ad_size;
+	GByteArray *data;
+
+	entry = udf_volume_get_block (volume, partition_ref, block);
+	if (entry == NULL ||
+	    udf_parse_file_entry (entry, &ads, &ads_len, &ad_type) == FALSE)
+		return NULL;
+
+	data = g_byte_array_new ();
+
+	/* Data embedded in the file entry itself */
+	if (ad_type == 3) {
+		g_byte_array_append (data, ads, ads_len);
+		return data;
+	}
+
+	/* Short or long allocation descriptors */
+	if (ad_type == 0)
+		ad_size = 8;
+	else if (ad_type == 1)
+		ad_size = 16;
+	else
+		goto error;
+
+	for (offset = 0; offset + ad_size <= ads_len; offset += ad_size) {
+		guint32 len, position, i;
+		guint16 extent_ref;
+
+		len = read_le32 (ads + offset);
+		position = read_le32 (ads + offset + 4);
+		extent_ref = (ad_type == 1) ? read_le16 (ads + offset + 8) : partition_ref;
+
+		/* Only recorded extents, stopping at continuations */
+		if ((len >> 30) == 3)
+			break;
+		if ((len >> 30) != 0)
+			continue;
+		len &= 0x3fffffff;
+		if (len == 0)
+			break;
+		if (data->len + len > MAX_DIRECTORY_SIZE)
+			goto error;
+
+		for (i = 0; len > 0; i++) {
+			const guchar *sector;
+			guint32 chunk;
+
+			sector = udf_volume_get_block (volume, extent_ref, position + i);
+			if (sector == NULL)
+				goto error;
+			chunk = MIN (len, SECTOR_SIZE);
+			g_byte_array_append (data, sector, chunk);
+			len -= chunk;
+		}
+	}
+
+	return data;
+
+error:
+	g_byte_array_free (data, TRUE);
+	return NULL;
+}
+
+/* Looks for @name in the directory whose file entry is at @block,
+ * and returns where its own file entry is */
+static gboolean
+udf_dir_find (UdfVolume *volume,
+	      guint16 partition_ref,
+	      guint32 block,
+	      const char *name,
+	      gboolean is_dir,
+	      guint16 *found_ref,
+	      guint32 *found_block)
+{
+	GByteArray *data;
+	guint offset;
+	gboolean found = FALSE;
+
+	data = udf_volume_read_file (volume, partition_ref, block);
+	if (data == NULL)
+		return FALSE;
+
+	offset = 0;
+	while (found == FALSE && offset + 38 <= data->len) {
+		const guchar *fid = data->data + offset;
+		guint characteristics, name_len, iu_len, len;
+
+		if (read_le16 (fid) != UDF_TAG_FILE_IDENTIFIER_DESCRIPTOR)
+			break;
+		characteristics = fid[18];
+		name_len = fid[19];
+		iu_len = read_le16 (fid + 36);
+		len = 38 + iu_len + name_len;
+		if (offset + len > data->len)
+			break;
+
+		if ((characteristics & (UDF_FILE_DELETED | UDF_FILE_PARENT)) == 0 &&
+		    ((characteristics & UDF_FILE_DIRECTORY) != 0) == is_dir &&
+		    udf_name_equal (fid + 38 + iu_len, name_len, name)) {
+			*found_block = read_le32 (fid + 20 + 4);
+			*found_ref = read_le16 (fid + 20 + 8);
+			found = TRUE;
+		}
+
+		/* Descriptors are padded to 4 bytes */
+		offset += (len + 3) & ~3;
+	}
+
+	g_byte_array_free (data, TRUE);
+
+	return found;
+}
+
+static const char *
+udf_get_content_type (UdfVolume *volume,
+		      guint16 root_ref,
+		      guint32 root_block)
+{
+	guint i;
+
+	for (i = 0; i < G_N_ELEMENTS (disc_types); i++) {
+		guint16 dir_ref, file_ref;
+		guint32 dir_block, file_block;
+
+		if (udf_dir_find (volume, root_ref, root_block, disc_types[i].dir, TRUE, &dir_ref, &dir_block) == FALSE)
+			continue;
+		if (disc_types[i].file == NULL ||
+		    udf_dir_find (volume, dir_ref, dir_block, disc_types[i].file, FALSE, &file_ref, &file_block) != FALSE)
+			return disc_types[i].content_type;
+	}
+
+	return NULL;
+}
+
+static gboolean
+udf_has_volume_recognition_sequence (IsoImage *image)
+{
+	guint i;
+
+	for (i = FIRST_DESCRIPTOR_SECTOR; i < FIRST_DESCRIPTOR_SECTOR + MAX_DESCRIPTORS; i++) {
+		const guchar *desc;
+
+		desc = iso_image_get_sector (image, i, SECTOR_SIZE);
+		if (desc == NULL)
+			return FALSE;
+		if (memcmp (desc + 1, "NSR02", 5) == 0 ||
+		    memcmp (desc + 1, "NSR03", 5) == 0)
+			return TRUE;
+		/* ISO9660 descriptors can come first */
+		if (memcmp (desc + 1, "BEA01", 5) != 0 &&
+		    memcmp (desc + 1, "CD001", 5) != 0 &&
+		    memcmp (desc + 1, "BOOT2", 5) != 0 &&
+		    memcmp (desc + 1, "CDW02", 5) != 0)
+			return FALSE;
+	}
+
+	return FALSE;
+}
+
+/* Reads the extents of the metadata file, for UDF 2.50 and later */
+static gboolean
+udf_read_metadata_extents (UdfVolume *volume,
+			   UdfPartition *partition,
+			   guint32 block)
+{
+	const guchar *entry, *ads;
+	guint32 ads_len, offset;
+	guint ad_type;
+
+	entry = iso_image_get_sector (volume->image, (guint64) partition->start + block, SECTOR_SIZE);
+	if (entry == NULL ||
+	    udf_parse_file_entry (entry, &ads, &ads_len, &ad_type) == FALSE ||
+	    ad_type != 0)
+		return FALSE;
+
+	partition->extents = g_array_new (FALSE, FALSE, sizeof (UdfExtent));
+	for (offset = 0; offset + 8 <= ads_len; offset += 8) {
+		UdfExtent extent;
+		guint32 len;
+
+		len = read_le32 (ads + offset) & 0x3fffffff;
+		if (len == 0)
+			break;
+		extent.position = read_le32 (ads + offset + 4);
+		extent.blocks = (len + SECTOR_SIZE - 1) / SECTOR_SIZE;
+		g_array_append_val (partition->extents, extent);
+	}
+
+	return TRUE;
+}
+
+static void
+udf_volume_close (UdfVolume *volume)
+{
+	guint i;
+
+	for (i = 0; i < volume->n_partitions; i++) {
+		if (volume->partitions[i].extents != NULL)
+			g_array_free (volume->partitions[i].extents, TRUE);
+	}
+}
+
+static gboolean
+udf_volume_open (UdfVolume *volume,
+		 IsoImage *image,
+		 char **label,
+		 guint16 *root_ref,
+		 guint32 *root_block)
+{
+	const guchar *anchor, *lvd = NULL, *maps, *fsd;
+	guint32 vds_len, vds_start, maps_len, n_maps, i;
+	struct {
+		guint16 number;
+		guint32 start;
+	} partition_descs[UDF_MAX_PARTITIONS];
+	guint n_partition_descs = 0;
+
+	memset (volume, 0, sizeof (UdfVolume));
+	volume->image = image;
+
+	if (udf_has_volume_recognition_sequence (image) == FALSE)
+		return FALSE;
+
+	anchor = iso_image_get_sector (image, UDF_ANCHOR_SECTOR, SECTOR_SIZE);
+	if (anchor == NULL || read_le16 (anchor) != UDF_TAG_ANCHOR_VOLUME_DESCRIPTOR)
+		return FALSE;
+
+	/* Main volume descriptor sequence */
+	vds_len = read_le32 (anchor + 16) / SECTOR_SIZE;
+	vds_start = read_le32 (anchor + 20);
+	for (i = 0; i < MIN (vds_len, MAX_DESCRIPTORS); i++) {
+		const guchar *desc;
+		guint16 tag;
+
+		desc = iso_image_get_sector (image, (guint64) vds_start + i, SECTOR_SIZE);
+		if (desc == NULL)
+			return FALSE;
+
+		tag = read_le16 (desc);
+		if (tag == UDF_TAG_PARTITION_DESCRIPTOR && n_partition_descs < UDF_MAX_PARTITIONS) {
+			partition_descs[n_partition_descs].number = read_le16 (desc + 22);
+			partition_descs[n_partition_descs].start = read_le32 (desc + 188);
+			n_partition_descs++;
+		} else if (tag == UDF_TAG_LOGICAL_VOLUME_DESCRIPTOR) {
+			lvd = desc;
+		} else if (tag == UDF_TAG_TERMINATING_DESCRIPTOR) {
+			break;
+		}
+	}
+
+	if (lvd == NULL || read_le32 (lvd + 212) != SECTOR_SIZE)
+		return FALSE;
+
+	/* Map partition reference numbers to where they are on the disc */
+	maps_len = read_le32 (lvd + 264);
+	n_maps = read_le32 (lvd + 268);
+	if (440 + maps_len > SECTOR_SIZE)
+		return FALSE;
+	maps = lvd + 440;
+	for (i = 0; i < n_maps && i < UDF_MAX_PARTITIONS && maps + 2 <= lvd + 440 + maps_len; i++) {
+		UdfPartition *partition = &volume->partitions[i];
+		guint16 number;
+		guint j;
+
+		if (maps[1] == 0 || maps + maps[1] > lvd + 440 + maps_len)
+			goto error;
+
+		if (maps[0] == 1 && maps[1] >= 6) {
+			number = read_le16 (maps + 4);
+		} else if (maps[0] == 2 && maps[1] >= 44 &&
+			   (memcmp (maps + 5, "*UDF Metadata Partition", 23) == 0 ||
+			    memcmp (maps + 5, "*UDF Sparable Partition", 23) == 0)) {
+			number = read_le16 (maps + 38);
+		} else {
+			/* Virtual partitions of CD-Rs aren't supported */
+			goto error;
+		}
+
+		for (j = 0; j < n_partition_descs; j++) {
+			if (partition_descs[j].number == number)
+				break;
+		}
+		if (j == n_partition_descs)
+			goto error;
+		partition->start = partition_descs[j].start;
+		volume->n_partitions++;
+
+		if (maps[0] == 2 && memcmp (maps + 5, "*UDF Metadata Partition", 23) == 0 &&
+		    udf_read_metadata_extents (volume, partition, read_le32 (maps + 40)) == FALSE)
+			goto error;
+
+		maps += maps[1];
+	}
+
+	/* The file set descriptor, and from there the root directory */
+	fsd = udf_volume_get_block (volume, read_le16 (lvd + 256), read_le32 (lvd + 252));
+	if (fsd == NULL || read_le16 (fsd) != UDF_TAG_FILE_SET_DESCRIPTOR)
+		goto error;
+	*root_block = read_le32 (fsd + 400 + 4);
+	*root_ref = read_le16 (fsd + 400 + 8);
+
+	/* The logical volume identifier is a 128 bytes dstring,
+	 * with its length in the last byte */
+	*label = make_label (udf_decode_chars (lvd + 84, MIN (lvd[84 + 127], 127)));
+
+	return TRUE;
+
+error:
+	udf_volume_close (volume);
+	return FALSE;
+}
+
+/**
+ * xplayer_disc_iso_probe:
+ * @filename: the path of a disc image
+ * @label: (out) (transfer full): return location for the volume label
+ * @content_type: (out) (transfer none): return location for the
+ * x-content type of the disc, or %NULL if it isn't a video disc
+ *
+ * Reads the volume descriptors of an ISO9660 or UDF image, as well as
+ * the few directories needed to tell whether it's a DVD, (S)VCD or
+ * Blu-ray. The ISO9660 volume label is preferred, as with the images'
+ * historical handling. @label is set to an empty string if the label
+ * isn't valid UTF-8.
+ *
+ * This is a private method, not exposed by the library.
+ *
+ * Return value: %TRUE if @filename is an ISO9660 or UDF image
+ **/
+gboolean
+xplayer_disc_iso_probe (const char *filename,
+		      char **label,
+		      const char **content_type)
+{
+	GMappedFile *map;
+	IsoImage image;
+	UdfVolume volume;
+	const guchar *pvd;
+	gboolean high_sierra, retval = FALSE;
+	guint16 root_ref;
+	guint32 root_block;
+	char *udf_label;
+
+	*label = NULL;
+	*content_type = NULL;
+
+	map = g_mapped_file_new (filename, FALSE, NULL);
+	if (map == NULL)
+		return FALSE;
+
+	image.data = (const guchar *) g_mapped_file_get_contents (map);
+	image.length = g_mapped_file_get_length (map);
+
+	pvd = iso9660_find_pvd (&image, &high_sierra);
+	if (pvd != NULL) {
+		*label = iso9660_get_label (pvd, high_sierra);
+		*content_type = iso9660_get_content_type (&image,
+							  pvd + (high_sierra ? 180 : 156),
+							  high_sierra);
+		retval = TRUE;
+	}
+
+	/* Blu-ray images often only have a UDF file system, and
+	 * UDF isn't used for raw images */
+	if (*content_type == NULL &&
+	    image.sector_size == SECTOR_SIZE &&
+	    udf_volume_open (&volume, &image, &udf_label, &root_ref, &root_block) != FALSE) {
+		*content_type = udf_get_content_type (&volume, root_ref, root_block);
+		if (*label == NULL || **label == '\0') {
+			g_free (*label);
+			*label = udf_label;
+		} else {
+			g_free (udf_label);
+		}
+		udf_volume_close (&volume);
+		retval = TRUE;
+	}
+
+	g_mapped_file_unref (map);
+
+	return retval;
+}
@@ -0,0 +1,38 @@
+/*
+   The Gnome Library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Library General Public License as
+   published by the Free Software Foundation; either version 2 of the
+   License, or (at your option) any later version.
+
+   The Gnome Library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Library General Public License for more details.
+
+   You should have received a copy of the GNU Library General Public
+   License along with the Gnome Library; see the file COPYING.LIB.  If not,
+   write to the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+   Boston, MA 02110-1301  USA.
+ */
+
+#ifndef XPLAYER_DISC_ISO_H
+#define XPLAYER_DISC_ISO_H
+
+#include <glib.h>
+
+#include "xplayer-disc.h"
+
+G_BEGIN_DECLS
+
+gboolean xplayer_disc_iso_probe (const char *filename,
+			       char **label,
+			       const char **content_type);
+
+XplayerDiscMediaType xplayer_cd_detect_type_with_label (const char *device,
+						      char **mrl,
+						      char **label,
+						      GError **error);
+
+G_END_DECLS
+
+#endif /* XPLAYER_DISC_ISO_H */
@@ -56,6 +56,7 @@
 
 #include <glib.h>
 #include <glib/gi18n.h>
+#include <glib/gstdio.h>
 #include <gio/gio.h>
 
 #ifdef HAVE_LIBARCHIVE
@@ -64,6 +65,7 @@
 #endif /* HAVE_ARCHIVE */
 
 #include "xplayer-disc.h"
+#include "xplayer-disc-iso.h"
 #include "xplayer-pl-parser.h"
 
 typedef struct _CdCache {
@@ -72,6 +74,8 @@ typedef struct _CdCache {
   GVolume *volume;
 
   char **content_types;
+  /* the volume label of an image, if it could be read */
+  char *label;
 
   GFile *iso_file;
 
@@ -98,6 +102,30 @@ typedef struct _CdCacheCallbackData {
 
 static void cd_cache_free (CdCache *cache);
 
+/* Top-level entries g_content_type_guess_for_tree() looks for to
+ * recognise video discs, as per shared-mime-info's treemagic */
+static const char *disc_markers[] = {
+  "VIDEO_TS",
+  "VIDEO_TS.IFO",
+  "VIDEO_TS.IFO;1",
+  "BDMV",
+  "BDAV",
+  "MPEGAV",
+  "MPEG2"
+};
+
+/* Directories known not to contain any of the above, by inode,
+ * along with their modification time at the time */
+typedef struct {
+  dev_t dev;
+  ino_t ino;
+} CdDirKey;
+
+#define NO_MARKERS_MAX_ENTRIES 16384
+
+static GMutex no_markers_mutex;
+static GHashTable *no_markers = NULL;
+
 static char *
 xplayer_resolve_symlink (const char *device, GError **error)
 {
@@ -271,6 +299,20 @@ cd_cache_check_archive (CdCache *cache,
 			const char *filename,
 			GError **error)
 {
+  char *label;
+  const char *content_type;
+
+  /* Only look at the few sectors we need for ISO9660 and
+   * UDF images, rather than going through every file */
+  if (xplayer_disc_iso_probe (filename, &label, &content_type) != FALSE) {
+    const char *content_types[] = { content_type, NULL };
+
+    cache->label = label;
+    if (content_type != NULL)
+      cache->content_types = g_strdupv ((gchar **) content_types);
+    return TRUE;
+  }
+
 #ifndef HAVE_LIBARCHIVE
   g_set_error (error, XPLAYER_PL_PARSER_ERROR, XPLAYER_PL_PARSER_ERROR_MOUNT_FAILED,
 	       _("Failed to mount %s."), filename);
@@ -591,6 +633,7 @@ cd_cache_free (CdCache *cache)
     g_object_unref (cache->volume);
   g_free (cache->mountpoint);
   g_free (cache->device);
+  g_free (cache->label);
   g_free (cache);
 }
 
@@ -702,6 +745,124 @@ xplayer_cd_dir_get_parent (const char *dir)
   return parent;
 }
 
+static guint
+cd_dir_key_hash (gconstpointer v)
+{
+  const CdDirKey *key = v;
+
+  return (guint) key->ino ^ (guint) key->dev;
+}
+
+static gboolean
+cd_dir_key_equal (gconstpointer a,
+		  gconstpointer b)
+{
+  const CdDirKey *key_a = a;
+  const CdDirKey *key_b = b;
+
+  return (key_a->ino == key_b->ino && key_a->dev == key_b->dev);
+}
+
+/* Whether @path holds a top-level entry that could make it a video
+ * disc. This lists the directory, as treemagic matching is
+ * case-insensitive */
+static gboolean
+cd_dir_has_disc_markers (const char *path)
+{
+  struct stat buf;
+  CdDirKey key;
+  gint64 *mtime;
+  GDir *dir;
+  const char *name;
+  gboolean found;
+
+  if (g_stat (path, &buf) != 0 || !S_ISDIR (buf.st_mode))
+    return TRUE;
+
+  memset (&key, 0, sizeof (key));
+  key.dev = buf.st_dev;
+  key.ino = buf.st_ino;
+
+  g_mutex_lock (&no_markers_mutex);
+  mtime = no_markers ? g_hash_table_lookup (no_markers, &key) : NULL;
+  found = (mtime == NULL || *mtime != (gint64) buf.st_mtime);
+  g_mutex_unlock (&no_markers_mutex);
+  if (found == FALSE)
+    return FALSE;
+
+  dir = g_dir_open (path, 0, NULL);
+  if (dir == NULL)
+    return TRUE;
+
+  found = FALSE;
+  while (found == FALSE && (name = g_dir_read_name (dir)) != NULL) {
+    guint i;
+
+    for (i = 0; i < G_N_ELEMENTS (disc_markers); i++) {
+      if (g_ascii_strcasecmp (name, disc_markers[i]) == 0) {
+	found = TRUE;
+	break;
+      }
+    }
+  }
+  g_dir_close (dir);
+
+  if (found == FALSE) {
+    g_mutex_lock (&no_markers_mutex);
+    if (no_markers == NULL)
+      no_markers = g_hash_table_new_full (cd_dir_key_hash, cd_dir_key_equal, g_free, g_free);
+    else if (g_hash_table_size (no_markers) >= NO_MARKERS_MAX_ENTRIES)
+      g_hash_table_remove_all (no_markers);
+    mtime = g_new (gint64, 1);
+    *mtime = buf.st_mtime;
+    g_hash_table_replace (no_markers, g_memdup (&key, sizeof (key)), mtime);
+    g_mutex_unlock (&no_markers_mutex);
+  }
+
+  return found;
+}
+
+/* Guessing the content type of a tree is expensive, so check
+ * that the directory, or its parent, at least looks like a disc
+ * before doing that. Anything that isn't a local directory needs
+ * the full detection */
+static gboolean
+cd_dir_might_be_disc (const char *dir)
+{
+  GFile *file;
+  char *local, *parent;
+  gboolean retval;
+
+  if (g_str_has_prefix (dir, "archive://"))
+    return TRUE;
+
+  if (dir[0] == '/') {
+    local = g_strdup (dir);
+  } else {
+    file = g_file_new_for_commandline_arg (dir);
+    local = g_file_get_path (file);
+    g_object_unref (file);
+    if (local == NULL)
+      return TRUE;
+  }
+
+  if (g_file_test (local, G_FILE_TEST_IS_DIR) == FALSE) {
+    g_free (local);
+    return TRUE;
+  }
+
+  retval = cd_dir_has_disc_markers (local);
+  if (retval == FALSE) {
+    parent = g_path_get_dirname (local);
+    if (strcmp (parent, local) != 0)
+      retval = cd_dir_has_disc_markers (parent);
+    g_free (parent);
+  }
+  g_free (local);
+
+  return retval;
+}
+
 /**
  * xplayer_cd_detect_type_from_dir:
  * @dir: a directory URI
@@ -730,6 +891,9 @@ xplayer_cd_detect_type_from_dir (const char *dir, char **mrl, GError **error)
 
   g_return_val_if_fail (dir != NULL, MEDIA_TYPE_ERROR);
 
+  if (cd_dir_might_be_disc (dir) == FALSE)
+    return MEDIA_TYPE_DATA;
+
   if (!(cache = cd_cache_new (dir, error)))
     return MEDIA_TYPE_ERROR;
   if ((type = cd_cache_disc_is_vcd (cache, error)) == MEDIA_TYPE_DATA &&
@@ -794,16 +958,47 @@ XplayerDiscMediaType
 xplayer_cd_detect_type_with_url (const char *device,
     			       char      **mrl,
 			       GError     **error)
+{
+  return xplayer_cd_detect_type_with_label (device, mrl, NULL, error);
+}
+
+/**
+ * xplayer_cd_detect_type_with_label:
+ * @device: a device node path
+ * @mrl: (out) (transfer full) (allow-none): return location for the disc's MRL, or %NULL
+ * @label: (out) (transfer full) (allow-none): return location for the volume
+ * label of a disc image, or %NULL
+ * @error: return location for a #GError, or %NULL
+ *
+ * Same as xplayer_cd_detect_type_with_url(), but also returns the label
+ * of disc images, read along with their type. @label is set to %NULL
+ * when it couldn't be read. This is a private method, not exposed by
+ * the library.
+ *
+ * Return value: #XplayerDiscMediaType corresponding to the disc's type, or #MEDIA_TYPE_ERROR on failure
+ **/
+XplayerDiscMediaType
+xplayer_cd_detect_type_with_label (const char *device,
+				 char      **mrl,
+				 char      **label,
+				 GError     **error)
 {
   CdCache *cache;
   XplayerDiscMediaType type;
 
   if (mrl != NULL)
     *mrl = NULL;
+  if (label != NULL)
+    *label = NULL;
 
   if (!(cache = cd_cache_new (device, error)))
     return MEDIA_TYPE_ERROR;
 
+  if (label != NULL) {
+    *label = cache->label;
+    cache->label = NULL;
+  }
+
   type = cd_cache_disc_is_cdda (cache, error);
   if (type == MEDIA_TYPE_ERROR && *error != NULL) {
     cd_cache_free (cache);
@@ -133,7 +133,7 @@ xplayer_pl_parser_add_amz (XplayerPlParser *parser,
 	XplayerPlParserResult ret;
 	gsize b64len;
 
-	if (g_file_load_contents (file, NULL, &b64data, &b64len, NULL, NULL) == FALSE)
+	if (xplayer_pl_parser_load_contents (parser, file, parse_data, &b64data, &b64len) == FALSE)
 		return XPLAYER_PL_PARSER_RESULT_ERROR;
 
 	if (amzfile_decrypt_blob (b64data, b64len, &contents) == FALSE) {
@@ -0,0 +1,411 @@
+/*
+   The Gnome Library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Library General Public License as
+   published by the Free Software Foundation; either version 2 of the
+   License, or (at your option) any later version.
+
+   The Gnome Library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Library General Public License for more details.
+
+   You should have received a copy of the GNU Library General Public
+   License along with the Gnome Library; see the file COPYING.LIB.  If not,
+   write to the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+   Boston, MA 02110-1301  USA.
+ */
+
+#include "config.h"
+
+#include <string.h>
+#include <glib.h>
+
+#ifndef XPLAYER_PL_PARSER_MINI
+#include "xplayer-pl-parser.h"
+#endif /* !XPLAYER_PL_PARSER_MINI */
+
+#include "xplayer-pl-parser-mini.h"
+#include "xplayer-pl-parser-binary.h"
+#include "xplayer-pl-parser-private.h"
+
+/* The binary format is meant for caches rather than for interchange,
+ * and is read in place, without parsing or copying the file.
+ *
+ * Everything is little-endian and 32-bit, starting with a header of
+ * N_HEADER_WORDS words, see below. The string table holds every field
+ * name and value once, each NUL-terminated, and strings are referred
+ * to by their offset in it, BINARY_NONE meaning none.
+ *
+ * The field table lists the names of the fields the playlist uses,
+ * and every entry is a record with one string offset per field, in
+ * the same order. Records are all the same size, so the Nth entry is
+ * found without reading the ones before it.
+ *
+ * The index section is reserved for a lookup index. Version 1 writers
+ * leave it empty, and readers ignore it. */
+#define BINARY_MAGIC		"XPLB"
+#define BINARY_VERSION		1
+#define BINARY_NONE		G_MAXUINT32
+
+enum {
+	HEADER_MAGIC,
+	HEADER_VERSION,
+	HEADER_FLAGS,
+	HEADER_N_ENTRIES,
+	HEADER_N_FIELDS,
+	HEADER_TITLE,
+	HEADER_FIELDS,
+	HEADER_RECORDS,
+	HEADER_STRINGS,
+	HEADER_STRINGS_SIZE,
+	HEADER_INDEX,
+	HEADER_INDEX_SIZE,
+	N_HEADER_WORDS
+};
+
+#define HEADER_SIZE		(N_HEADER_WORDS * sizeof (guint32))
+
+const char *
+xplayer_pl_parser_is_binary (const char *data, gsize len)
+{
+	if (len >= HEADER_SIZE && memcmp (data, BINARY_MAGIC, strlen (BINARY_MAGIC)) == 0)
+		return BINARY_PL_MIME_TYPE;
+
+	return NULL;
+}
+
+#ifndef XPLAYER_PL_PARSER_MINI
+
+/* The fields that are saved, the URI first */
+static const char *binary_fields[] = {
+	XPLAYER_PL_PARSER_FIELD_URI,
+	XPLAYER_PL_PARSER_FIELD_GENRE,
+	XPLAYER_PL_PARSER_FIELD_TITLE,
+	XPLAYER_PL_PARSER_FIELD_AUTHOR,
+	XPLAYER_PL_PARSER_FIELD_ALBUM,
+	XPLAYER_PL_PARSER_FIELD_BASE,
+	XPLAYER_PL_PARSER_FIELD_SUBTITLE_URI,
+	XPLAYER_PL_PARSER_FIELD_VOLUME,
+	XPLAYER_PL_PARSER_FIELD_AUTOPLAY,
+	XPLAYER_PL_PARSER_FIELD_DURATION,
+	XPLAYER_PL_PARSER_FIELD_DURATION_MS,
+	XPLAYER_PL_PARSER_FIELD_STARTTIME,
+	XPLAYER_PL_PARSER_FIELD_ENDTIME,
+	XPLAYER_PL_PARSER_FIELD_COPYRIGHT,
+	XPLAYER_PL_PARSER_FIELD_ABSTRACT,
+	XPLAYER_PL_PARSER_FIELD_DESCRIPTION,
+	XPLAYER_PL_PARSER_FIELD_MOREINFO,
+	XPLAYER_PL_PARSER_FIELD_SCREENSIZE,
+	XPLAYER_PL_PARSER_FIELD_UI_MODE,
+	XPLAYER_PL_PARSER_FIELD_PUB_DATE,
+	XPLAYER_PL_PARSER_FIELD_FILESIZE,
+	XPLAYER_PL_PARSER_FIELD_LANGUAGE,
+	XPLAYER_PL_PARSER_FIELD_CONTACT,
+	XPLAYER_PL_PARSER_FIELD_IMAGE_URI,
+	XPLAYER_PL_PARSER_FIELD_DOWNLOAD_URI,
+	XPLAYER_PL_PARSER_FIELD_ID,
+	XPLAYER_PL_PARSER_FIELD_CONTENT_TYPE,
+	XPLAYER_PL_PARSER_FIELD_PLAYING
+};
+
+static guint32
+binary_intern (GHashTable *offsets, GByteArray *strings, const char *str)
+{
+	gpointer offset;
+
+	if (g_hash_table_lookup_extended (offsets, str, NULL, &offset) == FALSE) {
+		offset = GUINT_TO_POINTER (strings->len);
+		g_hash_table_insert (offsets, g_strdup (str), offset);
+		g_byte_array_append (strings, (const guint8 *) str, strlen (str) + 1);
+	}
+
+	return GPOINTER_TO_UINT (offset);
+}
+
+gboolean
+xplayer_pl_parser_save_binary (XplayerPlParser    *parser,
+			     XplayerPlPlaylist  *playlist,
+			     GFile            *output,
+			     const char       *title,
+			     GError          **error)
+{
+	XplayerPlPlaylistIter iter;
+	GFileOutputStream *stream;
+	GHashTable *offsets;
+	GByteArray *strings;
+	GArray *records;
+	gboolean used[G_N_ELEMENTS (binary_fields)];
+	guint columns[G_N_ELEMENTS (binary_fields)];
+	guint32 header[N_HEADER_WORDS], names[G_N_ELEMENTS (binary_fields)];
+	guint n_entries, n_fields, i;
+	guint64 size;
+	gboolean valid, ret;
+
+	/* Find out which fields are used, so that the records only
+	 * have room for those */
+	memset (used, 0, sizeof (used));
+	used[0] = TRUE;
+	n_entries = 0;
+
+	valid = xplayer_pl_playlist_iter_first (playlist, &iter);
+	while (valid) {
+		GValue value = { 0, };
+
+		if (xplayer_pl_playlist_get_value (playlist, &iter, XPLAYER_PL_PARSER_FIELD_URI, &value) != FALSE) {
+			g_value_unset (&value);
+			n_entries++;
+
+			for (i = 1; i < G_N_ELEMENTS (binary_fields); i++) {
+				if (used[i] != FALSE)
+					continue;
+				if (xplayer_pl_playlist_get_value (playlist, &iter, binary_fields[i], &value) != FALSE) {
+					g_value_unset (&value);
+					used[i] = TRUE;
+				}
+			}
+		}
+
+		valid = xplayer_pl_playlist_iter_next (playlist, &iter);
+	}
+
+	n_fields = 0;
+	for (i = 0; i < G_N_ELEMENTS (binary_fields); i++) {
+		if (used[i] != FALSE)
+			columns[n_fields++] = i;
+	}
+
+	size = HEADER_SIZE + (guint64) n_fields * sizeof (guint32) * (1 + (guint64) n_entries);
+	if (size > G_MAXUINT32) {
+		g_set_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_ARGUMENT,
+			     "Playlist is too large to be saved in the binary format");
+		return FALSE;
+	}
+
+	offsets = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+	strings = g_byte_array_new ();
+
+	for (i = 0; i < n_fields; i++)
+		names[i] = GUINT32_TO_LE (binary_intern (offsets, strings, binary_fields[columns[i]]));
+
+	memcpy (header, BINARY_MAGIC, sizeof (guint32));
+	header[HEADER_VERSION] = GUINT32_TO_LE (BINARY_VERSION);
+	header[HEADER_FLAGS] = 0;
+	header[HEADER_N_ENTRIES] = GUINT32_TO_LE (n_entries);
+	header[HEADER_N_FIELDS] = GUINT32_TO_LE (n_fields);
+	if (title != NULL && *title != '\0')
+		header[HEADER_TITLE] = GUINT32_TO_LE (binary_intern (offsets, strings, title));
+	else
+		header[HEADER_TITLE] = GUINT32_TO_LE (BINARY_NONE);
+
+	records = g_array_sized_new (FALSE, FALSE, sizeof (guint32), n_entries * n_fields);
+
+	valid = xplayer_pl_playlist_iter_first (playlist, &iter);
+	while (valid) {
+		GValue value = { 0, };
+		guint32 offset;
+
+		if (xplayer_pl_playlist_get_value (playlist, &iter, XPLAYER_PL_PARSER_FIELD_URI, &value) == FALSE) {
+			valid = xplayer_pl_playlist_iter_next (playlist, &iter);
+			continue;
+		}
+		g_value_unset (&value);
+
+		for (i = 0; i < n_fields; i++) {
+			if (xplayer_pl_playlist_get_value (playlist, &iter, binary_fields[columns[i]], &value) != FALSE) {
+				offset = binary_intern (offsets, strings, g_value_get_string (&value));
+				g_value_unset (&value);
+			} else {
+				offset = BINARY_NONE;
+			}
+			offset = GUINT32_TO_LE (offset);
+			g_array_append_val (records, offset);
+		}
+
+		valid = xplayer_pl_playlist_iter_next (playlist, &iter);
+	}
+
+	g_hash_table_destroy (offsets);
+
+	size += strings->len;
+	if (size > G_MAXUINT32) {
+		g_set_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_ARGUMENT,
+			     "Playlist is too large to be saved in the binary format");
+		g_array_free (records, TRUE);
+		g_byte_array_free (strings, TRUE);
+		return FALSE;
+	}
+
+	header[HEADER_FIELDS] = GUINT32_TO_LE (HEADER_SIZE);
+	header[HEADER_RECORDS] = GUINT32_TO_LE (HEADER_SIZE + n_fields * sizeof (guint32));
+	header[HEADER_STRINGS] = GUINT32_TO_LE (size - strings->len);
+	header[HEADER_STRINGS_SIZE] = GUINT32_TO_LE (strings->len);
+	header[HEADER_INDEX] = 0;
+	header[HEADER_INDEX_SIZE] = 0;
+
+	ret = FALSE;
+	stream = g_file_replace (output, NULL, FALSE, G_FILE_CREATE_NONE, NULL, error);
+	if (stream != NULL) {
+		ret = xplayer_pl_parser_write_buffer (G_OUTPUT_STREAM (stream), (const char *) header, HEADER_SIZE, error) &&
+			xplayer_pl_parser_write_buffer (G_OUTPUT_STREAM (stream), (const char *) names, n_fields * sizeof (guint32), error) &&
+			xplayer_pl_parser_write_buffer (G_OUTPUT_STREAM (stream), records->data, records->len * sizeof (guint32), error) &&
+			xplayer_pl_parser_write_buffer (G_OUTPUT_STREAM (stream), (const char *) strings->data, strings->len, error);
+		if (ret == FALSE)
+			DEBUG(output, g_print ("Couldn't write binary playlist '%s'\n", uri));
+		g_object_unref (stream);
+	}
+
+	g_array_free (records, TRUE);
+	g_byte_array_free (strings, TRUE);
+
+	return ret;
+}
+
+static gboolean
+binary_read_header (XplayerPlParser *parser,
+		    GFile *file,
+		    const XplayerPlParserContents *contents,
+		    guint32 *header)
+{
+	guint64 size;
+	guint i;
+
+	size = contents->size;
+	if (size < HEADER_SIZE || memcmp (contents->data, BINARY_MAGIC, strlen (BINARY_MAGIC)) != 0) {
+		DEBUG(file, g_print ("Binary playlist '%s' has no valid header\n", uri));
+		return FALSE;
+	}
+
+	memcpy (header, contents->data, HEADER_SIZE);
+	for (i = HEADER_VERSION; i < N_HEADER_WORDS; i++)
+		header[i] = GUINT32_FROM_LE (header[i]);
+
+	if (header[HEADER_VERSION] != BINARY_VERSION) {
+		DEBUG(file, g_print ("Binary playlist '%s' has unsupported version %u\n", uri, header[HEADER_VERSION]));
+		return FALSE;
+	}
+
+	/* Everything must fit in the file, the string table must end
+	 * with a NUL, and the tables of offsets must be aligned */
+	if (header[HEADER_N_FIELDS] == 0 ||
+	    header[HEADER_FIELDS] % sizeof (guint32) != 0 ||
+	    header[HEADER_RECORDS] % sizeof (guint32) != 0 ||
+	    header[HEADER_FIELDS] + (guint64) header[HEADER_N_FIELDS] * sizeof (guint32) > size ||
+	    (guint64) header[HEADER_N_FIELDS] * header[HEADER_N_ENTRIES] > size / sizeof (guint32) ||
+	    header[HEADER_RECORDS] + (guint64) header[HEADER_N_FIELDS] * header[HEADER_N_ENTRIES] * sizeof (guint32) > size ||
+	    header[HEADER_STRINGS] + (guint64) header[HEADER_STRINGS_SIZE] > size ||
+	    (header[HEADER_STRINGS_SIZE] > 0 &&
+	     contents->data[header[HEADER_STRINGS] + header[HEADER_STRINGS_SIZE] - 1] != '\0')) {
+		DEBUG(file, g_print ("Binary playlist '%s' is truncated or corrupted\n", uri));
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+static const char *
+binary_string (const char *strings, guint32 strings_size, guint32 offset)
+{
+	if (offset >= strings_size)
+		return NULL;
+	return strings + offset;
+}
+
+XplayerPlParserResult
+xplayer_pl_parser_add_binary (XplayerPlParser *parser,
+			    GFile *file,
+			    GFile *base_file,
+			    XplayerPlParseData *parse_data,
+			    gpointer data)
+{
+	XplayerPlParserContents contents;
+	guint32 header[N_HEADER_WORDS];
+	const guint32 *fields, *records;
+	const char **names;
+	const char *strings, *str;
+	guint32 strings_size, n_fields, uri_field, i, j;
+	char *uri;
+
+	if (xplayer_pl_parser_contents_load (parser, file, parse_data, &contents) == FALSE)
+		return XPLAYER_PL_PARSER_RESULT_ERROR;
+
+	if (binary_read_header (parser, file, &contents, header) == FALSE) {
+		xplayer_pl_parser_contents_clear (&contents);
+		return XPLAYER_PL_PARSER_RESULT_ERROR;
+	}
+
+	strings = contents.data + header[HEADER_STRINGS];
+	strings_size = header[HEADER_STRINGS_SIZE];
+
+	/* Validate all the strings in one go, rather than one at a time */
+	for (str = strings; str < strings + strings_size; str += strlen (str) + 1) {
+		if (g_utf8_validate (str, -1, NULL) == FALSE) {
+			DEBUG(file, g_print ("Binary playlist '%s' contains invalid UTF-8\n", uri));
+			xplayer_pl_parser_contents_clear (&contents);
+			return XPLAYER_PL_PARSER_RESULT_ERROR;
+		}
+	}
+
+	n_fields = header[HEADER_N_FIELDS];
+	fields = (const guint32 *) (contents.data + header[HEADER_FIELDS]);
+	records = (const guint32 *) (contents.data + header[HEADER_RECORDS]);
+
+	names = g_new (const char *, n_fields);
+	uri_field = BINARY_NONE;
+	for (i = 0; i < n_fields; i++) {
+		names[i] = binary_string (strings, strings_size, GUINT32_FROM_LE (fields[i]));
+		if (uri_field == BINARY_NONE && g_strcmp0 (names[i], XPLAYER_PL_PARSER_FIELD_URI) == 0)
+			uri_field = i;
+	}
+
+	if (uri_field == BINARY_NONE) {
+		DEBUG(file, g_print ("Binary playlist '%s' has no URI field\n", uri));
+		g_free (names);
+		xplayer_pl_parser_contents_clear (&contents);
+		return XPLAYER_PL_PARSER_RESULT_ERROR;
+	}
+
+	xplayer_pl_parser_add_uri (parser,
+				 XPLAYER_PL_PARSER_FIELD_IS_PLAYLIST, TRUE,
+				 XPLAYER_PL_PARSER_FIELD_FILE, file,
+				 XPLAYER_PL_PARSER_FIELD_TITLE, binary_string (strings, strings_size, header[HEADER_TITLE]),
+				 NULL);
+
+	for (i = 0; i < header[HEADER_N_ENTRIES]; i++) {
+		const guint32 *record;
+		const char *entry_uri;
+		GHashTable *metadata;
+
+		record = records + (gsize) i * n_fields;
+		entry_uri = binary_string (strings, strings_size, GUINT32_FROM_LE (record[uri_field]));
+		if (entry_uri == NULL || *entry_uri == '\0')
+			continue;
+
+		/* The values were already fixed up when the playlist was
+		 * parsed, so they're added as they are */
+		metadata = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
+		for (j = 0; j < n_fields; j++) {
+			const char *value;
+
+			if (j == uri_field || names[j] == NULL)
+				continue;
+			value = binary_string (strings, strings_size, GUINT32_FROM_LE (record[j]));
+			if (value == NULL || *value == '\0')
+				continue;
+			g_hash_table_insert (metadata, g_strdup (names[j]), g_strdup (value));
+		}
+
+		xplayer_pl_parser_add_hash_table (parser, metadata, entry_uri, FALSE);
+		g_hash_table_unref (metadata);
+	}
+
+	uri = g_file_get_uri (file);
+	xplayer_pl_parser_playlist_end (parser, uri);
+	g_free (uri);
+
+	g_free (names);
+	xplayer_pl_parser_contents_clear (&contents);
+
+	return XPLAYER_PL_PARSER_RESULT_SUCCESS;
+}
+
+#endif /* !XPLAYER_PL_PARSER_MINI */
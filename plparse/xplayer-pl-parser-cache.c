@@ -0,0 +1,388 @@
+/*
+   The Gnome Library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Library General Public License as
+   published by the Free Software Foundation; either version 2 of the
+   License, or (at your option) any later version.
+
+   The Gnome Library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Library General Public License for more details.
+
+   You should have received a copy of the GNU Library General Public
+   License along with the Gnome Library; see the file COPYING.LIB.  If not,
+   write to the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+   Boston, MA 02110-1301  USA.
+ */
+
+#include "config.h"
+
+#ifndef XPLAYER_PL_PARSER_MINI
+#include <string.h>
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <libsoup/soup.h>
+
+#include "xplayer-pl-parser.h"
+#include "xplayer-pl-parser-cache.h"
+
+/* Each cached document is stored as two files named after the SHA-1 of
+ * its URL: the body itself, and a key file next to it holding the
+ * validators we need to revalidate it with a conditional GET */
+#define CACHE_GROUP "Cache Entry"
+#define CACHE_INFO_SUFFIX ".info"
+
+/* Evict down to this fraction of the maximum size, so that a full
+ * cache doesn't list its directory for every new document */
+#define CACHE_EVICT_RATIO 0.75
+
+struct XplayerPlParserCache {
+	volatile gint ref_count;
+	char *dir;
+	guint64 max_size;
+	XplayerPlParserCacheEviction eviction;
+	gint64 total; /* size of the bodies in dir, or -1 until listed */
+	GMutex mutex; /* serialises writes and eviction */
+};
+
+typedef struct {
+	char *info_path;
+	gint64 time;
+	guint64 size;
+} CacheEntry;
+
+XplayerPlParserCache *
+xplayer_pl_parser_cache_new (const char *dir,
+			   guint64 max_size,
+			   XplayerPlParserCacheEviction eviction)
+{
+	XplayerPlParserCache *cache;
+
+	g_return_val_if_fail (dir != NULL, NULL);
+
+	cache = g_new0 (XplayerPlParserCache, 1);
+	cache->ref_count = 1;
+	cache->dir = g_strdup (dir);
+	cache->max_size = max_size;
+	cache->eviction = eviction;
+	cache->total = -1;
+	g_mutex_init (&cache->mutex);
+
+	return cache;
+}
+
+XplayerPlParserCache *
+xplayer_pl_parser_cache_ref (XplayerPlParserCache *cache)
+{
+	g_atomic_int_inc (&cache->ref_count);
+	return cache;
+}
+
+void
+xplayer_pl_parser_cache_unref (XplayerPlParserCache *cache)
+{
+	if (g_atomic_int_dec_and_test (&cache->ref_count) == FALSE)
+		return;
+
+	g_mutex_clear (&cache->mutex);
+	g_free (cache->dir);
+	g_free (cache);
+}
+
+gboolean
+xplayer_pl_parser_cache_handles (XplayerPlParserCache *cache,
+			       GFile *file)
+{
+	return (g_file_has_uri_scheme (file, "http") != FALSE ||
+		g_file_has_uri_scheme (file, "https") != FALSE);
+}
+
+static int
+cache_entry_compare (gconstpointer a, gconstpointer b)
+{
+	const CacheEntry *ea = a;
+	const CacheEntry *eb = b;
+
+	if (ea->time < eb->time)
+		return -1;
+	return ea->time > eb->time;
+}
+
+/* Called with the mutex held */
+static void
+cache_remove_entry (XplayerPlParserCache *cache,
+		    const char *info_path)
+{
+	GStatBuf buf;
+	char *body_path;
+
+	body_path = g_strndup (info_path, strlen (info_path) - strlen (CACHE_INFO_SUFFIX));
+	if (cache->total >= 0 && g_stat (body_path, &buf) == 0)
+		cache->total = MAX (cache->total - (gint64) buf.st_size, 0);
+	g_unlink (body_path);
+	g_unlink (info_path);
+	g_free (body_path);
+}
+
+/* Called with the mutex held */
+static void
+cache_evict (XplayerPlParserCache *cache)
+{
+	GArray *entries;
+	GDir *dir;
+	const char *name;
+	guint64 total, target;
+	guint i;
+
+	dir = g_dir_open (cache->dir, 0, NULL);
+	if (dir == NULL)
+		return;
+
+	entries = g_array_new (FALSE, FALSE, sizeof (CacheEntry));
+	total = 0;
+	while ((name = g_dir_read_name (dir)) != NULL) {
+		CacheEntry entry;
+		GKeyFile *info;
+		GStatBuf buf;
+		char *body_path;
+
+		if (g_str_has_suffix (name, CACHE_INFO_SUFFIX) == FALSE)
+			continue;
+
+		entry.info_path = g_build_filename (cache->dir, name, NULL);
+		body_path = g_strndup (entry.info_path, strlen (entry.info_path) - strlen (CACHE_INFO_SUFFIX));
+		info = g_key_file_new ();
+		if (g_key_file_load_from_file (info, entry.info_path, G_KEY_FILE_NONE, NULL) == FALSE ||
+		    g_stat (body_path, &buf) != 0) {
+			/* Orphaned entry, always removed */
+			entry.time = -1;
+			entry.size = 0;
+		} else {
+			entry.time = g_key_file_get_int64 (info, CACHE_GROUP,
+							   cache->eviction == XPLAYER_PL_PARSER_CACHE_EVICTION_LRU ? "Accessed" : "Stored",
+							   NULL);
+			entry.size = buf.st_size;
+		}
+		g_key_file_free (info);
+		g_free (body_path);
+
+		total += entry.size;
+		g_array_append_val (entries, entry);
+	}
+	g_dir_close (dir);
+
+	/* Orphaned entries sort first */
+	target = (total > cache->max_size) ? cache->max_size * CACHE_EVICT_RATIO : total;
+	g_array_sort (entries, cache_entry_compare);
+	for (i = 0; i < entries->len; i++) {
+		CacheEntry *entry = &g_array_index (entries, CacheEntry, i);
+
+		if (total <= target && entry->time >= 0)
+			break;
+		cache_remove_entry (cache, entry->info_path);
+		total -= entry->size;
+	}
+	cache->total = total;
+
+	for (i = 0; i < entries->len; i++)
+		g_free (g_array_index (entries, CacheEntry, i).info_path);
+	g_array_free (entries, TRUE);
+}
+
+static void
+cache_store (XplayerPlParserCache *cache,
+	     SoupMessage *msg,
+	     const char *uri,
+	     const char *body_path,
+	     const char *info_path,
+	     GKeyFile *info)
+{
+	const char *etag, *last_modified, *cache_control;
+	GStatBuf buf;
+	guint64 old_size;
+	char *data;
+	gsize len;
+	gint64 now;
+
+	etag = soup_message_headers_get_one (msg->response_headers, "ETag");
+	last_modified = soup_message_headers_get_one (msg->response_headers, "Last-Modified");
+	cache_control = soup_message_headers_get_list (msg->response_headers, "Cache-Control");
+
+	g_mutex_lock (&cache->mutex);
+
+	/* Nothing to revalidate the body with, or not allowed to keep it */
+	if ((etag == NULL && last_modified == NULL) ||
+	    (cache_control != NULL && soup_header_contains (cache_control, "no-store"))) {
+		cache_remove_entry (cache, info_path);
+		g_mutex_unlock (&cache->mutex);
+		return;
+	}
+
+	if (cache->max_size != 0 && msg->response_body->length > cache->max_size) {
+		cache_remove_entry (cache, info_path);
+		g_mutex_unlock (&cache->mutex);
+		return;
+	}
+
+	old_size = (g_stat (body_path, &buf) == 0) ? (guint64) buf.st_size : 0;
+	if (g_mkdir_with_parents (cache->dir, 0700) < 0 ||
+	    g_file_set_contents (body_path, msg->response_body->data, msg->response_body->length, NULL) == FALSE) {
+		g_mutex_unlock (&cache->mutex);
+		return;
+	}
+	if (cache->total >= 0)
+		cache->total += (gint64) msg->response_body->length - (gint64) old_size;
+
+	now = g_get_real_time () / G_USEC_PER_SEC;
+	g_key_file_remove_group (info, CACHE_GROUP, NULL);
+	g_key_file_set_string (info, CACHE_GROUP, "URL", uri);
+	if (etag != NULL)
+		g_key_file_set_string (info, CACHE_GROUP, "ETag", etag);
+	if (last_modified != NULL)
+		g_key_file_set_string (info, CACHE_GROUP, "Last-Modified", last_modified);
+	g_key_file_set_int64 (info, CACHE_GROUP, "Stored", now);
+	g_key_file_set_int64 (info, CACHE_GROUP, "Accessed", now);
+
+	data = g_key_file_to_data (info, &len, NULL);
+	if (g_file_set_contents (info_path, data, len, NULL) == FALSE)
+		cache_remove_entry (cache, info_path);
+	g_free (data);
+
+	if (cache->max_size != 0 &&
+	    (cache->total < 0 || (guint64) cache->total > cache->max_size))
+		cache_evict (cache);
+
+	g_mutex_unlock (&cache->mutex);
+}
+
+static gboolean
+cache_replay (XplayerPlParserCache *cache,
+	      SoupMessage *msg,
+	      const char *body_path,
+	      const char *info_path,
+	      GKeyFile *info,
+	      char **contents,
+	      gsize *size)
+{
+	const char *etag;
+	char *data;
+	gsize len;
+
+	g_mutex_lock (&cache->mutex);
+
+	if (g_file_get_contents (body_path, contents, size, NULL) == FALSE) {
+		cache_remove_entry (cache, info_path);
+		g_mutex_unlock (&cache->mutex);
+		return FALSE;
+	}
+
+	/* A 304 may carry updated validators */
+	etag = soup_message_headers_get_one (msg->response_headers, "ETag");
+	if (etag != NULL)
+		g_key_file_set_string (info, CACHE_GROUP, "ETag", etag);
+	g_key_file_set_int64 (info, CACHE_GROUP, "Accessed", g_get_real_time () / G_USEC_PER_SEC);
+
+	data = g_key_file_to_data (info, &len, NULL);
+	g_file_set_contents (info_path, data, len, NULL);
+	g_free (data);
+
+	g_mutex_unlock (&cache->mutex);
+
+	return TRUE;
+}
+
+/**
+ * xplayer_pl_parser_cache_load:
+ * @cache: a #XplayerPlParserCache
+ * @session: the #SoupSession to make the request with
+ * @file: the remote file to load
+ * @contents: return location for the NUL-terminated contents of @file
+ * @size: return location for the length of @contents
+ * @debug: whether to print debug output
+ *
+ * Fetches @file over HTTP, revalidating any earlier copy in @cache with
+ * If-None-Match and If-Modified-Since, and replaying that copy if the
+ * server answers 304 Not Modified. Fresh copies are stored when the
+ * server gives us a validator to revalidate them with later.
+ *
+ * Return value: %TRUE if @contents were loaded, %FALSE if the request
+ * failed, in which case callers should fall back to GIO
+ **/
+gboolean
+xplayer_pl_parser_cache_load (XplayerPlParserCache *cache,
+			    SoupSession *session,
+			    GFile *file,
+			    char **contents,
+			    gsize *size,
+			    gboolean debug)
+{
+	SoupMessage *msg;
+	GKeyFile *info;
+	char *uri, *key, *body_path, *info_path;
+	gboolean have_entry, retval;
+
+	uri = g_file_get_uri (file);
+	msg = soup_message_new (SOUP_METHOD_GET, uri);
+	if (msg == NULL) {
+		g_free (uri);
+		return FALSE;
+	}
+
+	key = g_compute_checksum_for_string (G_CHECKSUM_SHA1, uri, -1);
+	body_path = g_build_filename (cache->dir, key, NULL);
+	info_path = g_strconcat (body_path, CACHE_INFO_SUFFIX, NULL);
+	g_free (key);
+
+	info = g_key_file_new ();
+	have_entry = FALSE;
+	if (g_key_file_load_from_file (info, info_path, G_KEY_FILE_NONE, NULL) != FALSE) {
+		char *cached_uri, *etag, *last_modified;
+
+		cached_uri = g_key_file_get_string (info, CACHE_GROUP, "URL", NULL);
+		etag = g_key_file_get_string (info, CACHE_GROUP, "ETag", NULL);
+		last_modified = g_key_file_get_string (info, CACHE_GROUP, "Last-Modified", NULL);
+
+		if (g_strcmp0 (cached_uri, uri) == 0) {
+			if (etag != NULL)
+				soup_message_headers_replace (msg->request_headers, "If-None-Match", etag);
+			if (last_modified != NULL)
+				soup_message_headers_replace (msg->request_headers, "If-Modified-Since", last_modified);
+			have_entry = (etag != NULL || last_modified != NULL);
+		}
+
+		g_free (cached_uri);
+		g_free (etag);
+		g_free (last_modified);
+	}
+
+	soup_session_send_message (session, msg);
+
+	retval = FALSE;
+	if (msg->status_code == SOUP_STATUS_NOT_MODIFIED && have_entry != FALSE) {
+		retval = cache_replay (cache, msg, body_path, info_path, info, contents, size);
+		if (debug)
+			g_print ("URI '%s' was %s from the cache\n", uri, retval ? "replayed" : "missing");
+	} else if (SOUP_STATUS_IS_SUCCESSFUL (msg->status_code)) {
+		*size = msg->response_body->length;
+		*contents = g_malloc (*size + 1);
+		memcpy (*contents, msg->response_body->data, *size);
+		(*contents)[*size] = '\0';
+		retval = TRUE;
+
+		cache_store (cache, msg, uri, body_path, info_path, info);
+		if (debug)
+			g_print ("URI '%s' was fetched (%"G_GSIZE_FORMAT" bytes)\n", uri, *size);
+	} else if (debug) {
+		g_print ("URI '%s' couldn't be fetched: %d %s\n", uri, msg->status_code, msg->reason_phrase);
+	}
+
+	g_key_file_free (info);
+	g_free (body_path);
+	g_free (info_path);
+	g_object_unref (msg);
+	g_free (uri);
+
+	return retval;
+}
+
+#endif /* !XPLAYER_PL_PARSER_MINI */
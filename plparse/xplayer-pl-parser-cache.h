@@ -0,0 +1,48 @@
+/*
+   The Gnome Library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Library General Public License as
+   published by the Free Software Foundation; either version 2 of the
+   License, or (at your option) any later version.
+
+   The Gnome Library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Library General Public License for more details.
+
+   You should have received a copy of the GNU Library General Public
+   License along with the Gnome Library; see the file COPYING.LIB.  If not,
+   write to the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+   Boston, MA 02110-1301  USA.
+ */
+
+#ifndef XPLAYER_PL_PARSER_CACHE_H
+#define XPLAYER_PL_PARSER_CACHE_H
+
+G_BEGIN_DECLS
+
+#ifndef XPLAYER_PL_PARSER_MINI
+#include "xplayer-pl-parser.h"
+#include <gio/gio.h>
+#include <libsoup/soup.h>
+
+typedef struct XplayerPlParserCache XplayerPlParserCache;
+
+XplayerPlParserCache *xplayer_pl_parser_cache_new	(const char *dir,
+						 guint64 max_size,
+						 XplayerPlParserCacheEviction eviction);
+XplayerPlParserCache *xplayer_pl_parser_cache_ref	(XplayerPlParserCache *cache);
+void xplayer_pl_parser_cache_unref		(XplayerPlParserCache *cache);
+gboolean xplayer_pl_parser_cache_handles		(XplayerPlParserCache *cache,
+						 GFile *file);
+gboolean xplayer_pl_parser_cache_load		(XplayerPlParserCache *cache,
+						 SoupSession *session,
+						 GFile *file,
+						 char **contents,
+						 gsize *size,
+						 gboolean debug);
+
+#endif /* !XPLAYER_PL_PARSER_MINI */
+
+G_END_DECLS
+
+#endif /* XPLAYER_PL_PARSER_CACHE_H */
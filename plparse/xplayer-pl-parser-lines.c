@@ -253,34 +253,37 @@ XplayerPlParserResult
 xplayer_pl_parser_add_ram (XplayerPlParser *parser, GFile *file, XplayerPlParseData *parse_data, gpointer data)
 {
 	gboolean retval = XPLAYER_PL_PARSER_RESULT_UNHANDLED;
-	char *contents, **lines;
-	gsize size;
-	guint i;
+	XplayerPlParserContents contents;
+	const char *pos, *end;
+	GString *line;
 
-	if (g_file_load_contents (file, NULL, &contents, &size, NULL, NULL) == FALSE)
+	if (xplayer_pl_parser_contents_load (parser, file, parse_data, &contents) == FALSE)
 		return XPLAYER_PL_PARSER_RESULT_ERROR;
 
-	lines = g_strsplit_set (contents, "\r\n", 0);
-	g_free (contents);
+	/* Stop at the first NUL, as the string it used to be loaded as did */
+	end = memchr (contents.data, '\0', contents.size);
+	if (end == NULL)
+		end = contents.data + contents.size;
 
-	for (i = 0; lines[i] != NULL; i++) {
+	line = g_string_new (NULL);
+	for (pos = contents.data; xplayer_pl_parser_contents_next_line (&pos, end, line) != FALSE; ) {
 		/* Empty line */
-		if (xplayer_pl_parser_line_is_empty (lines[i]) != FALSE)
+		if (xplayer_pl_parser_line_is_empty (line->str) != FALSE)
 			continue;
 
 		retval = XPLAYER_PL_PARSER_RESULT_SUCCESS;
 
 		/* Either it's a URI, or it has a proper path ... */
-		if (strstr(lines[i], "://") != NULL
-				|| lines[i][0] == G_DIR_SEPARATOR) {
+		if (strstr(line->str, "://") != NULL
+				|| line->str[0] == G_DIR_SEPARATOR) {
 			GFile *line_file;
 
-			line_file = g_file_new_for_uri (lines[i]);
+			line_file = g_file_new_for_uri (line->str);
 			/* .ram files can contain .smil entries */
 			if (xplayer_pl_parser_parse_internal (parser, line_file, NULL, parse_data) != XPLAYER_PL_PARSER_RESULT_SUCCESS)
-				xplayer_pl_parser_parse_ram_uri (parser, lines[i]);
+				xplayer_pl_parser_parse_ram_uri (parser, line->str);
 			g_object_unref (line_file);
-		} else if (strcmp (lines[i], "--stop--") == 0) {
+		} else if (strcmp (line->str, "--stop--") == 0) {
 			/* For Real Media playlists, handle the stop command */
 			break;
 		} else {
@@ -291,10 +294,10 @@ xplayer_pl_parser_add_ram (XplayerPlParser *parser, GFile *file, XplayerPlParseD
 			/* Try with a base */
 			base = xplayer_pl_parser_base_uri (uri);
 
-			if (xplayer_pl_parser_parse_internal (parser, lines[i], base) != XPLAYER_PL_PARSER_RESULT_SUCCESS)
+			if (xplayer_pl_parser_parse_internal (parser, line->str, base) != XPLAYER_PL_PARSER_RESULT_SUCCESS)
 			{
 				char *fullpath;
-				fullpath = g_strdup_printf ("%s/%s", base, lines[i]);
+				fullpath = g_strdup_printf ("%s/%s", base, line->str);
 				xplayer_pl_parser_parse_ram_uri (parser, fullpath);
 				g_free (fullpath);
 			}
@@ -303,7 +306,8 @@ xplayer_pl_parser_add_ram (XplayerPlParser *parser, GFile *file, XplayerPlParseD
 		}
 	}
 
-	g_strfreev (lines);
+	g_string_free (line, TRUE);
+	xplayer_pl_parser_contents_clear (&contents);
 
 	return retval;
 }
@@ -365,33 +369,46 @@ xplayer_pl_parser_add_m3u (XplayerPlParser *parser,
 			 gpointer data)
 {
 	XplayerPlParserResult retval = XPLAYER_PL_PARSER_RESULT_UNHANDLED;
-	char *contents, **lines;
-	gsize size;
-	guint i, num_lines;
+	XplayerPlParserContents contents;
+	const char *text, *pos, *end;
+	char *fixed, *extinfo;
+	GString *line_buf;
 	gboolean dos_mode = FALSE;
-	const char *extinfo;
 	char *pl_uri;
 
-	if (g_file_load_contents (file, NULL, &contents, &size, NULL, NULL) == FALSE)
+	if (xplayer_pl_parser_contents_load (parser, file, parse_data, &contents) == FALSE)
 		return XPLAYER_PL_PARSER_RESULT_ERROR;
 
+	/* Stop at the first NUL, as the string it used to be loaded as did */
+	text = contents.data;
+	end = memchr (text, '\0', contents.size);
+	if (end == NULL)
+		end = text + contents.size;
+
 	/* .pls files with a .m3u extension, the nasties */
-	if (g_str_has_prefix (contents, "[playlist]") != FALSE
-			|| g_str_has_prefix (contents, "[Playlist]") != FALSE
-			|| g_str_has_prefix (contents, "[PLAYLIST]") != FALSE) {
-		retval = xplayer_pl_parser_add_pls_with_contents (parser, file, base_file, contents, parse_data);
-		g_free (contents);
+	if (end - text >= 10 &&
+	    (strncmp (text, "[playlist]", 10) == 0
+	     || strncmp (text, "[Playlist]", 10) == 0
+	     || strncmp (text, "[PLAYLIST]", 10) == 0)) {
+		char *str;
+
+		str = g_strndup (text, end - text);
+		retval = xplayer_pl_parser_add_pls_with_contents (parser, file, base_file, str, parse_data);
+		g_free (str);
+		xplayer_pl_parser_contents_clear (&contents);
 		return retval;
 	}
 
 	/* Try to use ISO-8859-1 if we don't have valid UTF-8,
 	 * try to parse anyway if it's not ISO-8859-1 */
-	if (g_utf8_validate (contents, -1, NULL) == FALSE) {
-		char *fixed;
-		fixed = g_convert (contents, -1, "UTF-8", "ISO8859-1", NULL, NULL, NULL);
+	fixed = NULL;
+	if (g_utf8_validate (text, end - text, NULL) == FALSE) {
+		gsize len;
+
+		fixed = g_convert (text, end - text, "UTF-8", "ISO8859-1", NULL, &len, NULL);
 		if (fixed != NULL) {
-			g_free (contents);
-			contents = fixed;
+			text = fixed;
+			end = fixed + len;
 		}
 	}
 
@@ -399,16 +416,10 @@ xplayer_pl_parser_add_m3u (XplayerPlParser *parser,
 	extinfo = NULL;
 
 	/* figure out whether we're a unix m3u or dos m3u */
-	if (strstr(contents, "\x0d")) {
+	if (memchr (text, '\x0d', end - text) != NULL) {
 		dos_mode = TRUE;
 	}
 
-	lines = g_strsplit_set (contents, "\r\n", 0);
-	g_free (contents);
-	num_lines = g_strv_length (lines);
-	/* We don't count the terminating NULL */
-	num_lines--;
-
 	/* Send out the playlist start and get crackin' */
 	pl_uri = g_file_get_uri (file);
 	xplayer_pl_parser_add_uri (parser,
@@ -417,15 +428,14 @@ xplayer_pl_parser_add_m3u (XplayerPlParser *parser,
 				 XPLAYER_PL_PARSER_FIELD_CONTENT_TYPE, "audio/x-mpegurl",
 				 NULL);
 
-	for (i = 0; lines[i] != NULL; i++) {
+	/* Lines are copied one at a time, never the whole playlist */
+	line_buf = g_string_new (NULL);
+	for (pos = text; xplayer_pl_parser_contents_next_line (&pos, end, line_buf) != FALSE; ) {
 		const char *line;
 		char *length;
 		gint64 length_num = 0;
 
-		line = lines[i];
-
-		if (line[0] == '\0')
-			continue;
+		line = line_buf->str;
 
 		retval = XPLAYER_PL_PARSER_RESULT_SUCCESS;
 
@@ -436,7 +446,7 @@ xplayer_pl_parser_add_m3u (XplayerPlParser *parser,
 		/* Ignore comments, but mark it if we have extra info */
 		if (line[0] == '#') {
 			if (extinfo == NULL && g_str_has_prefix (line, EXTINF) != FALSE)
-				extinfo = line;
+				extinfo = g_strdup (line);
 			continue;
 		}
 
@@ -457,20 +467,20 @@ xplayer_pl_parser_add_m3u (XplayerPlParser *parser,
 						xplayer_pl_parser_get_extinfo_title (extinfo));
 			}
 			g_object_unref (uri);
-			extinfo = NULL;
+			g_clear_pointer (&extinfo, g_free);
 		} else if (g_ascii_isalpha (line[0]) != FALSE
 			   && g_str_has_prefix (line + 1, ":\\")) {
 			/* Path relative to a drive on Windows, we need to use
 			 * the base that was passed to us */
 			GFile *uri;
 
-			lines[i] = g_strdelimit (lines[i], "\\", '/');
+			g_strdelimit (line_buf->str, "\\", '/');
 			/* + 2, skip drive letter */
 			uri = g_file_get_child (base_file, line + 2);
 			xplayer_pl_parser_add_one_file (parser, uri,
 						     xplayer_pl_parser_get_extinfo_title (extinfo));
 			g_object_unref (uri);
-			extinfo = NULL;
+			g_clear_pointer (&extinfo, g_free);
 		} else if (line[0] == '\\' && line[1] == '\\') {
 			/* ... Or it's in the windows smb form
 			 * (\\machine\share\filename), Note drive names
@@ -478,12 +488,12 @@ xplayer_pl_parser_add_m3u (XplayerPlParser *parser,
 			 * drive letters) */
 		        char *tmpuri;
 
-			lines[i] = g_strdelimit (lines[i], "\\", '/');
+			g_strdelimit (line_buf->str, "\\", '/');
 			tmpuri = g_strjoin (NULL, "smb:", line, NULL);
 
 			xplayer_pl_parser_add_one_uri (parser, line,
 					xplayer_pl_parser_get_extinfo_title (extinfo));
-			extinfo = NULL;
+			g_clear_pointer (&extinfo, g_free);
 
 			g_free (tmpuri);
 		} else {
@@ -494,17 +504,20 @@ xplayer_pl_parser_add_m3u (XplayerPlParser *parser,
 			_base_file = g_file_get_parent (file);
 			sep = (dos_mode ? '\\' : '/');
 			if (sep == '\\')
-				lines[i] = g_strdelimit (lines[i], "\\", '/');
+				g_strdelimit (line_buf->str, "\\", '/');
 			uri = g_file_get_child (_base_file, line);
 			g_object_unref (_base_file);
 			xplayer_pl_parser_add_one_file (parser, uri,
 						     xplayer_pl_parser_get_extinfo_title (extinfo));
 			g_object_unref (uri);
-			extinfo = NULL;
+			g_clear_pointer (&extinfo, g_free);
 		}
 	}
 
-	g_strfreev (lines);
+	g_string_free (line_buf, TRUE);
+	g_free (extinfo);
+	g_free (fixed);
+	xplayer_pl_parser_contents_clear (&contents);
 
 	xplayer_pl_parser_playlist_end (parser, pl_uri);
 	g_free (pl_uri);
@@ -25,10 +25,10 @@
 #ifndef XPLAYER_PL_PARSER_MINI
 #include <string.h>
 #include <glib.h>
-#include <stdio.h>
 
 #include "xplayer-pl-parser.h"
 #include "xplayer-disc.h"
+#include "xplayer-disc-iso.h"
 #endif /* !XPLAYER_PL_PARSER_MINI */
 
 #include "xplayer-pl-parser-mini.h"
@@ -40,79 +40,6 @@
 #define SORT_LAST_CHAR2 '#'
 
 #ifndef XPLAYER_PL_PARSER_MINI
-/* Returns NULL if we don't have an ISO image,
- * or an empty string if it's non-UTF-8 data */
-static char *
-xplayer_pl_parser_iso_get_title (GFile *_file)
-{
-	char *fname;
-	FILE  *file;
-#define BUFFER_SIZE 128
-	char buf [BUFFER_SIZE+1];
-	int res;
-	char *str;
-
-	fname = g_file_get_path (_file);
-	if (fname == NULL)
-		return NULL;
-
-	file = fopen (fname, "rb");
-	g_free (fname);
-	if (file == NULL)
-		return NULL;
-
-	/* Verify we have an ISO image */
-	/* This check is for the raw sector images */
-	res = fseek (file, 37633L, SEEK_SET);
-	if (res != 0) {
-		fclose (file);
-		return NULL;
-	}
-
-	res = fread (buf, sizeof (char), 5, file);
-	if (res != 5 || strncmp (buf, "CD001", 5) != 0) {
-		/* Standard ISO images */
-		res = fseek (file, 32769L, SEEK_SET);
-		if (res != 0) {
-			fclose (file);
-			return NULL;
-		}
-		res = fread (buf, sizeof (char), 5, file);
-		if (res != 5 || strncmp (buf, "CD001", 5) != 0) {
-			/* High Sierra images */
-			res = fseek (file, 32776L, SEEK_SET);
-			if (res != 0) {
-				fclose (file);
-				return NULL;
-			}
-			res = fread (buf, sizeof (char), 5, file);
-			if (res != 5 || strncmp (buf, "CDROM", 5) != 0) {
-				fclose (file);
-				return NULL;
-			}
-		}
-	}
-	/* Extract the volume label from the image */
-	res = fseek (file, 32808L, SEEK_SET);
-	if (res != 0) {
-		fclose (file);
-		return NULL;
-	}
-	res = fread (buf, sizeof(char), BUFFER_SIZE, file);
-	fclose (file);
-	if (res != BUFFER_SIZE)
-		return NULL;
-
-	buf [BUFFER_SIZE] = '\0';
-	str = g_strdup (g_strstrip (buf));
-	if (!g_utf8_validate (str, -1, NULL)) {
-		g_free (str);
-		return g_strdup ("");
-	}
-
-	return str;
-}
-
 XplayerPlParserResult
 xplayer_pl_parser_add_iso (XplayerPlParser *parser,
 			 GFile *file,
@@ -121,20 +48,20 @@ xplayer_pl_parser_add_iso (XplayerPlParser *parser,
 			 gpointer data)
 {
 	XplayerDiscMediaType type;
-	char *uri, *retval;
+	char *uri, *label, *retval;
 
+	/* The type and label come from the same read of the image */
 	uri = g_file_get_uri (file);
-	type = xplayer_cd_detect_type_with_url (uri, &retval, NULL);
+	type = xplayer_cd_detect_type_with_label (uri, &retval, &label, NULL);
 	g_free (uri);
 	if (type == MEDIA_TYPE_DVD || type == MEDIA_TYPE_VCD) {
-		char *label;
-
-		label = xplayer_pl_parser_iso_get_title (file);
 		xplayer_pl_parser_add_one_uri (parser, retval, label);
 		g_free (label);
 		g_free (retval);
 		return XPLAYER_PL_PARSER_RESULT_SUCCESS;
 	}
+	g_free (label);
+	g_free (retval);
 
 	return XPLAYER_PL_PARSER_RESULT_IGNORED;
 }
@@ -160,71 +87,459 @@ xplayer_pl_parser_add_cue (XplayerPlParser *parser,
 	return XPLAYER_PL_PARSER_RESULT_SUCCESS;
 }
 
+typedef struct {
+	char *key;
+	GFileInfo *info;
+} DirEntry;
+
+/* Builds a key such that comparing keys with strcmp() sorts
+ * files like a file manager would, with hidden and backup
+ * files last. Computing it once per file is much cheaper than
+ * computing collation keys in the sort comparison. */
+static char *
+xplayer_pl_parser_dir_sort_key (const char *name)
+{
+	char *key, *retval;
+	gboolean sort_last;
+
+	if (name == NULL)
+		return g_strdup ("");
+
+	sort_last = name[0] == SORT_LAST_CHAR1 || name[0] == SORT_LAST_CHAR2;
+	key = g_utf8_collate_key_for_filename (name, -1);
+	retval = g_strconcat (sort_last ? "1" : "0", key, NULL);
+	g_free (key);
+
+	return retval;
+}
+
 static int
-xplayer_pl_parser_dir_compare (GFileInfo *a, GFileInfo *b)
+xplayer_pl_parser_dir_compare (gconstpointer a, gconstpointer b)
 {
-	const char *name_1, *name_2;
-	char *key_1, *key_2;
-	gboolean sort_last_1, sort_last_2;
-	int compare;
+	const DirEntry *entry_1 = a;
+	const DirEntry *entry_2 = b;
 
-	name_1 = g_file_info_get_name (a);
-	name_2 = g_file_info_get_name (b);
+	return strcmp (entry_1->key, entry_2->key);
+}
 
-	if (name_1 == NULL) {
-		if (name_2 == NULL)
-			compare = 0;
-		else
-			compare = -1;
-	} else {	
-		sort_last_1 = name_1[0] == SORT_LAST_CHAR1 || name_1[0] == SORT_LAST_CHAR2;
-		sort_last_2 = name_2[0] == SORT_LAST_CHAR1 || name_2[0] == SORT_LAST_CHAR2;
-		
-		if (sort_last_1 && !sort_last_2) {
-			compare = +1;
-		} else if (!sort_last_1 && sort_last_2) {
-			compare = -1;
-		} else {
-			key_1 = g_utf8_collate_key_for_filename (name_1, -1);
-			key_2 = g_utf8_collate_key_for_filename (name_2, -1);
-			compare = strcmp (key_1, key_2);
-			g_free (key_1);
-			g_free (key_2);
-		}
-	}
+/* The attributes parse_internal can use to classify a file
+ * without opening it, and how many entries to read at once */
+#define DIR_ATTRIBUTES G_FILE_ATTRIBUTE_STANDARD_NAME ","		\
+	G_FILE_ATTRIBUTE_STANDARD_TYPE ","				\
+	G_FILE_ATTRIBUTE_STANDARD_SIZE ","				\
+	G_FILE_ATTRIBUTE_STANDARD_FAST_CONTENT_TYPE
+#define DIR_BATCH_SIZE 64
 
-	return compare;
+typedef struct {
+	GFileEnumerator *e;
+	GMainContext *context;
+	GList *files;
+	gboolean pending;
+} DirBatch;
+
+static void
+xplayer_pl_parser_dir_batch_ready (GObject *source,
+				 GAsyncResult *result,
+				 DirBatch *batch)
+{
+	batch->files = g_file_enumerator_next_files_finish (G_FILE_ENUMERATOR (source), result, NULL);
+	batch->pending = FALSE;
 }
 
-static gboolean
-xplayer_pl_parser_load_directory (GFile *file, GList **list, gboolean *unhandled)
+/* Starts reading the next batch of entries in the background */
+static void
+xplayer_pl_parser_dir_batch_request (DirBatch *batch)
+{
+	batch->pending = TRUE;
+	g_main_context_push_thread_default (batch->context);
+	g_file_enumerator_next_files_async (batch->e, DIR_BATCH_SIZE,
+					    G_PRIORITY_DEFAULT, NULL,
+					    (GAsyncReadyCallback) xplayer_pl_parser_dir_batch_ready,
+					    batch);
+	g_main_context_pop_thread_default (batch->context);
+}
+
+/* Waits for the batch requested above, the list is empty at the
+ * end of the directory, or on errors */
+static GList *
+xplayer_pl_parser_dir_batch_wait (DirBatch *batch)
+{
+	GList *files;
+
+	while (batch->pending != FALSE)
+		g_main_context_iteration (batch->context, TRUE);
+
+	files = batch->files;
+	batch->files = NULL;
+
+	return files;
+}
+
+static GFileEnumerator *
+xplayer_pl_parser_open_directory (GFile *file, gboolean *unhandled)
 {
 	GFileEnumerator *e;
-	GFileInfo *info;
 	GError *err = NULL;
 
-	*list = NULL;
 	*unhandled = FALSE;
 
 	e = g_file_enumerate_children (file,
-				       G_FILE_ATTRIBUTE_STANDARD_NAME,
+				       DIR_ATTRIBUTES,
 				       G_FILE_QUERY_INFO_NONE,
 				       NULL, &err);
 	if (e == NULL) {
 		if (g_error_matches (err, G_IO_ERROR, G_IO_ERROR_NOT_SUPPORTED) != FALSE)
 			*unhandled = TRUE;
 		g_error_free (err);
-		return FALSE;
 	}
 
-	while ((info = g_file_enumerator_next_file (e, NULL, NULL)) != NULL)
-		*list = g_list_prepend (*list, info);
+	return e;
+}
+
+static void
+xplayer_pl_parser_add_directory_entry (XplayerPlParser *parser,
+				     GFile *file,
+				     GFileInfo *info,
+				     XplayerPlParseData *parse_data)
+{
+	GFile *item;
+	XplayerPlParserResult ret;
+
+	item = g_file_get_child (file, g_file_info_get_name (info));
+
+	ret = xplayer_pl_parser_parse_internal_with_info (parser, item, NULL, info, parse_data);
+	if (ret != XPLAYER_PL_PARSER_RESULT_SUCCESS &&
+	    ret != XPLAYER_PL_PARSER_RESULT_IGNORED &&
+	    ret != XPLAYER_PL_PARSER_RESULT_ERROR) {
+		char *item_uri;
+
+		item_uri = g_file_get_uri (item);
+		xplayer_pl_parser_add_one_uri (parser, item_uri, NULL);
+		g_free (item_uri);
+	}
 
+	g_object_unref (item);
+}
+
+/* Lists all of @file, with the entries sorted */
+static GArray *
+xplayer_pl_parser_list_directory (GFile *file, gboolean *unhandled)
+{
+	GFileEnumerator *e;
+	DirBatch batch;
+	GArray *entries;
+	GList *files;
+
+	e = xplayer_pl_parser_open_directory (file, unhandled);
+	if (e == NULL)
+		return NULL;
+
+	batch.e = e;
+	batch.context = g_main_context_new ();
+	batch.files = NULL;
+	xplayer_pl_parser_dir_batch_request (&batch);
+	files = xplayer_pl_parser_dir_batch_wait (&batch);
+
+	entries = g_array_new (FALSE, FALSE, sizeof (DirEntry));
+	while (files != NULL) {
+		GList *l;
+
+		xplayer_pl_parser_dir_batch_request (&batch);
+		for (l = files; l != NULL; l = l->next) {
+			DirEntry entry;
+
+			entry.info = l->data;
+			entry.key = xplayer_pl_parser_dir_sort_key (g_file_info_get_name (entry.info));
+			g_array_append_val (entries, entry);
+		}
+		g_list_free (files);
+		files = xplayer_pl_parser_dir_batch_wait (&batch);
+	}
 	g_file_enumerator_close (e, NULL, NULL);
 	g_object_unref (e);
+	g_main_context_unref (batch.context);
+
+	g_array_sort (entries, xplayer_pl_parser_dir_compare);
+
+	return entries;
+}
+
+static void
+xplayer_pl_parser_free_entries (GArray *entries)
+{
+	guint i;
+
+	for (i = 0; i < entries->len; i++) {
+		DirEntry *entry = &g_array_index (entries, DirEntry, i);
+
+		g_object_unref (entry->info);
+		g_free (entry->key);
+	}
+	g_array_free (entries, TRUE);
+}
+
+/* The walker lists subdirectories in a thread pool ahead of the
+ * parser, so that waiting for one directory listing, on network
+ * file systems in particular, overlaps with waiting for the others.
+ * The parser still adds the entries itself, in the same order. */
+#define DIR_MAX_OUTSTANDING_PER_WORKER 8
+
+typedef struct {
+	char *uri; /* owned by the listings table */
+	GFile *file;
+	GArray *entries;
+	guint depth;
+	guint seq;
+	guint unhandled : 1;
+	guint done : 1;
+	guint abandoned : 1;
+} DirListing;
+
+typedef struct XplayerPlDirWalker {
+	GThreadPool *pool;
+	GMutex lock;
+	GCond cond;
+	GHashTable *listings; /* key = char *uri, value = DirListing */
+	guint outstanding;
+	guint max_outstanding;
+	guint seq;
+} XplayerPlDirWalker;
+
+static void
+xplayer_pl_parser_dir_listing_free (DirListing *listing)
+{
+	if (listing->entries != NULL)
+		xplayer_pl_parser_free_entries (listing->entries);
+	g_object_unref (listing->file);
+	g_free (listing);
+}
+
+/* Deeper directories first, as the parser will reach them before
+ * the rest of their parent's siblings, then in the order queued */
+static gint
+xplayer_pl_parser_dir_listing_compare (gconstpointer a,
+				       gconstpointer b,
+				       gpointer user_data)
+{
+	const DirListing *listing_1 = a;
+	const DirListing *listing_2 = b;
+
+	if (listing_1->depth != listing_2->depth)
+		return listing_1->depth > listing_2->depth ? -1 : 1;
+	if (listing_1->seq != listing_2->seq)
+		return listing_1->seq < listing_2->seq ? -1 : 1;
+	return 0;
+}
+
+static void
+xplayer_pl_parser_dir_walker_list (DirListing *listing,
+				 XplayerPlDirWalker *walker)
+{
+	GArray *entries;
+	gboolean abandoned, unhandled;
+
+	g_mutex_lock (&walker->lock);
+	abandoned = listing->abandoned;
+	g_mutex_unlock (&walker->lock);
+
+	entries = NULL;
+	unhandled = FALSE;
+	if (abandoned == FALSE)
+		entries = xplayer_pl_parser_list_directory (listing->file, &unhandled);
+
+	g_mutex_lock (&walker->lock);
+	listing->entries = entries;
+	listing->unhandled = unhandled;
+	listing->done = TRUE;
+	if (listing->abandoned != FALSE)
+		g_hash_table_remove (walker->listings, listing->uri);
+	else
+		g_cond_broadcast (&walker->cond);
+	g_mutex_unlock (&walker->lock);
+}
+
+static XplayerPlDirWalker *
+xplayer_pl_parser_dir_walker_new (guint workers)
+{
+	XplayerPlDirWalker *walker;
+
+	walker = g_new0 (XplayerPlDirWalker, 1);
+	g_mutex_init (&walker->lock);
+	g_cond_init (&walker->cond);
+	walker->listings = g_hash_table_new_full (g_str_hash, g_str_equal,
+						  g_free, (GDestroyNotify) xplayer_pl_parser_dir_listing_free);
+	walker->max_outstanding = workers * DIR_MAX_OUTSTANDING_PER_WORKER;
+	walker->pool = g_thread_pool_new ((GFunc) xplayer_pl_parser_dir_walker_list,
+					  walker, workers, FALSE, NULL);
+	g_thread_pool_set_sort_function (walker->pool, xplayer_pl_parser_dir_listing_compare, NULL);
+
+	return walker;
+}
+
+static void
+xplayer_pl_parser_dir_walker_free (XplayerPlDirWalker *walker)
+{
+	GHashTableIter iter;
+	DirListing *listing;
+
+	/* Don't list what's still queued */
+	g_mutex_lock (&walker->lock);
+	g_hash_table_iter_init (&iter, walker->listings);
+	while (g_hash_table_iter_next (&iter, NULL, (gpointer *) &listing))
+		listing->abandoned = TRUE;
+	g_mutex_unlock (&walker->lock);
+
+	g_thread_pool_free (walker->pool, FALSE, TRUE);
+	g_hash_table_destroy (walker->listings);
+	g_mutex_clear (&walker->lock);
+	g_cond_clear (&walker->cond);
+	g_free (walker);
+}
+
+/* Queues the subdirectories in @entries, as long as there's room,
+ * and adds their URIs to @queued */
+static void
+xplayer_pl_parser_dir_walker_queue (XplayerPlDirWalker *walker,
+				  GFile *file,
+				  GArray *entries,
+				  guint depth,
+				  GPtrArray *queued)
+{
+	guint i;
+
+	g_mutex_lock (&walker->lock);
+	for (i = 0; i < entries->len && walker->outstanding < walker->max_outstanding; i++) {
+		DirEntry *entry = &g_array_index (entries, DirEntry, i);
+		DirListing *listing;
+		GFile *child;
+		char *uri;
+
+		if (g_file_info_get_file_type (entry->info) != G_FILE_TYPE_DIRECTORY)
+			continue;
+
+		child = g_file_get_child (file, g_file_info_get_name (entry->info));
+		uri = g_file_get_uri (child);
+		if (g_hash_table_lookup (walker->listings, uri) != NULL) {
+			g_object_unref (child);
+			g_free (uri);
+			continue;
+		}
+
+		listing = g_new0 (DirListing, 1);
+		listing->uri = uri;
+		listing->file = child;
+		listing->depth = depth;
+		listing->seq = walker->seq++;
+		g_hash_table_insert (walker->listings, uri, listing);
+		g_ptr_array_add (queued, g_strdup (uri));
+		walker->outstanding++;
+
+		g_thread_pool_push (walker->pool, listing, NULL);
+	}
+	g_mutex_unlock (&walker->lock);
+}
+
+/* Takes the listing of @uri, waiting for it if it's still being read.
+ * Returns %FALSE if it wasn't queued */
+static gboolean
+xplayer_pl_parser_dir_walker_take (XplayerPlDirWalker *walker,
+				 const char *uri,
+				 GArray **entries,
+				 gboolean *unhandled)
+{
+	DirListing *listing;
+
+	g_mutex_lock (&walker->lock);
+	listing = g_hash_table_lookup (walker->listings, uri);
+	if (listing == NULL || listing->abandoned != FALSE) {
+		g_mutex_unlock (&walker->lock);
+		return FALSE;
+	}
+
+	while (listing->done == FALSE)
+		g_cond_wait (&walker->cond, &walker->lock);
+
+	*entries = listing->entries;
+	*unhandled = listing->unhandled;
+	listing->entries = NULL;
+	g_hash_table_remove (walker->listings, uri);
+	walker->outstanding--;
+	g_mutex_unlock (&walker->lock);
+
 	return TRUE;
 }
 
+/* Forgets the listings in @queued that the parser didn't use, for
+ * example because the directories were ignored */
+static void
+xplayer_pl_parser_dir_walker_drop (XplayerPlDirWalker *walker,
+				 GPtrArray *queued)
+{
+	guint i;
+
+	g_mutex_lock (&walker->lock);
+	for (i = 0; i < queued->len; i++) {
+		DirListing *listing;
+
+		listing = g_hash_table_lookup (walker->listings, g_ptr_array_index (queued, i));
+		if (listing == NULL || listing->abandoned != FALSE)
+			continue;
+
+		walker->outstanding--;
+		if (listing->done != FALSE)
+			g_hash_table_remove (walker->listings, listing->uri);
+		else
+			listing->abandoned = TRUE;
+	}
+	g_mutex_unlock (&walker->lock);
+}
+
+/* Adds the entries of @file as soon as they're read, while the
+ * next batch is read in the background */
+static XplayerPlParserResult
+xplayer_pl_parser_stream_directory (XplayerPlParser *parser,
+				  GFile *file,
+				  XplayerPlParseData *parse_data)
+{
+	GFileEnumerator *e;
+	DirBatch batch;
+	GList *files;
+	gboolean unhandled;
+	gint64 start;
+
+	start = g_get_monotonic_time ();
+	e = xplayer_pl_parser_open_directory (file, &unhandled);
+	if (e == NULL) {
+		if (unhandled != FALSE)
+			return XPLAYER_PL_PARSER_RESULT_UNHANDLED;
+		return XPLAYER_PL_PARSER_RESULT_ERROR;
+	}
+
+	batch.e = e;
+	batch.context = g_main_context_new ();
+	batch.files = NULL;
+	xplayer_pl_parser_dir_batch_request (&batch);
+	files = xplayer_pl_parser_dir_batch_wait (&batch);
+
+	if (files != NULL)
+		DEBUG(file, g_print ("First entry of '%s' after %" G_GINT64_FORMAT " ms\n",
+				     uri, (g_get_monotonic_time () - start) / 1000));
+	while (files != NULL) {
+		GList *l;
+
+		xplayer_pl_parser_dir_batch_request (&batch);
+		for (l = files; l != NULL; l = l->next)
+			xplayer_pl_parser_add_directory_entry (parser, file, l->data, parse_data);
+		g_list_free_full (files, g_object_unref);
+		files = xplayer_pl_parser_dir_batch_wait (&batch);
+	}
+	g_file_enumerator_close (e, NULL, NULL);
+	g_object_unref (e);
+	g_main_context_unref (batch.context);
+
+	return XPLAYER_PL_PARSER_RESULT_SUCCESS;
+}
+
 XplayerPlParserResult
 xplayer_pl_parser_add_directory (XplayerPlParser *parser,
 			       GFile *file,
@@ -233,14 +548,16 @@ xplayer_pl_parser_add_directory (XplayerPlParser *parser,
 			       gpointer data)
 {
 	XplayerDiscMediaType type;
-	GList *list, *l;
+	GArray *entries;
+	GPtrArray *queued;
 	char *media_uri, *uri;
-	gboolean unhandled;
+	gboolean unhandled, owner;
+	gint64 start;
+	guint i;
 
 	uri = g_file_get_uri (file);
 	media_uri = NULL;
 	type = xplayer_cd_detect_type_from_dir (uri, &media_uri, NULL);
-	g_free (uri);
 
 	if (type != MEDIA_TYPE_DATA && type != MEDIA_TYPE_ERROR && media_uri != NULL) {
 		char *base_name = NULL, *fname;
@@ -253,44 +570,65 @@ xplayer_pl_parser_add_directory (XplayerPlParser *parser,
 		xplayer_pl_parser_add_one_uri (parser, media_uri, base_name);
 		g_free (base_name);
 		g_free (media_uri);
+		g_free (uri);
 		return XPLAYER_PL_PARSER_RESULT_SUCCESS;
 	}
 	g_free (media_uri);
 
-	if (xplayer_pl_parser_load_directory (file, &list, &unhandled) == FALSE) {
-		if (unhandled != FALSE)
-			return XPLAYER_PL_PARSER_RESULT_UNHANDLED;
-		return XPLAYER_PL_PARSER_RESULT_ERROR;
+	if (parse_data->sort_directories == FALSE) {
+		g_free (uri);
+		return xplayer_pl_parser_stream_directory (parser, file, parse_data);
 	}
 
-	list = g_list_sort (list, (GCompareFunc) xplayer_pl_parser_dir_compare);
-	l = list;
-
-	while (l != NULL) {
-		GFileInfo *info = l->data;
-		GFile *item;
-		XplayerPlParserResult ret;
+	/* The first directory parsed recursively starts the walker
+	 * for all the directories below it */
+	owner = FALSE;
+	if (parse_data->walker == NULL &&
+	    parse_data->recurse != FALSE &&
+	    parse_data->directory_workers > 1) {
+		parse_data->walker = xplayer_pl_parser_dir_walker_new (parse_data->directory_workers);
+		owner = TRUE;
+	}
 
-		item = g_file_get_child (file, g_file_info_get_name (info));
+	start = g_get_monotonic_time ();
+	if (parse_data->walker == NULL ||
+	    xplayer_pl_parser_dir_walker_take (parse_data->walker, uri, &entries, &unhandled) == FALSE)
+		entries = xplayer_pl_parser_list_directory (file, &unhandled);
+	g_free (uri);
 
-		ret = xplayer_pl_parser_parse_internal (parser, item, NULL, parse_data);
-		if (ret != XPLAYER_PL_PARSER_RESULT_SUCCESS &&
-		    ret != XPLAYER_PL_PARSER_RESULT_IGNORED &&
-		    ret != XPLAYER_PL_PARSER_RESULT_ERROR) {
-			char *item_uri;
+	queued = NULL;
+	if (entries != NULL && parse_data->walker != NULL) {
+		queued = g_ptr_array_new_with_free_func (g_free);
+		xplayer_pl_parser_dir_walker_queue (parse_data->walker, file, entries,
+						  parse_data->recurse_level, queued);
+	}
 
-			item_uri = g_file_get_uri (item);
-			xplayer_pl_parser_add_one_uri (parser, item_uri, NULL);
-			g_free (item_uri);
-		}
+	if (entries != NULL && entries->len > 0)
+		DEBUG(file, g_print ("First entry of '%s' after %" G_GINT64_FORMAT " ms\n",
+				     uri, (g_get_monotonic_time () - start) / 1000));
+	for (i = 0; entries != NULL && i < entries->len; i++) {
+		DirEntry *entry = &g_array_index (entries, DirEntry, i);
 
-		g_object_unref (item);
-		g_object_unref (info);
+		xplayer_pl_parser_add_directory_entry (parser, file, entry->info, parse_data);
+		g_object_unref (entry->info);
+		g_free (entry->key);
+	}
 
-		l = l->next;
+	if (queued != NULL) {
+		xplayer_pl_parser_dir_walker_drop (parse_data->walker, queued);
+		g_ptr_array_free (queued, TRUE);
+	}
+	if (owner != FALSE) {
+		xplayer_pl_parser_dir_walker_free (parse_data->walker);
+		parse_data->walker = NULL;
 	}
 
-	g_list_free (list);
+	if (entries == NULL) {
+		if (unhandled != FALSE)
+			return XPLAYER_PL_PARSER_RESULT_UNHANDLED;
+		return XPLAYER_PL_PARSER_RESULT_ERROR;
+	}
+	g_array_free (entries, TRUE);
 
 	return XPLAYER_PL_PARSER_RESULT_SUCCESS;
 }
@@ -47,7 +47,7 @@ xplayer_pl_parser_add_gvp (XplayerPlParser *parser,
 	char *contents, **lines, *title, *url_link, *version;
 	gsize size;
 
-	if (g_file_load_contents (file, NULL, &contents, &size, NULL, NULL) == FALSE)
+	if (xplayer_pl_parser_load_contents (parser, file, parse_data, &contents, &size) == FALSE)
 		return XPLAYER_PL_PARSER_RESULT_ERROR;
 
 	if (g_str_has_prefix (contents, "#.download.the.free.Google.Video.Player") == FALSE && g_str_has_prefix (contents, "# download the free Google Video Player") == FALSE) {
@@ -99,7 +99,7 @@ xplayer_pl_parser_add_desktop (XplayerPlParser *parser,
 	gsize size;
 	XplayerPlParserResult res = XPLAYER_PL_PARSER_RESULT_ERROR;
 
-	if (g_file_load_contents (file, NULL, &contents, &size, NULL, NULL) == FALSE)
+	if (xplayer_pl_parser_load_contents (parser, file, parse_data, &contents, &size) == FALSE)
 		return res;
 
 	lines = g_strsplit (contents, "\n", 0);
@@ -23,6 +23,7 @@
 
 #ifndef XPLAYER_PL_PARSER_MINI
 #include <string.h>
+#include <stdlib.h>
 #include <glib.h>
 #include <glib/gi18n-lib.h>
 
@@ -32,6 +33,7 @@
 #include "xplayer-pl-parser-mini.h"
 #include "xplayer-pl-parser-pla.h"
 #include "xplayer-pl-parser-private.h"
+#include "xmllexer.h"
 
 /* things we know */
 #define PATH_OFFSET		2
@@ -175,7 +177,7 @@ xplayer_pl_parser_add_pla (XplayerPlParser *parser,
 	guint offset, max_entries, entry;
 	gsize size;
 
-	if (g_file_load_contents (file, NULL, &contents, &size, NULL, NULL) == FALSE)
+	if (xplayer_pl_parser_load_contents (parser, file, parse_data, &contents, &size) == FALSE)
 		return XPLAYER_PL_PARSER_RESULT_ERROR;
 
 	if (size < RECORD_SIZE)
@@ -212,27 +214,20 @@ xplayer_pl_parser_add_pla (XplayerPlParser *parser,
 		GError *error = NULL;
 
 		/* path starts at +2, is at most 500 bytes, in big-endian utf16 .. */
-		path = g_convert (contents + offset + PATH_OFFSET,
-				  RECORD_SIZE - PATH_OFFSET,
-				  "UTF-8", "UTF-16BE",
-				  NULL, NULL, &error);
-		if (path == NULL)
-		{
-			DEBUG1(g_print ("error converting entry %d to UTF-8: %s\n", entry, error->message));
-			g_error_free (error);
-			retval = XPLAYER_PL_PARSER_RESULT_ERROR;
-			break;
-		}
+		path = lexer_utf_to_utf8 (contents + offset + PATH_OFFSET,
+					  RECORD_SIZE - PATH_OFFSET,
+					  LEXER_UTF16BE, NULL);
 
 		/* .. with backslashes.. */
 		g_strdelimit (path, "\\", '/');
 
 		/* and that's all we get. */
-		uri = g_filename_to_uri (path, NULL, NULL);
+		uri = g_filename_to_uri (path, NULL, &error);
 		if (uri == NULL)
 		{
 			DEBUG1(g_print ("error converting path %s to URI: %s\n", path, error->message));
 			g_error_free (error);
+			free (path);
 			retval = XPLAYER_PL_PARSER_RESULT_ERROR;
 			break;
 		}
@@ -240,7 +235,7 @@ xplayer_pl_parser_add_pla (XplayerPlParser *parser,
 		xplayer_pl_parser_add_uri (parser, XPLAYER_PL_PARSER_FIELD_URI, uri, NULL);
 
 		g_free (uri);
-		g_free (path);
+		free (path);
 		offset += RECORD_SIZE;
 		entry++;
 	}
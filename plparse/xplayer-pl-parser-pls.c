@@ -157,6 +157,15 @@ ensure_utf8_valid (char *input)
 	return utf8_valid;
 }
 
+static int
+pls_index_compare (gconstpointer a, gconstpointer b)
+{
+	guint index_a = *(const guint *) a;
+	guint index_b = *(const guint *) b;
+
+	return (index_a > index_b) - (index_a < index_b);
+}
+
 XplayerPlParserResult
 xplayer_pl_parser_add_pls_with_contents (XplayerPlParser *parser,
 				       GFile *file,
@@ -167,18 +176,17 @@ xplayer_pl_parser_add_pls_with_contents (XplayerPlParser *parser,
 	XplayerPlParserResult retval = XPLAYER_PL_PARSER_RESULT_UNHANDLED;
 	GFile *base_file;
 	char **lines;
-	guint i, num_entries;
+	guint i, n;
 	char *playlist_title;
 	gboolean fallback;
 	GHashTable *entries;
-	guint found_entries;
+	GArray *indices;
 	char *uri;
 
 	lines = g_strsplit_set (contents, "\r\n", 0);
 
 	/* [playlist] */
 	i = 0;
-	num_entries = 0;
 
 	/* Ignore empty lines */
 	while (lines[i] != NULL && xplayer_pl_parser_line_is_empty (lines[i]) != FALSE)
@@ -201,11 +209,14 @@ xplayer_pl_parser_add_pls_with_contents (XplayerPlParser *parser,
 				 NULL);
 	g_free (playlist_title);
 
-	/* Load the file in hash table to speed up the later processing */
+	/* Load the file in hash table to speed up the later processing,
+	 * and remember which entry numbers are used, so that sparse or
+	 * repeated numbers don't have us count through all the others */
 	entries = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
+	indices = g_array_new (FALSE, FALSE, sizeof (guint));
 	for (i = 0; lines[i] != NULL; i++) {
 		char **bits;
-		char *value;
+		char *key, *value;
 
 		if (xplayer_pl_parser_line_is_empty (lines[i]))
 			continue;
@@ -219,17 +230,28 @@ xplayer_pl_parser_add_pls_with_contents (XplayerPlParser *parser,
 			continue;
 		}
 
-		if (g_ascii_strncasecmp (g_strchug (bits[0]), "file", strlen ("file")) == 0)
-			num_entries++;
+		key = g_ascii_strdown (g_strchug (bits[0]), -1);
+		if (g_str_has_prefix (key, "file") != FALSE) {
+			const char *number;
+			char *end;
+			guint64 index;
+			guint entry;
+
+			number = key + strlen ("file");
+			index = g_ascii_strtoull (number, &end, 10);
+			if (end != number && *end == '\0' && index > 0 && index <= G_MAXINT) {
+				entry = index;
+				g_array_append_val (indices, entry);
+			}
+		}
 
 		value = g_strdup (bits[1]);
 
-		g_hash_table_insert (entries,
-				     g_ascii_strdown (bits[0], strlen (bits[0])),
-				     value);
+		g_hash_table_insert (entries, key, value);
 		g_strfreev (bits);
 	}
 	g_strfreev (lines);
+	g_array_sort (indices, pls_index_compare);
 
 	/* Base? */
 	if (_base_file == NULL)
@@ -239,12 +261,15 @@ xplayer_pl_parser_add_pls_with_contents (XplayerPlParser *parser,
 
 	retval = XPLAYER_PL_PARSER_RESULT_SUCCESS;
 
-	found_entries = 0;
-	for (i = 1; found_entries < num_entries; i++) {
+	for (n = 0; n < indices->len; n++) {
 		char *file_str, *title, *genre, *length;
 		char *file_key, *title_key, *genre_key, *length_key;
 		gint64 length_num;
 
+		i = g_array_index (indices, guint, n);
+		if (n > 0 && i == g_array_index (indices, guint, n - 1))
+			continue;
+
 		file_key = g_strdup_printf ("file%d", i);
 		title_key = g_strdup_printf ("title%d", i);
 		length_key = g_strdup_printf ("length%d", i);
@@ -264,7 +289,6 @@ xplayer_pl_parser_add_pls_with_contents (XplayerPlParser *parser,
 
 		if (file_str == NULL)
 			continue;
-		found_entries++;
 
 		fallback = parse_data->fallback;
 		if (parse_data->recurse)
@@ -317,6 +341,7 @@ xplayer_pl_parser_add_pls_with_contents (XplayerPlParser *parser,
 
 	g_object_unref (base_file);
         g_hash_table_destroy (entries);
+	g_array_free (indices, TRUE);
 
 	return retval;
 }
@@ -332,7 +357,7 @@ xplayer_pl_parser_add_pls (XplayerPlParser *parser,
 	char *contents;
 	gsize size;
 
-	if (g_file_load_contents (file, NULL, &contents, &size, NULL, NULL) == FALSE)
+	if (xplayer_pl_parser_load_contents (parser, file, parse_data, &contents, &size) == FALSE)
 		return XPLAYER_PL_PARSER_RESULT_ERROR;
 
 	if (size == 0) {
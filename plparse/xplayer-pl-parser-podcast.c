@@ -99,6 +99,68 @@ xplayer_pl_parser_is_xml_feed (const char *data, gsize len)
 
 #ifndef XPLAYER_PL_PARSER_MINI
 
+/* The element and property names we look for in RSS, Atom
+ * and OPML documents, sorted case-insensitively */
+#define PODCAST_VOCABULARY(X) \
+	X (PODCAST_AUTHOR, "author") \
+	X (PODCAST_BODY, "body") \
+	X (PODCAST_CHANNEL, "channel") \
+	X (PODCAST_CONTENT, "content") \
+	X (PODCAST_COPYRIGHT, "copyright") \
+	X (PODCAST_DESCRIPTION, "description") \
+	X (PODCAST_DURATION, "duration") \
+	X (PODCAST_ENCLOSURE, "enclosure") \
+	X (PODCAST_ENTRY, "entry") \
+	X (PODCAST_FEED, "feed") \
+	X (PODCAST_FILE_SIZE, "fileSize") \
+	X (PODCAST_GENERATOR, "generator") \
+	X (PODCAST_GUID, "guid") \
+	X (PODCAST_HREF, "href") \
+	X (PODCAST_ICON, "icon") \
+	X (PODCAST_IMAGE, "image") \
+	X (PODCAST_ITEM, "item") \
+	X (PODCAST_ITUNES_AUTHOR, "itunes:author") \
+	X (PODCAST_ITUNES_DURATION, "itunes:duration") \
+	X (PODCAST_ITUNES_IMAGE, "itunes:image") \
+	X (PODCAST_ITUNES_SUBTITLE, "itunes:subtitle") \
+	X (PODCAST_ITUNES_SUMMARY, "itunes:summary") \
+	X (PODCAST_LANGUAGE, "language") \
+	X (PODCAST_LAST_BUILD_DATE, "lastBuildDate") \
+	X (PODCAST_LENGTH, "length") \
+	X (PODCAST_LICENSE, "license") \
+	X (PODCAST_LINK, "link") \
+	X (PODCAST_LOGO, "logo") \
+	X (PODCAST_MEDIA_CONTENT, "media:content") \
+	X (PODCAST_MODIFIED, "modified") \
+	X (PODCAST_OPML, "opml") \
+	X (PODCAST_OUTLINE, "outline") \
+	X (PODCAST_PUB_DATE, "pubDate") \
+	X (PODCAST_REL, "rel") \
+	X (PODCAST_RSS, "rss") \
+	X (PODCAST_SUMMARY, "summary") \
+	X (PODCAST_TAGLINE, "tagline") \
+	X (PODCAST_TEXT, "text") \
+	X (PODCAST_TITLE, "title") \
+	X (PODCAST_TYPE, "type") \
+	X (PODCAST_UPDATED, "updated") \
+	X (PODCAST_URL, "url") \
+	X (PODCAST_WEB_MASTER, "webMaster") \
+	X (PODCAST_XML_URL, "xmlUrl")
+
+enum {
+	PODCAST_UNKNOWN = XML_ID_UNKNOWN,
+	PODCAST_VOCABULARY (XML_VOCABULARY_ID)
+};
+
+static const char * const podcast_names[] = {
+	PODCAST_VOCABULARY (XML_VOCABULARY_NAME)
+};
+
+static const xml_vocabulary_t podcast_vocabulary = {
+	podcast_names,
+	G_N_ELEMENTS (podcast_names)
+};
+
 static gboolean
 is_image (const char *url)
 {
@@ -125,66 +187,74 @@ parse_rss_item (XplayerPlParser *parser, xml_node_t *parent)
 	img = pub_date = duration = filesize = id = NULL;
 
 	for (node = parent->child; node != NULL; node = node->next) {
-		if (node->name == NULL)
-			continue;
+		const char *tmp;
 
-		if (g_ascii_strcasecmp (node->name, "title") == 0) {
+		switch (node->id) {
+		case PODCAST_TITLE:
 			title = node->data;
-		} else if (g_ascii_strcasecmp (node->name, "url") == 0) {
+			break;
+		case PODCAST_URL:
 			uri = node->data;
-		} else if (g_ascii_strcasecmp (node->name, "pubDate") == 0) {
+			break;
+		case PODCAST_PUB_DATE:
 			pub_date = node->data;
-		} else if (g_ascii_strcasecmp (node->name, "guid") == 0) {
+			break;
+		case PODCAST_GUID:
 			id = node->data;
-		} else if (g_ascii_strcasecmp (node->name, "description") == 0
-			   || g_ascii_strcasecmp (node->name, "itunes:summary") == 0) {
+			break;
+		case PODCAST_DESCRIPTION:
+		case PODCAST_ITUNES_SUMMARY:
 			description = node->data;
-		} else if (g_ascii_strcasecmp (node->name, "author") == 0
-			   || g_ascii_strcasecmp (node->name, "itunes:author") == 0) {
+			break;
+		case PODCAST_AUTHOR:
+		case PODCAST_ITUNES_AUTHOR:
 			author = node->data;
-		} else if (g_ascii_strcasecmp (node->name, "itunes:duration") == 0) {
+			break;
+		case PODCAST_ITUNES_DURATION:
 			duration = node->data;
-		} else if (g_ascii_strcasecmp (node->name, "length") == 0) {
+			break;
+		case PODCAST_LENGTH:
 			filesize = node->data;
-		} else if (g_ascii_strcasecmp (node->name, "media:content") == 0) {
-			const char *tmp;
-
-			tmp = xml_parser_get_property (node, "type");
+			break;
+		case PODCAST_MEDIA_CONTENT:
+			tmp = xml_parser_get_property_by_id (node, PODCAST_TYPE);
 			if (tmp != NULL &&
 			    g_str_has_prefix (tmp, "audio/") == FALSE) {
 				if (g_str_has_prefix (tmp, "image/"))
-					img = xml_parser_get_property (node, "url");
-				continue;
+					img = xml_parser_get_property_by_id (node, PODCAST_URL);
+				break;
 			}
 			content_type = tmp;
 
-			tmp = xml_parser_get_property (node, "url");
-			if (tmp != NULL)
-				uri = tmp;
-			else
-				continue;
+			tmp = xml_parser_get_property_by_id (node, PODCAST_URL);
+			if (tmp == NULL)
+				break;
+			uri = tmp;
 
-			tmp = xml_parser_get_property (node, "fileSize");
+			tmp = xml_parser_get_property_by_id (node, PODCAST_FILE_SIZE);
 			if (tmp != NULL)
 				filesize = tmp;
 
-			tmp = xml_parser_get_property (node, "duration");
+			tmp = xml_parser_get_property_by_id (node, PODCAST_DURATION);
 			if (tmp != NULL)
 				duration = tmp;
-		} else if (g_ascii_strcasecmp (node->name, "enclosure") == 0) {
-			const char *tmp;
-
-			tmp = xml_parser_get_property (node, "url");
-			if (tmp != NULL && is_image (tmp) == FALSE)
-				uri = tmp;
-			else
-				continue;
-			tmp = xml_parser_get_property (node, "length");
+			break;
+		case PODCAST_ENCLOSURE:
+			tmp = xml_parser_get_property_by_id (node, PODCAST_URL);
+			if (tmp == NULL || is_image (tmp) != FALSE)
+				break;
+			uri = tmp;
+
+			tmp = xml_parser_get_property_by_id (node, PODCAST_LENGTH);
 			if (tmp != NULL)
 				filesize = tmp;
-		} else if (g_ascii_strcasecmp (node->name, "link") == 0 &&
-			   xplayer_pl_parser_is_videosite (node->data, FALSE) != FALSE) {
-			uri = node->data;
+			break;
+		case PODCAST_LINK:
+			if (xplayer_pl_parser_is_videosite (node->data, FALSE) != FALSE)
+				uri = node->data;
+			break;
+		default:
+			break;
 		}
 	}
 
@@ -206,13 +276,14 @@ parse_rss_item (XplayerPlParser *parser, xml_node_t *parent)
 					 XPLAYER_PL_PARSER_FIELD_CONTENT_TYPE, content_type,
 					 XPLAYER_PL_PARSER_FIELD_IMAGE_URI, img,
 					 NULL);
+		return XPLAYER_PL_PARSER_RESULT_SUCCESS;
 	}
 
-	return XPLAYER_PL_PARSER_RESULT_SUCCESS;
+	return XPLAYER_PL_PARSER_RESULT_UNHANDLED;
 }
 
-static XplayerPlParserResult
-parse_rss_items (XplayerPlParser *parser, const char *uri, xml_node_t *parent)
+static void
+parse_rss_channel_info (XplayerPlParser *parser, const char *uri, xml_node_t *parent)
 {
 	const char *title, *language, *description, *author;
 	const char *contact, *img, *pub_date, *copyright;
@@ -221,37 +292,48 @@ parse_rss_items (XplayerPlParser *parser, const char *uri, xml_node_t *parent)
 	title = language = description = author = NULL;
 	contact = img = pub_date = copyright = NULL;
 
-	/* We need to parse for the feed metadata first, then for the items */
 	for (node = parent->child; node != NULL; node = node->next) {
-		if (node->name == NULL)
-			continue;
+		const char *href;
 
-		if (g_ascii_strcasecmp (node->name, "title") == 0) {
+		switch (node->id) {
+		case PODCAST_TITLE:
 			title = node->data;
-		} else if (g_ascii_strcasecmp (node->name, "language") == 0) {
+			break;
+		case PODCAST_LANGUAGE:
 			language = node->data;
-		} else if (g_ascii_strcasecmp (node->name, "description") == 0
-			 || g_ascii_strcasecmp (node->name, "itunes:subtitle") == 0) {
-		    	description = node->data;
-		} else if (g_ascii_strcasecmp (node->name, "author") == 0
-			 || g_ascii_strcasecmp (node->name, "itunes:author") == 0
-			 || (g_ascii_strcasecmp (node->name, "generator") == 0 && author == NULL)) {
-		    	author = node->data;
-		} else if (g_ascii_strcasecmp (node->name, "webMaster") == 0) {
+			break;
+		case PODCAST_DESCRIPTION:
+		case PODCAST_ITUNES_SUBTITLE:
+			description = node->data;
+			break;
+		case PODCAST_GENERATOR:
+			if (author != NULL)
+				break;
+			/* fall through */
+		case PODCAST_AUTHOR:
+		case PODCAST_ITUNES_AUTHOR:
+			author = node->data;
+			break;
+		case PODCAST_WEB_MASTER:
 			contact = node->data;
-		} else if (g_ascii_strcasecmp (node->name, "image") == 0) {
+			break;
+		case PODCAST_IMAGE:
 			img = node->data;
-		} else if (g_ascii_strcasecmp (node->name, "itunes:image") == 0) {
-			const char *href;
-
-			href = xml_parser_get_property (node, "href");
+			break;
+		case PODCAST_ITUNES_IMAGE:
+			href = xml_parser_get_property_by_id (node, PODCAST_HREF);
 			if (href != NULL)
 				img = href;
-		} else if (g_ascii_strcasecmp (node->name, "lastBuildDate") == 0
-			 || g_ascii_strcasecmp (node->name, "pubDate") == 0) {
-		    	pub_date = node->data;
-		} else if (g_ascii_strcasecmp (node->name, "copyright") == 0) {
+			break;
+		case PODCAST_LAST_BUILD_DATE:
+		case PODCAST_PUB_DATE:
+			pub_date = node->data;
+			break;
+		case PODCAST_COPYRIGHT:
 			copyright = node->data;
+			break;
+		default:
+			break;
 		}
 	}
 
@@ -268,18 +350,207 @@ parse_rss_items (XplayerPlParser *parser, const char *uri, xml_node_t *parent)
 				 XPLAYER_PL_PARSER_FIELD_IMAGE_URI, img,
 				 XPLAYER_PL_PARSER_FIELD_CONTACT, contact,
 				 NULL);
+}
 
-	for (node = parent->child; node != NULL; node = node->next) {
-		if (node->name == NULL)
-			continue;
+/* Feeds list their newest items first, so once this many items in a row
+ * are older than the min-date, the rest of the feed can be skipped */
+#define FEED_MAX_OLD_ITEMS 3
+
+typedef struct {
+	XplayerPlParser *parser;
+	char *uri;
+	/* the element holding the feed's metadata and items */
+	xml_node_t *feed;
+	guint depth;
+
+	/* the window of items to add, from XplayerPlParseData */
+	guint max_items;
+	guint64 min_date;
+	guint num_items;
+	guint num_old_items;
+	guint64 last_date;
+
+	guint error : 1;
+	guint has_root : 1;
+	guint started : 1;
+	guint done : 1;
+	guint unordered : 1;
+} FeedParseData;
+
+static const char *
+feed_item_date (xml_node_t *item)
+{
+	const char *date;
+	xml_node_t *node;
 
-		if (g_ascii_strcasecmp (node->name, "item") == 0)
-			parse_rss_item (parser, node);
+	date = NULL;
+	for (node = item->child; node != NULL; node = node->next) {
+		if (node->id == PODCAST_PUB_DATE || node->id == PODCAST_UPDATED)
+			return node->data;
+		if (node->id == PODCAST_MODIFIED)
+			date = node->data;
 	}
 
-	xplayer_pl_parser_playlist_end (parser, uri);
+	return date;
+}
 
-	return XPLAYER_PL_PARSER_RESULT_SUCCESS;
+/* Whether an item is recent enough to be added; this also keeps track of
+ * whether the feed really is sorted newest first */
+static gboolean
+feed_item_in_window (FeedParseData *data, xml_node_t *item)
+{
+	const char *date_str;
+	guint64 date;
+
+	if (data->min_date == 0)
+		return TRUE;
+
+	date_str = feed_item_date (item);
+	if (date_str == NULL)
+		return TRUE;
+	date = xplayer_pl_parser_parse_date (date_str, FALSE);
+	if (date == 0 || date == (guint64) -1)
+		return TRUE;
+
+	if (data->last_date != 0 && date > data->last_date)
+		data->unordered = TRUE;
+	data->last_date = date;
+
+	if (date >= data->min_date) {
+		data->num_old_items = 0;
+		return TRUE;
+	}
+	data->num_old_items++;
+
+	return FALSE;
+}
+
+/* Whether the rest of the feed can't have any more items to add. The
+ * max-items count goes by document order, even in feeds found not to be
+ * listed newest first, as sorting would mean keeping every item around */
+static gboolean
+feed_window_is_full (FeedParseData *data)
+{
+	if (data->max_items != 0 && data->num_items >= data->max_items)
+		return TRUE;
+	return data->unordered == FALSE && data->num_old_items >= FEED_MAX_OLD_ITEMS;
+}
+
+static int
+feed_item_parsed (FeedParseData *data,
+		  xml_node_t *item,
+		  XplayerPlParserResult (*parse_item) (XplayerPlParser *, xml_node_t *))
+{
+	if (feed_item_in_window (data, item) != FALSE &&
+	    parse_item (data->parser, item) == XPLAYER_PL_PARSER_RESULT_SUCCESS)
+		data->num_items++;
+
+	if (feed_window_is_full (data) == FALSE)
+		return XML_PARSER_DISCARD;
+
+	xplayer_pl_parser_playlist_end (data->parser, data->uri);
+	data->done = TRUE;
+	return XML_PARSER_STOP;
+}
+
+static int
+rss_start_element (void *user_data, xml_node_t *node)
+{
+	FeedParseData *data = user_data;
+
+	data->depth++;
+	if (node->name[0] == '?')
+		return XML_PARSER_CONTINUE;
+
+	if (data->depth == 1) {
+		if (node->id != PODCAST_RSS) {
+			data->error = TRUE;
+			return XML_PARSER_STOP;
+		}
+		data->has_root = TRUE;
+	} else if (data->depth == 2 && data->feed == NULL
+		   && node->id == PODCAST_CHANNEL) {
+		data->feed = node;
+	}
+
+	return XML_PARSER_CONTINUE;
+}
+
+static int
+rss_end_element (void *user_data, xml_node_t *node)
+{
+	FeedParseData *data = user_data;
+	guint depth;
+
+	depth = data->depth--;
+	if (data->feed == NULL)
+		return XML_PARSER_CONTINUE;
+
+	/* Items are sent as soon as they're parsed, after the feed
+	 * metadata that precedes them */
+	if (depth == 3 && node->id == PODCAST_ITEM) {
+		if (data->started == FALSE) {
+			parse_rss_channel_info (data->parser, data->uri, data->feed);
+			data->started = TRUE;
+		}
+		return feed_item_parsed (data, node, parse_rss_item);
+	}
+
+	if (node == data->feed) {
+		if (data->started == FALSE) {
+			parse_rss_channel_info (data->parser, data->uri, data->feed);
+			data->started = TRUE;
+		}
+		xplayer_pl_parser_playlist_end (data->parser, data->uri);
+		data->done = TRUE;
+
+		/* One channel per file */
+		return XML_PARSER_STOP;
+	}
+
+	return XML_PARSER_CONTINUE;
+}
+
+static const xml_parser_callbacks_t rss_callbacks = {
+	rss_start_element,
+	NULL,
+	rss_end_element
+};
+
+static XplayerPlParserResult
+parse_feed_stream (XplayerPlParser *parser,
+		   GFile *file,
+		   XplayerPlParseData *parse_data,
+		   char *contents,
+		   gsize size,
+		   const xml_parser_callbacks_t *callbacks)
+{
+	FeedParseData data;
+	XplayerPlParserResult ret;
+
+	memset (&data, 0, sizeof (data));
+	data.parser = parser;
+	data.uri = g_file_get_uri (file);
+	data.max_items = parse_data->max_items;
+	data.min_date = parse_data->min_date;
+
+	ret = XPLAYER_PL_PARSER_RESULT_SUCCESS;
+	if (xplayer_pl_parser_parse_xml_relaxed_stream (contents, size, &podcast_vocabulary,
+						      callbacks, &data) == FALSE
+	    || data.error != FALSE) {
+		/* Finish off what we've already sent, if anything */
+		if (data.started == FALSE)
+			ret = XPLAYER_PL_PARSER_RESULT_ERROR;
+		else if (data.done == FALSE)
+			xplayer_pl_parser_playlist_end (parser, data.uri);
+	} else if (data.has_root == FALSE) {
+		/* An empty document, or one with only a prolog */
+		ret = XPLAYER_PL_PARSER_RESULT_ERROR;
+	}
+
+	g_free (data.uri);
+
+	return ret;
 }
 
 XplayerPlParserResult
@@ -292,45 +563,18 @@ xplayer_pl_parser_add_rss (XplayerPlParser *parser,
 #ifndef HAVE_GMIME
 	WARN_NO_GMIME;
 #else
-	xml_node_t* doc, *channel;
+	XplayerPlParserResult ret;
 	char *contents;
 	gsize size;
 
-	if (g_file_load_contents (file, NULL, &contents, &size, NULL, NULL) == FALSE)
-		return XPLAYER_PL_PARSER_RESULT_ERROR;
-
-	doc = xplayer_pl_parser_parse_xml_relaxed (contents, size);
-	if (doc == NULL) {
-		g_free (contents);
-		return XPLAYER_PL_PARSER_RESULT_ERROR;
-	}
-
-	/* If the document has no name */
-	if (doc->name == NULL
-	    || (g_ascii_strcasecmp (doc->name , "rss") != 0
-		&& g_ascii_strcasecmp (doc->name , "rss\n") != 0)) {
-		g_free (contents);
-		xml_parser_free_tree (doc);
+	if (xplayer_pl_parser_load_contents (parser, file, parse_data, &contents, &size) == FALSE)
 		return XPLAYER_PL_PARSER_RESULT_ERROR;
-	}
 
-	for (channel = doc->child; channel != NULL; channel = channel->next) {
-		if (g_ascii_strcasecmp (channel->name, "channel") == 0) {
-			char *uri;
-
-			uri = g_file_get_uri (file);
-			parse_rss_items (parser, uri, channel);
-			g_free (uri);
-
-			/* One channel per file */
-			break;
-		}
-	}
+	ret = parse_feed_stream (parser, file, parse_data, contents, size, &rss_callbacks);
 
 	g_free (contents);
-	xml_parser_free_tree (doc);
 
-	return XPLAYER_PL_PARSER_RESULT_SUCCESS;
+	return ret;
 #endif /* !HAVE_GMIME */
 }
 
@@ -420,48 +664,54 @@ parse_atom_entry (XplayerPlParser *parser, xml_node_t *parent)
 	copyright = pub_date = description = NULL;
 
 	for (node = parent->child; node != NULL; node = node->next) {
-		if (node->name == NULL)
-			continue;
+		const char *rel, *href, *type;
 
-		if (g_ascii_strcasecmp (node->name, "title") == 0) {
+		switch (node->id) {
+		case PODCAST_TITLE:
 			title = node->data;
-		} else if (g_ascii_strcasecmp (node->name, "author") == 0) {
+			break;
+		case PODCAST_AUTHOR:
 			//FIXME
-		} else if (g_ascii_strcasecmp (node->name, "link") == 0) {
-			const char *rel;
-
+			break;
+		case PODCAST_LINK:
 			//FIXME how do we choose the default enclosure type?
-			rel = xml_parser_get_property (node, "rel");
+			rel = xml_parser_get_property_by_id (node, PODCAST_REL);
 			if (g_ascii_strcasecmp (rel, "enclosure") == 0) {
-				const char *href;
-
 				//FIXME what's the difference between url and href there?
-				href = xml_parser_get_property (node, "href");
+				href = xml_parser_get_property_by_id (node, PODCAST_HREF);
 				if (href == NULL)
-					continue;
+					break;
 				uri = href;
-				filesize = xml_parser_get_property (node, "length");
-			} else if (g_ascii_strcasecmp (node->name, "license") == 0) {
-				const char *href;
-
-				href = xml_parser_get_property (node, "href");
-				if (href == NULL)
-					continue;
-				/* This isn't really a copyright, but what the hey */
-				copyright = href;
+				filesize = xml_parser_get_property_by_id (node, PODCAST_LENGTH);
 			}
-		} else if (g_ascii_strcasecmp (node->name, "updated") == 0
-			   || (g_ascii_strcasecmp (node->name, "modified") == 0 && pub_date == NULL)) {
+			break;
+		case PODCAST_LICENSE:
+			href = xml_parser_get_property_by_id (node, PODCAST_HREF);
+			if (href == NULL)
+				break;
+			/* This isn't really a copyright, but what the hey */
+			copyright = href;
+			break;
+		case PODCAST_MODIFIED:
+			if (pub_date != NULL)
+				break;
+			/* fall through */
+		case PODCAST_UPDATED:
 			pub_date = node->data;
-		} else if (g_ascii_strcasecmp (node->name, "summary") == 0
-			   || (g_ascii_strcasecmp (node->name, "content") == 0 && description == NULL)) {
-			const char *type;
-
-			type = xml_parser_get_property (node, "content");
+			break;
+		case PODCAST_CONTENT:
+			if (description != NULL)
+				break;
+			/* fall through */
+		case PODCAST_SUMMARY:
+			type = xml_parser_get_property_by_id (node, PODCAST_CONTENT);
 			if (type != NULL && g_ascii_strcasecmp (type, "text/plain") == 0)
 				description = node->data;
-		}
+			break;
 		//FIXME handle category
+		default:
+			break;
+		}
 	}
 
 	if (uri != NULL) {
@@ -474,65 +724,119 @@ parse_atom_entry (XplayerPlParser *parser, xml_node_t *parent)
 					 XPLAYER_PL_PARSER_FIELD_PUB_DATE, pub_date,
 					 XPLAYER_PL_PARSER_FIELD_DESCRIPTION, description,
 					 NULL);
+		return XPLAYER_PL_PARSER_RESULT_SUCCESS;
 	}
 
-	return XPLAYER_PL_PARSER_RESULT_SUCCESS;
+	return XPLAYER_PL_PARSER_RESULT_UNHANDLED;
 }
 
-static XplayerPlParserResult
-parse_atom_entries (XplayerPlParser *parser, const char *uri, xml_node_t *parent)
+static void
+parse_atom_feed_info (XplayerPlParser *parser, const char *uri, xml_node_t *parent)
 {
 	const char *title, *pub_date, *description;
 	const char *author, *img;
 	xml_node_t *node;
-	gboolean started = FALSE;
 
 	title = pub_date = description = NULL;
 	author = img = NULL;
 
 	for (node = parent->child; node != NULL; node = node->next) {
-		if (node->name == NULL)
-			continue;
-
-		if (g_ascii_strcasecmp (node->name, "title") == 0) {
+		switch (node->id) {
+		case PODCAST_TITLE:
 			title = node->data;
-		} else if (g_ascii_strcasecmp (node->name, "tagline") == 0) {
-		    	description = node->data;
-		} else if (g_ascii_strcasecmp (node->name, "modified") == 0
-			   || g_ascii_strcasecmp (node->name, "updated") == 0) {
+			break;
+		case PODCAST_TAGLINE:
+			description = node->data;
+			break;
+		case PODCAST_MODIFIED:
+		case PODCAST_UPDATED:
 			pub_date = node->data;
-		} else if (g_ascii_strcasecmp (node->name, "author") == 0
-			 || (g_ascii_strcasecmp (node->name, "generator") == 0 && author == NULL)) {
-		    	author = node->data;
-		} else if ((g_ascii_strcasecmp (node->name, "icon") == 0 && img == NULL)
-			   || g_ascii_strcasecmp (node->name, "logo") == 0) {
+			break;
+		case PODCAST_GENERATOR:
+			if (author != NULL)
+				break;
+			/* fall through */
+		case PODCAST_AUTHOR:
+			author = node->data;
+			break;
+		case PODCAST_ICON:
+			if (img != NULL)
+				break;
+			/* fall through */
+		case PODCAST_LOGO:
 			img = node->data;
+			break;
+		default:
+			break;
 		}
+	}
 
-		if (g_ascii_strcasecmp (node->name, "entry") == 0) {
-			if (started == FALSE) {
-				/* Send the info we already have about the feed */
-				xplayer_pl_parser_add_uri (parser,
-							 XPLAYER_PL_PARSER_FIELD_IS_PLAYLIST, TRUE,
-							 XPLAYER_PL_PARSER_FIELD_URI, uri,
-							 XPLAYER_PL_PARSER_FIELD_TITLE, title,
-							 XPLAYER_PL_PARSER_FIELD_DESCRIPTION, description,
-							 XPLAYER_PL_PARSER_FIELD_AUTHOR, author,
-							 XPLAYER_PL_PARSER_FIELD_PUB_DATE, pub_date,
-							 XPLAYER_PL_PARSER_FIELD_IMAGE_URI, img,
-							 NULL);
-				started = TRUE;
-			}
+	/* Send the info we already have about the feed */
+	xplayer_pl_parser_add_uri (parser,
+				 XPLAYER_PL_PARSER_FIELD_IS_PLAYLIST, TRUE,
+				 XPLAYER_PL_PARSER_FIELD_URI, uri,
+				 XPLAYER_PL_PARSER_FIELD_TITLE, title,
+				 XPLAYER_PL_PARSER_FIELD_DESCRIPTION, description,
+				 XPLAYER_PL_PARSER_FIELD_AUTHOR, author,
+				 XPLAYER_PL_PARSER_FIELD_PUB_DATE, pub_date,
+				 XPLAYER_PL_PARSER_FIELD_IMAGE_URI, img,
+				 NULL);
+}
+
+static int
+atom_start_element (void *user_data, xml_node_t *node)
+{
+	FeedParseData *data = user_data;
+
+	data->depth++;
+	if (node->name[0] == '?' || data->depth != 1)
+		return XML_PARSER_CONTINUE;
 
-			parse_atom_entry (parser, node);
+	if (node->id != PODCAST_FEED) {
+		data->error = TRUE;
+		return XML_PARSER_STOP;
+	}
+	data->has_root = TRUE;
+	data->feed = node;
+
+	return XML_PARSER_CONTINUE;
+}
+
+static int
+atom_end_element (void *user_data, xml_node_t *node)
+{
+	FeedParseData *data = user_data;
+	guint depth;
+
+	depth = data->depth--;
+	if (data->feed == NULL)
+		return XML_PARSER_CONTINUE;
+
+	/* Entries are sent as soon as they're parsed, after the feed
+	 * metadata that precedes the first of them */
+	if (depth == 2 && node->id == PODCAST_ENTRY) {
+		if (data->started == FALSE) {
+			parse_atom_feed_info (data->parser, data->uri, data->feed);
+			data->started = TRUE;
 		}
+		return feed_item_parsed (data, node, parse_atom_entry);
 	}
 
-	xplayer_pl_parser_playlist_end (parser, uri);
+	if (node == data->feed) {
+		xplayer_pl_parser_playlist_end (data->parser, data->uri);
+		data->done = TRUE;
+		return XML_PARSER_STOP;
+	}
 
-	return XPLAYER_PL_PARSER_RESULT_SUCCESS;
+	return XML_PARSER_CONTINUE;
 }
 
+static const xml_parser_callbacks_t atom_callbacks = {
+	atom_start_element,
+	NULL,
+	atom_end_element
+};
+
 XplayerPlParserResult
 xplayer_pl_parser_add_atom (XplayerPlParser *parser,
 			  GFile *file,
@@ -543,35 +847,18 @@ xplayer_pl_parser_add_atom (XplayerPlParser *parser,
 #ifndef HAVE_GMIME
 	WARN_NO_GMIME;
 #else
-	xml_node_t* doc;
-	char *contents, *uri;
+	XplayerPlParserResult ret;
+	char *contents;
 	gsize size;
 
-	if (g_file_load_contents (file, NULL, &contents, &size, NULL, NULL) == FALSE)
+	if (xplayer_pl_parser_load_contents (parser, file, parse_data, &contents, &size) == FALSE)
 		return XPLAYER_PL_PARSER_RESULT_ERROR;
 
-	doc = xplayer_pl_parser_parse_xml_relaxed (contents, size);
-	if (doc == NULL) {
-		g_free (contents);
-		return XPLAYER_PL_PARSER_RESULT_ERROR;
-	}
-
-	/* If the document has no name */
-	if (doc->name == NULL
-	    || g_ascii_strcasecmp (doc->name , "feed") != 0) {
-		g_free (contents);
-		xml_parser_free_tree (doc);
-		return XPLAYER_PL_PARSER_RESULT_ERROR;
-	}
-
-	uri = g_file_get_uri (file);
-	parse_atom_entries (parser, uri, doc);
-	g_free (uri);
+	ret = parse_feed_stream (parser, file, parse_data, contents, size, &atom_callbacks);
 
 	g_free (contents);
-	xml_parser_free_tree (doc);
 
-	return XPLAYER_PL_PARSER_RESULT_SUCCESS;
+	return ret;
 #endif /* !HAVE_GMIME */
 }
 
@@ -604,31 +891,31 @@ xplayer_pl_parser_add_xml_feed (XplayerPlParser *parser,
 }
 
 static GByteArray *
-xplayer_pl_parser_load_http_itunes (const char *uri,
+xplayer_pl_parser_load_http_itunes (XplayerPlParser *parser,
+				  const char *uri,
 				  gboolean    debug)
 {
 	SoupMessage *msg;
 	SoupSession *session;
-	GByteArray *data;
+	GByteArray *data = NULL;
 
 	if (debug)
 		g_print ("Loading ITMS playlist '%s'\n", uri);
 
-	session = soup_session_sync_new_with_options (
-	    SOUP_SESSION_ADD_FEATURE_BY_TYPE, SOUP_TYPE_CONTENT_DECODER,
-	    SOUP_SESSION_USER_AGENT, "iTunes/10.0.0",
-	    SOUP_SESSION_ACCEPT_LANGUAGE_AUTO, TRUE,
-	    NULL);
-
 	msg = soup_message_new (SOUP_METHOD_GET, uri);
+	if (msg == NULL)
+		return NULL;
+	soup_message_headers_replace (msg->request_headers, "User-Agent", "iTunes/10.0.0");
+
+	session = xplayer_pl_parser_get_session (parser);
 	soup_session_send_message (session, msg);
 	if (SOUP_STATUS_IS_SUCCESSFUL (msg->status_code)) {
 		data = g_byte_array_new ();
 		g_byte_array_append (data,
 				     (guchar *) msg->response_body->data,
 				     msg->response_body->length);
-	} else {
-		return NULL;
+	} else if (debug) {
+		g_print ("Couldn't load ITMS playlist '%s': %d %s\n", uri, msg->status_code, msg->reason_phrase);
 	}
 	g_object_unref (msg);
 	g_object_unref (session);
@@ -693,7 +980,7 @@ xplayer_pl_parser_parse_html (char *data, gsize len, gboolean debug)
 }
 
 static GFile *
-xplayer_pl_parser_get_feed_uri (char *data, gsize len, gboolean debug)
+xplayer_pl_parser_get_feed_uri (XplayerPlParser *parser, char *data, gsize len, gboolean debug)
 {
 	xml_node_t* doc;
 	const char *uri;
@@ -715,7 +1002,7 @@ xplayer_pl_parser_get_feed_uri (char *data, gsize len, gboolean debug)
 		return ret;
 	}
 
-	doc = xplayer_pl_parser_parse_xml_relaxed (data, len);
+	doc = xplayer_pl_parser_parse_xml_relaxed (data, len, NULL);
 	if (doc == NULL)
 		return NULL;
 
@@ -732,10 +1019,10 @@ xplayer_pl_parser_get_feed_uri (char *data, gsize len, gboolean debug)
 	if (uri == NULL)
 		goto out;
 
-	content = xplayer_pl_parser_load_http_itunes (uri, debug);
+	content = xplayer_pl_parser_load_http_itunes (parser, uri, debug);
 	if (!content)
 		goto out;
-	ret = xplayer_pl_parser_get_feed_uri ((char *) content->data, content->len, debug);
+	ret = xplayer_pl_parser_get_feed_uri (parser, (char *) content->data, content->len, debug);
 	g_byte_array_free (content, TRUE);
 
 out:
@@ -769,10 +1056,13 @@ xplayer_pl_parser_add_itms (XplayerPlParser *parser,
 	}
 
 	/* Load the file using iTunes user-agent */
-	content = xplayer_pl_parser_load_http_itunes (itms_uri, xplayer_pl_parser_is_debugging_enabled (parser));
+	content = xplayer_pl_parser_load_http_itunes (parser, itms_uri, xplayer_pl_parser_is_debugging_enabled (parser));
+	g_free (itms_uri);
+	if (content == NULL)
+		return XPLAYER_PL_PARSER_RESULT_ERROR;
 
 	/* And look in the file for the feedURL */
-	feed_file = xplayer_pl_parser_get_feed_uri ((char *) content->data, content->len,
+	feed_file = xplayer_pl_parser_get_feed_uri (parser, (char *) content->data, content->len,
 						  xplayer_pl_parser_is_debugging_enabled (parser));
 	g_byte_array_free (content, TRUE);
 	if (feed_file == NULL)
@@ -820,11 +1110,11 @@ parse_opml_outline (XplayerPlParser *parser, xml_node_t *parent)
 	for (node = parent->child; node != NULL; node = node->next) {
 		const char *title, *uri;
 
-		if (node->name == NULL || g_ascii_strcasecmp (node->name, "outline") != 0)
+		if (node->id != PODCAST_OUTLINE)
 			continue;
 
-		uri = xml_parser_get_property (node, "xmlUrl");
-		title = xml_parser_get_property (node, "text");
+		uri = xml_parser_get_property_by_id (node, PODCAST_XML_URL);
+		title = xml_parser_get_property_by_id (node, PODCAST_TEXT);
 
 		if (uri == NULL)
 			continue;
@@ -847,10 +1137,7 @@ parse_opml_head_body (XplayerPlParser *parser, const char *uri, xml_node_t *pare
 	started = FALSE;
 
 	for (node = parent->child; node != NULL; node = node->next) {
-		if (node->name == NULL)
-			continue;
-
-		if (g_ascii_strcasecmp (node->name, "body") == 0) {
+		if (node->id == PODCAST_BODY) {
 			if (started == FALSE) {
 				/* Send the info we already have about the feed */
 				xplayer_pl_parser_add_uri (parser,
@@ -881,18 +1168,17 @@ xplayer_pl_parser_add_opml (XplayerPlParser *parser,
 	char *contents, *uri;
 	gsize size;
 
-	if (g_file_load_contents (file, NULL, &contents, &size, NULL, NULL) == FALSE)
+	if (xplayer_pl_parser_load_contents (parser, file, parse_data, &contents, &size) == FALSE)
 		return XPLAYER_PL_PARSER_RESULT_ERROR;
 
-	doc = xplayer_pl_parser_parse_xml_relaxed (contents, size);
+	doc = xplayer_pl_parser_parse_xml_relaxed (contents, size, &podcast_vocabulary);
 	if (doc == NULL) {
 		g_free (contents);
 		return XPLAYER_PL_PARSER_RESULT_ERROR;
 	}
 
 	/* If the document has no name */
-	if (doc->name == NULL
-	    || g_ascii_strcasecmp (doc->name , "opml") != 0) {
+	if (doc->id != PODCAST_OPML) {
 		g_free (contents);
 		xml_parser_free_tree (doc);
 		return XPLAYER_PL_PARSER_RESULT_ERROR;
@@ -62,6 +62,7 @@
 #include <gio/gio.h>
 #include <gio/gio.h>
 #include <string.h>
+#include <libsoup/soup.h>
 #include "xmlparser.h"
 #else
 #include "xplayer-pl-parser-mini.h"
@@ -80,6 +81,7 @@
 #define QUICKTIME_META_MIME_TYPE "application/x-quicktime-media-link"
 #define ASX_MIME_TYPE "audio/x-ms-asx"
 #define ASF_REF_MIME_TYPE "video/x-ms-asf"
+#define BINARY_PL_MIME_TYPE "application/x-xplayer-pl-binary"
 
 #define XPLAYER_PL_PARSER_FIELD_FILE		"gfile-object"
 #define XPLAYER_PL_PARSER_FIELD_BASE_FILE		"gfile-object-base"
@@ -104,14 +106,56 @@
 	}							\
 }
 
+#ifndef XPLAYER_PL_PARSER_MINI
+/* The stages the time of a parse operation is split between, see
+ * xplayer_pl_parser_stage_enter() and #XplayerPlParserStats */
+typedef enum {
+	XPLAYER_PL_PARSER_STAGE_PARSE,
+	XPLAYER_PL_PARSER_STAGE_SNIFF,
+	XPLAYER_PL_PARSER_STAGE_LOAD,
+	XPLAYER_PL_PARSER_STAGE_XML,
+	XPLAYER_PL_PARSER_STAGE_RESOLVE,
+	XPLAYER_PL_PARSER_STAGE_DISPATCH
+} XplayerPlParserStage;
+#endif /* !XPLAYER_PL_PARSER_MINI */
+
 typedef struct {
 	guint recurse_level;
+	guint max_items;
+	guint64 min_date;
+	struct XplayerPlParserCache *cache;
+	/* Lists subdirectories ahead of the parser, see add_directory */
+	guint directory_workers;
+	struct XplayerPlDirWalker *walker;
+	/* Replays local playlists parsed before, see parse_internal */
+	struct XplayerPlParserResultCache *result_cache;
+	char *result_options;
+	/* Where the entries of the local playlist being recorded go */
+	struct XplayerPlParserResultRecord *result_record;
 	guint fallback : 1;
 	guint recurse : 1;
 	guint force : 1;
 	guint disable_unsafe : 1;
+	guint sort_directories : 1;
+#ifndef XPLAYER_PL_PARSER_MINI
+	/* What the parse operation cost so far, and the stage it is in */
+	XplayerPlParserStats stats;
+	XplayerPlParserStage stage;
+	gint64 stage_start;
+#endif /* !XPLAYER_PL_PARSER_MINI */
 } XplayerPlParseData;
 
+#ifndef XPLAYER_PL_PARSER_MINI
+/* A read-only view of the contents of a file, which isn't NUL-terminated
+ * when mapped, see xplayer_pl_parser_contents_load() */
+typedef struct {
+	const char *data;
+	gsize size;
+	GMappedFile *map;
+	char *buffer;
+} XplayerPlParserContents;
+#endif /* !XPLAYER_PL_PARSER_MINI */
+
 #ifndef XPLAYER_PL_PARSER_MINI
 char *xplayer_pl_parser_read_ini_line_string	(char **lines, const char *key);
 int   xplayer_pl_parser_read_ini_line_int		(char **lines, const char *key);
@@ -128,6 +172,22 @@ int xplayer_pl_parser_num_entries			(XplayerPlParser   *parser,
 gboolean xplayer_pl_parser_scheme_is_ignored	(XplayerPlParser *parser,
 						 GFile *file);
 gboolean xplayer_pl_parser_line_is_empty		(const char *line);
+gboolean xplayer_pl_parser_load_contents		(XplayerPlParser *parser,
+						 GFile *file,
+						 XplayerPlParseData *parse_data,
+						 char **contents,
+						 gsize *size);
+gboolean xplayer_pl_parser_uses_cache		(XplayerPlParseData *parse_data,
+						 GFile *file);
+gboolean xplayer_pl_parser_contents_load		(XplayerPlParser *parser,
+						 GFile *file,
+						 XplayerPlParseData *parse_data,
+						 XplayerPlParserContents *contents);
+void xplayer_pl_parser_contents_clear		(XplayerPlParserContents *contents);
+gboolean xplayer_pl_parser_contents_next_line	(const char **pos,
+						 const char *end,
+						 GString *line);
+SoupSession *xplayer_pl_parser_get_session		(XplayerPlParser *parser);
 gboolean xplayer_pl_parser_write_string		(GOutputStream *stream,
 						 const char *buf,
 						 GError **error);
@@ -143,6 +203,11 @@ XplayerPlParserResult xplayer_pl_parser_parse_internal (XplayerPlParser *parser,
 						    GFile *file,
 						    GFile *base_file,
 						    XplayerPlParseData *parse_data);
+XplayerPlParserResult xplayer_pl_parser_parse_internal_with_info (XplayerPlParser *parser,
+							      GFile *file,
+							      GFile *base_file,
+							      GFileInfo *info,
+							      XplayerPlParseData *parse_data);
 void xplayer_pl_parser_add_one_uri		(XplayerPlParser *parser,
 						 const char *uri,
 						 const char *title);
@@ -159,10 +224,21 @@ void xplayer_pl_parser_add_hash_table		(XplayerPlParser *parser,
 gboolean xplayer_pl_parser_ignore			(XplayerPlParser *parser,
 						 const char *uri);
 xml_node_t * xplayer_pl_parser_parse_xml_relaxed	(char *contents,
-						 gsize size);
+						 gsize size,
+						 const xml_vocabulary_t *vocabulary);
+gboolean xplayer_pl_parser_parse_xml_relaxed_stream (char *contents,
+						 gsize size,
+						 const xml_vocabulary_t *vocabulary,
+						 const xml_parser_callbacks_t *callbacks,
+						 gpointer user_data);
 gboolean xplayer_pl_parser_fix_string		(const char  *name,
 						 const char  *value,
 						 char       **ret);
+XplayerPlParseData *xplayer_pl_parser_get_parse_data (void);
+XplayerPlParserStage xplayer_pl_parser_stage_enter	(XplayerPlParseData *parse_data,
+						 XplayerPlParserStage stage);
+void xplayer_pl_parser_stage_leave		(XplayerPlParseData *parse_data,
+						 XplayerPlParserStage previous);
 
 #endif /* !XPLAYER_PL_PARSER_MINI */
 
@@ -76,7 +76,7 @@ xplayer_pl_parser_add_quicktime_rtsptext (XplayerPlParser *parser,
 	gsize size;
 	char **lines;
 
-	if (g_file_load_contents (file, NULL, &contents, &size, NULL, NULL) == FALSE)
+	if (xplayer_pl_parser_load_contents (parser, file, parse_data, &contents, &size) == FALSE)
 		return XPLAYER_PL_PARSER_RESULT_ERROR;
 
 	lines = g_strsplit_set (contents, "\r\n", 0);
@@ -131,7 +131,7 @@ xplayer_pl_parser_add_quicktime_metalink (XplayerPlParser *parser,
 	if (g_str_has_prefix (data, "SMILtext") != FALSE) {
 		XplayerPlParserResult retval;
 
-		if (g_file_load_contents (file, NULL, &contents, &size, NULL, NULL) == FALSE)
+		if (xplayer_pl_parser_load_contents (parser, file, parse_data, &contents, &size) == FALSE)
 			return XPLAYER_PL_PARSER_RESULT_ERROR;
 
 		retval = xplayer_pl_parser_add_smil_with_data (parser,
@@ -142,10 +142,10 @@ xplayer_pl_parser_add_quicktime_metalink (XplayerPlParser *parser,
 		return retval;
 	}
 
-	if (g_file_load_contents (file, NULL, &contents, &size, NULL, NULL) == FALSE)
+	if (xplayer_pl_parser_load_contents (parser, file, parse_data, &contents, &size) == FALSE)
 		return XPLAYER_PL_PARSER_RESULT_ERROR;
 
-	doc = xplayer_pl_parser_parse_xml_relaxed (contents, size);
+	doc = xplayer_pl_parser_parse_xml_relaxed (contents, size, NULL);
 	if (doc == NULL) {
 		g_free (contents);
 		return XPLAYER_PL_PARSER_RESULT_ERROR;
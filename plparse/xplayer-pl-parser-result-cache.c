@@ -0,0 +1,681 @@
+/*
+   The Gnome Library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Library General Public License as
+   published by the Free Software Foundation; either version 2 of the
+   License, or (at your option) any later version.
+
+   The Gnome Library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Library General Public License for more details.
+
+   You should have received a copy of the GNU Library General Public
+   License along with the Gnome Library; see the file COPYING.LIB.  If not,
+   write to the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+   Boston, MA 02110-1301  USA.
+ */
+
+#include "config.h"
+
+#ifndef XPLAYER_PL_PARSER_MINI
+#include <string.h>
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <gio/gio.h>
+
+#include "xplayer-pl-parser.h"
+#include "xplayer-pl-parser-private.h"
+#include "xplayer-pl-parser-result-cache.h"
+
+/* The entries of each playlist are stored in a single file named after
+ * the SHA-1 of its URI. The file starts with a header made of the parse
+ * options, the URI, the base URI and the modification time, size and
+ * inode of the playlist, so that a lookup is a prefix comparison. The
+ * local files the playlist pulled in follow, each with its own stamp,
+ * then the result and the recorded signals.
+ *
+ * Integers are little-endian, and strings are prefixed with their length,
+ * or RESULT_NULL_STRING for NULL. */
+#define RESULT_MAGIC "XPLR"
+#define RESULT_FORMAT_VERSION 1
+#define RESULT_NULL_STRING G_MAXUINT32
+#define RESULT_KEY_LEN 40 /* SHA-1 in hex */
+
+/* Evict down to this fraction of the maximum size, so that a full
+ * cache doesn't list its directory for every new playlist */
+#define RESULT_EVICT_RATIO 0.75
+
+#define RESULT_ATTRIBUTES G_FILE_ATTRIBUTE_STANDARD_TYPE","		\
+	G_FILE_ATTRIBUTE_STANDARD_SIZE","				\
+	G_FILE_ATTRIBUTE_TIME_MODIFIED","				\
+	G_FILE_ATTRIBUTE_TIME_MODIFIED_USEC","				\
+	G_FILE_ATTRIBUTE_UNIX_INODE
+
+enum {
+	RESULT_EVENT_ENTRY,
+	RESULT_EVENT_PLAYLIST_STARTED,
+	RESULT_EVENT_PLAYLIST_ENDED
+};
+
+typedef struct {
+	guint64 mtime; /* in microseconds */
+	guint64 size;
+	guint64 inode;
+} ResultStamp;
+
+typedef struct {
+	guint8 kind;
+	char *uri;
+	GHashTable *metadata;
+} ResultEvent;
+
+typedef struct {
+	const guint8 *data;
+	const guint8 *end;
+} ResultReader;
+
+typedef struct {
+	char *path;
+	gint64 time;
+	guint64 size;
+} ResultFile;
+
+struct XplayerPlParserResultCache {
+	volatile gint ref_count;
+	char *dir;
+	guint64 max_size;
+	gint64 total; /* size of the files in dir, or -1 until listed */
+	GMutex mutex; /* serialises writes and eviction */
+};
+
+struct XplayerPlParserResultRecord {
+	char *path;
+	GByteArray *header;
+	GByteArray *deps;
+	guint num_deps;
+	GByteArray *events;
+	guint num_events;
+	guint handled : 1;
+	guint uncacheable : 1;
+};
+
+static void
+put_uint32 (GByteArray *buf, guint32 value)
+{
+	value = GUINT32_TO_LE (value);
+	g_byte_array_append (buf, (const guint8 *) &value, sizeof (value));
+}
+
+static void
+put_uint64 (GByteArray *buf, guint64 value)
+{
+	value = GUINT64_TO_LE (value);
+	g_byte_array_append (buf, (const guint8 *) &value, sizeof (value));
+}
+
+static void
+put_string (GByteArray *buf, const char *str)
+{
+	guint32 len;
+
+	if (str == NULL) {
+		put_uint32 (buf, RESULT_NULL_STRING);
+		return;
+	}
+	len = strlen (str);
+	put_uint32 (buf, len);
+	g_byte_array_append (buf, (const guint8 *) str, len);
+}
+
+static void
+put_stamp (GByteArray *buf, const ResultStamp *stamp)
+{
+	put_uint64 (buf, stamp->mtime);
+	put_uint64 (buf, stamp->size);
+	put_uint64 (buf, stamp->inode);
+}
+
+static gboolean
+get_uint32 (ResultReader *reader, guint32 *value)
+{
+	if (reader->end - reader->data < (gssize) sizeof (*value))
+		return FALSE;
+	memcpy (value, reader->data, sizeof (*value));
+	*value = GUINT32_FROM_LE (*value);
+	reader->data += sizeof (*value);
+	return TRUE;
+}
+
+static gboolean
+get_uint64 (ResultReader *reader, guint64 *value)
+{
+	if (reader->end - reader->data < (gssize) sizeof (*value))
+		return FALSE;
+	memcpy (value, reader->data, sizeof (*value));
+	*value = GUINT64_FROM_LE (*value);
+	reader->data += sizeof (*value);
+	return TRUE;
+}
+
+static gboolean
+get_string (ResultReader *reader, char **str)
+{
+	guint32 len;
+
+	if (get_uint32 (reader, &len) == FALSE)
+		return FALSE;
+	if (len == RESULT_NULL_STRING) {
+		*str = NULL;
+		return TRUE;
+	}
+	if ((guint64) (reader->end - reader->data) < len)
+		return FALSE;
+	*str = g_strndup ((const char *) reader->data, len);
+	reader->data += len;
+	return TRUE;
+}
+
+static gboolean
+get_stamp (ResultReader *reader, ResultStamp *stamp)
+{
+	return (get_uint64 (reader, &stamp->mtime) != FALSE &&
+		get_uint64 (reader, &stamp->size) != FALSE &&
+		get_uint64 (reader, &stamp->inode) != FALSE);
+}
+
+/* Fills in @stamp for @file, or zeroes it if @file isn't a regular
+ * file, and returns the type of @file, G_FILE_TYPE_UNKNOWN if it
+ * doesn't exist */
+static GFileType
+result_stamp_query (GFile *file, ResultStamp *stamp)
+{
+	GFileInfo *info;
+	GFileType type;
+
+	memset (stamp, 0, sizeof (*stamp));
+
+	info = g_file_query_info (file, RESULT_ATTRIBUTES, G_FILE_QUERY_INFO_NONE, NULL, NULL);
+	if (info == NULL)
+		return G_FILE_TYPE_UNKNOWN;
+
+	type = g_file_info_get_file_type (info);
+	if (type == G_FILE_TYPE_REGULAR) {
+		stamp->mtime = g_file_info_get_attribute_uint64 (info, G_FILE_ATTRIBUTE_TIME_MODIFIED) * G_USEC_PER_SEC +
+			g_file_info_get_attribute_uint32 (info, G_FILE_ATTRIBUTE_TIME_MODIFIED_USEC);
+		stamp->size = g_file_info_get_size (info);
+		stamp->inode = g_file_info_get_attribute_uint64 (info, G_FILE_ATTRIBUTE_UNIX_INODE);
+	}
+	g_object_unref (info);
+
+	return type;
+}
+
+static void
+result_event_free (ResultEvent *event)
+{
+	g_free (event->uri);
+	if (event->metadata != NULL)
+		g_hash_table_unref (event->metadata);
+	g_free (event);
+}
+
+static gboolean
+result_read_dependencies (ResultReader *reader)
+{
+	guint32 num_deps, i;
+
+	if (get_uint32 (reader, &num_deps) == FALSE)
+		return FALSE;
+
+	for (i = 0; i < num_deps; i++) {
+		ResultStamp stamp, current;
+		GFileType type;
+		GFile *file;
+		char *uri;
+
+		if (get_string (reader, &uri) == FALSE || uri == NULL ||
+		    get_stamp (reader, &stamp) == FALSE) {
+			g_free (uri);
+			return FALSE;
+		}
+
+		file = g_file_new_for_uri (uri);
+		type = result_stamp_query (file, &current);
+		g_object_unref (file);
+		g_free (uri);
+
+		if ((type != G_FILE_TYPE_REGULAR && type != G_FILE_TYPE_UNKNOWN) ||
+		    memcmp (&stamp, &current, sizeof (stamp)) != 0)
+			return FALSE;
+	}
+
+	return TRUE;
+}
+
+static gboolean
+result_read_events (ResultReader *reader, GPtrArray *events)
+{
+	guint32 num_events, i;
+
+	if (get_uint32 (reader, &num_events) == FALSE)
+		return FALSE;
+
+	for (i = 0; i < num_events; i++) {
+		ResultEvent *event;
+		guint32 num_fields, j;
+
+		if (reader->data == reader->end)
+			return FALSE;
+
+		event = g_new0 (ResultEvent, 1);
+		event->kind = *reader->data++;
+		g_ptr_array_add (events, event);
+
+		if (event->kind > RESULT_EVENT_PLAYLIST_ENDED ||
+		    get_string (reader, &event->uri) == FALSE)
+			return FALSE;
+		if (event->kind == RESULT_EVENT_PLAYLIST_ENDED)
+			continue;
+
+		if (get_uint32 (reader, &num_fields) == FALSE)
+			return FALSE;
+		event->metadata = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
+		for (j = 0; j < num_fields; j++) {
+			char *key, *value;
+
+			if (get_string (reader, &key) == FALSE)
+				return FALSE;
+			if (get_string (reader, &value) == FALSE || key == NULL || value == NULL) {
+				g_free (key);
+				g_free (value);
+				return FALSE;
+			}
+			g_hash_table_insert (event->metadata, key, value);
+		}
+	}
+
+	return (reader->data == reader->end);
+}
+
+/* Checks the whole of @contents before replaying anything, so that
+ * a stale or truncated file is a plain miss */
+static gboolean
+result_replay (XplayerPlParser *parser,
+	       const char *contents,
+	       gsize len,
+	       GByteArray *header,
+	       XplayerPlParserResult *result)
+{
+	ResultReader reader;
+	GPtrArray *events;
+	guint32 value;
+	gboolean retval;
+	guint i;
+
+	if (len < header->len || memcmp (contents, header->data, header->len) != 0)
+		return FALSE;
+
+	reader.data = (const guint8 *) contents + header->len;
+	reader.end = (const guint8 *) contents + len;
+
+	if (result_read_dependencies (&reader) == FALSE ||
+	    get_uint32 (&reader, &value) == FALSE)
+		return FALSE;
+
+	events = g_ptr_array_new_with_free_func ((GDestroyNotify) result_event_free);
+	retval = result_read_events (&reader, events);
+	if (retval != FALSE) {
+		*result = value;
+		for (i = 0; i < events->len; i++) {
+			ResultEvent *event = g_ptr_array_index (events, i);
+
+			if (event->kind == RESULT_EVENT_PLAYLIST_ENDED)
+				xplayer_pl_parser_playlist_end (parser, event->uri);
+			else
+				xplayer_pl_parser_add_hash_table (parser, event->metadata, event->uri,
+								event->kind == RESULT_EVENT_PLAYLIST_STARTED);
+		}
+	}
+	g_ptr_array_free (events, TRUE);
+
+	return retval;
+}
+
+XplayerPlParserResultCache *
+xplayer_pl_parser_result_cache_new (const char *dir,
+				  guint64 max_size)
+{
+	XplayerPlParserResultCache *cache;
+
+	g_return_val_if_fail (dir != NULL, NULL);
+
+	cache = g_new0 (XplayerPlParserResultCache, 1);
+	cache->ref_count = 1;
+	cache->dir = g_strdup (dir);
+	cache->max_size = max_size;
+	cache->total = -1;
+	g_mutex_init (&cache->mutex);
+
+	return cache;
+}
+
+XplayerPlParserResultCache *
+xplayer_pl_parser_result_cache_ref (XplayerPlParserResultCache *cache)
+{
+	g_atomic_int_inc (&cache->ref_count);
+	return cache;
+}
+
+void
+xplayer_pl_parser_result_cache_unref (XplayerPlParserResultCache *cache)
+{
+	if (g_atomic_int_dec_and_test (&cache->ref_count) == FALSE)
+		return;
+
+	g_mutex_clear (&cache->mutex);
+	g_free (cache->dir);
+	g_free (cache);
+}
+
+/**
+ * xplayer_pl_parser_result_cache_lookup:
+ * @cache: a #XplayerPlParserResultCache
+ * @parser: the #XplayerPlParser to replay the entries on
+ * @file: the local file about to be parsed
+ * @base_file: (allow-none): the base #GFile @file is parsed with, or %NULL
+ * @options: a digest of the options @file is parsed with
+ * @result: return location for the result of the cached parse
+ * @record: return location for a new #XplayerPlParserResultRecord
+ *
+ * Looks for the entries @file was parsed into the last time, with the
+ * same @base_file and @options, and replays them on @parser if neither
+ * @file nor any of the local files it pulled in changed since.
+ *
+ * On a miss, @record is set to a new record to collect the entries of
+ * the parse in, and to pass to xplayer_pl_parser_result_cache_store()
+ * once done, unless @file can't be cached at all.
+ *
+ * Return value: %TRUE if the entries were replayed and @result set
+ **/
+gboolean
+xplayer_pl_parser_result_cache_lookup (XplayerPlParserResultCache *cache,
+				     XplayerPlParser *parser,
+				     GFile *file,
+				     GFile *base_file,
+				     const char *options,
+				     XplayerPlParserResult *result,
+				     XplayerPlParserResultRecord **record)
+{
+	XplayerPlParserResultRecord *rec;
+	ResultStamp stamp;
+	GByteArray *header;
+	char *uri, *base, *key, *path, *contents;
+	gsize len;
+	gboolean hit;
+
+	*record = NULL;
+
+	if (result_stamp_query (file, &stamp) != G_FILE_TYPE_REGULAR)
+		return FALSE;
+
+	uri = g_file_get_uri (file);
+	base = base_file ? g_file_get_uri (base_file) : NULL;
+
+	header = g_byte_array_new ();
+	g_byte_array_append (header, (const guint8 *) RESULT_MAGIC, strlen (RESULT_MAGIC));
+	put_uint32 (header, RESULT_FORMAT_VERSION);
+	put_string (header, options);
+	put_string (header, uri);
+	put_string (header, base);
+	put_stamp (header, &stamp);
+
+	key = g_compute_checksum_for_string (G_CHECKSUM_SHA1, uri, -1);
+	path = g_build_filename (cache->dir, key, NULL);
+	g_free (key);
+	g_free (base);
+	g_free (uri);
+
+	hit = FALSE;
+	if (g_file_get_contents (path, &contents, &len, NULL) != FALSE) {
+		hit = result_replay (parser, contents, len, header, result);
+		g_free (contents);
+	}
+
+	if (hit != FALSE) {
+		/* Eviction goes by modification time */
+		g_utime (path, NULL);
+		g_byte_array_unref (header);
+		g_free (path);
+		return TRUE;
+	}
+
+	rec = g_new0 (XplayerPlParserResultRecord, 1);
+	rec->path = path;
+	rec->header = header;
+	rec->deps = g_byte_array_new ();
+	rec->events = g_byte_array_new ();
+	*record = rec;
+
+	return FALSE;
+}
+
+static int
+result_file_compare (gconstpointer a, gconstpointer b)
+{
+	const ResultFile *fa = a;
+	const ResultFile *fb = b;
+
+	if (fa->time < fb->time)
+		return -1;
+	return fa->time > fb->time;
+}
+
+/* Called with the mutex held */
+static void
+result_cache_evict (XplayerPlParserResultCache *cache)
+{
+	GArray *files;
+	GDir *dir;
+	const char *name;
+	guint64 total, target;
+	guint i;
+
+	dir = g_dir_open (cache->dir, 0, NULL);
+	if (dir == NULL)
+		return;
+
+	files = g_array_new (FALSE, FALSE, sizeof (ResultFile));
+	total = 0;
+	while ((name = g_dir_read_name (dir)) != NULL) {
+		ResultFile rfile;
+		GStatBuf buf;
+
+		/* Skip the temporary files of g_file_set_contents() */
+		if (strlen (name) != RESULT_KEY_LEN)
+			continue;
+
+		rfile.path = g_build_filename (cache->dir, name, NULL);
+		if (g_stat (rfile.path, &buf) != 0) {
+			g_free (rfile.path);
+			continue;
+		}
+		rfile.time = buf.st_mtime;
+		rfile.size = buf.st_size;
+
+		total += rfile.size;
+		g_array_append_val (files, rfile);
+	}
+	g_dir_close (dir);
+
+	if (total > cache->max_size) {
+		target = cache->max_size * RESULT_EVICT_RATIO;
+		g_array_sort (files, result_file_compare);
+		for (i = 0; i < files->len && total > target; i++) {
+			ResultFile *rfile = &g_array_index (files, ResultFile, i);
+
+			if (g_unlink (rfile->path) == 0)
+				total -= rfile->size;
+		}
+	}
+	cache->total = total;
+
+	for (i = 0; i < files->len; i++)
+		g_free (g_array_index (files, ResultFile, i).path);
+	g_array_free (files, TRUE);
+}
+
+/**
+ * xplayer_pl_parser_result_cache_store:
+ * @cache: a #XplayerPlParserResultCache
+ * @record: (transfer full): the record returned by xplayer_pl_parser_result_cache_lookup()
+ * @result: the result of the parse
+ *
+ * Writes the entries collected in @record to @cache if the parse
+ * succeeded and can be replayed later, then frees @record.
+ **/
+void
+xplayer_pl_parser_result_cache_store (XplayerPlParserResultCache *cache,
+				    XplayerPlParserResultRecord *record,
+				    XplayerPlParserResult result)
+{
+	GByteArray *data;
+	GStatBuf buf;
+	guint64 old_size;
+
+	if (record->handled == FALSE ||
+	    record->uncacheable != FALSE ||
+	    result != XPLAYER_PL_PARSER_RESULT_SUCCESS) {
+		xplayer_pl_parser_result_record_free (record);
+		return;
+	}
+
+	data = g_byte_array_sized_new (record->header->len + record->deps->len + record->events->len + 12);
+	g_byte_array_append (data, record->header->data, record->header->len);
+	put_uint32 (data, record->num_deps);
+	g_byte_array_append (data, record->deps->data, record->deps->len);
+	put_uint32 (data, result);
+	put_uint32 (data, record->num_events);
+	g_byte_array_append (data, record->events->data, record->events->len);
+
+	if (cache->max_size != 0 && data->len > cache->max_size)
+		goto out;
+
+	g_mutex_lock (&cache->mutex);
+
+	old_size = (g_stat (record->path, &buf) == 0) ? (guint64) buf.st_size : 0;
+	if (g_mkdir_with_parents (cache->dir, 0700) < 0 ||
+	    g_file_set_contents (record->path, (const char *) data->data, data->len, NULL) == FALSE) {
+		g_mutex_unlock (&cache->mutex);
+		goto out;
+	}
+
+	if (cache->total >= 0)
+		cache->total += (gint64) data->len - (gint64) old_size;
+	if (cache->max_size != 0 &&
+	    (cache->total < 0 || (guint64) cache->total > cache->max_size))
+		result_cache_evict (cache);
+
+	g_mutex_unlock (&cache->mutex);
+
+out:
+	g_byte_array_unref (data);
+	xplayer_pl_parser_result_record_free (record);
+}
+
+void
+xplayer_pl_parser_result_record_free (XplayerPlParserResultRecord *record)
+{
+	g_free (record->path);
+	g_byte_array_unref (record->header);
+	g_byte_array_unref (record->deps);
+	g_byte_array_unref (record->events);
+	g_free (record);
+}
+
+/**
+ * xplayer_pl_parser_result_record_depend:
+ * @record: a #XplayerPlParserResultRecord
+ * @file: a file parsed while recording
+ *
+ * Adds @file to the files the recorded entries depend on. Only local
+ * files, or local files which don't exist, can be checked for changes
+ * cheaply, anything else makes the record impossible to store.
+ **/
+void
+xplayer_pl_parser_result_record_depend (XplayerPlParserResultRecord *record,
+				      GFile *file)
+{
+	ResultStamp stamp;
+	GFileType type;
+	char *uri;
+
+	if (record->uncacheable != FALSE)
+		return;
+
+	if (g_file_is_native (file) == FALSE) {
+		record->uncacheable = TRUE;
+		return;
+	}
+
+	type = result_stamp_query (file, &stamp);
+	if (type != G_FILE_TYPE_REGULAR && type != G_FILE_TYPE_UNKNOWN) {
+		record->uncacheable = TRUE;
+		return;
+	}
+
+	uri = g_file_get_uri (file);
+	put_string (record->deps, uri);
+	put_stamp (record->deps, &stamp);
+	record->num_deps++;
+	g_free (uri);
+}
+
+/**
+ * xplayer_pl_parser_result_record_handled:
+ * @record: a #XplayerPlParserResultRecord
+ *
+ * Marks the file being recorded as having been parsed by one of the
+ * playlist handlers, rather than merely added as a single entry, which
+ * isn't worth caching.
+ **/
+void
+xplayer_pl_parser_result_record_handled (XplayerPlParserResultRecord *record)
+{
+	record->handled = TRUE;
+}
+
+void
+xplayer_pl_parser_result_record_entry (XplayerPlParserResultRecord *record,
+				     const char *uri,
+				     GHashTable *metadata,
+				     gboolean is_playlist)
+{
+	GHashTableIter iter;
+	gpointer key, value;
+	guint8 kind;
+
+	kind = is_playlist ? RESULT_EVENT_PLAYLIST_STARTED : RESULT_EVENT_ENTRY;
+	g_byte_array_append (record->events, &kind, 1);
+	put_string (record->events, uri);
+	put_uint32 (record->events, g_hash_table_size (metadata));
+
+	g_hash_table_iter_init (&iter, metadata);
+	while (g_hash_table_iter_next (&iter, &key, &value)) {
+		put_string (record->events, key);
+		put_string (record->events, value);
+	}
+	record->num_events++;
+}
+
+void
+xplayer_pl_parser_result_record_end (XplayerPlParserResultRecord *record,
+				   const char *uri)
+{
+	guint8 kind = RESULT_EVENT_PLAYLIST_ENDED;
+
+	g_byte_array_append (record->events, &kind, 1);
+	put_string (record->events, uri);
+	record->num_events++;
+}
+
+#endif /* !XPLAYER_PL_PARSER_MINI */
@@ -0,0 +1,60 @@
+/*
+   The Gnome Library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Library General Public License as
+   published by the Free Software Foundation; either version 2 of the
+   License, or (at your option) any later version.
+
+   The Gnome Library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Library General Public License for more details.
+
+   You should have received a copy of the GNU Library General Public
+   License along with the Gnome Library; see the file COPYING.LIB.  If not,
+   write to the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+   Boston, MA 02110-1301  USA.
+ */
+
+#ifndef XPLAYER_PL_PARSER_RESULT_CACHE_H
+#define XPLAYER_PL_PARSER_RESULT_CACHE_H
+
+G_BEGIN_DECLS
+
+#ifndef XPLAYER_PL_PARSER_MINI
+#include "xplayer-pl-parser.h"
+#include <gio/gio.h>
+
+typedef struct XplayerPlParserResultCache XplayerPlParserResultCache;
+typedef struct XplayerPlParserResultRecord XplayerPlParserResultRecord;
+
+XplayerPlParserResultCache *xplayer_pl_parser_result_cache_new	(const char *dir,
+								 guint64 max_size);
+XplayerPlParserResultCache *xplayer_pl_parser_result_cache_ref	(XplayerPlParserResultCache *cache);
+void xplayer_pl_parser_result_cache_unref			(XplayerPlParserResultCache *cache);
+gboolean xplayer_pl_parser_result_cache_lookup			(XplayerPlParserResultCache *cache,
+								 XplayerPlParser *parser,
+								 GFile *file,
+								 GFile *base_file,
+								 const char *options,
+								 XplayerPlParserResult *result,
+								 XplayerPlParserResultRecord **record);
+void xplayer_pl_parser_result_cache_store			(XplayerPlParserResultCache *cache,
+								 XplayerPlParserResultRecord *record,
+								 XplayerPlParserResult result);
+
+void xplayer_pl_parser_result_record_free			(XplayerPlParserResultRecord *record);
+void xplayer_pl_parser_result_record_depend			(XplayerPlParserResultRecord *record,
+								 GFile *file);
+void xplayer_pl_parser_result_record_handled			(XplayerPlParserResultRecord *record);
+void xplayer_pl_parser_result_record_entry			(XplayerPlParserResultRecord *record,
+								 const char *uri,
+								 GHashTable *metadata,
+								 gboolean is_playlist);
+void xplayer_pl_parser_result_record_end			(XplayerPlParserResultRecord *record,
+								 const char *uri);
+
+#endif /* !XPLAYER_PL_PARSER_MINI */
+
+G_END_DECLS
+
+#endif /* XPLAYER_PL_PARSER_RESULT_CACHE_H */
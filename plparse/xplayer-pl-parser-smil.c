@@ -35,6 +35,41 @@
 #include "xplayer-pl-parser-private.h"
 
 #ifndef XPLAYER_PL_PARSER_MINI
+/* The element and property names we look for in SMIL
+ * documents, sorted case-insensitively */
+#define SMIL_VOCABULARY(X) \
+	X (SMIL_ABSTRACT, "abstract") \
+	X (SMIL_AUDIO, "audio") \
+	X (SMIL_AUTHOR, "author") \
+	X (SMIL_BODY, "body") \
+	X (SMIL_CLIP_BEGIN, "clip-begin") \
+	X (SMIL_CONTENT, "content") \
+	X (SMIL_COPYRIGHT, "copyright") \
+	X (SMIL_DUR, "dur") \
+	X (SMIL_HEAD, "head") \
+	X (SMIL_MEDIA, "media") \
+	X (SMIL_META, "meta") \
+	X (SMIL_NAME, "name") \
+	X (SMIL_SMIL, "smil") \
+	X (SMIL_SRC, "src") \
+	X (SMIL_TEXTSTREAM, "textstream") \
+	X (SMIL_TITLE, "title") \
+	X (SMIL_VIDEO, "video")
+
+enum {
+	SMIL_UNKNOWN = XML_ID_UNKNOWN,
+	SMIL_VOCABULARY (XML_VOCABULARY_ID)
+};
+
+static const char * const smil_names[] = {
+	SMIL_VOCABULARY (XML_VOCABULARY_NAME)
+};
+
+static const xml_vocabulary_t smil_vocabulary = {
+	smil_names,
+	G_N_ELEMENTS (smil_names)
+};
+
 static void
 parse_smil_entry_add (XplayerPlParser *parser,
 		      GFile *base_file,
@@ -102,9 +137,10 @@ parse_smil_entry (XplayerPlParser *parser,
 			continue;
 
 		/* ENTRY should only have one ref and one title nodes */
-		if (g_ascii_strcasecmp (node->name, "video") == 0
-		    || g_ascii_strcasecmp (node->name, "audio") == 0
-		    || g_ascii_strcasecmp (node->name, "media") == 0) {
+		switch (node->id) {
+		case SMIL_VIDEO:
+		case SMIL_AUDIO:
+		case SMIL_MEDIA:
 			/* Send the previous entry */
 			if (uri != NULL && added == FALSE) {
 				parse_smil_entry_add (parser,
@@ -121,21 +157,24 @@ parse_smil_entry (XplayerPlParser *parser,
 				retval = XPLAYER_PL_PARSER_RESULT_SUCCESS;
 			}
 
-			uri = xml_parser_get_property (node, "src");
-			title = xml_parser_get_property (node, "title");
-			author = xml_parser_get_property (node, "author");
-			dur = xml_parser_get_property (node, "dur");
-			clip_begin = xml_parser_get_property (node, "clip-begin");
-			abstract = xml_parser_get_property (node, "abstract");
-			copyright = xml_parser_get_property (node, "copyright");
+			uri = xml_parser_get_property_by_id (node, SMIL_SRC);
+			title = xml_parser_get_property_by_id (node, SMIL_TITLE);
+			author = xml_parser_get_property_by_id (node, SMIL_AUTHOR);
+			dur = xml_parser_get_property_by_id (node, SMIL_DUR);
+			clip_begin = xml_parser_get_property_by_id (node, SMIL_CLIP_BEGIN);
+			abstract = xml_parser_get_property_by_id (node, SMIL_ABSTRACT);
+			copyright = xml_parser_get_property_by_id (node, SMIL_COPYRIGHT);
 			subtitle_uri = NULL;
 			added = FALSE;
-		} else if (g_ascii_strcasecmp (node->name, "textstream") == 0) {
-			subtitle_uri = xml_parser_get_property (node, "src");
-		} else {
+			break;
+		case SMIL_TEXTSTREAM:
+			subtitle_uri = xml_parser_get_property_by_id (node, SMIL_SRC);
+			break;
+		default:
 			if (parse_smil_entry (parser,
 						base_file, doc, node, parent_title) != FALSE)
 				retval = XPLAYER_PL_PARSER_RESULT_SUCCESS;
+			break;
 		}
 	}
 
@@ -166,11 +205,11 @@ parse_smil_head (XplayerPlParser *parser, xml_node_t *doc, xml_node_t *parent)
 	title = NULL;
 
 	for (node = parent->child; node != NULL; node = node->next) {
-		if (g_ascii_strcasecmp (node->name, "meta") == 0) {
+		if (node->id == SMIL_META) {
 			const char *prop;
-			prop = xml_parser_get_property (node, "name");
+			prop = xml_parser_get_property_by_id (node, SMIL_NAME);
 			if (prop != NULL && g_ascii_strcasecmp (prop, "title") == 0) {
-				title = xml_parser_get_property (node, "content");
+				title = xml_parser_get_property_by_id (node, SMIL_CONTENT);
 				if (title != NULL)
 					break;
 			}
@@ -190,17 +229,13 @@ parse_smil_entries (XplayerPlParser *parser, GFile *base_file, xml_node_t *doc)
 	title = NULL;
 
 	for (node = doc->child; node != NULL; node = node->next) {
-		if (node->name == NULL)
-			continue;
-
-		if (g_ascii_strcasecmp (node->name, "body") == 0) {
+		if (node->id == SMIL_BODY) {
 			if (parse_smil_entry (parser, base_file,
 					      doc, node, title) != FALSE) {
 				retval = XPLAYER_PL_PARSER_RESULT_SUCCESS;
 			}
-		} else if (title == NULL) {
-			if (g_ascii_strcasecmp (node->name, "head") == 0)
-				title = parse_smil_head (parser, doc, node);
+		} else if (title == NULL && node->id == SMIL_HEAD) {
+			title = parse_smil_head (parser, doc, node);
 		}
 	}
 
@@ -214,8 +249,7 @@ xplayer_pl_parser_add_smil_with_doc (XplayerPlParser *parser, GFile *file,
 	XplayerPlParserResult retval = XPLAYER_PL_PARSER_RESULT_UNHANDLED;
 
 	/* If the document has no root, or no name */
-	if(doc->name == NULL
-	   || g_ascii_strcasecmp (doc->name, "smil") != 0) {
+	if (doc->id != SMIL_SMIL) {
 		return XPLAYER_PL_PARSER_RESULT_ERROR;
 	}
 
@@ -235,7 +269,7 @@ xplayer_pl_parser_add_smil (XplayerPlParser *parser,
 	gsize size;
 	XplayerPlParserResult retval;
 
-	if (g_file_load_contents (file, NULL, &contents, &size, NULL, NULL) == FALSE)
+	if (xplayer_pl_parser_load_contents (parser, file, parse_data, &contents, &size) == FALSE)
 		return XPLAYER_PL_PARSER_RESULT_ERROR;
 
 	retval = xplayer_pl_parser_add_smil_with_data (parser, file,
@@ -256,7 +290,7 @@ xplayer_pl_parser_add_smil_with_data (XplayerPlParser *parser,
 	char *contents_dup;
 
 	contents_dup = g_strndup (contents, size);
-	doc = xplayer_pl_parser_parse_xml_relaxed (contents_dup, size);
+	doc = xplayer_pl_parser_parse_xml_relaxed (contents_dup, size, &smil_vocabulary);
 	if (doc == NULL) {
 		g_free (contents_dup);
 		return XPLAYER_PL_PARSER_RESULT_ERROR;
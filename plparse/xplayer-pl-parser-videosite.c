@@ -21,44 +21,525 @@
 
 #include "config.h"
 
+#include <stdlib.h>
 #include <string.h>
 #include <glib.h>
 
+#ifdef HAVE_QUVI
+#include <errno.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#endif /* HAVE_QUVI */
+
 #include "xplayer-pl-parser-mini.h"
 #include "xplayer-pl-parser-videosite.h"
 #include "xplayer-pl-parser-private.h"
 
 #define BASE 20
 
-gboolean
-xplayer_pl_parser_is_videosite (const char *uri, gboolean debug)
+/* How long, in seconds, to trust whether a site is supported */
+#define SUPPORT_CACHE_TTL (24 * 60 * 60)
+#define SUPPORT_CACHE_MAX_ENTRIES 4096
+/* How long, in seconds, to wait for more changes before saving the cache */
+#define SUPPORT_CACHE_SAVE_DELAY 5
+
+typedef struct {
+	gboolean supported;
+	gint64 expires;
+} SupportEntry;
+
+static GMutex support_cache_mutex;
+static GHashTable *support_cache = NULL;
+static char *support_cache_file = NULL;
+static gboolean support_cache_dirty = FALSE;
+static guint support_cache_save_id = 0;
+static guint64 support_cache_hits = 0;
+static guint64 support_cache_misses = 0;
+/* serialises writes to support_cache_file, taken before support_cache_mutex */
+static GMutex support_cache_file_mutex;
+
+static gint64
+support_cache_now (void)
+{
+	return g_get_real_time () / G_USEC_PER_SEC;
+}
+
+static void
+support_cache_insert (const char *key,
+		      gboolean supported,
+		      gint64 expires)
+{
+	SupportEntry *entry;
+
+	if (support_cache == NULL)
+		support_cache = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
+
+	entry = g_new (SupportEntry, 1);
+	entry->supported = supported;
+	entry->expires = expires;
+	g_hash_table_replace (support_cache, g_strdup (key), entry);
+}
+
+/* One "<key> <supported> <expiry>" line per entry; keys are built
+ * from escaped URIs, so can't contain spaces. Only the copy of the
+ * entries is made with support_cache_mutex held, so that lookups
+ * don't wait for the file to be written. */
+static void
+support_cache_save (void)
+{
+	GHashTableIter iter;
+	gpointer key, value;
+	GString *str = NULL;
+	char *filename = NULL;
+
+	g_mutex_lock (&support_cache_file_mutex);
+
+	g_mutex_lock (&support_cache_mutex);
+	if (support_cache_dirty != FALSE && support_cache_file != NULL && support_cache != NULL) {
+		str = g_string_new (NULL);
+		g_hash_table_iter_init (&iter, support_cache);
+		while (g_hash_table_iter_next (&iter, &key, &value)) {
+			SupportEntry *entry = value;
+
+			g_string_append_printf (str, "%s %d %" G_GINT64_FORMAT "\n",
+						(char *) key, entry->supported ? 1 : 0, entry->expires);
+		}
+		filename = g_strdup (support_cache_file);
+	}
+	support_cache_dirty = FALSE;
+	g_mutex_unlock (&support_cache_mutex);
+
+	if (str != NULL) {
+		g_file_set_contents (filename, str->str, str->len, NULL);
+		g_string_free (str, TRUE);
+		g_free (filename);
+	}
+
+	g_mutex_unlock (&support_cache_file_mutex);
+}
+
+#ifdef HAVE_QUVI
+static gboolean
+support_cache_save_timeout (gpointer user_data)
+{
+	g_mutex_lock (&support_cache_mutex);
+	support_cache_save_id = 0;
+	g_mutex_unlock (&support_cache_mutex);
+
+	support_cache_save ();
+
+	return G_SOURCE_REMOVE;
+}
+
+/* Called with support_cache_mutex held. Changes are saved together,
+ * a little while after the first one, or by
+ * xplayer_pl_parser_videosite_cache_flush() */
+static void
+support_cache_mark_dirty (void)
+{
+	support_cache_dirty = TRUE;
+	if (support_cache_file != NULL && support_cache_save_id == 0)
+		support_cache_save_id = g_timeout_add_seconds (SUPPORT_CACHE_SAVE_DELAY,
+							       support_cache_save_timeout, NULL);
+}
+#endif /* HAVE_QUVI */
+
+static void
+support_cache_load (void)
+{
+	char *contents;
+	char **lines;
+	gint64 now;
+	guint i;
+
+	if (g_file_get_contents (support_cache_file, &contents, NULL, NULL) == FALSE)
+		return;
+
+	now = support_cache_now ();
+	lines = g_strsplit (contents, "\n", -1);
+	g_free (contents);
+	for (i = 0; lines[i] != NULL; i++) {
+		char **fields;
+
+		fields = g_strsplit (lines[i], " ", 3);
+		if (g_strv_length (fields) == 3) {
+			gint64 expires;
+
+			expires = g_ascii_strtoll (fields[2], NULL, 10);
+			if (expires > now)
+				support_cache_insert (fields[0], atoi (fields[1]) != 0, expires);
+		}
+		g_strfreev (fields);
+	}
+	g_strfreev (lines);
+}
+
+/**
+ * xplayer_pl_parser_videosite_cache_set_file:
+ * @filename: (allow-none): file to keep the cache in, or %NULL
+ *
+ * Sets the file the video site support cache is loaded from and saved
+ * to, so that it survives across processes. Entries from the file are
+ * merged into the in-memory cache.
+ *
+ * This is a private method, not exposed by the library.
+ **/
+void
+xplayer_pl_parser_videosite_cache_set_file (const char *filename)
+{
+	/* Changes made so far go to the previous file */
+	xplayer_pl_parser_videosite_cache_flush ();
+
+	g_mutex_lock (&support_cache_mutex);
+	g_free (support_cache_file);
+	support_cache_file = g_strdup (filename);
+	if (support_cache_file != NULL)
+		support_cache_load ();
+	g_mutex_unlock (&support_cache_mutex);
+}
+
+/**
+ * xplayer_pl_parser_videosite_cache_flush:
+ *
+ * Saves the changes to the video site support cache which are still
+ * waiting to be written to the file set with
+ * xplayer_pl_parser_videosite_cache_set_file().
+ *
+ * This is a private method, not exposed by the library.
+ **/
+void
+xplayer_pl_parser_videosite_cache_flush (void)
+{
+	g_mutex_lock (&support_cache_mutex);
+	if (support_cache_save_id != 0) {
+		g_source_remove (support_cache_save_id);
+		support_cache_save_id = 0;
+	}
+	g_mutex_unlock (&support_cache_mutex);
+
+	support_cache_save ();
+}
+
+/**
+ * xplayer_pl_parser_videosite_cache_get_stats:
+ * @hits: (out): return location for the number of cache hits
+ * @misses: (out): return location for the number of cache misses
+ *
+ * Gets how often the video site support cache could answer a query.
+ *
+ * This is a private method, not exposed by the library.
+ **/
+void
+xplayer_pl_parser_videosite_cache_get_stats (guint64 *hits,
+					   guint64 *misses)
 {
+	g_mutex_lock (&support_cache_mutex);
+	if (hits != NULL)
+		*hits = support_cache_hits;
+	if (misses != NULL)
+		*misses = support_cache_misses;
+	g_mutex_unlock (&support_cache_mutex);
+}
+
 #ifdef HAVE_QUVI
+
+/* Sites are recognised by their host and the start of the path,
+ * eg. "www.youtube.com/watch", so that's what we remember */
+static char *
+support_cache_key (const char *uri)
+{
+	const char *host, *end, *at;
+	char *key;
+
+	host = strstr (uri, "://");
+	if (host == NULL)
+		return NULL;
+	host += strlen ("://");
+
+	end = host + strcspn (host, "/?#");
+	at = memchr (host, '@', end - host);
+	if (at != NULL)
+		host = at + 1;
+	if (host == end)
+		return NULL;
+
+	if (*end == '/')
+		end = end + 1 + strcspn (end + 1, "/?#");
+
+	key = g_ascii_strdown (host, end - host);
+
+	return key;
+}
+
+/* Returns %TRUE and sets @supported if we know whether @key is
+ * supported */
+static gboolean
+support_cache_lookup (const char *key,
+		      gboolean *supported)
+{
+	SupportEntry *entry = NULL;
+
+	g_mutex_lock (&support_cache_mutex);
+	if (support_cache != NULL)
+		entry = g_hash_table_lookup (support_cache, key);
+	if (entry != NULL && entry->expires > support_cache_now ()) {
+		*supported = entry->supported;
+		support_cache_hits++;
+	} else {
+		entry = NULL;
+		support_cache_misses++;
+	}
+	g_mutex_unlock (&support_cache_mutex);
+
+	return (entry != NULL);
+}
+
+static gboolean
+support_cache_entry_expired (gpointer key,
+			     gpointer value,
+			     gpointer user_data)
+{
+	SupportEntry *entry = value;
+	gint64 *now = user_data;
+
+	return (entry->expires <= *now);
+}
+
+static void
+support_cache_store (const char *key,
+		     gboolean supported)
+{
+	gint64 now;
+
+	g_mutex_lock (&support_cache_mutex);
+	now = support_cache_now ();
+	if (support_cache != NULL &&
+	    g_hash_table_size (support_cache) >= SUPPORT_CACHE_MAX_ENTRIES) {
+		g_hash_table_foreach_remove (support_cache, support_cache_entry_expired, &now);
+		if (g_hash_table_size (support_cache) >= SUPPORT_CACHE_MAX_ENTRIES)
+			g_hash_table_remove_all (support_cache);
+	}
+	support_cache_insert (key, supported, now + SUPPORT_CACHE_TTL);
+	support_cache_mark_dirty ();
+	g_mutex_unlock (&support_cache_mutex);
+}
+
+/* Number of xplayer-pl-parser-videosite helpers kept running, and
+ * so the number of video sites that can be looked up at once */
+#define NUM_HELPERS 4
+
+typedef struct {
+	GIOChannel *channel;
+	gboolean busy;
+} VideositeHelper;
+
+static GMutex helpers_mutex;
+static GCond helpers_cond;
+static VideositeHelper helpers[NUM_HELPERS];
+
+static void
+videosite_helper_child_setup (gpointer user_data)
+{
+	int fd = GPOINTER_TO_INT (user_data);
+
+	dup2 (fd, STDIN_FILENO);
+	dup2 (fd, STDOUT_FILENO);
+}
+
+/* The helper talks to us over a socket rather than pipes, so that
+ * writing to one that died doesn't raise SIGPIPE in the application */
+static GIOChannel *
+videosite_helper_spawn (gboolean debug)
+{
 	const char *args[] = {
 		LIBEXECDIR "/xplayer-pl-parser-videosite",
-		"--check",
-		"--url",
-		NULL,
+		"--server",
 		NULL
 	};
-	char *out;
-
-	args[3] = uri;
-	g_spawn_sync (NULL,
-		      (char **) args,
-		      NULL,
-		      0,
-		      NULL,
-		      NULL,
-		      &out,
-		      NULL,
-		      NULL,
-		      NULL);
+	GIOChannel *channel;
+	GError *error = NULL;
+	int fds[2];
+
+	if (socketpair (AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, fds) < 0)
+		return NULL;
+
+	if (g_spawn_async (NULL,
+			   (char **) args,
+			   NULL,
+			   0,
+			   videosite_helper_child_setup,
+			   GINT_TO_POINTER (fds[1]),
+			   NULL,
+			   &error) == FALSE) {
+		if (debug)
+			g_print ("Failed to launch the videosite helper: %s\n", error->message);
+		g_error_free (error);
+		close (fds[0]);
+		close (fds[1]);
+		return NULL;
+	}
+	close (fds[1]);
+
+	channel = g_io_channel_unix_new (fds[0]);
+	g_io_channel_set_encoding (channel, NULL, NULL);
+	g_io_channel_set_close_on_unref (channel, TRUE);
+
+	return channel;
+}
+
+static VideositeHelper *
+videosite_helper_acquire (void)
+{
+	VideositeHelper *helper = NULL;
+	guint i;
+
+	g_mutex_lock (&helpers_mutex);
+	while (helper == NULL) {
+		for (i = 0; i < NUM_HELPERS; i++) {
+			if (helpers[i].busy == FALSE) {
+				helper = &helpers[i];
+				helper->busy = TRUE;
+				break;
+			}
+		}
+		if (helper == NULL)
+			g_cond_wait (&helpers_cond, &helpers_mutex);
+	}
+	g_mutex_unlock (&helpers_mutex);
+
+	return helper;
+}
+
+static void
+videosite_helper_release (VideositeHelper *helper)
+{
+	g_mutex_lock (&helpers_mutex);
+	helper->busy = FALSE;
+	g_cond_signal (&helpers_cond);
+	g_mutex_unlock (&helpers_mutex);
+}
+
+static gboolean
+videosite_helper_send (VideositeHelper *helper,
+		       const char *request)
+{
+	gsize len, written = 0;
+	int fd;
+
+	fd = g_io_channel_unix_get_fd (helper->channel);
+	len = strlen (request);
+	while (written < len) {
+		ssize_t ret;
+
+		ret = send (fd, request + written, len - written, MSG_NOSIGNAL);
+		if (ret < 0) {
+			if (errno == EINTR)
+				continue;
+			return FALSE;
+		}
+		written += ret;
+	}
+
+	return TRUE;
+}
+
+static char **
+videosite_helper_receive (VideositeHelper *helper)
+{
+	GPtrArray *lines;
+	char *line;
+
+	lines = g_ptr_array_new ();
+	while (g_io_channel_read_line (helper->channel, &line, NULL, NULL, NULL) == G_IO_STATUS_NORMAL) {
+		g_strchomp (line);
+		if (*line == '\0') {
+			g_free (line);
+			g_ptr_array_add (lines, NULL);
+			return (char **) g_ptr_array_free (lines, FALSE);
+		}
+		g_ptr_array_add (lines, line);
+	}
+
+	/* The helper went away before finishing its reply */
+	g_ptr_array_foreach (lines, (GFunc) g_free, NULL);
+	g_ptr_array_free (lines, TRUE);
+
+	return NULL;
+}
+
+/* Sends "command uri" to one of the helpers, starting it if needed,
+ * and returns the lines of the reply. A helper that crashed or
+ * exited is restarted, and the request tried again once. */
+static char **
+videosite_request (const char *command,
+		   const char *uri,
+		   gboolean debug)
+{
+	VideositeHelper *helper;
+	char *request;
+	char **reply = NULL;
+	guint attempt;
+
+	/* That would be read as more than one request */
+	if (strchr (uri, '\n') != NULL || strchr (uri, '\r') != NULL)
+		return NULL;
+
+	request = g_strdup_printf ("%s %s\n", command, uri);
+	helper = videosite_helper_acquire ();
+
+	for (attempt = 0; attempt < 2 && reply == NULL; attempt++) {
+		if (helper->channel == NULL)
+			helper->channel = videosite_helper_spawn (debug);
+		if (helper->channel == NULL)
+			break;
+
+		if (videosite_helper_send (helper, request) != FALSE)
+			reply = videosite_helper_receive (helper);
+		if (reply == NULL) {
+			if (debug)
+				g_print ("Videosite helper died handling '%s', restarting it\n", uri);
+			g_io_channel_unref (helper->channel);
+			helper->channel = NULL;
+		}
+	}
+
+	videosite_helper_release (helper);
+	g_free (request);
+
+	return reply;
+}
+
+#endif /* HAVE_QUVI */
+
+gboolean
+xplayer_pl_parser_is_videosite (const char *uri, gboolean debug)
+{
+#ifdef HAVE_QUVI
+	char **reply;
+	char *key;
+	gboolean ret;
+
+	key = support_cache_key (uri);
+	if (key != NULL && support_cache_lookup (key, &ret) != FALSE) {
+		if (debug)
+			g_print ("Videosite support for URI '%s' cached as %s\n",
+				 uri, ret ? "true" : "false");
+		g_free (key);
+		return ret;
+	}
+
+	reply = videosite_request ("check", uri, debug);
+	ret = (reply != NULL && g_strcmp0 (reply[0], "TRUE") == 0);
 	if (debug)
 		g_print ("Checking videosite for URI '%s' returned '%s' (%s)\n",
-			 uri, out, g_strcmp0 (out, "TRUE") == 0 ? "true" : "false");
+			 uri, reply ? reply[0] : NULL, ret ? "true" : "false");
+	if (key != NULL && reply != NULL)
+		support_cache_store (key, ret);
+	g_strfreev (reply);
+	g_free (key);
 
-	return (g_strcmp0 (out, "TRUE") == 0);
+	return ret;
 #else
 	return FALSE;
 #endif /* HAVE_QUVI */
@@ -74,49 +555,54 @@ xplayer_pl_parser_add_videosite (XplayerPlParser *parser,
 			       gpointer data)
 {
 #ifdef HAVE_QUVI
-	const char *args[] = {
-		LIBEXECDIR "/xplayer-pl-parser-videosite",
-		"--url",
-		NULL,
-		NULL
-	};
-	char *uri;
-	char *out = NULL;
+	char *uri, *key;
 	char **lines;
 	guint i;
 	GHashTable *ht;
 	char *new_uri = NULL;
+	gboolean supported;
 
 	uri = g_file_get_uri (file);
+	key = support_cache_key (uri);
+
+	/* No need to ask the helper about sites we know it can't handle */
+	if (key != NULL &&
+	    support_cache_lookup (key, &supported) != FALSE &&
+	    supported == FALSE) {
+		if (xplayer_pl_parser_is_debugging_enabled (parser))
+			g_print ("Videosite URI '%s' cached as unsupported\n", uri);
+		g_free (key);
+		g_free (uri);
+		return XPLAYER_PL_PARSER_RESULT_UNHANDLED;
+	}
 
-	args[2] = uri;
-	g_spawn_sync (NULL,
-		      (char **) args,
-		      NULL,
-		      0,
-		      NULL,
-		      NULL,
-		      &out,
-		      NULL,
-		      NULL,
-		      NULL);
+	lines = videosite_request ("parse", uri, xplayer_pl_parser_is_debugging_enabled (parser));
 	if (xplayer_pl_parser_is_debugging_enabled (parser))
-		g_print ("Parsing videosite for URI '%s' returned '%s'\n", uri, out);
+		g_print ("Parsing videosite for URI '%s' returned '%s'\n", uri, lines ? lines[0] : NULL);
+	g_free (uri);
 
-	if (out != NULL) {
-		if (g_str_equal (out, "XPLAYER_PL_PARSER_RESULT_ERROR"))
-			return XPLAYER_PL_PARSER_RESULT_ERROR;
-		if (g_str_equal (out, "XPLAYER_PL_PARSER_RESULT_UNHANDLED"))
-			return XPLAYER_PL_PARSER_RESULT_UNHANDLED;
-	} else {
+	if (lines == NULL) {
 		/* xplayer-pl-parser-videosite failed to launch */
+		g_free (key);
+		return XPLAYER_PL_PARSER_RESULT_ERROR;
+	}
+
+	supported = (g_strcmp0 (lines[0], "XPLAYER_PL_PARSER_RESULT_UNHANDLED") != 0);
+	if (key != NULL)
+		support_cache_store (key, supported);
+	g_free (key);
+
+	if (g_strcmp0 (lines[0], "XPLAYER_PL_PARSER_RESULT_ERROR") == 0) {
+		g_strfreev (lines);
 		return XPLAYER_PL_PARSER_RESULT_ERROR;
 	}
+	if (supported == FALSE) {
+		g_strfreev (lines);
+		return XPLAYER_PL_PARSER_RESULT_UNHANDLED;
+	}
 
 	ht = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
-	lines = g_strsplit (out, "\n", -1);
-	g_free (out);
-	for (i = 0; lines[i] != NULL && *lines[i] != '\0'; i++) {
+	for (i = 0; lines[i] != NULL; i++) {
 		char **line;
 
 		line = g_strsplit (lines[i], "=", 2);
@@ -140,4 +626,3 @@ xplayer_pl_parser_add_videosite (XplayerPlParser *parser,
 }
 
 #endif /* !XPLAYER_PL_PARSER_MINI */
-
@@ -33,6 +33,9 @@ G_BEGIN_DECLS
 #endif /* !XPLAYER_PL_PARSER_MINI */
 
 gboolean xplayer_pl_parser_is_videosite (const char *uri, gboolean debug);
+void xplayer_pl_parser_videosite_cache_set_file (const char *filename);
+void xplayer_pl_parser_videosite_cache_flush (void);
+void xplayer_pl_parser_videosite_cache_get_stats (guint64 *hits, guint64 *misses);
 
 #ifndef XPLAYER_PL_PARSER_MINI
 
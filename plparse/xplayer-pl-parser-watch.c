@@ -0,0 +1,660 @@
+/*
+   The Gnome Library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Library General Public License as
+   published by the Free Software Foundation; either version 2 of the
+   License, or (at your option) any later version.
+
+   The Gnome Library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Library General Public License for more details.
+
+   You should have received a copy of the GNU Library General Public
+   License along with the Gnome Library; see the file COPYING.LIB.  If not,
+   write to the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+   Boston, MA 02110-1301  USA.
+ */
+
+#include "config.h"
+
+#ifndef XPLAYER_PL_PARSER_MINI
+#include <string.h>
+#include <glib.h>
+#include <gio/gio.h>
+
+#include "xplayer-pl-parser.h"
+#include "xplayer-pl-parser-watch.h"
+#include "xplayer-pl-parser-private.h"
+
+/* A watch keeps the tree of directories and playlists found while
+ * parsing the watched URI, with the entries each of them added. The
+ * parsing is done by a private parser, which calls back into the watch
+ * as it enters and leaves each of them. When one changes, only it is
+ * parsed again, reusing the subtrees below it that didn't change, and
+ * the differences are emitted on the watching parser. */
+
+/* Changes closer together than this are handled together */
+#define WATCH_COALESCE_MS 500
+
+typedef struct WatchNode WatchNode;
+
+typedef struct {
+	char *uri;
+	GFileMonitor *monitor; /* NULL if the file can't be monitored */
+	GSList *nodes; /* the nodes for this URI */
+	XplayerPlParserWatch *watch;
+} WatchMonitor;
+
+struct WatchNode {
+	char *uri;
+	WatchNode *parent;
+	GPtrArray *children; /* of WatchNode, NULL once reused elsewhere */
+	GHashTable *entries; /* key = char *uri, value = GHashTable metadata */
+	WatchMonitor *monitor;
+	XplayerPlParserResult result;
+	guint is_dir : 1;
+	guint dirty : 1;
+	guint dirty_below : 1;
+	guint reused : 1;
+};
+
+typedef struct {
+	WatchNode *node;
+	WatchNode *old; /* what node replaces, if anything */
+	GHashTable *old_children; /* key = char *uri, value = index in old->children */
+} WatchFrame;
+
+typedef struct {
+	guint signal;
+	char *uri;
+	GHashTable *metadata;
+} WatchEvent;
+
+enum {
+	EVENT_ADDED,
+	EVENT_CHANGED,
+	EVENT_REMOVED
+};
+
+static const char *event_signals[] = {
+	"entry-added",
+	"entry-changed",
+	"entry-removed"
+};
+
+struct XplayerPlParserWatch {
+	XplayerPlParser *parser; /* not a reference, the parser owns us */
+	XplayerPlParser *recorder;
+	GMainContext *context;
+	WatchNode *root;
+	GHashTable *monitors; /* key = char *uri, value = WatchMonitor */
+	GHashTable *dirty; /* key = char *uri */
+	GSource *flush_source;
+	GQueue events;
+
+	/* While parsing */
+	GSList *stack; /* of WatchFrame */
+	WatchNode *replaced;
+	WatchNode *replacement;
+};
+
+static void watch_monitor_changed (GFileMonitor *monitor,
+				   GFile *file,
+				   GFile *other_file,
+				   GFileMonitorEvent event,
+				   WatchMonitor *wm);
+
+static WatchNode *
+watch_node_new (XplayerPlParserWatch *watch,
+		GFile *file,
+		const char *uri,
+		gboolean is_dir)
+{
+	WatchMonitor *wm;
+	WatchNode *node;
+
+	node = g_new0 (WatchNode, 1);
+	node->uri = g_strdup (uri);
+	node->children = g_ptr_array_new ();
+	node->entries = g_hash_table_new_full (g_str_hash, g_str_equal,
+					       g_free, (GDestroyNotify) g_hash_table_unref);
+	node->result = XPLAYER_PL_PARSER_RESULT_UNHANDLED;
+	node->is_dir = is_dir != FALSE;
+
+	/* Nodes for the same URI share a monitor */
+	wm = g_hash_table_lookup (watch->monitors, uri);
+	if (wm == NULL) {
+		wm = g_new0 (WatchMonitor, 1);
+		wm->uri = g_strdup (uri);
+		wm->watch = watch;
+		if (g_file_is_native (file) != FALSE) {
+			g_main_context_push_thread_default (watch->context);
+			if (is_dir != FALSE)
+				wm->monitor = g_file_monitor_directory (file, G_FILE_MONITOR_NONE, NULL, NULL);
+			else
+				wm->monitor = g_file_monitor_file (file, G_FILE_MONITOR_NONE, NULL, NULL);
+			g_main_context_pop_thread_default (watch->context);
+		}
+		if (wm->monitor != NULL)
+			g_signal_connect (G_OBJECT (wm->monitor), "changed",
+					  G_CALLBACK (watch_monitor_changed), wm);
+		g_hash_table_insert (watch->monitors, wm->uri, wm);
+	}
+	wm->nodes = g_slist_prepend (wm->nodes, node);
+	node->monitor = wm;
+
+	return node;
+}
+
+static void
+watch_node_free (XplayerPlParserWatch *watch, WatchNode *node)
+{
+	WatchMonitor *wm;
+	guint i;
+
+	for (i = 0; i < node->children->len; i++) {
+		WatchNode *child = g_ptr_array_index (node->children, i);
+
+		if (child != NULL)
+			watch_node_free (watch, child);
+	}
+
+	wm = node->monitor;
+	wm->nodes = g_slist_remove (wm->nodes, node);
+	if (wm->nodes == NULL) {
+		if (wm->monitor != NULL) {
+			g_signal_handlers_disconnect_by_func (wm->monitor, watch_monitor_changed, wm);
+			g_file_monitor_cancel (wm->monitor);
+			g_object_unref (wm->monitor);
+		}
+		g_hash_table_remove (watch->monitors, wm->uri);
+		g_free (wm->uri);
+		g_free (wm);
+	}
+
+	g_ptr_array_free (node->children, TRUE);
+	g_hash_table_destroy (node->entries);
+	g_free (node->uri);
+	g_free (node);
+}
+
+/* Adds the entries of @node and below to @entries,
+ * except for the subtrees that were reused */
+static void
+watch_node_collect (WatchNode *node, GHashTable *entries)
+{
+	GHashTableIter iter;
+	gpointer key, value;
+	guint i;
+
+	if (node->reused != FALSE)
+		return;
+
+	g_hash_table_iter_init (&iter, node->entries);
+	while (g_hash_table_iter_next (&iter, &key, &value))
+		g_hash_table_replace (entries, key, value);
+
+	for (i = 0; i < node->children->len; i++) {
+		WatchNode *child = g_ptr_array_index (node->children, i);
+
+		if (child != NULL)
+			watch_node_collect (child, entries);
+	}
+}
+
+/* Clears the marks left by parsing again, which are only on the
+ * new nodes and on the reused ones right below them */
+static void
+watch_node_clear_reused (WatchNode *node)
+{
+	guint i;
+
+	if (node->reused != FALSE) {
+		node->reused = FALSE;
+		return;
+	}
+
+	for (i = 0; i < node->children->len; i++) {
+		WatchNode *child = g_ptr_array_index (node->children, i);
+
+		if (child != NULL)
+			watch_node_clear_reused (child);
+	}
+}
+
+static void
+watch_node_clear_dirty_below (WatchNode *node)
+{
+	guint i;
+
+	if (node->dirty_below == FALSE)
+		return;
+	node->dirty_below = FALSE;
+
+	for (i = 0; i < node->children->len; i++) {
+		WatchNode *child = g_ptr_array_index (node->children, i);
+
+		if (child != NULL)
+			watch_node_clear_dirty_below (child);
+	}
+}
+
+static gboolean
+watch_metadata_equal (GHashTable *a, GHashTable *b)
+{
+	GHashTableIter iter;
+	gpointer key, value;
+
+	if (g_hash_table_size (a) != g_hash_table_size (b))
+		return FALSE;
+
+	g_hash_table_iter_init (&iter, a);
+	while (g_hash_table_iter_next (&iter, &key, &value)) {
+		if (g_strcmp0 (value, g_hash_table_lookup (b, key)) != 0)
+			return FALSE;
+	}
+
+	return TRUE;
+}
+
+static void
+watch_queue_event (XplayerPlParserWatch *watch,
+		   guint signal,
+		   const char *uri,
+		   GHashTable *metadata)
+{
+	WatchEvent *event;
+
+	event = g_new (WatchEvent, 1);
+	event->signal = signal;
+	event->uri = g_strdup (uri);
+	event->metadata = metadata ? g_hash_table_ref (metadata) : NULL;
+	g_queue_push_tail (&watch->events, event);
+}
+
+/* Queues the differences between the entries of @old and @new,
+ * leaving out the subtrees @new took from @old as is */
+static void
+watch_diff (XplayerPlParserWatch *watch, WatchNode *old, WatchNode *new)
+{
+	GHashTable *old_entries, *new_entries;
+	GHashTableIter iter;
+	gpointer key, value;
+
+	old_entries = g_hash_table_new (g_str_hash, g_str_equal);
+	new_entries = g_hash_table_new (g_str_hash, g_str_equal);
+	watch_node_collect (old, old_entries);
+	watch_node_collect (new, new_entries);
+
+	g_hash_table_iter_init (&iter, new_entries);
+	while (g_hash_table_iter_next (&iter, &key, &value)) {
+		GHashTable *old_metadata;
+
+		old_metadata = g_hash_table_lookup (old_entries, key);
+		if (old_metadata == NULL)
+			watch_queue_event (watch, EVENT_ADDED, key, value);
+		else if (watch_metadata_equal (old_metadata, value) == FALSE)
+			watch_queue_event (watch, EVENT_CHANGED, key, value);
+	}
+
+	g_hash_table_iter_init (&iter, old_entries);
+	while (g_hash_table_iter_next (&iter, &key, &value)) {
+		if (g_hash_table_contains (new_entries, key) == FALSE)
+			watch_queue_event (watch, EVENT_REMOVED, key, NULL);
+	}
+
+	g_hash_table_destroy (old_entries);
+	g_hash_table_destroy (new_entries);
+}
+
+static void
+watch_reparse (XplayerPlParserWatch *watch, WatchNode *node)
+{
+	WatchNode *new;
+
+	watch->replaced = node;
+	watch->replacement = NULL;
+	xplayer_pl_parser_parse (watch->recorder, node->uri, FALSE);
+	new = watch->replacement;
+	watch->replaced = NULL;
+	watch->replacement = NULL;
+
+	/* It's gone, or isn't a playlist anymore, keep watching it
+	 * in case it comes back */
+	if (new == NULL) {
+		GFile *file;
+
+		file = g_file_new_for_uri (node->uri);
+		new = watch_node_new (watch, file, node->uri, node->is_dir);
+		g_object_unref (file);
+	}
+
+	new->parent = node->parent;
+	if (node->parent == NULL) {
+		watch->root = new;
+	} else {
+		guint i;
+
+		for (i = 0; i < node->parent->children->len; i++) {
+			if (g_ptr_array_index (node->parent->children, i) == node)
+				g_ptr_array_index (node->parent->children, i) = new;
+		}
+	}
+
+	watch_diff (watch, node, new);
+	watch_node_clear_reused (new);
+	watch_node_free (watch, node);
+}
+
+/* Finds the dirty nodes that have no dirty parent */
+static void
+watch_find_dirty (WatchNode *node, GPtrArray *dirty)
+{
+	guint i;
+
+	if (node->dirty != FALSE) {
+		g_ptr_array_add (dirty, node);
+		return;
+	}
+	if (node->dirty_below == FALSE)
+		return;
+
+	for (i = 0; i < node->children->len; i++) {
+		WatchNode *child = g_ptr_array_index (node->children, i);
+
+		if (child != NULL)
+			watch_find_dirty (child, dirty);
+	}
+}
+
+static gboolean
+watch_flush (XplayerPlParserWatch *watch)
+{
+	XplayerPlParser *parser;
+	GHashTableIter iter;
+	GPtrArray *dirty;
+	WatchEvent *event;
+	gpointer key;
+	GQueue events;
+	guint i;
+
+	g_source_unref (watch->flush_source);
+	watch->flush_source = NULL;
+
+	g_hash_table_iter_init (&iter, watch->dirty);
+	while (g_hash_table_iter_next (&iter, &key, NULL)) {
+		WatchMonitor *wm;
+		GSList *l;
+
+		wm = g_hash_table_lookup (watch->monitors, key);
+		if (wm == NULL)
+			continue;
+		for (l = wm->nodes; l != NULL; l = l->next) {
+			WatchNode *node = l->data;
+
+			node->dirty = TRUE;
+			for (node = node->parent; node != NULL; node = node->parent)
+				node->dirty_below = TRUE;
+		}
+	}
+	g_hash_table_remove_all (watch->dirty);
+
+	dirty = g_ptr_array_new ();
+	watch_find_dirty (watch->root, dirty);
+	for (i = 0; i < dirty->len; i++)
+		watch_reparse (watch, g_ptr_array_index (dirty, i));
+	g_ptr_array_free (dirty, TRUE);
+	watch_node_clear_dirty_below (watch->root);
+
+	/* Nothing of the watch is used once the signals are
+	 * emitted, as a handler might remove it */
+	events = watch->events;
+	g_queue_init (&watch->events);
+	parser = g_object_ref (watch->parser);
+	while ((event = g_queue_pop_head (&events)) != NULL) {
+		if (event->metadata != NULL)
+			g_signal_emit_by_name (parser, event_signals[event->signal], event->uri, event->metadata);
+		else
+			g_signal_emit_by_name (parser, event_signals[event->signal], event->uri);
+		g_free (event->uri);
+		if (event->metadata != NULL)
+			g_hash_table_unref (event->metadata);
+		g_free (event);
+	}
+	g_object_unref (parser);
+
+	return G_SOURCE_REMOVE;
+}
+
+static void
+watch_monitor_changed (GFileMonitor *monitor,
+		       GFile *file,
+		       GFile *other_file,
+		       GFileMonitorEvent event,
+		       WatchMonitor *wm)
+{
+	XplayerPlParserWatch *watch = wm->watch;
+
+	switch (event) {
+	/* Wait for the writer to be done */
+	case G_FILE_MONITOR_EVENT_CHANGED:
+	case G_FILE_MONITOR_EVENT_ATTRIBUTE_CHANGED:
+	case G_FILE_MONITOR_EVENT_PRE_UNMOUNT:
+		return;
+	default:
+		break;
+	}
+
+	g_hash_table_add (watch->dirty, g_strdup (wm->uri));
+	if (watch->flush_source != NULL)
+		return;
+
+	watch->flush_source = g_timeout_source_new (WATCH_COALESCE_MS);
+	g_source_set_callback (watch->flush_source, (GSourceFunc) watch_flush, watch, NULL);
+	g_source_attach (watch->flush_source, watch->context);
+}
+
+/**
+ * xplayer_pl_parser_watch_enter:
+ * @watch: a #XplayerPlParserWatch
+ * @file: the directory or playlist about to be parsed
+ * @mimetype: the MIME type of @file
+ * @result: return location for the result of parsing @file
+ *
+ * Called by the watch's parser before it parses a directory or
+ * playlist. If @file didn't change since it was last parsed, the
+ * entries found then are kept, @result is set to what parsing
+ * returned then, and %FALSE is returned, so that it's skipped.
+ *
+ * This is a private method, not exposed by the library.
+ *
+ * Return value: %TRUE if @file needs parsing
+ **/
+gboolean
+xplayer_pl_parser_watch_enter (XplayerPlParserWatch *watch,
+			     GFile *file,
+			     const char *mimetype,
+			     XplayerPlParserResult *result)
+{
+	WatchFrame *parent, *frame;
+	WatchNode *node, *old;
+	char *uri;
+	guint idx;
+
+	parent = watch->stack ? watch->stack->data : NULL;
+	uri = g_file_get_uri (file);
+
+	old = NULL;
+	idx = 0;
+	if (parent == NULL) {
+		old = watch->replaced;
+	} else if (parent->old_children != NULL) {
+		gpointer value;
+
+		if (g_hash_table_lookup_extended (parent->old_children, uri, NULL, &value) != FALSE) {
+			idx = GPOINTER_TO_UINT (value);
+			old = g_ptr_array_index (parent->old->children, idx);
+		}
+	}
+
+	/* Nothing changed in there, take it as is */
+	if (parent != NULL && old != NULL &&
+	    old->dirty == FALSE && old->dirty_below == FALSE) {
+		g_hash_table_remove (parent->old_children, uri);
+		g_ptr_array_index (parent->old->children, idx) = NULL;
+		old->parent = parent->node;
+		old->reused = TRUE;
+		g_ptr_array_add (parent->node->children, old);
+		*result = old->result;
+		g_free (uri);
+		return FALSE;
+	}
+
+	node = watch_node_new (watch, file, uri, g_strcmp0 (mimetype, DIR_MIME_TYPE) == 0);
+	g_free (uri);
+	if (parent != NULL) {
+		node->parent = parent->node;
+		g_ptr_array_add (parent->node->children, node);
+	} else {
+		watch->replacement = node;
+	}
+
+	frame = g_new0 (WatchFrame, 1);
+	frame->node = node;
+	frame->old = old;
+	if (old != NULL && old->children->len > 0) {
+		guint i;
+
+		frame->old_children = g_hash_table_new (g_str_hash, g_str_equal);
+		for (i = 0; i < old->children->len; i++) {
+			WatchNode *child = g_ptr_array_index (old->children, i);
+
+			if (child != NULL && g_hash_table_contains (frame->old_children, child->uri) == FALSE)
+				g_hash_table_insert (frame->old_children, child->uri, GUINT_TO_POINTER (i));
+		}
+	}
+	watch->stack = g_slist_prepend (watch->stack, frame);
+
+	return TRUE;
+}
+
+/**
+ * xplayer_pl_parser_watch_leave:
+ * @watch: a #XplayerPlParserWatch
+ * @result: the result of parsing the directory or playlist
+ *
+ * Called by the watch's parser once it's done parsing the directory
+ * or playlist passed to the matching xplayer_pl_parser_watch_enter().
+ *
+ * This is a private method, not exposed by the library.
+ **/
+void
+xplayer_pl_parser_watch_leave (XplayerPlParserWatch *watch,
+			     XplayerPlParserResult result)
+{
+	WatchFrame *frame;
+
+	g_return_if_fail (watch->stack != NULL);
+
+	frame = watch->stack->data;
+	watch->stack = g_slist_delete_link (watch->stack, watch->stack);
+
+	frame->node->result = result;
+	if (frame->old_children != NULL)
+		g_hash_table_destroy (frame->old_children);
+	g_free (frame);
+}
+
+/**
+ * xplayer_pl_parser_watch_record:
+ * @watch: a #XplayerPlParserWatch
+ * @uri: the URI of the entry
+ * @metadata: the metadata of the entry
+ *
+ * Called by the watch's parser instead of emitting
+ * #XplayerPlParser::entry-parsed.
+ *
+ * This is a private method, not exposed by the library.
+ **/
+void
+xplayer_pl_parser_watch_record (XplayerPlParserWatch *watch,
+			      const char *uri,
+			      GHashTable *metadata)
+{
+	WatchFrame *frame;
+
+	if (watch->stack == NULL || uri == NULL)
+		return;
+
+	frame = watch->stack->data;
+	g_hash_table_replace (frame->node->entries, g_strdup (uri), g_hash_table_ref (metadata));
+}
+
+/**
+ * xplayer_pl_parser_watch_new:
+ * @parser: the #XplayerPlParser to emit changes on
+ * @uri: the URI of the directory or playlist to watch
+ * @result: return location for the result of parsing @uri
+ *
+ * Parses @uri and starts watching it, and the directories and
+ * playlists below it, for changes.
+ *
+ * This is a private method, not exposed by the library.
+ *
+ * Return value: a new watch, or %NULL if @uri isn't a directory or
+ * playlist that could be parsed
+ **/
+XplayerPlParserWatch *
+xplayer_pl_parser_watch_new (XplayerPlParser *parser,
+			   const char *uri,
+			   XplayerPlParserResult *result)
+{
+	XplayerPlParserWatch *watch;
+
+	watch = g_new0 (XplayerPlParserWatch, 1);
+	watch->parser = parser;
+	watch->context = g_main_context_ref_thread_default ();
+	watch->monitors = g_hash_table_new (g_str_hash, g_str_equal);
+	watch->dirty = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+	g_queue_init (&watch->events);
+	watch->recorder = xplayer_pl_parser_new_for_watch (parser, watch);
+
+	*result = xplayer_pl_parser_parse (watch->recorder, uri, FALSE);
+	watch->root = watch->replacement;
+	watch->replacement = NULL;
+
+	if (watch->root == NULL || *result != XPLAYER_PL_PARSER_RESULT_SUCCESS) {
+		if (*result == XPLAYER_PL_PARSER_RESULT_SUCCESS)
+			*result = XPLAYER_PL_PARSER_RESULT_UNHANDLED;
+		xplayer_pl_parser_watch_free (watch);
+		return NULL;
+	}
+
+	return watch;
+}
+
+void
+xplayer_pl_parser_watch_free (XplayerPlParserWatch *watch)
+{
+	WatchEvent *event;
+
+	if (watch->flush_source != NULL) {
+		g_source_destroy (watch->flush_source);
+		g_source_unref (watch->flush_source);
+	}
+	if (watch->root != NULL)
+		watch_node_free (watch, watch->root);
+	while ((event = g_queue_pop_head (&watch->events)) != NULL) {
+		g_free (event->uri);
+		if (event->metadata != NULL)
+			g_hash_table_unref (event->metadata);
+		g_free (event);
+	}
+	g_object_unref (watch->recorder);
+	g_hash_table_destroy (watch->monitors);
+	g_hash_table_destroy (watch->dirty);
+	g_main_context_unref (watch->context);
+	g_free (watch);
+}
+
+#endif /* !XPLAYER_PL_PARSER_MINI */
@@ -0,0 +1,51 @@
+/*
+   The Gnome Library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Library General Public License as
+   published by the Free Software Foundation; either version 2 of the
+   License, or (at your option) any later version.
+
+   The Gnome Library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Library General Public License for more details.
+
+   You should have received a copy of the GNU Library General Public
+   License along with the Gnome Library; see the file COPYING.LIB.  If not,
+   write to the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+   Boston, MA 02110-1301  USA.
+ */
+
+#ifndef XPLAYER_PL_PARSER_WATCH_H
+#define XPLAYER_PL_PARSER_WATCH_H
+
+G_BEGIN_DECLS
+
+#ifndef XPLAYER_PL_PARSER_MINI
+#include "xplayer-pl-parser.h"
+#include <gio/gio.h>
+
+typedef struct XplayerPlParserWatch XplayerPlParserWatch;
+
+XplayerPlParserWatch *xplayer_pl_parser_watch_new	(XplayerPlParser *parser,
+							 const char *uri,
+							 XplayerPlParserResult *result);
+void xplayer_pl_parser_watch_free			(XplayerPlParserWatch *watch);
+gboolean xplayer_pl_parser_watch_enter		(XplayerPlParserWatch *watch,
+							 GFile *file,
+							 const char *mimetype,
+							 XplayerPlParserResult *result);
+void xplayer_pl_parser_watch_leave			(XplayerPlParserWatch *watch,
+							 XplayerPlParserResult result);
+void xplayer_pl_parser_watch_record		(XplayerPlParserWatch *watch,
+							 const char *uri,
+							 GHashTable *metadata);
+
+/* In xplayer-pl-parser.c */
+XplayerPlParser *xplayer_pl_parser_new_for_watch	(XplayerPlParser *parser,
+							 XplayerPlParserWatch *watch);
+
+#endif /* !XPLAYER_PL_PARSER_MINI */
+
+G_END_DECLS
+
+#endif /* XPLAYER_PL_PARSER_WATCH_H */
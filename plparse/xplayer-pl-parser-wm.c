@@ -77,6 +77,41 @@ xplayer_pl_parser_is_asf (const char *data, gsize len)
 
 #ifndef XPLAYER_PL_PARSER_MINI
 
+/* The element and property names we look for in ASX
+ * documents, sorted case-insensitively */
+#define ASX_VOCABULARY(X) \
+	X (ASX_ABSTRACT, "abstract") \
+	X (ASX_ASX, "asx") \
+	X (ASX_AUTHOR, "author") \
+	X (ASX_BASE, "base") \
+	X (ASX_COPYRIGHT, "copyright") \
+	X (ASX_DURATION, "duration") \
+	X (ASX_ENTRY, "entry") \
+	X (ASX_ENTRYREF, "entryref") \
+	X (ASX_HREF, "href") \
+	X (ASX_MOREINFO, "moreinfo") \
+	X (ASX_NAME, "name") \
+	X (ASX_PARAM, "param") \
+	X (ASX_REF, "ref") \
+	X (ASX_REPEAT, "repeat") \
+	X (ASX_STARTTIME, "starttime") \
+	X (ASX_TITLE, "title") \
+	X (ASX_VALUE, "value")
+
+enum {
+	ASX_UNKNOWN = XML_ID_UNKNOWN,
+	ASX_VOCABULARY (XML_VOCABULARY_ID)
+};
+
+static const char * const asx_names[] = {
+	ASX_VOCABULARY (XML_VOCABULARY_NAME)
+};
+
+static const xml_vocabulary_t asx_vocabulary = {
+	asx_names,
+	G_N_ELEMENTS (asx_names)
+};
+
 static XplayerPlParserResult
 xplayer_pl_parser_add_asf_reference_parser (XplayerPlParser *parser,
 					  GFile *file,
@@ -87,7 +122,7 @@ xplayer_pl_parser_add_asf_reference_parser (XplayerPlParser *parser,
 	char *contents, **lines, *ref;
 	gsize size;
 
-	if (g_file_load_contents (file, NULL, &contents, &size, NULL, NULL) == FALSE)
+	if (xplayer_pl_parser_load_contents (parser, file, parse_data, &contents, &size) == FALSE)
 		return XPLAYER_PL_PARSER_RESULT_ERROR;
 
 	lines = g_strsplit_set (contents, "\n\r", 0);
@@ -134,7 +169,7 @@ xplayer_pl_parser_add_asf_parser (XplayerPlParser *parser,
 		return xplayer_pl_parser_add_asf_reference_parser (parser, file, base_file, parse_data, data);
 	}
 
-	if (g_file_load_contents (file, NULL, &contents, &size, NULL, NULL) == FALSE)
+	if (xplayer_pl_parser_load_contents (parser, file, parse_data, &contents, &size) == FALSE)
 		return XPLAYER_PL_PARSER_RESULT_ERROR;
 
 	if (size <= 4) {
@@ -176,76 +211,57 @@ parse_asx_entry (XplayerPlParser *parser, GFile *base_file, xml_node_t *parent,
 	author = NULL;
 
 	for (node = parent->child; node != NULL; node = node->next) {
-		if (node->name == NULL)
-			continue;
-
-		/* ENTRY can only have one title node but multiple REFs */
-		if (g_ascii_strcasecmp (node->name, "ref") == 0) {
-			const char *tmp;
+		const char *tmp, *value;
 
-			tmp = xml_parser_get_property (node, "href");
-			if (tmp == NULL)
-				continue;
+		switch (node->id) {
+		case ASX_REF:
+			/* ENTRY can only have one title node but multiple REFs */
+			tmp = xml_parser_get_property_by_id (node, ASX_HREF);
 			/* FIXME, should we prefer mms streams, or non-mms?
 			 * See bug #352559 */
-			if (uri == NULL)
+			if (tmp != NULL && uri == NULL)
 				uri = tmp;
-
-			continue;
-		}
-
-		if (g_ascii_strcasecmp (node->name, "title") == 0)
+			break;
+		case ASX_TITLE:
 			title = node->data;
-
-		if (g_ascii_strcasecmp (node->name, "author") == 0)
+			break;
+		case ASX_AUTHOR:
 			author = node->data;
-
-		if (g_ascii_strcasecmp (node->name, "moreinfo") == 0) {
-			const char *tmp;
-
-			tmp = xml_parser_get_property (node, "href");
-			if (tmp == NULL)
-				continue;
-			moreinfo = tmp;
-		}
-
-		if (g_ascii_strcasecmp (node->name, "copyright") == 0)
+			break;
+		case ASX_MOREINFO:
+			tmp = xml_parser_get_property_by_id (node, ASX_HREF);
+			if (tmp != NULL)
+				moreinfo = tmp;
+			break;
+		case ASX_COPYRIGHT:
 			copyright = node->data;
-
-		if (g_ascii_strcasecmp (node->name, "abstract") == 0)
+			break;
+		case ASX_ABSTRACT:
 			abstract = node->data;
-
-		if (g_ascii_strcasecmp (node->name, "duration") == 0) {
-			const char *tmp;
-
-			tmp = xml_parser_get_property (node, "value");
-			if (tmp == NULL)
-				continue;
-			duration = tmp;
-		}
-
-		if (g_ascii_strcasecmp (node->name, "starttime") == 0) {
-			const char *tmp;
-
-			tmp = xml_parser_get_property (node, "value");
-			if (tmp == NULL)
-				continue;
-			starttime = tmp;
-		}
-
-		if (g_ascii_strcasecmp (node->name, "param") == 0) {
-			const char *name, *value;
-
-			name = xml_parser_get_property (node, "name");
-			if (name == NULL || g_ascii_strcasecmp (name, "showwhilebuffering") != 0)
-				continue;
-			value = xml_parser_get_property (node, "value");
+			break;
+		case ASX_DURATION:
+			tmp = xml_parser_get_property_by_id (node, ASX_VALUE);
+			if (tmp != NULL)
+				duration = tmp;
+			break;
+		case ASX_STARTTIME:
+			tmp = xml_parser_get_property_by_id (node, ASX_VALUE);
+			if (tmp != NULL)
+				starttime = tmp;
+			break;
+		case ASX_PARAM:
+			tmp = xml_parser_get_property_by_id (node, ASX_NAME);
+			if (tmp == NULL || g_ascii_strcasecmp (tmp, "showwhilebuffering") != 0)
+				break;
+			value = xml_parser_get_property_by_id (node, ASX_VALUE);
 			if (value == NULL || g_ascii_strcasecmp (value, "true") != 0)
-				continue;
+				break;
 
 			/* We ignore items that are the buffering images */
 			retval = XPLAYER_PL_PARSER_RESULT_IGNORED;
 			goto bail;
+		default:
+			break;
 		}
 	}
 
@@ -285,7 +301,7 @@ parse_asx_entryref (XplayerPlParser *parser, GFile *base_file, xml_node_t *node,
 	GFile *resolved;
 	char *resolved_uri;
 
-	uri = xml_parser_get_property (node, "href");
+	uri = xml_parser_get_property_by_id (node, ASX_HREF);
 
 	if (uri == NULL)
 		return XPLAYER_PL_PARSER_RESULT_ERROR;
@@ -319,9 +335,7 @@ parse_asx_entries (XplayerPlParser *parser, const char *uri, GFile *base_file, x
 
 	/* Loop to look for playlist information first */
 	for (node = parent->child; node != NULL; node = node->next) {
-		if (node->name == NULL)
-			continue;
-		if (g_ascii_strcasecmp (node->name, "title") == 0) {
+		if (node->id == ASX_TITLE) {
 			g_free (title);
 			title = g_strdup (node->data);
 			xplayer_pl_parser_add_uri (parser,
@@ -330,9 +344,9 @@ parse_asx_entries (XplayerPlParser *parser, const char *uri, GFile *base_file, x
 						 XPLAYER_PL_PARSER_FIELD_TITLE, title,
 						 NULL);
 		}
-		if (g_ascii_strcasecmp (node->name, "base") == 0) {
+		if (node->id == ASX_BASE) {
 			const char *str;
-			str = xml_parser_get_property (node, "href");
+			str = xml_parser_get_property_by_id (node, ASX_HREF);
 			if (str != NULL) {
 				if (new_base != NULL)
 					g_object_unref (new_base);
@@ -343,23 +357,24 @@ parse_asx_entries (XplayerPlParser *parser, const char *uri, GFile *base_file, x
 
 	/* Restart for the entries now */
 	for (node = parent->child; node != NULL; node = node->next) {
-		if (node->name == NULL)
-			continue;
-
-		if (g_ascii_strcasecmp (node->name, "entry") == 0) {
+		switch (node->id) {
+		case ASX_ENTRY:
 			/* Whee! found an entry here, find the REF and TITLE */
 			if (parse_asx_entry (parser, new_base ? new_base : base_file, node, parse_data) != FALSE)
 				retval = XPLAYER_PL_PARSER_RESULT_SUCCESS;
-		}
-		if (g_ascii_strcasecmp (node->name, "entryref") == 0) {
+			break;
+		case ASX_ENTRYREF:
 			/* Found an entryref, extract the REF attribute */
 			if (parse_asx_entryref (parser, new_base ? new_base : base_file, node, parse_data) != FALSE)
 				retval = XPLAYER_PL_PARSER_RESULT_SUCCESS;
-		}
-		if (g_ascii_strcasecmp (node->name, "repeat") == 0) {
+			break;
+		case ASX_REPEAT:
 			/* Repeat at the top-level */
 			if (parse_asx_entries (parser, uri, new_base ? new_base : base_file, node, parse_data) != FALSE)
 				retval = XPLAYER_PL_PARSER_RESULT_SUCCESS;
+			break;
+		default:
+			break;
 		}
 	}
 
@@ -388,18 +403,17 @@ xplayer_pl_parser_add_asx (XplayerPlParser *parser,
 		return xplayer_pl_parser_add_ram (parser, file, parse_data, data);
 	}
 
-	if (g_file_load_contents (file, NULL, &contents, &size, NULL, NULL) == FALSE)
+	if (xplayer_pl_parser_load_contents (parser, file, parse_data, &contents, &size) == FALSE)
 		return XPLAYER_PL_PARSER_RESULT_ERROR;
 
-	doc = xplayer_pl_parser_parse_xml_relaxed (contents, size);
+	doc = xplayer_pl_parser_parse_xml_relaxed (contents, size, &asx_vocabulary);
 	if (doc == NULL) {
 		g_free (contents);
 		return XPLAYER_PL_PARSER_RESULT_ERROR;
 	}
 
 	/* If the document has no name */
-	if (doc->name == NULL
-	    || g_ascii_strcasecmp (doc->name , "asx") != 0) {
+	if (doc->id != ASX_ASX) {
 		g_free (contents);
 		xml_parser_free_tree (doc);
 		return XPLAYER_PL_PARSER_RESULT_ERROR;
@@ -28,6 +28,7 @@
 #include <glib/gi18n-lib.h>
 #include <libxml/tree.h>
 #include <libxml/parser.h>
+#include <libxml/xmlreader.h>
 
 #include "xplayer-pl-parser.h"
 #endif /* !XPLAYER_PL_PARSER_MINI */
@@ -41,32 +42,38 @@
 #define SAFE_FREE(x) { if (x != NULL) xmlFree (x); }
 
 static xmlDocPtr
-xplayer_pl_parser_parse_xml_file (GFile *file)
+xplayer_pl_parser_parse_xml_file (XplayerPlParser *parser,
+				GFile *file,
+				XplayerPlParseData *parse_data)
 {
+	XplayerPlParserStage stage;
 	xmlDocPtr doc;
 	char *contents;
 	gsize size;
 
-	if (g_file_load_contents (file, NULL, &contents, &size, NULL, NULL) == FALSE)
+	if (xplayer_pl_parser_load_contents (parser, file, parse_data, &contents, &size) == FALSE)
 		return NULL;
 
-	/* Try to remove HTML style comments */
+	/* Try to remove HTML style comments, resuming the search after
+	 * each one rather than from the start of the file */
 	{
-		char *needle;
-
-		while ((needle = strstr (contents, "<!--")) != NULL) {
-			while (strncmp (needle, "-->", 3) != 0) {
-				*needle = ' ';
-				needle++;
-				if (*needle == '\0')
-					break;
-			}
+		char *needle, *end;
+
+		needle = contents;
+		while ((needle = strstr (needle, "<!--")) != NULL) {
+			end = strstr (needle, "-->");
+			if (end == NULL)
+				end = needle + strlen (needle);
+			memset (needle, ' ', end - needle);
+			needle = end;
 		}
 	}
 
+	stage = xplayer_pl_parser_stage_enter (parse_data, XPLAYER_PL_PARSER_STAGE_XML);
 	doc = xmlParseMemory (contents, size);
 	if (doc == NULL)
 		doc = xmlRecoverMemory (contents, size);
+	xplayer_pl_parser_stage_leave (parse_data, stage);
 	g_free (contents);
 
 	return doc;
@@ -311,6 +318,7 @@ parse_xspf_track (XplayerPlParser *parser, GFile *base_file, xmlDocPtr doc,
 						xmlChar *str;
 						str = xmlNodeListGetString (doc, child->xmlChildrenNode, 0);
 						playing = parse_bool_str ((char *) str) ? (xmlChar *) "true" : NULL;
+						SAFE_FREE (str);
 					} else if (g_ascii_strcasecmp ((char *)child->name, "subtitle") == 0) {
 						subtitle = xmlNodeListGetString (doc, child->xmlChildrenNode, 0);
 					} else if (g_ascii_strcasecmp ((char *)child->name, "mime-type") == 0) {
@@ -418,6 +426,10 @@ bail:
 	SAFE_FREE (download_uri);
 	SAFE_FREE (id);
 	SAFE_FREE (genre);
+	SAFE_FREE (filesize);
+	SAFE_FREE (subtitle);
+	SAFE_FREE (mime_type);
+	SAFE_FREE (starttime);
 
 	return retval;
 }
@@ -451,7 +463,7 @@ parse_xspf_entries (XplayerPlParser *parser,
 {
 	xmlNodePtr node;
 	XplayerPlParserResult retval = XPLAYER_PL_PARSER_RESULT_ERROR;
-	const xmlChar *title;
+	xmlChar *title;
 	char *uri;
 
 	uri = g_file_get_uri (file);
@@ -465,7 +477,7 @@ parse_xspf_entries (XplayerPlParser *parser,
 			continue;
 
 		if (g_ascii_strcasecmp ((char *)node->name, "title") == 0) {
-			title = node->name;
+			title = xmlNodeListGetString (doc, node->xmlChildrenNode, 1);
 			break;
 		}
 	}
@@ -476,6 +488,7 @@ parse_xspf_entries (XplayerPlParser *parser,
 				 XPLAYER_PL_PARSER_FIELD_TITLE, title,
 				 XPLAYER_PL_PARSER_FIELD_CONTENT_TYPE, "application/xspf+xml",
 				 NULL);
+	SAFE_FREE (title);
 
 	for (node = parent->children; node != NULL; node = node->next) {
 		if (node->name == NULL)
@@ -508,6 +521,127 @@ is_xspf_doc (xmlDocPtr doc)
 	return TRUE;
 }
 
+static int
+xspf_stream_read (void *context, char *buffer, int len)
+{
+	XplayerPlParseData *parse_data;
+	XplayerPlParserStage stage;
+	gssize ret;
+
+	parse_data = xplayer_pl_parser_get_parse_data ();
+	stage = xplayer_pl_parser_stage_enter (parse_data, XPLAYER_PL_PARSER_STAGE_LOAD);
+	ret = g_input_stream_read (G_INPUT_STREAM (context), buffer, len, NULL, NULL);
+	xplayer_pl_parser_stage_leave (parse_data, stage);
+	if (parse_data != NULL && ret > 0)
+		parse_data->stats.bytes_read += ret;
+
+	return ret;
+}
+
+static int
+xspf_stream_close (void *context)
+{
+	g_object_unref (context);
+	return 0;
+}
+
+static void
+xspf_playlist_started (XplayerPlParser *parser, const char *uri, xmlChar *title)
+{
+	xplayer_pl_parser_add_uri (parser,
+				 XPLAYER_PL_PARSER_FIELD_IS_PLAYLIST, TRUE,
+				 XPLAYER_PL_PARSER_FIELD_URI, uri,
+				 XPLAYER_PL_PARSER_FIELD_TITLE, title,
+				 XPLAYER_PL_PARSER_FIELD_CONTENT_TYPE, "application/xspf+xml",
+				 NULL);
+}
+
+/* Walks the playlist with a pull parser, expanding and emitting one
+ * <track> at a time, so that memory use is bounded by the size of a
+ * track rather than that of the document. Sets @failed if the document
+ * couldn't be read before anything was emitted, in which case the caller
+ * can still fall back to the more lenient DOM parser. */
+static XplayerPlParserResult
+parse_xspf_reader (XplayerPlParser  *parser,
+		   GFile          *file,
+		   GFile          *base_file,
+		   xmlTextReaderPtr reader,
+		   gboolean       *failed)
+{
+	XplayerPlParserResult retval = XPLAYER_PL_PARSER_RESULT_ERROR;
+	xmlChar *title;
+	char *uri;
+	gboolean started;
+	int ret, depth;
+
+	*failed = FALSE;
+
+	/* Find the root element, which has to be a playlist */
+	while ((ret = xmlTextReaderRead (reader)) == 1 &&
+	       xmlTextReaderNodeType (reader) != XML_READER_TYPE_ELEMENT)
+		;
+	if (ret != 1) {
+		*failed = TRUE;
+		return XPLAYER_PL_PARSER_RESULT_ERROR;
+	}
+	if (g_ascii_strcasecmp ((char *) xmlTextReaderConstLocalName (reader), "playlist") != 0)
+		return XPLAYER_PL_PARSER_RESULT_ERROR;
+
+	uri = g_file_get_uri (file);
+	title = NULL;
+	started = FALSE;
+
+	ret = xmlTextReaderIsEmptyElement (reader) ? 0 : xmlTextReaderRead (reader);
+	while (ret == 1) {
+		const char *name;
+
+		if (xmlTextReaderNodeType (reader) != XML_READER_TYPE_ELEMENT) {
+			ret = xmlTextReaderRead (reader);
+			continue;
+		}
+
+		name = (const char *) xmlTextReaderConstLocalName (reader);
+		depth = xmlTextReaderDepth (reader);
+
+		if (depth == 1 && g_ascii_strcasecmp (name, "trackList") == 0) {
+			/* The title has to come first to be part of the
+			 * playlist-started signal, as for the DOM parser */
+			if (started == FALSE) {
+				xspf_playlist_started (parser, uri, title);
+				started = TRUE;
+			}
+			ret = xmlTextReaderRead (reader);
+		} else if (depth == 1 && started == FALSE && title == NULL &&
+			   g_ascii_strcasecmp (name, "title") == 0) {
+			title = xmlTextReaderReadString (reader);
+			ret = xmlTextReaderNext (reader);
+		} else if (depth == 2 && g_ascii_strcasecmp (name, "track") == 0) {
+			xmlNodePtr node;
+
+			node = xmlTextReaderExpand (reader);
+			if (node != NULL &&
+			    parse_xspf_track (parser, base_file, node->doc, node) != FALSE)
+				retval = XPLAYER_PL_PARSER_RESULT_SUCCESS;
+			ret = xmlTextReaderNext (reader);
+		} else {
+			ret = xmlTextReaderNext (reader);
+		}
+	}
+
+	if (ret < 0 && started == FALSE) {
+		*failed = TRUE;
+	} else {
+		if (started == FALSE)
+			xspf_playlist_started (parser, uri, title);
+		xplayer_pl_parser_playlist_end (parser, uri);
+	}
+
+	SAFE_FREE (title);
+	g_free (uri);
+
+	return retval;
+}
+
 XplayerPlParserResult
 xplayer_pl_parser_add_xspf_with_contents (XplayerPlParser *parser,
 					GFile *file,
@@ -515,13 +649,30 @@ xplayer_pl_parser_add_xspf_with_contents (XplayerPlParser *parser,
 					const char *contents,
 					XplayerPlParseData *parse_data)
 {
+	XplayerPlParserStage stage;
+	xmlTextReaderPtr reader;
 	xmlDocPtr doc;
 	xmlNodePtr node;
 	XplayerPlParserResult retval = XPLAYER_PL_PARSER_RESULT_UNHANDLED;
+	gboolean failed = TRUE;
+
+	stage = xplayer_pl_parser_stage_enter (parse_data, XPLAYER_PL_PARSER_STAGE_XML);
+	reader = xmlReaderForMemory (contents, strlen (contents), NULL, NULL,
+				     XML_PARSE_RECOVER | XML_PARSE_NONET | XML_PARSE_NOERROR | XML_PARSE_NOWARNING);
+	if (reader != NULL) {
+		retval = parse_xspf_reader (parser, file, base_file, reader, &failed);
+		xmlFreeTextReader (reader);
+	}
+	xplayer_pl_parser_stage_leave (parse_data, stage);
+	if (failed == FALSE)
+		return retval;
 
+	retval = XPLAYER_PL_PARSER_RESULT_UNHANDLED;
+	stage = xplayer_pl_parser_stage_enter (parse_data, XPLAYER_PL_PARSER_STAGE_XML);
 	doc = xmlParseMemory (contents, strlen (contents));
 	if (doc == NULL)
 		doc = xmlRecoverMemory (contents, strlen (contents));
+	xplayer_pl_parser_stage_leave (parse_data, stage);
 
 	if (is_xspf_doc (doc) == FALSE) {
 		if (doc != NULL)
@@ -545,11 +696,54 @@ xplayer_pl_parser_add_xspf (XplayerPlParser *parser,
 			  XplayerPlParseData *parse_data,
 			  gpointer data)
 {
+	XplayerPlParserStage stage;
+	GFileInputStream *stream;
+	xmlTextReaderPtr reader;
 	xmlDocPtr doc;
 	xmlNodePtr node;
 	XplayerPlParserResult retval = XPLAYER_PL_PARSER_RESULT_UNHANDLED;
+	gboolean failed = TRUE;
+
+	/* Remote playlists are fetched whole over the parser's own session,
+	 * or through the HTTP cache */
+	if (g_file_has_uri_scheme (file, "http") != FALSE ||
+	    g_file_has_uri_scheme (file, "https") != FALSE) {
+		char *contents;
+		gsize size;
+
+		if (xplayer_pl_parser_load_contents (parser, file, parse_data, &contents, &size) == FALSE)
+			return XPLAYER_PL_PARSER_RESULT_ERROR;
+		retval = xplayer_pl_parser_add_xspf_with_contents (parser, file, base_file, contents, parse_data);
+		g_free (contents);
+		return retval;
+	}
+
+	/* Stream the file first; XSPF libraries can have hundreds of
+	 * thousands of tracks, too many to hold as a DOM */
+	stage = xplayer_pl_parser_stage_enter (parse_data, XPLAYER_PL_PARSER_STAGE_LOAD);
+	stream = g_file_read (file, NULL, NULL);
+	xplayer_pl_parser_stage_leave (parse_data, stage);
+	if (stream != NULL) {
+		char *uri;
+
+		parse_data->stats.files_opened++;
+		stage = xplayer_pl_parser_stage_enter (parse_data, XPLAYER_PL_PARSER_STAGE_XML);
+		uri = g_file_get_uri (file);
+		/* The reader closes the stream, even if it fails */
+		reader = xmlReaderForIO (xspf_stream_read, xspf_stream_close, stream, uri, NULL,
+					 XML_PARSE_RECOVER | XML_PARSE_NONET | XML_PARSE_NOERROR | XML_PARSE_NOWARNING);
+		g_free (uri);
+		if (reader != NULL) {
+			retval = parse_xspf_reader (parser, file, base_file, reader, &failed);
+			xmlFreeTextReader (reader);
+		}
+		xplayer_pl_parser_stage_leave (parse_data, stage);
+	}
+	if (failed == FALSE)
+		return retval;
 
-	doc = xplayer_pl_parser_parse_xml_file (file);
+	retval = XPLAYER_PL_PARSER_RESULT_UNHANDLED;
+	doc = xplayer_pl_parser_parse_xml_file (parser, file, parse_data);
 	if (is_xspf_doc (doc) == FALSE) {
 		if (doc != NULL)
 			xmlFreeDoc(doc);
@@ -132,6 +132,10 @@
 #ifndef XPLAYER_PL_PARSER_MINI
 #include <gobject/gvaluecollector.h>
 
+#ifdef G_OS_UNIX
+#include <sys/mman.h>
+#endif
+
 #ifdef HAVE_GMIME
 #include <gmime/gmime-utils.h>
 #endif
@@ -139,6 +143,9 @@
 #include "xplayer-pl-parser.h"
 #include "xplayerplparser-marshal.h"
 #include "xplayer-disc.h"
+#include "xplayer-pl-parser-cache.h"
+#include "xplayer-pl-parser-result-cache.h"
+#include "xplayer-pl-parser-watch.h"
 #endif /* !XPLAYER_PL_PARSER_MINI */
 
 #include "xplayer-pl-parser-mini.h"
@@ -155,6 +162,7 @@
 #include "xplayer-pl-parser-private.h"
 #include "xplayer-pl-parser-videosite.h"
 #include "xplayer-pl-parser-amz.h"
+#include "xplayer-pl-parser-binary.h"
 
 #define READ_CHUNK_SIZE 8192
 #define RECURSE_LEVEL_MAX 4
@@ -208,6 +216,7 @@ static PlaylistTypes special_types[] = {
 	PLAYLIST_TYPE ("application/rss+xml", xplayer_pl_parser_add_rss, xplayer_pl_parser_is_rss, FALSE),
 	PLAYLIST_TYPE ("text/x-opml+xml", xplayer_pl_parser_add_opml, NULL, FALSE),
 	PLAYLIST_TYPE ("audio/x-amzxml", xplayer_pl_parser_add_amz, NULL, FALSE),
+	PLAYLIST_TYPE (BINARY_PL_MIME_TYPE, xplayer_pl_parser_add_binary, NULL, FALSE),
 #ifndef XPLAYER_PL_PARSER_MINI
 	PLAYLIST_TYPE ("application/x-desktop", xplayer_pl_parser_add_desktop, NULL, TRUE),
 	PLAYLIST_TYPE ("application/x-gnome-app-info", xplayer_pl_parser_add_desktop, NULL, TRUE),
@@ -261,10 +270,31 @@ struct XplayerPlParserPrivate {
 	GMutex ignore_mutex;
 	GThread *main_thread; /* see CALL_ASYNC() in *-private.h */
 
+	guint max_items;
+	guint64 min_date;
+
+	char *cache_dir;
+	guint64 cache_max_size;
+	XplayerPlParserCacheEviction cache_eviction;
+	XplayerPlParserCache *cache;
+	guint http_timeout;
+	guint http_max_conns_per_host;
+	guint directory_workers;
+	SoupSession *session;
+	GMutex http_mutex; /* protects cache, result_cache and session */
+
+	char *result_cache_dir;
+	guint64 result_cache_max_size;
+	XplayerPlParserResultCache *result_cache;
+
+	GHashTable *watches; /* key = char *uri, value = XplayerPlParserWatch */
+	XplayerPlParserWatch *recording; /* set on the parser a watch parses with */
+
 	guint recurse : 1;
 	guint debug : 1;
 	guint force : 1;
 	guint disable_unsafe : 1;
+	guint sort_directories : 1;
 };
 
 enum {
@@ -272,7 +302,18 @@ enum {
 	PROP_RECURSE,
 	PROP_DEBUG,
 	PROP_FORCE,
-	PROP_DISABLE_UNSAFE
+	PROP_DISABLE_UNSAFE,
+	PROP_MAX_ITEMS,
+	PROP_MIN_DATE,
+	PROP_CACHE_DIR,
+	PROP_CACHE_MAX_SIZE,
+	PROP_CACHE_EVICTION,
+	PROP_HTTP_TIMEOUT,
+	PROP_HTTP_MAX_CONNS_PER_HOST,
+	PROP_SORT_DIRECTORIES,
+	PROP_DIRECTORY_WORKERS,
+	PROP_RESULT_CACHE_DIR,
+	PROP_RESULT_CACHE_MAX_SIZE
 };
 
 /* Signals */
@@ -280,12 +321,24 @@ enum {
 	ENTRY_PARSED,
 	PLAYLIST_STARTED,
 	PLAYLIST_ENDED,
+	ENTRY_ADDED,
+	ENTRY_CHANGED,
+	ENTRY_REMOVED,
+	PARSE_STATS,
 	LAST_SIGNAL
 };
 
 static int xplayer_pl_parser_table_signals[LAST_SIGNAL];
 static GParamSpecPool *xplayer_pl_parser_pspec_pool = NULL;
 
+/* The data of the parse operation running in this thread, for the code
+ * which isn't passed it, see xplayer_pl_parser_get_parse_data() */
+static GPrivate xplayer_pl_parser_parse_data = G_PRIVATE_INIT (NULL);
+
+/* Where xplayer_pl_parser_parse_get_stats() finds the stats of an
+ * asynchronous parse operation */
+#define PARSE_STATS_KEY "xplayer-pl-parser-stats"
+
 static void xplayer_pl_parser_class_init (XplayerPlParserClass *klass);
 static void xplayer_pl_parser_base_class_finalize	(XplayerPlParserClass *klass);
 static void xplayer_pl_parser_init       (XplayerPlParser *parser);
@@ -390,6 +443,180 @@ xplayer_pl_parser_class_init (XplayerPlParserClass *klass)
 							       FALSE,
 							       G_PARAM_READWRITE));
 
+	/**
+	 * XplayerPlParser:max-items:
+	 *
+	 * The maximum number of entries to add from a podcast feed, or 0 for
+	 * no limit. Entries are counted in the order the feed lists them, and
+	 * parsing stops as soon as the limit is reached, so these are the
+	 * newest entries only for feeds that list their newest entries first,
+	 * as most do. Entries are not sorted by date.
+	 **/
+	g_object_class_install_property (object_class,
+					 PROP_MAX_ITEMS,
+					 g_param_spec_uint ("max-items",
+							    "max-items",
+							    "Maximum number of podcast feed entries to add",
+							    0, G_MAXUINT, 0,
+							    G_PARAM_READWRITE));
+
+	/**
+	 * XplayerPlParser:min-date:
+	 *
+	 * If non-zero, podcast feed entries published before this date, in
+	 * seconds since the UNIX Epoch, are skipped. Entries without a valid
+	 * publication date are always added. Parsing stops once a few entries
+	 * in a row are too old, unless the feed turns out not to list its
+	 * entries newest first.
+	 **/
+	g_object_class_install_property (object_class,
+					 PROP_MIN_DATE,
+					 g_param_spec_uint64 ("min-date",
+							      "min-date",
+							      "Publication date of the oldest podcast feed entries to add",
+							      0, G_MAXUINT64, 0,
+							      G_PARAM_READWRITE));
+
+	/**
+	 * XplayerPlParser:cache-dir:
+	 *
+	 * If set, remote playlists and feeds fetched over HTTP are kept in this
+	 * directory along with their ETag and Last-Modified headers. Parsing
+	 * them again only re-downloads them if the server says they changed,
+	 * otherwise the cached copy is used.
+	 **/
+	g_object_class_install_property (object_class,
+					 PROP_CACHE_DIR,
+					 g_param_spec_string ("cache-dir",
+							      "cache-dir",
+							      "Directory in which to cache remote playlists",
+							      NULL,
+							      G_PARAM_READWRITE));
+
+	/**
+	 * XplayerPlParser:cache-max-size:
+	 *
+	 * The maximum size in bytes of the playlists kept in
+	 * #XplayerPlParser:cache-dir, or 0 for no limit. Entries are removed
+	 * according to #XplayerPlParser:cache-eviction once the limit is
+	 * exceeded.
+	 **/
+	g_object_class_install_property (object_class,
+					 PROP_CACHE_MAX_SIZE,
+					 g_param_spec_uint64 ("cache-max-size",
+							      "cache-max-size",
+							      "Maximum size of the remote playlist cache",
+							      0, G_MAXUINT64, 16 * 1024 * 1024,
+							      G_PARAM_READWRITE | G_PARAM_CONSTRUCT));
+
+	/**
+	 * XplayerPlParser:cache-eviction:
+	 *
+	 * Which entries to remove first when the cache grows beyond
+	 * #XplayerPlParser:cache-max-size.
+	 **/
+	g_object_class_install_property (object_class,
+					 PROP_CACHE_EVICTION,
+					 g_param_spec_enum ("cache-eviction",
+							    "cache-eviction",
+							    "Eviction policy of the remote playlist cache",
+							    XPLAYER_TYPE_PL_PARSER_CACHE_EVICTION,
+							    XPLAYER_PL_PARSER_CACHE_EVICTION_LRU,
+							    G_PARAM_READWRITE));
+
+	/**
+	 * XplayerPlParser:http-timeout:
+	 *
+	 * The number of seconds after which HTTP requests made by the parser
+	 * itself, such as for podcast feeds or the cache, are given up on
+	 * if the server doesn't answer, or 0 to wait forever.
+	 **/
+	g_object_class_install_property (object_class,
+					 PROP_HTTP_TIMEOUT,
+					 g_param_spec_uint ("http-timeout",
+							    "http-timeout",
+							    "Timeout in seconds for HTTP requests",
+							    0, G_MAXUINT, 0,
+							    G_PARAM_READWRITE));
+
+	/**
+	 * XplayerPlParser:http-max-conns-per-host:
+	 *
+	 * The maximum number of connections the parser keeps open to a single
+	 * host. Connections are reused across requests and parse operations
+	 * of the same #XplayerPlParser.
+	 **/
+	g_object_class_install_property (object_class,
+					 PROP_HTTP_MAX_CONNS_PER_HOST,
+					 g_param_spec_uint ("http-max-conns-per-host",
+							    "http-max-conns-per-host",
+							    "Maximum number of HTTP connections to a single host",
+							    1, G_MAXUINT, 2,
+							    G_PARAM_READWRITE | G_PARAM_CONSTRUCT));
+
+	/**
+	 * XplayerPlParser:sort-directories:
+	 *
+	 * If %TRUE, the entries of a directory are added in the order a file
+	 * manager would list them. Otherwise, they're added in whatever order
+	 * the file system returns them, as they're read, which gets the
+	 * first entries out much sooner for huge directories.
+	 **/
+	g_object_class_install_property (object_class,
+					 PROP_SORT_DIRECTORIES,
+					 g_param_spec_boolean ("sort-directories",
+							       "sort-directories",
+							       "Whether or not to sort the entries of directories",
+							       TRUE,
+							       G_PARAM_READWRITE | G_PARAM_CONSTRUCT));
+
+	/**
+	 * XplayerPlParser:directory-workers:
+	 *
+	 * The number of threads listing subdirectories ahead of the parser
+	 * when parsing sorted directories recursively. The entries are still
+	 * added in the same order. Set it to 1 to list directories one at
+	 * a time, as they're reached.
+	 **/
+	g_object_class_install_property (object_class,
+					 PROP_DIRECTORY_WORKERS,
+					 g_param_spec_uint ("directory-workers",
+							    "directory-workers",
+							    "Number of threads listing directories",
+							    1, 64, 4,
+							    G_PARAM_READWRITE | G_PARAM_CONSTRUCT));
+
+	/**
+	 * XplayerPlParser:result-cache-dir:
+	 *
+	 * If set, the entries local playlists are parsed into are kept in
+	 * this directory. Parsing a playlist again replays its entries
+	 * without reading it, as long as neither it nor the local files it
+	 * pulled in changed, and the parser options are the same.
+	 **/
+	g_object_class_install_property (object_class,
+					 PROP_RESULT_CACHE_DIR,
+					 g_param_spec_string ("result-cache-dir",
+							      "result-cache-dir",
+							      "Directory in which to cache the entries of local playlists",
+							      NULL,
+							      G_PARAM_READWRITE));
+
+	/**
+	 * XplayerPlParser:result-cache-max-size:
+	 *
+	 * The maximum size in bytes of the entries kept in
+	 * #XplayerPlParser:result-cache-dir, or 0 for no limit. The least
+	 * recently used playlists are removed first once the limit is exceeded.
+	 **/
+	g_object_class_install_property (object_class,
+					 PROP_RESULT_CACHE_MAX_SIZE,
+					 g_param_spec_uint64 ("result-cache-max-size",
+							      "result-cache-max-size",
+							      "Maximum size of the playlist entries cache",
+							      0, G_MAXUINT64, 16 * 1024 * 1024,
+							      G_PARAM_READWRITE | G_PARAM_CONSTRUCT));
+
 	/**
 	 * XplayerPlParser::entry-parsed:
 	 * @parser: the object which received the signal
@@ -443,6 +670,73 @@ xplayer_pl_parser_class_init (XplayerPlParserClass *klass)
 			      NULL, NULL,
 			      g_cclosure_marshal_VOID__STRING,
 			      G_TYPE_NONE, 1, G_TYPE_STRING);
+	/**
+	 * XplayerPlParser::entry-added:
+	 * @parser: the object which received the signal
+	 * @uri: the URI of the entry added
+	 * @metadata: (type GHashTable) (element-type utf8 utf8): a #GHashTable of metadata relating to the entry added
+	 *
+	 * The ::entry-added signal is emitted when an entry appears in a
+	 * directory or playlist watched with xplayer_pl_parser_watch().
+	 */
+	xplayer_pl_parser_table_signals[ENTRY_ADDED] =
+		g_signal_new ("entry-added",
+			      G_TYPE_FROM_CLASS (klass),
+			      G_SIGNAL_RUN_LAST,
+			      0,
+			      NULL, NULL,
+			      _xplayerplparser_marshal_VOID__STRING_BOXED,
+			      G_TYPE_NONE, 2, G_TYPE_STRING, XPLAYER_TYPE_PL_PARSER_METADATA);
+	/**
+	 * XplayerPlParser::entry-changed:
+	 * @parser: the object which received the signal
+	 * @uri: the URI of the entry changed
+	 * @metadata: (type GHashTable) (element-type utf8 utf8): a #GHashTable of the new metadata relating to the entry
+	 *
+	 * The ::entry-changed signal is emitted when the metadata of an
+	 * entry in a directory or playlist watched with
+	 * xplayer_pl_parser_watch() changes.
+	 */
+	xplayer_pl_parser_table_signals[ENTRY_CHANGED] =
+		g_signal_new ("entry-changed",
+			      G_TYPE_FROM_CLASS (klass),
+			      G_SIGNAL_RUN_LAST,
+			      0,
+			      NULL, NULL,
+			      _xplayerplparser_marshal_VOID__STRING_BOXED,
+			      G_TYPE_NONE, 2, G_TYPE_STRING, XPLAYER_TYPE_PL_PARSER_METADATA);
+	/**
+	 * XplayerPlParser::entry-removed:
+	 * @parser: the object which received the signal
+	 * @uri: the URI of the entry removed
+	 *
+	 * The ::entry-removed signal is emitted when an entry disappears
+	 * from a directory or playlist watched with xplayer_pl_parser_watch().
+	 */
+	xplayer_pl_parser_table_signals[ENTRY_REMOVED] =
+		g_signal_new ("entry-removed",
+			      G_TYPE_FROM_CLASS (klass),
+			      G_SIGNAL_RUN_LAST,
+			      0,
+			      NULL, NULL,
+			      g_cclosure_marshal_VOID__STRING,
+			      G_TYPE_NONE, 1, G_TYPE_STRING);
+	/**
+	 * XplayerPlParser::parse-stats:
+	 * @parser: the object which received the signal
+	 * @stats: a #XplayerPlParserStats of what the parse operation cost
+	 *
+	 * The ::parse-stats signal is emitted when a parse operation is
+	 * finished, after the signals for all the entries it found.
+	 */
+	xplayer_pl_parser_table_signals[PARSE_STATS] =
+		g_signal_new ("parse-stats",
+			      G_TYPE_FROM_CLASS (klass),
+			      G_SIGNAL_RUN_LAST,
+			      0,
+			      NULL, NULL,
+			      g_cclosure_marshal_VOID__BOXED,
+			      G_TYPE_NONE, 1, XPLAYER_TYPE_PL_PARSER_STATS);
 
 	/* param specs */
 	xplayer_pl_parser_pspec_pool = g_param_spec_pool_new (FALSE);
@@ -587,6 +881,53 @@ xplayer_pl_parser_base_class_finalize (XplayerPlParserClass *klass)
 	g_list_free (list);
 }
 
+/* The cache is shared with the parse operations already running, which
+ * hold their own reference, so replace it rather than changing it */
+static void
+xplayer_pl_parser_update_cache (XplayerPlParser *parser)
+{
+	XplayerPlParserCache *cache = NULL;
+
+	if (parser->priv->cache_dir != NULL)
+		cache = xplayer_pl_parser_cache_new (parser->priv->cache_dir,
+						   parser->priv->cache_max_size,
+						   parser->priv->cache_eviction);
+
+	g_mutex_lock (&parser->priv->http_mutex);
+	if (parser->priv->cache != NULL)
+		xplayer_pl_parser_cache_unref (parser->priv->cache);
+	parser->priv->cache = cache;
+	g_mutex_unlock (&parser->priv->http_mutex);
+}
+
+static void
+xplayer_pl_parser_update_session (XplayerPlParser *parser)
+{
+	g_mutex_lock (&parser->priv->http_mutex);
+	if (parser->priv->session != NULL)
+		g_object_set (parser->priv->session,
+			      SOUP_SESSION_TIMEOUT, parser->priv->http_timeout,
+			      SOUP_SESSION_MAX_CONNS_PER_HOST, parser->priv->http_max_conns_per_host,
+			      NULL);
+	g_mutex_unlock (&parser->priv->http_mutex);
+}
+
+static void
+xplayer_pl_parser_update_result_cache (XplayerPlParser *parser)
+{
+	XplayerPlParserResultCache *cache = NULL;
+
+	if (parser->priv->result_cache_dir != NULL)
+		cache = xplayer_pl_parser_result_cache_new (parser->priv->result_cache_dir,
+							  parser->priv->result_cache_max_size);
+
+	g_mutex_lock (&parser->priv->http_mutex);
+	if (parser->priv->result_cache != NULL)
+		xplayer_pl_parser_result_cache_unref (parser->priv->result_cache);
+	parser->priv->result_cache = cache;
+	g_mutex_unlock (&parser->priv->http_mutex);
+}
+
 static void
 xplayer_pl_parser_set_property (GObject *object,
 			      guint prop_id,
@@ -609,6 +950,48 @@ xplayer_pl_parser_set_property (GObject *object,
 	case PROP_DISABLE_UNSAFE:
 		parser->priv->disable_unsafe = g_value_get_boolean (value) != FALSE;
 		break;
+	case PROP_MAX_ITEMS:
+		parser->priv->max_items = g_value_get_uint (value);
+		break;
+	case PROP_MIN_DATE:
+		parser->priv->min_date = g_value_get_uint64 (value);
+		break;
+	case PROP_CACHE_DIR:
+		g_free (parser->priv->cache_dir);
+		parser->priv->cache_dir = g_value_dup_string (value);
+		xplayer_pl_parser_update_cache (parser);
+		break;
+	case PROP_CACHE_MAX_SIZE:
+		parser->priv->cache_max_size = g_value_get_uint64 (value);
+		xplayer_pl_parser_update_cache (parser);
+		break;
+	case PROP_CACHE_EVICTION:
+		parser->priv->cache_eviction = g_value_get_enum (value);
+		xplayer_pl_parser_update_cache (parser);
+		break;
+	case PROP_HTTP_TIMEOUT:
+		parser->priv->http_timeout = g_value_get_uint (value);
+		xplayer_pl_parser_update_session (parser);
+		break;
+	case PROP_HTTP_MAX_CONNS_PER_HOST:
+		parser->priv->http_max_conns_per_host = g_value_get_uint (value);
+		xplayer_pl_parser_update_session (parser);
+		break;
+	case PROP_SORT_DIRECTORIES:
+		parser->priv->sort_directories = g_value_get_boolean (value) != FALSE;
+		break;
+	case PROP_DIRECTORY_WORKERS:
+		parser->priv->directory_workers = g_value_get_uint (value);
+		break;
+	case PROP_RESULT_CACHE_DIR:
+		g_free (parser->priv->result_cache_dir);
+		parser->priv->result_cache_dir = g_value_dup_string (value);
+		xplayer_pl_parser_update_result_cache (parser);
+		break;
+	case PROP_RESULT_CACHE_MAX_SIZE:
+		parser->priv->result_cache_max_size = g_value_get_uint64 (value);
+		xplayer_pl_parser_update_result_cache (parser);
+		break;
 	default:
 		G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
 		break;
@@ -637,6 +1020,39 @@ xplayer_pl_parser_get_property (GObject *object,
 	case PROP_DISABLE_UNSAFE:
 		g_value_set_boolean (value, parser->priv->disable_unsafe);
 		break;
+	case PROP_MAX_ITEMS:
+		g_value_set_uint (value, parser->priv->max_items);
+		break;
+	case PROP_MIN_DATE:
+		g_value_set_uint64 (value, parser->priv->min_date);
+		break;
+	case PROP_CACHE_DIR:
+		g_value_set_string (value, parser->priv->cache_dir);
+		break;
+	case PROP_CACHE_MAX_SIZE:
+		g_value_set_uint64 (value, parser->priv->cache_max_size);
+		break;
+	case PROP_CACHE_EVICTION:
+		g_value_set_enum (value, parser->priv->cache_eviction);
+		break;
+	case PROP_HTTP_TIMEOUT:
+		g_value_set_uint (value, parser->priv->http_timeout);
+		break;
+	case PROP_HTTP_MAX_CONNS_PER_HOST:
+		g_value_set_uint (value, parser->priv->http_max_conns_per_host);
+		break;
+	case PROP_SORT_DIRECTORIES:
+		g_value_set_boolean (value, parser->priv->sort_directories);
+		break;
+	case PROP_DIRECTORY_WORKERS:
+		g_value_set_uint (value, parser->priv->directory_workers);
+		break;
+	case PROP_RESULT_CACHE_DIR:
+		g_value_set_string (value, parser->priv->result_cache_dir);
+		break;
+	case PROP_RESULT_CACHE_MAX_SIZE:
+		g_value_set_uint64 (value, parser->priv->result_cache_max_size);
+		break;
 	default:
 		G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
 		break;
@@ -713,8 +1129,13 @@ emit_playlist_ended_signal (PlaylistEndedSignalData *data)
 void
 xplayer_pl_parser_playlist_end (XplayerPlParser *parser, const char *playlist_uri)
 {
+	XplayerPlParseData *parse_data;
 	PlaylistEndedSignalData *data;
 
+	parse_data = xplayer_pl_parser_get_parse_data ();
+	if (parse_data != NULL && parse_data->result_record != NULL)
+		xplayer_pl_parser_result_record_end (parse_data->result_record, playlist_uri);
+
 	data = g_new (PlaylistEndedSignalData, 1);
 	data->parser = g_object_ref (parser);
 	data->playlist_uri = g_strdup (playlist_uri);
@@ -722,9 +1143,521 @@ xplayer_pl_parser_playlist_end (XplayerPlParser *parser, const char *playlist_ur
 	CALL_ASYNC (parser, emit_playlist_ended_signal, data);
 }
 
+/**
+ * xplayer_pl_parser_get_session:
+ * @parser: a #XplayerPlParser
+ *
+ * Returns the #SoupSession shared by all the HTTP requests @parser makes
+ * itself, so that connections to a host are kept alive and reused between
+ * requests. The session is safe to use from the parsing threads.
+ * This is a private method, not exposed by the library.
+ *
+ * Return value: (transfer full): a #SoupSession
+ **/
+SoupSession *
+xplayer_pl_parser_get_session (XplayerPlParser *parser)
+{
+	SoupSession *session;
+
+	g_mutex_lock (&parser->priv->http_mutex);
+	if (parser->priv->session == NULL) {
+		parser->priv->session = soup_session_new_with_options (
+		    SOUP_SESSION_ADD_FEATURE_BY_TYPE, SOUP_TYPE_CONTENT_DECODER,
+		    SOUP_SESSION_ACCEPT_LANGUAGE_AUTO, TRUE,
+		    SOUP_SESSION_TIMEOUT, parser->priv->http_timeout,
+		    SOUP_SESSION_MAX_CONNS_PER_HOST, parser->priv->http_max_conns_per_host,
+		    NULL);
+	}
+	session = g_object_ref (parser->priv->session);
+	g_mutex_unlock (&parser->priv->http_mutex);
+
+	return session;
+}
+
+/**
+ * xplayer_pl_parser_get_parse_data:
+ *
+ * Returns the data of the parse operation running in the current thread,
+ * for the code which isn't passed it, such as xplayer_pl_parser_add_uri().
+ * This is a private method, not exposed by the library.
+ *
+ * Return value: the #XplayerPlParseData, or %NULL when not parsing
+ **/
+XplayerPlParseData *
+xplayer_pl_parser_get_parse_data (void)
+{
+	return g_private_get (&xplayer_pl_parser_parse_data);
+}
+
+/* Adds the time since the last change of stage to the current one */
+static void
+xplayer_pl_parser_stage_account (XplayerPlParseData *parse_data, gint64 now)
+{
+	XplayerPlParserStats *stats = &parse_data->stats;
+	gint64 elapsed;
+
+	elapsed = now - parse_data->stage_start;
+	parse_data->stage_start = now;
+
+	switch (parse_data->stage) {
+	case XPLAYER_PL_PARSER_STAGE_PARSE:
+		stats->parse_time += elapsed;
+		break;
+	case XPLAYER_PL_PARSER_STAGE_SNIFF:
+		stats->sniff_time += elapsed;
+		break;
+	case XPLAYER_PL_PARSER_STAGE_LOAD:
+		stats->load_time += elapsed;
+		break;
+	case XPLAYER_PL_PARSER_STAGE_XML:
+		stats->xml_time += elapsed;
+		break;
+	case XPLAYER_PL_PARSER_STAGE_RESOLVE:
+		stats->resolve_time += elapsed;
+		break;
+	case XPLAYER_PL_PARSER_STAGE_DISPATCH:
+		stats->dispatch_time += elapsed;
+		break;
+	default:
+		g_assert_not_reached ();
+	}
+}
+
+/**
+ * xplayer_pl_parser_stage_enter:
+ * @parse_data: (allow-none): the #XplayerPlParseData for the current parse operation, or %NULL
+ * @stage: the #XplayerPlParserStage starting
+ *
+ * Charges the time spent from now on to @stage in the stats of the
+ * parse operation, until xplayer_pl_parser_stage_leave() is called with
+ * the stage returned. Stages can be nested, only the innermost one is
+ * charged. This is a private method, not exposed by the library.
+ *
+ * Return value: the previous stage, to pass to xplayer_pl_parser_stage_leave()
+ **/
+XplayerPlParserStage
+xplayer_pl_parser_stage_enter (XplayerPlParseData *parse_data,
+			     XplayerPlParserStage stage)
+{
+	XplayerPlParserStage previous;
+
+	if (parse_data == NULL)
+		return XPLAYER_PL_PARSER_STAGE_PARSE;
+
+	previous = parse_data->stage;
+	if (stage != previous) {
+		xplayer_pl_parser_stage_account (parse_data, g_get_monotonic_time ());
+		parse_data->stage = stage;
+	}
+
+	return previous;
+}
+
+/**
+ * xplayer_pl_parser_stage_leave:
+ * @parse_data: (allow-none): the #XplayerPlParseData for the current parse operation, or %NULL
+ * @previous: the stage returned by xplayer_pl_parser_stage_enter()
+ *
+ * Goes back to the stage the parse operation was in before the matching
+ * xplayer_pl_parser_stage_enter(). This is a private method, not exposed by the library.
+ **/
+void
+xplayer_pl_parser_stage_leave (XplayerPlParseData *parse_data,
+			     XplayerPlParserStage previous)
+{
+	if (parse_data == NULL || parse_data->stage == previous)
+		return;
+
+	xplayer_pl_parser_stage_account (parse_data, g_get_monotonic_time ());
+	parse_data->stage = previous;
+}
+
+/**
+ * xplayer_pl_parser_uses_cache:
+ * @parse_data: the #XplayerPlParseData for the current parse operation
+ * @file: a #GFile
+ *
+ * Returns whether @file is loaded through the HTTP cache set up with
+ * #XplayerPlParser:cache-dir. This is a private method, not exposed by the library.
+ *
+ * Return value: %TRUE if xplayer_pl_parser_load_contents() will use the cache for @file
+ **/
+gboolean
+xplayer_pl_parser_uses_cache (XplayerPlParseData *parse_data, GFile *file)
+{
+	return (parse_data->cache != NULL &&
+		xplayer_pl_parser_cache_handles (parse_data->cache, file) != FALSE);
+}
+
+static gboolean
+xplayer_pl_parser_fetch_cached (XplayerPlParser *parser,
+			      GFile *file,
+			      XplayerPlParseData *parse_data,
+			      char **contents,
+			      gsize *size)
+{
+	SoupSession *session;
+	gboolean ret;
+
+	if (xplayer_pl_parser_uses_cache (parse_data, file) == FALSE)
+		return FALSE;
+
+	session = xplayer_pl_parser_get_session (parser);
+	ret = xplayer_pl_parser_cache_load (parse_data->cache, session, file, contents, size,
+					  parser->priv->debug);
+	g_object_unref (session);
+
+	parse_data->stats.http_requests++;
+	if (ret != FALSE)
+		parse_data->stats.bytes_read += *size;
+
+	return ret;
+}
+
+static gboolean
+xplayer_pl_parser_file_is_http (GFile *file)
+{
+	return (g_file_has_uri_scheme (file, "http") != FALSE ||
+		g_file_has_uri_scheme (file, "https") != FALSE);
+}
+
+/* Loads remote files with our own session rather than through gvfs,
+ * reusing the connection opened to sniff them */
+static gboolean
+xplayer_pl_parser_load_http (XplayerPlParser *parser,
+			   GFile *file,
+			   XplayerPlParseData *parse_data,
+			   char **contents,
+			   gsize *size)
+{
+	SoupSession *session;
+	SoupMessage *msg;
+	char *uri;
+	gboolean ret = FALSE;
+
+	if (xplayer_pl_parser_file_is_http (file) == FALSE)
+		return FALSE;
+
+	uri = g_file_get_uri (file);
+	msg = soup_message_new (SOUP_METHOD_GET, uri);
+	if (msg == NULL) {
+		g_free (uri);
+		return FALSE;
+	}
+
+	session = xplayer_pl_parser_get_session (parser);
+	soup_session_send_message (session, msg);
+	parse_data->stats.http_requests++;
+	if (SOUP_STATUS_IS_SUCCESSFUL (msg->status_code)) {
+		*size = msg->response_body->length;
+		*contents = g_malloc (*size + 1);
+		memcpy (*contents, msg->response_body->data, *size);
+		(*contents)[*size] = '\0';
+		parse_data->stats.bytes_read += *size;
+		ret = TRUE;
+	} else {
+		DEBUG1(g_print ("URI '%s' couldn't be loaded: %d %s\n", uri, msg->status_code, msg->reason_phrase));
+	}
+
+	g_object_unref (msg);
+	g_object_unref (session);
+	g_free (uri);
+
+	return ret;
+}
+
+/**
+ * xplayer_pl_parser_load_contents:
+ * @parser: a #XplayerPlParser
+ * @file: the #GFile to load
+ * @parse_data: the #XplayerPlParseData for the current parse operation
+ * @contents: return location for the NUL-terminated contents of @file
+ * @size: return location for the length of @contents
+ *
+ * Loads the contents of @file, like g_file_load_contents(), going through
+ * the HTTP cache if one was set up with #XplayerPlParser:cache-dir.
+ * This is a private method, not exposed by the library.
+ *
+ * Return value: %TRUE if @file was loaded
+ **/
+gboolean
+xplayer_pl_parser_load_contents (XplayerPlParser *parser,
+			       GFile *file,
+			       XplayerPlParseData *parse_data,
+			       char **contents,
+			       gsize *size)
+{
+	XplayerPlParserStage stage;
+	gboolean ret;
+
+	stage = xplayer_pl_parser_stage_enter (parse_data, XPLAYER_PL_PARSER_STAGE_LOAD);
+
+	if (xplayer_pl_parser_fetch_cached (parser, file, parse_data, contents, size) != FALSE) {
+		ret = TRUE;
+	} else if (xplayer_pl_parser_load_http (parser, file, parse_data, contents, size) != FALSE) {
+		ret = TRUE;
+	} else {
+		ret = g_file_load_contents (file, NULL, contents, size, NULL, NULL);
+		if (ret != FALSE) {
+			parse_data->stats.files_opened++;
+			parse_data->stats.bytes_read += *size;
+		}
+	}
+
+	xplayer_pl_parser_stage_leave (parse_data, stage);
+
+	return ret;
+}
+
+/**
+ * xplayer_pl_parser_contents_load:
+ * @parser: a #XplayerPlParser
+ * @file: the #GFile to load
+ * @parse_data: the #XplayerPlParseData for the current parse operation
+ * @contents: the #XplayerPlParserContents to fill in
+ *
+ * Maps local files read-only into memory, so that even huge playlists
+ * can be parsed without copying them, and loads anything else with
+ * xplayer_pl_parser_load_contents(). Unlike the latter, @contents->data
+ * isn't NUL-terminated, only @contents->size bytes of it can be read.
+ * Free it with xplayer_pl_parser_contents_clear().
+ * This is a private method, not exposed by the library.
+ *
+ * Return value: %TRUE if @file was loaded
+ **/
+gboolean
+xplayer_pl_parser_contents_load (XplayerPlParser *parser,
+			       GFile *file,
+			       XplayerPlParseData *parse_data,
+			       XplayerPlParserContents *contents)
+{
+	memset (contents, 0, sizeof (*contents));
+
+	if (g_file_is_native (file) != FALSE) {
+		XplayerPlParserStage stage;
+		char *path;
+
+		stage = xplayer_pl_parser_stage_enter (parse_data, XPLAYER_PL_PARSER_STAGE_LOAD);
+		path = g_file_get_path (file);
+		if (path != NULL)
+			contents->map = g_mapped_file_new (path, FALSE, NULL);
+		g_free (path);
+		xplayer_pl_parser_stage_leave (parse_data, stage);
+	}
+
+	if (contents->map != NULL) {
+		contents->size = g_mapped_file_get_length (contents->map);
+		parse_data->stats.files_opened++;
+		parse_data->stats.bytes_read += contents->size;
+		contents->data = g_mapped_file_get_contents (contents->map);
+		/* Empty files aren't mapped at all */
+		if (contents->data == NULL)
+			contents->data = "";
+#if defined (G_OS_UNIX) && defined (MADV_SEQUENTIAL)
+		else
+			madvise ((gpointer) contents->data, contents->size, MADV_SEQUENTIAL);
+#endif
+		return TRUE;
+	}
+
+	if (xplayer_pl_parser_load_contents (parser, file, parse_data, &contents->buffer, &contents->size) == FALSE)
+		return FALSE;
+	contents->data = contents->buffer;
+
+	return TRUE;
+}
+
+void
+xplayer_pl_parser_contents_clear (XplayerPlParserContents *contents)
+{
+	g_clear_pointer (&contents->map, g_mapped_file_unref);
+	g_clear_pointer (&contents->buffer, g_free);
+	contents->data = NULL;
+	contents->size = 0;
+}
+
+/**
+ * xplayer_pl_parser_contents_next_line:
+ * @pos: the position to read the line from, moved past it
+ * @end: the end of the contents
+ * @line: a #GString to copy the line into
+ *
+ * Copies the next non-empty line between @pos and @end into @line,
+ * lines being separated by any number of CRs and LFs, as splitting the
+ * contents with g_strsplit_set() on those would. Only one line is ever
+ * copied, whatever the size of the contents.
+ * This is a private method, not exposed by the library.
+ *
+ * Return value: %FALSE if there are no lines left
+ **/
+gboolean
+xplayer_pl_parser_contents_next_line (const char **pos,
+				    const char *end,
+				    GString *line)
+{
+	const char *start, *eol;
+
+	for (start = *pos; start < end && (*start == '\r' || *start == '\n'); start++)
+		;
+	if (start == end) {
+		*pos = end;
+		return FALSE;
+	}
+
+	for (eol = start; eol < end && *eol != '\r' && *eol != '\n'; eol++)
+		;
+	g_string_truncate (line, 0);
+	g_string_append_len (line, start, eol - start);
+	*pos = eol;
+
+	return TRUE;
+}
+
+/* Content types servers use for anything, which don't tell us whether
+ * we're looking at a playlist without checking the data */
+static const char *generic_content_types[] = {
+	UNKNOWN_TYPE,
+	AUDIO_MPEG_TYPE,
+	"text/plain",
+	"text/html",
+	"text/xml",
+	"application/xml",
+	"application/x-php",
+};
+
+static gboolean
+xplayer_pl_parser_content_type_is_playlist (const char *content_type)
+{
+	guint i;
+
+	for (i = 0; i < G_N_ELEMENTS(special_types); i++) {
+		if (strcmp (special_types[i].mimetype, content_type) == 0)
+			return TRUE;
+	}
+	for (i = 0; i < G_N_ELEMENTS(dual_types); i++) {
+		if (strcmp (dual_types[i].mimetype, content_type) == 0)
+			return TRUE;
+	}
+
+	return FALSE;
+}
+
+/* Reads the first MIME_READ_CHUNK_SIZE bytes of a remote file with a
+ * ranged GET, trusting the Content-Type the server sends if it names a
+ * type we know. Media files aren't read at all, as those can be endless
+ * streams. Returns %FALSE if the request couldn't be made */
+static gboolean
+xplayer_pl_parser_probe_http (XplayerPlParser *parser,
+			    GFile *file,
+			    XplayerPlParseData *parse_data,
+			    gpointer *data,
+			    char **mimetype)
+{
+	SoupSession *session;
+	SoupMessage *msg;
+	GInputStream *stream;
+	GError *error = NULL;
+	const char *header;
+	char *uri, *content_type, *buffer;
+	gsize bytes_read;
+	gboolean trusted;
+	guint i;
+
+	*mimetype = NULL;
+
+	uri = g_file_get_uri (file);
+	msg = soup_message_new (SOUP_METHOD_GET, uri);
+	if (msg == NULL) {
+		g_free (uri);
+		return FALSE;
+	}
+	soup_message_headers_set_range (msg->request_headers, 0, MIME_READ_CHUNK_SIZE - 1);
+
+	session = xplayer_pl_parser_get_session (parser);
+	stream = soup_session_send (session, msg, NULL, &error);
+	parse_data->stats.http_requests++;
+	if (stream == NULL) {
+		DEBUG1(g_print ("URI '%s' couldn't be probed: '%s'\n", uri, error->message));
+		g_error_free (error);
+		g_object_unref (msg);
+		g_object_unref (session);
+		g_free (uri);
+		return FALSE;
+	}
+
+	if (msg->status_code == SOUP_STATUS_REQUESTED_RANGE_NOT_SATISFIABLE) {
+		DEBUG1(g_print ("URI '%s' is empty in _get_mime_type_with_data\n", uri));
+		*mimetype = g_strdup (EMPTY_FILE_TYPE);
+		goto out;
+	}
+	if (SOUP_STATUS_IS_SUCCESSFUL (msg->status_code) == FALSE) {
+		DEBUG1(g_print ("URI '%s' couldn't be opened in _get_mime_type_with_data: %d %s\n", uri, msg->status_code, msg->reason_phrase));
+		goto out;
+	}
+
+	header = soup_message_headers_get_content_type (msg->response_headers, NULL);
+	content_type = header ? g_ascii_strdown (header, -1) : NULL;
+	trusted = (content_type != NULL);
+	for (i = 0; trusted != FALSE && i < G_N_ELEMENTS(generic_content_types); i++) {
+		if (strcmp (generic_content_types[i], content_type) == 0)
+			trusted = FALSE;
+	}
+	DEBUG1(g_print ("URI '%s' has Content-Type '%s'%s\n", uri, content_type, trusted ? "" : ", checking the data"));
+
+	/* A media file, no need to look into it */
+	if (trusted != FALSE &&
+	    xplayer_pl_parser_content_type_is_playlist (content_type) == FALSE &&
+	    (g_str_has_prefix (content_type, "audio/") != FALSE ||
+	     g_str_has_prefix (content_type, "video/") != FALSE)) {
+		*mimetype = content_type;
+		goto out;
+	}
+
+	buffer = g_malloc (MIME_READ_CHUNK_SIZE + 1);
+	if (g_input_stream_read_all (stream, buffer, MIME_READ_CHUNK_SIZE, &bytes_read, NULL, NULL) == FALSE) {
+		DEBUG1(g_print ("Couldn't read data from '%s'\n", uri));
+		g_free (buffer);
+		g_free (content_type);
+		goto out;
+	}
+
+	if (bytes_read == 0) {
+		DEBUG1(g_print ("URI '%s' is empty in _get_mime_type_with_data\n", uri));
+		g_free (buffer);
+		g_free (content_type);
+		*mimetype = g_strdup (EMPTY_FILE_TYPE);
+		goto out;
+	}
+
+	buffer[bytes_read] = '\0';
+	*data = buffer;
+	parse_data->stats.bytes_read += bytes_read;
+	if (trusted != FALSE && xplayer_pl_parser_content_type_is_playlist (content_type) != FALSE) {
+		*mimetype = content_type;
+	} else {
+		g_free (content_type);
+		*mimetype = xplayer_pl_parser_mime_type_from_data (buffer, bytes_read);
+	}
+
+out:
+	/* Closing the stream reads the rest of the body so that the
+	 * connection can be reused, which is fine for the range we asked
+	 * for, but not if the server sent the whole file instead */
+	if (msg->status_code != SOUP_STATUS_PARTIAL_CONTENT)
+		soup_session_cancel_message (session, msg, SOUP_STATUS_CANCELLED);
+	g_input_stream_close (stream, NULL, NULL);
+	g_object_unref (stream);
+	g_object_unref (msg);
+	g_object_unref (session);
+	g_free (uri);
+
+	return TRUE;
+}
+
 static char *
-my_g_file_info_get_mime_type_with_data (GFile *file, gpointer *data, XplayerPlParser *parser)
+sniff_mime_type_with_data (GFile *file, GFileInfo *info, gpointer *data, XplayerPlParser *parser, XplayerPlParseData *parse_data)
 {
+	XplayerPlParserStage stage;
 	char *buffer;
 	gsize bytes_read;
 	GFileInputStream *stream;
@@ -732,10 +1665,35 @@ my_g_file_info_get_mime_type_with_data (GFile *file, gpointer *data, XplayerPlPa
 
 	*data = NULL;
 
+	/* The directory listing already told us the file is empty */
+	if (info != NULL &&
+	    g_file_info_get_file_type (info) == G_FILE_TYPE_REGULAR &&
+	    g_file_info_has_attribute (info, G_FILE_ATTRIBUTE_STANDARD_SIZE) != FALSE &&
+	    g_file_info_get_size (info) == 0) {
+		DEBUG(file, g_print ("URI '%s' is empty according to its file info\n", uri));
+		return g_strdup (EMPTY_FILE_TYPE);
+	}
+
+	/* Only the start of remote files is read here, whether or not they
+	 * are cached: they could be endless streams. The handler loads the
+	 * rest through the cache once it knows it has a playlist */
+	if (xplayer_pl_parser_file_is_http (file) != FALSE) {
+		XplayerPlParserStage stage;
+		char *mimetype;
+		gboolean probed;
+
+		stage = xplayer_pl_parser_stage_enter (parse_data, XPLAYER_PL_PARSER_STAGE_LOAD);
+		probed = xplayer_pl_parser_probe_http (parser, file, parse_data, data, &mimetype);
+		xplayer_pl_parser_stage_leave (parse_data, stage);
+		if (probed != FALSE)
+			return mimetype;
+	}
+
 #ifndef _WIN32
 	/* Stat for a block device, we're screwed as far as speed
 	 * is concerned now */
-	if (g_file_is_native (file) != FALSE) {
+	if (g_file_is_native (file) != FALSE &&
+	    (info == NULL || g_file_info_get_file_type (info) == G_FILE_TYPE_SPECIAL)) {
 		struct stat buf;
 		char *path;
 
@@ -749,8 +1707,10 @@ my_g_file_info_get_mime_type_with_data (GFile *file, gpointer *data, XplayerPlPa
 #endif
 
 	/* Open the file. */
+	stage = xplayer_pl_parser_stage_enter (parse_data, XPLAYER_PL_PARSER_STAGE_LOAD);
 	stream = g_file_read (file, NULL, &error);
 	if (stream == NULL) {
+		xplayer_pl_parser_stage_leave (parse_data, stage);
 		if (g_error_matches (error, G_IO_ERROR, G_IO_ERROR_IS_DIRECTORY) != FALSE) {
 			g_error_free (error);
 			return g_strdup (DIR_MIME_TYPE);
@@ -759,17 +1719,21 @@ my_g_file_info_get_mime_type_with_data (GFile *file, gpointer *data, XplayerPlPa
 		g_error_free (error);
 		return NULL;
 	}
+	parse_data->stats.files_opened++;
 	DEBUG(file, g_print ("URI '%s' was opened successfully in _get_mime_type_with_data\n", uri));
 
 	/* Read the whole thing, up to MIME_READ_CHUNK_SIZE */
 	buffer = g_malloc (MIME_READ_CHUNK_SIZE);
 	if (g_input_stream_read_all (G_INPUT_STREAM (stream), buffer, MIME_READ_CHUNK_SIZE, &bytes_read, NULL, &error) == FALSE) {
 		g_object_unref (stream);
+		xplayer_pl_parser_stage_leave (parse_data, stage);
 		DEBUG(file, g_print ("Couldn't read data from '%s'\n", uri));
 		g_free (buffer);
 		return NULL;
 	}
 	g_object_unref (G_INPUT_STREAM (stream));
+	xplayer_pl_parser_stage_leave (parse_data, stage);
+	parse_data->stats.bytes_read += bytes_read;
 
 	/* Empty file */
 	if (bytes_read == 0) {
@@ -786,6 +1750,19 @@ my_g_file_info_get_mime_type_with_data (GFile *file, gpointer *data, XplayerPlPa
 	return xplayer_pl_parser_mime_type_from_data (*data, bytes_read);
 }
 
+static char *
+my_g_file_info_get_mime_type_with_data (GFile *file, GFileInfo *info, gpointer *data, XplayerPlParser *parser, XplayerPlParseData *parse_data)
+{
+	XplayerPlParserStage stage;
+	char *mimetype;
+
+	stage = xplayer_pl_parser_stage_enter (parse_data, XPLAYER_PL_PARSER_STAGE_SNIFF);
+	mimetype = sniff_mime_type_with_data (file, info, data, parser, parse_data);
+	xplayer_pl_parser_stage_leave (parse_data, stage);
+
+	return mimetype;
+}
+
 /**
  * xplayer_pl_parser_is_debugging_enabled:
  * @parser: a #XplayerPlParser
@@ -1010,9 +1987,9 @@ is_probably_dir (const char *filename)
 	return ret;
 }
 
-char *
-xplayer_pl_parser_resolve_uri (GFile *base_gfile,
-			     const char *relative_uri)
+static char *
+xplayer_pl_parser_real_resolve_uri (GFile *base_gfile,
+				  const char *relative_uri)
 {
 	char *uri, *scheme, *query, *new_relative_uri, *base_uri;
 	GFile *base_parent_gfile, *resolved_gfile;
@@ -1095,6 +2072,22 @@ xplayer_pl_parser_resolve_uri (GFile *base_gfile,
 	}
 }
 
+char *
+xplayer_pl_parser_resolve_uri (GFile *base_gfile,
+			     const char *relative_uri)
+{
+	XplayerPlParseData *parse_data;
+	XplayerPlParserStage stage;
+	char *uri;
+
+	parse_data = xplayer_pl_parser_get_parse_data ();
+	stage = xplayer_pl_parser_stage_enter (parse_data, XPLAYER_PL_PARSER_STAGE_RESOLVE);
+	uri = xplayer_pl_parser_real_resolve_uri (base_gfile, relative_uri);
+	xplayer_pl_parser_stage_leave (parse_data, stage);
+
+	return uri;
+}
+
 #ifndef XPLAYER_PL_PARSER_MINI
 /**
  * xplayer_pl_parser_save:
@@ -1159,6 +2152,8 @@ xplayer_pl_parser_save (XplayerPlParser      *parser,
 		return xplayer_pl_parser_save_xspf (parser, playlist, dest, title, error);
 	case XPLAYER_PL_PARSER_IRIVER_PLA:
 		return xplayer_pl_parser_save_pla (parser, playlist, dest, title, error);
+	case XPLAYER_PL_PARSER_BINARY:
+		return xplayer_pl_parser_save_binary (parser, playlist, dest, title, error);
 	default:
 		g_assert_not_reached ();
 	}
@@ -1276,6 +2271,7 @@ xplayer_pl_parser_init (XplayerPlParser *parser)
 	parser->priv = G_TYPE_INSTANCE_GET_PRIVATE (parser, XPLAYER_TYPE_PL_PARSER, XplayerPlParserPrivate);
 	parser->priv->main_thread = g_thread_self ();
 	g_mutex_init (&parser->priv->ignore_mutex);
+	g_mutex_init (&parser->priv->http_mutex);
 	parser->priv->ignore_schemes = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
 	parser->priv->ignore_mimetypes = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
 }
@@ -1288,11 +2284,23 @@ xplayer_pl_parser_finalize (GObject *object)
 	g_return_if_fail (object != NULL);
 	g_return_if_fail (priv != NULL);
 
+	g_clear_pointer (&priv->watches, g_hash_table_destroy);
 	g_clear_pointer (&priv->ignore_schemes, g_hash_table_destroy);
 	g_clear_pointer (&priv->ignore_mimetypes, g_hash_table_destroy);
 
 	g_mutex_clear (&priv->ignore_mutex);
 
+	g_clear_pointer (&priv->cache, xplayer_pl_parser_cache_unref);
+	g_clear_object (&priv->session);
+	g_clear_pointer (&priv->cache_dir, g_free);
+	g_clear_pointer (&priv->result_cache, xplayer_pl_parser_result_cache_unref);
+	g_clear_pointer (&priv->result_cache_dir, g_free);
+	g_mutex_clear (&priv->http_mutex);
+
+	/* The video site cache is shared, but this is as good a time
+	 * as any to save it */
+	xplayer_pl_parser_videosite_cache_flush ();
+
 	G_OBJECT_CLASS (xplayer_pl_parser_parent_class)->finalize (object);
 }
 
@@ -1352,9 +2360,28 @@ xplayer_pl_parser_add_hash_table (XplayerPlParser *parser,
 				const char    *uri,
 				gboolean       is_playlist)
 {
+	XplayerPlParseData *parse_data;
+	XplayerPlParserStage stage;
+
+	parse_data = xplayer_pl_parser_get_parse_data ();
+	if (parse_data != NULL && is_playlist == FALSE &&
+	    (g_hash_table_size (metadata) > 0 || uri != NULL))
+		parse_data->stats.entries_emitted++;
+
+	/* A watch's parser only reports to the watch */
+	if (parser->priv->recording != NULL) {
+		if (is_playlist == FALSE)
+			xplayer_pl_parser_watch_record (parser->priv->recording, uri, metadata);
+		return;
+	}
+
+	stage = xplayer_pl_parser_stage_enter (parse_data, XPLAYER_PL_PARSER_STAGE_DISPATCH);
 	if (g_hash_table_size (metadata) > 0 || uri != NULL) {
 		EntryParsedSignalData *data;
 
+		if (parse_data != NULL && parse_data->result_record != NULL)
+			xplayer_pl_parser_result_record_entry (parse_data->result_record, uri, metadata, is_playlist);
+
 		/* Make sure to emit the signals asynchronously, as we could be in the main loop
 		 * *or* a worker thread at this point. */
 		data = g_new (EntryParsedSignalData, 1);
@@ -1369,6 +2396,7 @@ xplayer_pl_parser_add_hash_table (XplayerPlParser *parser,
 
 		CALL_ASYNC (parser, emit_entry_parsed_signal, data);
 	}
+	xplayer_pl_parser_stage_leave (parse_data, stage);
 }
 
 static void
@@ -1629,94 +2657,191 @@ xplayer_pl_parser_ignore (XplayerPlParser *parser, const char *uri)
 		}
 	}
 
-	g_free (mimetype);
+	g_free (mimetype);
+
+	return TRUE;
+}
+
+/**
+ * xplayer_pl_parser_get_xml_encoding:
+ * @contents: the contents of the file
+ * @size: the size of @contents
+ *
+ * Looks for the encoding of an XML document in its XML declaration, before
+ * anything gets parsed. Documents starting with a byte-order mark are
+ * handled by the lexer itself.
+ *
+ * Return value: a newly-allocated encoding name, or %NULL if the document
+ * is UTF-8 already
+ */
+static char *
+xplayer_pl_parser_get_xml_encoding (const char *contents,
+				    gsize size)
+{
+	const char *p, *end, *value;
+	char quote;
+
+	if (size >= 3 && memcmp (contents, "\xEF\xBB\xBF", 3) == 0)
+		return NULL;
+	if (size >= 2 && (memcmp (contents, "\xFF\xFE", 2) == 0
+			  || memcmp (contents, "\xFE\xFF", 2) == 0
+			  || memcmp (contents, "\0\0", 2) == 0))
+		return NULL;
+
+	/* The declaration has to come first */
+	p = contents;
+	end = contents + MIN (size, MIME_READ_CHUNK_SIZE);
+	while (p < end && g_ascii_isspace (*p))
+		p++;
+	if (end - p < 5 || g_ascii_strncasecmp (p, "<?xml", 5) != 0)
+		return NULL;
+	end = g_strstr_len (p, end - p, "?>");
+	if (end == NULL)
+		return NULL;
+
+	for (p += 5; end - p > 8; p++) {
+		if (g_ascii_strncasecmp (p, "encoding", 8) == 0)
+			break;
+	}
+	if (end - p <= 8)
+		return NULL;
+
+	for (p += 8; p < end && (g_ascii_isspace (*p) || *p == '='); p++)
+		;
+	if (p == end || (*p != '"' && *p != '\''))
+		return NULL;
+	quote = *p++;
+	for (value = p; p < end && *p != quote; p++)
+		;
+	if (p == end || p == value)
+		return NULL;
 
-	return TRUE;
+	if (p - value == 5 && g_ascii_strncasecmp (value, "UTF-8", 5) == 0)
+		return NULL;
+
+	return g_strndup (value, p - value);
 }
 
-/**
- * xplayer_pl_parser_cleanup_xml:
- * @contents: the contents of the file
- *
- * Removes HTML comments from a string representing the contents of an XML file.
- * The function modifies the string in place.
- */
+/* The vocabularies are sorted by hand, and a name out of order would
+ * silently never be found, so check each one the first time it is used */
 static void
-xplayer_pl_parser_cleanup_xml (char *contents)
-{
-	char *needle;
-
-	needle = contents;
-	while ((needle = strstr (needle, "<!--")) != NULL) {
-		char *end;
-
-		/* Find end of comments */
-		end = strstr (needle, "-->");
-		/* Broken file? */
-		if (end == NULL)
-			return;
-		if (g_strstr_len (needle, end - needle, "]]>") != NULL) {
-			/* Advance 3 and skip */
-			needle += 3;
-			continue;
+xplayer_pl_parser_check_vocabulary (const xml_vocabulary_t *vocabulary)
+{
+	static GMutex mutex;
+	static GSList *checked = NULL;
+
+	if (vocabulary == NULL)
+		return;
+
+	g_mutex_lock (&mutex);
+	if (g_slist_find (checked, vocabulary) == NULL) {
+		g_assert (xml_vocabulary_is_sorted (vocabulary));
+		checked = g_slist_prepend (checked, (gpointer) vocabulary);
+	}
+	g_mutex_unlock (&mutex);
+}
+
+/* Sets up a parser for the document, converted to UTF-8 in one go if need
+ * be; *converted is set to the buffer to free once the parser is done */
+static xml_parser_t *
+xplayer_pl_parser_xml_parser_new (const char *contents,
+				  gsize size,
+				  const xml_vocabulary_t *vocabulary,
+				  char **converted)
+{
+	xml_parser_t *xml_parser;
+	char *encoding;
+
+	*converted = NULL;
+	encoding = xplayer_pl_parser_get_xml_encoding (contents, size);
+	if (encoding != NULL) {
+		*converted = g_convert (contents, size, "UTF-8", encoding, NULL, &size, NULL);
+		g_free (encoding);
+		if (*converted == NULL) {
+			g_warning ("Failed to convert XML data to UTF-8");
+			return NULL;
 		}
-		/* Empty the comment */
-		memset (needle, ' ', end + 3 - needle);
+		contents = *converted;
 	}
+
+	xplayer_pl_parser_check_vocabulary (vocabulary);
+	xml_parser = xml_parser_init_r (contents, size, XML_PARSER_CASE_INSENSITIVE);
+	xml_parser_set_vocabulary_r (xml_parser, vocabulary);
+
+	return xml_parser;
 }
 
 xml_node_t *
 xplayer_pl_parser_parse_xml_relaxed (char *contents,
-				   gsize size)
+				   gsize size,
+				   const xml_vocabulary_t *vocabulary)
 {
-	xml_node_t* doc, *node;
-	char *encoding, *new_contents;
-	gsize new_size;
+	XplayerPlParseData *parse_data;
+	XplayerPlParserStage stage;
+	xml_node_t* doc;
+	char *converted;
 	xml_parser_t *xml_parser;
 
-	xplayer_pl_parser_cleanup_xml (contents);
-	xml_parser = xml_parser_init_r (contents, size, XML_PARSER_CASE_INSENSITIVE);
-	if (xml_parser_build_tree_with_options_r (xml_parser, &doc, XML_PARSER_RELAXED | XML_PARSER_MULTI_TEXT) < 0) {
-		xml_parser_finalize_r (xml_parser);
-		return NULL;
-	}
+	parse_data = xplayer_pl_parser_get_parse_data ();
+	stage = xplayer_pl_parser_stage_enter (parse_data, XPLAYER_PL_PARSER_STAGE_XML);
 
-	xml_parser_finalize_r (xml_parser);
+	doc = NULL;
+	xml_parser = xplayer_pl_parser_xml_parser_new (contents, size, vocabulary, &converted);
+	if (xml_parser != NULL) {
+		if (xml_parser_build_tree_with_options_r (xml_parser, &doc, XML_PARSER_RELAXED | XML_PARSER_MULTI_TEXT) < 0)
+			doc = NULL;
 
-	encoding = NULL;
-	for (node = doc; node != NULL; node = node->next) {
-		if (node->name == NULL || g_str_equal (node->name, "?XML") == FALSE)
-			continue;
-		encoding = g_strdup (xml_parser_get_property (node, "ENCODING"));
-		break;
+		xml_parser_finalize_r (xml_parser);
+		g_free (converted);
 	}
 
-	if (encoding == NULL || g_str_equal (encoding, "UTF-8") != FALSE) {
-		g_free (encoding);
-		return doc;
-	}
+	xplayer_pl_parser_stage_leave (parse_data, stage);
 
-	xml_parser_free_tree (doc);
+	return doc;
+}
 
-	new_contents = g_convert (contents, size, "UTF-8", encoding, NULL, &new_size, NULL);
-	if (new_contents == NULL) {
-		g_warning ("Failed to convert XML data to UTF-8");
-		g_free (encoding);
-		return NULL;
-	}
-	g_free (encoding);
+/**
+ * xplayer_pl_parser_parse_xml_relaxed_stream:
+ * @contents: the contents of the file
+ * @size: the size of @contents
+ * @vocabulary: the element and property names to give ids to, or %NULL
+ * @callbacks: the callbacks to call while parsing
+ * @user_data: data to pass to @callbacks
+ *
+ * Streaming version of xplayer_pl_parser_parse_xml_relaxed(): elements are
+ * reported through @callbacks as soon as they are parsed, and no tree is
+ * kept other than what the callbacks choose to keep.
+ *
+ * Return value: %FALSE if the document couldn't be parsed
+ */
+gboolean
+xplayer_pl_parser_parse_xml_relaxed_stream (char *contents,
+					  gsize size,
+					  const xml_vocabulary_t *vocabulary,
+					  const xml_parser_callbacks_t *callbacks,
+					  gpointer user_data)
+{
+	XplayerPlParseData *parse_data;
+	XplayerPlParserStage stage;
+	char *converted;
+	xml_parser_t *xml_parser;
+	int res;
+
+	parse_data = xplayer_pl_parser_get_parse_data ();
+	stage = xplayer_pl_parser_stage_enter (parse_data, XPLAYER_PL_PARSER_STAGE_XML);
 
-	xml_parser = xml_parser_init_r (new_contents, new_size, XML_PARSER_CASE_INSENSITIVE);
-	if (xml_parser_build_tree_with_options_r (xml_parser, &doc, XML_PARSER_RELAXED | XML_PARSER_MULTI_TEXT) < 0) {
+	res = -1;
+	xml_parser = xplayer_pl_parser_xml_parser_new (contents, size, vocabulary, &converted);
+	if (xml_parser != NULL) {
+		res = xml_parser_build_tree_with_callbacks_r (xml_parser, NULL, XML_PARSER_RELAXED | XML_PARSER_MULTI_TEXT,
+							      callbacks, user_data);
 		xml_parser_finalize_r (xml_parser);
-		g_free (new_contents);
-		return NULL;
+		g_free (converted);
 	}
 
-	xml_parser_finalize_r (xml_parser);
-	g_free (new_contents);
+	xplayer_pl_parser_stage_leave (parse_data, stage);
 
-	return doc;
+	return (res >= 0);
 }
 
 static gboolean
@@ -1761,6 +2886,18 @@ xplayer_pl_parser_parse_internal (XplayerPlParser *parser,
 				GFile *file,
 				GFile *base_file,
 				XplayerPlParseData *parse_data)
+{
+	return xplayer_pl_parser_parse_internal_with_info (parser, file, base_file, NULL, parse_data);
+}
+
+/* Sets @record if @file is being recorded into the result cache */
+static XplayerPlParserResult
+xplayer_pl_parser_parse_internal_with_record (XplayerPlParser *parser,
+					    GFile *file,
+					    GFile *base_file,
+					    GFileInfo *info,
+					    XplayerPlParseData *parse_data,
+					    XplayerPlParserResultRecord **record)
 {
 	char *mimetype;
 	guint i;
@@ -1803,25 +2940,51 @@ xplayer_pl_parser_parse_internal (XplayerPlParser *parser,
 		return XPLAYER_PL_PARSER_RESULT_UNHANDLED;
 
 #ifdef HAVE_QUVI
-	/* Should we try to parse it with quvi? */
+	/* Should we try to parse it with quvi? The helper checks
+	 * whether the site is supported as part of parsing it */
 	if (g_file_has_uri_scheme (file, "http")) {
-		char *url;
-		url = g_file_get_uri (file);
-		if (url != NULL && xplayer_pl_parser_is_videosite (url, parser->priv->debug) != FALSE) {
-			ret = xplayer_pl_parser_add_videosite (parser, file, base_file, parse_data, NULL);
-			if (ret == XPLAYER_PL_PARSER_RESULT_SUCCESS)
+		ret = xplayer_pl_parser_add_videosite (parser, file, base_file, parse_data, NULL);
+		if (ret == XPLAYER_PL_PARSER_RESULT_SUCCESS)
+			return ret;
+	}
+#endif /* HAVE_QUVI */
+
+	/* The outermost local file gets replayed from the result cache, or
+	 * recorded into it, and the files it pulls in become dependencies */
+	if (parse_data->result_cache != NULL) {
+		if (parse_data->result_record != NULL) {
+			xplayer_pl_parser_result_record_depend (parse_data->result_record, file);
+		} else if (g_file_is_native (file) != FALSE &&
+			   (info == NULL || g_file_info_get_file_type (info) == G_FILE_TYPE_REGULAR)) {
+			if (xplayer_pl_parser_result_cache_lookup (parse_data->result_cache, parser, file, base_file,
+								 parse_data->result_options, &ret, record) != FALSE) {
+				DEBUG(file, g_print ("URI '%s' was replayed from the result cache\n", uri));
 				return ret;
+			}
+			parse_data->result_record = *record;
 		}
-		g_free (url);
 	}
-#endif /* HAVE_QUVI */
 
-	/* In force mode we want to get the data */
-	if (parse_data->force != FALSE) {
-		mimetype = my_g_file_info_get_mime_type_with_data (file, &data, parser);
+	if (info != NULL && g_file_info_get_file_type (info) == G_FILE_TYPE_DIRECTORY) {
+		/* No need to open a directory to know what it is */
+		mimetype = g_strdup (DIR_MIME_TYPE);
+	} else if (parse_data->force != FALSE) {
+		/* In force mode we want to get the data */
+		mimetype = my_g_file_info_get_mime_type_with_data (file, info, &data, parser, parse_data);
+	} else if (info != NULL && g_file_info_get_attribute_string (info, G_FILE_ATTRIBUTE_STANDARD_FAST_CONTENT_TYPE) != NULL) {
+		const char *content_type;
+
+		content_type = g_file_info_get_attribute_string (info, G_FILE_ATTRIBUTE_STANDARD_FAST_CONTENT_TYPE);
+#ifdef G_OS_WIN32
+		mimetype = g_content_type_get_mime_type (content_type);
+#else
+		mimetype = g_strdup (content_type);
+#endif
 	} else {
+		XplayerPlParserStage stage;
 		char *uri;
 
+		stage = xplayer_pl_parser_stage_enter (parse_data, XPLAYER_PL_PARSER_STAGE_SNIFF);
 		uri = g_file_get_uri (file);
 #ifdef G_OS_WIN32
 		{
@@ -1835,6 +2998,7 @@ xplayer_pl_parser_parse_internal (XplayerPlParser *parser,
 #endif
 
 		g_free (uri);
+		xplayer_pl_parser_stage_leave (parse_data, stage);
 	}
 
 	/* We're much more likely to have an MP2T file instead */
@@ -1855,7 +3019,7 @@ xplayer_pl_parser_parse_internal (XplayerPlParser *parser,
 	if (mimetype == NULL || strcmp (UNKNOWN_TYPE, mimetype) == 0
 	    || (g_file_is_native (file) && g_content_type_is_a (mimetype, "text/plain") != FALSE)) {
 		char *new_mimetype;
-		new_mimetype = my_g_file_info_get_mime_type_with_data (file, &data, parser);
+		new_mimetype = my_g_file_info_get_mime_type_with_data (file, info, &data, parser, parse_data);
 		if (new_mimetype) {
 			g_free (mimetype);
 			mimetype = new_mimetype;
@@ -1880,7 +3044,7 @@ xplayer_pl_parser_parse_internal (XplayerPlParser *parser,
 	 * data from the playlist parser */
 	if (strcmp (mimetype, AUDIO_MPEG_TYPE) == 0 && parse_data->recurse_level == 0 && data == NULL) {
 		char *tmp;
-		tmp = my_g_file_info_get_mime_type_with_data (file, &data, parser);
+		tmp = my_g_file_info_get_mime_type_with_data (file, info, &data, parser, parse_data);
 		if (tmp != NULL) {
 			g_free (mimetype);
 			mimetype = tmp;
@@ -1889,6 +3053,7 @@ xplayer_pl_parser_parse_internal (XplayerPlParser *parser,
 	}
 
 	if (xplayer_pl_parser_mimetype_is_ignored (parser, mimetype) != FALSE) {
+		parse_data->stats.entries_ignored++;
 		g_free (mimetype);
 		g_free (data);
 		return XPLAYER_PL_PARSER_RESULT_IGNORED;
@@ -1902,6 +3067,7 @@ xplayer_pl_parser_parse_internal (XplayerPlParser *parser,
 				DEBUG(file, g_print ("URI '%s' is special type '%s'\n", uri, mimetype));
 				if (parse_data->disable_unsafe != FALSE && special_types[i].unsafe != FALSE) {
 					DEBUG(file, g_print ("URI '%s' is unsafe so was ignored\n", uri));
+					parse_data->stats.entries_ignored++;
 					g_free (mimetype);
 					g_free (data);
 					return XPLAYER_PL_PARSER_RESULT_IGNORED;
@@ -1912,7 +3078,16 @@ xplayer_pl_parser_parse_internal (XplayerPlParser *parser,
 					base_file = g_object_ref (base_file);
 
 				DEBUG (file, g_print ("Using %s function for '%s'\n", special_types[i].mimetype, uri));
-				ret = (* special_types[i].func) (parser, file, base_file, parse_data, data);
+				if (parse_data->recurse_level > 1)
+					parse_data->stats.playlists_visited++;
+				if (*record != NULL)
+					xplayer_pl_parser_result_record_handled (*record);
+				if (parser->priv->recording == NULL) {
+					ret = (* special_types[i].func) (parser, file, base_file, parse_data, data);
+				} else if (xplayer_pl_parser_watch_enter (parser->priv->recording, file, mimetype, &ret) != FALSE) {
+					ret = (* special_types[i].func) (parser, file, base_file, parse_data, data);
+					xplayer_pl_parser_watch_leave (parser->priv->recording, ret);
+				}
 
 				if (base_file != NULL)
 					g_object_unref (base_file);
@@ -1929,7 +3104,7 @@ xplayer_pl_parser_parse_internal (XplayerPlParser *parser,
 				DEBUG(file, g_print ("URI '%s' is dual type '%s'\n", uri, mimetype));
 				if (data == NULL) {
 					g_free (mimetype);
-					mimetype = my_g_file_info_get_mime_type_with_data (file, &data, parser);
+					mimetype = my_g_file_info_get_mime_type_with_data (file, info, &data, parser, parse_data);
 					DEBUG(file, g_print ("URI '%s' dual type has type '%s' from data\n", uri, mimetype));
 				}
 				/* If it's _still_ a text/plain, we don't want it */
@@ -1959,7 +3134,16 @@ xplayer_pl_parser_parse_internal (XplayerPlParser *parser,
 				else
 					base_file = g_object_ref (base_file);
 
-				ret = (* func) (parser, file, base_file ? base_file : file, parse_data, data);
+				if (parse_data->recurse_level > 1)
+					parse_data->stats.playlists_visited++;
+				if (*record != NULL)
+					xplayer_pl_parser_result_record_handled (*record);
+				if (parser->priv->recording == NULL) {
+					ret = (* func) (parser, file, base_file ? base_file : file, parse_data, data);
+				} else if (xplayer_pl_parser_watch_enter (parser->priv->recording, file, mimetype, &ret) != FALSE) {
+					ret = (* func) (parser, file, base_file ? base_file : file, parse_data, data);
+					xplayer_pl_parser_watch_leave (parser->priv->recording, ret);
+				}
 
 				if (base_file != NULL)
 					g_object_unref (base_file);
@@ -1980,6 +3164,7 @@ xplayer_pl_parser_parse_internal (XplayerPlParser *parser,
 	}
 
 	if (xplayer_pl_parser_ignore_from_mimetype (parser, mimetype) != FALSE) {
+		parse_data->stats.entries_ignored++;
 		g_free (mimetype);
 		return XPLAYER_PL_PARSER_RESULT_IGNORED;
 	}
@@ -1993,6 +3178,86 @@ xplayer_pl_parser_parse_internal (XplayerPlParser *parser,
 	return ret;
 }
 
+/**
+ * xplayer_pl_parser_parse_internal_with_info:
+ * @parser: a #XplayerPlParser
+ * @file: a #GFile to parse
+ * @base_file: (allow-none): the base #GFile, or %NULL
+ * @info: (allow-none): a #GFileInfo for @file, or %NULL
+ * @parse_data: the current parse data
+ *
+ * Parses @file like xplayer_pl_parser_parse_internal() does, using the
+ * type, size and fast content type in @info, as read from a directory
+ * listing, instead of looking at the file again when possible.
+ *
+ * Local files parsed at the outermost level go through the
+ * #XplayerPlParser:result-cache-dir cache, if one is set.
+ *
+ * This is a private method, not exposed by the library.
+ *
+ * Return value: a #XplayerPlParserResult
+ **/
+XplayerPlParserResult
+xplayer_pl_parser_parse_internal_with_info (XplayerPlParser *parser,
+					  GFile *file,
+					  GFile *base_file,
+					  GFileInfo *info,
+					  XplayerPlParseData *parse_data)
+{
+	XplayerPlParserResultRecord *record = NULL;
+	XplayerPlParserResult ret;
+
+	ret = xplayer_pl_parser_parse_internal_with_record (parser, file, base_file, info, parse_data, &record);
+	if (record != NULL) {
+		parse_data->result_record = NULL;
+		xplayer_pl_parser_result_cache_store (parse_data->result_cache, record, ret);
+	}
+
+	return ret;
+}
+
+static void
+append_sorted_keys (GString *str, GHashTable *table)
+{
+	GList *keys, *l;
+
+	keys = g_list_sort (g_hash_table_get_keys (table), (GCompareFunc) strcmp);
+	for (l = keys; l != NULL; l = l->next)
+		g_string_append_printf (str, " %s", (const char *) l->data);
+	g_list_free (keys);
+	g_string_append_c (str, '\n');
+}
+
+/* A digest of everything besides the files themselves which changes
+ * the entries a playlist is parsed into, so that the result cache
+ * doesn't replay entries parsed with a different version or options */
+static char *
+xplayer_pl_parser_result_options (XplayerPlParser *parser, XplayerPlParseData *parse_data)
+{
+	GString *str;
+	char *digest;
+
+	str = g_string_new (NULL);
+	g_string_append_printf (str, "%d.%d.%d\n%d %d %d %d %d %u %"G_GUINT64_FORMAT"\n",
+				XPLAYER_PL_PARSER_VERSION_MAJOR,
+				XPLAYER_PL_PARSER_VERSION_MINOR,
+				XPLAYER_PL_PARSER_VERSION_MICRO,
+				parse_data->recurse, parse_data->force,
+				parse_data->disable_unsafe, parse_data->fallback,
+				parse_data->sort_directories,
+				parse_data->max_items, parse_data->min_date);
+
+	g_mutex_lock (&parser->priv->ignore_mutex);
+	append_sorted_keys (str, parser->priv->ignore_schemes);
+	append_sorted_keys (str, parser->priv->ignore_mimetypes);
+	g_mutex_unlock (&parser->priv->ignore_mutex);
+
+	digest = g_compute_checksum_for_string (G_CHECKSUM_SHA1, str->str, str->len);
+	g_string_free (str, TRUE);
+
+	return digest;
+}
+
 typedef struct {
 	char *uri;
 	char *base;
@@ -2007,10 +3272,17 @@ parse_async_data_free (ParseAsyncData *data)
 	g_slice_free (ParseAsyncData, data);
 }
 
+static XplayerPlParserResult xplayer_pl_parser_parse_with_stats (XplayerPlParser *parser,
+							       const char *uri,
+							       const char *base,
+							       gboolean fallback,
+							       XplayerPlParserStats *stats);
+
 static void
 parse_thread (GSimpleAsyncResult *result, GObject *object, GCancellable *cancellable)
 {
 	XplayerPlParserResult parse_result;
+	XplayerPlParserStats stats;
 	GError *error = NULL;
 	ParseAsyncData *data = g_simple_async_result_get_op_res_gpointer (result);
 
@@ -2023,7 +3295,10 @@ parse_thread (GSimpleAsyncResult *result, GObject *object, GCancellable *cancell
 	}
 
 	/* Parse and return */
-	parse_result = xplayer_pl_parser_parse_with_base (XPLAYER_PL_PARSER (object), data->uri, data->base, data->fallback);
+	parse_result = xplayer_pl_parser_parse_with_stats (XPLAYER_PL_PARSER (object), data->uri, data->base, data->fallback, &stats);
+	g_object_set_data_full (G_OBJECT (result), PARSE_STATS_KEY,
+				xplayer_pl_parser_stats_copy (&stats),
+				(GDestroyNotify) xplayer_pl_parser_stats_free);
 	g_simple_async_result_set_op_res_gpointer (result, GUINT_TO_POINTER (parse_result), NULL);
 }
 
@@ -2068,38 +3343,52 @@ xplayer_pl_parser_parse_with_base_async (XplayerPlParser *parser, const char *ur
 	g_object_unref (result);
 }
 
-/**
- * xplayer_pl_parser_parse_with_base:
- * @parser: a #XplayerPlParser
- * @uri: the URI of the playlist to parse
- * @base: (allow-none): the base path for relative filenames, or %NULL
- * @fallback: %TRUE if the parser should add the playlist URI to the
- * end of the playlist on parse failure
- *
- * Parses a playlist given by the absolute URI @uri, using
- * @base to resolve relative paths where appropriate.
- *
- * Return value: a #XplayerPlParserResult
- **/
-XplayerPlParserResult
-xplayer_pl_parser_parse_with_base (XplayerPlParser *parser, const char *uri,
-				 const char *base, gboolean fallback)
+typedef struct {
+	XplayerPlParser *parser;
+	XplayerPlParserStats *stats;
+} ParseStatsSignalData;
+
+static gboolean
+emit_parse_stats_signal (ParseStatsSignalData *data)
+{
+	g_signal_emit (data->parser,
+		       xplayer_pl_parser_table_signals[PARSE_STATS],
+		       0, data->stats);
+
+	/* Free the data */
+	g_object_unref (data->parser);
+	xplayer_pl_parser_stats_free (data->stats);
+	g_free (data);
+
+	return FALSE;
+}
+
+/* Parses @uri as xplayer_pl_parser_parse_with_base() does, filling
+ * @stats in with what it cost, and emits #XplayerPlParser::parse-stats */
+static XplayerPlParserResult
+xplayer_pl_parser_parse_with_stats (XplayerPlParser *parser, const char *uri,
+				  const char *base, gboolean fallback,
+				  XplayerPlParserStats *stats)
 {
 	GFile *file, *base_file;
 	XplayerPlParserResult retval;
 	XplayerPlParseData data;
+	XplayerPlParseData *outer_data;
+	ParseStatsSignalData *signal_data;
+	gint64 start;
 
-	g_return_val_if_fail (XPLAYER_IS_PL_PARSER (parser), XPLAYER_PL_PARSER_RESULT_UNHANDLED);
-	g_return_val_if_fail (uri != NULL, XPLAYER_PL_PARSER_RESULT_UNHANDLED);
-	g_return_val_if_fail (strstr (uri, "://") != NULL,
-			XPLAYER_PL_PARSER_RESULT_ERROR);
+	start = g_get_monotonic_time ();
+	memset (&data.stats, 0, sizeof (data.stats));
+	data.stage = XPLAYER_PL_PARSER_STAGE_PARSE;
+	data.stage_start = start;
 
 	file = g_file_new_for_uri (uri);
 	base_file = NULL;
 
 	if (xplayer_pl_parser_scheme_is_ignored (parser, file) != FALSE) {
-		g_object_unref (file);
-		return XPLAYER_PL_PARSER_RESULT_UNHANDLED;
+		data.stats.entries_ignored++;
+		retval = XPLAYER_PL_PARSER_RESULT_UNHANDLED;
+		goto out;
 	}
 
 	/* Use a struct to store copies of the options as set for this parse operation */
@@ -2108,18 +3397,82 @@ xplayer_pl_parser_parse_with_base (XplayerPlParser *parser, const char *uri,
 	data.recurse = parser->priv->recurse;
 	data.force = parser->priv->force;
 	data.disable_unsafe = parser->priv->disable_unsafe;
+	data.sort_directories = parser->priv->sort_directories;
+	data.directory_workers = parser->priv->directory_workers;
+	data.walker = NULL;
+	data.max_items = parser->priv->max_items;
+	data.min_date = parser->priv->min_date;
+
+	g_mutex_lock (&parser->priv->http_mutex);
+	data.cache = parser->priv->cache ? xplayer_pl_parser_cache_ref (parser->priv->cache) : NULL;
+	data.result_cache = parser->priv->result_cache ? xplayer_pl_parser_result_cache_ref (parser->priv->result_cache) : NULL;
+	g_mutex_unlock (&parser->priv->http_mutex);
+	data.result_options = data.result_cache ? xplayer_pl_parser_result_options (parser, &data) : NULL;
+	data.result_record = NULL;
 
 	if (base != NULL)
 		base_file = g_file_new_for_uri (base);
+
+	/* Parses can nest, signal handlers can start one */
+	outer_data = g_private_get (&xplayer_pl_parser_parse_data);
+	g_private_set (&xplayer_pl_parser_parse_data, &data);
 	retval = xplayer_pl_parser_parse_internal (parser, file, base_file, &data);
+	g_private_set (&xplayer_pl_parser_parse_data, outer_data);
+
+	if (data.cache != NULL)
+		xplayer_pl_parser_cache_unref (data.cache);
+	if (data.result_cache != NULL)
+		xplayer_pl_parser_result_cache_unref (data.result_cache);
+	g_free (data.result_options);
 
-	g_object_unref (file);
 	if (base_file != NULL)
 		g_object_unref (base_file);
 
+out:
+	g_object_unref (file);
+
+	xplayer_pl_parser_stage_account (&data, g_get_monotonic_time ());
+	data.stats.total_time = data.stage_start - start;
+	*stats = data.stats;
+
+	signal_data = g_new (ParseStatsSignalData, 1);
+	signal_data->parser = g_object_ref (parser);
+	signal_data->stats = xplayer_pl_parser_stats_copy (stats);
+	CALL_ASYNC (parser, emit_parse_stats_signal, signal_data);
+
 	return retval;
 }
 
+/**
+ * xplayer_pl_parser_parse_with_base:
+ * @parser: a #XplayerPlParser
+ * @uri: the URI of the playlist to parse
+ * @base: (allow-none): the base path for relative filenames, or %NULL
+ * @fallback: %TRUE if the parser should add the playlist URI to the
+ * end of the playlist on parse failure
+ *
+ * Parses a playlist given by the absolute URI @uri, using
+ * @base to resolve relative paths where appropriate.
+ *
+ * Once done, #XplayerPlParser::parse-stats is emitted with what
+ * parsing the playlist cost.
+ *
+ * Return value: a #XplayerPlParserResult
+ **/
+XplayerPlParserResult
+xplayer_pl_parser_parse_with_base (XplayerPlParser *parser, const char *uri,
+				 const char *base, gboolean fallback)
+{
+	XplayerPlParserStats stats;
+
+	g_return_val_if_fail (XPLAYER_IS_PL_PARSER (parser), XPLAYER_PL_PARSER_RESULT_UNHANDLED);
+	g_return_val_if_fail (uri != NULL, XPLAYER_PL_PARSER_RESULT_UNHANDLED);
+	g_return_val_if_fail (strstr (uri, "://") != NULL,
+			XPLAYER_PL_PARSER_RESULT_ERROR);
+
+	return xplayer_pl_parser_parse_with_stats (parser, uri, base, fallback, &stats);
+}
+
 /**
  * xplayer_pl_parser_parse_async:
  * @parser: a #XplayerPlParser
@@ -2174,6 +3527,34 @@ xplayer_pl_parser_parse_finish (XplayerPlParser *parser, GAsyncResult *async_res
 	return GPOINTER_TO_UINT (g_simple_async_result_get_op_res_gpointer (result));
 }
 
+/**
+ * xplayer_pl_parser_parse_get_stats:
+ * @parser: a #XplayerPlParser
+ * @async_result: a #GAsyncResult
+ *
+ * Returns what an asynchronous playlist parsing operation cost, once it
+ * was finished with xplayer_pl_parser_parse_finish(). The same stats are
+ * passed to #XplayerPlParser::parse-stats, which synchronous parses emit too.
+ *
+ * Return value: (transfer full) (allow-none): a newly-allocated #XplayerPlParserStats,
+ * or %NULL if the operation was cancelled before it started; free it with
+ * xplayer_pl_parser_stats_free()
+ **/
+XplayerPlParserStats *
+xplayer_pl_parser_parse_get_stats (XplayerPlParser *parser, GAsyncResult *async_result)
+{
+	XplayerPlParserStats *stats;
+
+	g_return_val_if_fail (XPLAYER_IS_PL_PARSER (parser), NULL);
+	g_return_val_if_fail (G_IS_ASYNC_RESULT (async_result), NULL);
+
+	stats = g_object_get_data (G_OBJECT (async_result), PARSE_STATS_KEY);
+	if (stats == NULL)
+		return NULL;
+
+	return xplayer_pl_parser_stats_copy (stats);
+}
+
 /**
  * xplayer_pl_parser_parse:
  * @parser: a #XplayerPlParser
@@ -2196,6 +3577,121 @@ xplayer_pl_parser_parse (XplayerPlParser *parser, const char *uri,
 	return xplayer_pl_parser_parse_with_base (parser, uri, NULL, fallback);
 }
 
+/**
+ * xplayer_pl_parser_watch:
+ * @parser: a #XplayerPlParser
+ * @uri: the URI of the directory or playlist to watch
+ *
+ * Starts watching the directory or playlist given by the absolute
+ * URI @uri, as well as the directories and playlists found in it,
+ * for changes.
+ *
+ * When one of them changes, only it is parsed again, and
+ * #XplayerPlParser::entry-added, #XplayerPlParser::entry-changed and
+ * #XplayerPlParser::entry-removed are emitted for the differences.
+ * Changes made in quick succession are handled together. Entries already
+ * there when the watch starts aren't reported, so @uri would usually be
+ * parsed with xplayer_pl_parser_parse() first.
+ *
+ * The signals are emitted from the thread-default main context of the
+ * caller. The options of @parser are the ones it has when called.
+ *
+ * Return value: %XPLAYER_PL_PARSER_RESULT_SUCCESS if @uri is now watched,
+ * or a #XplayerPlParserResult saying why it couldn't be parsed
+ **/
+XplayerPlParserResult
+xplayer_pl_parser_watch (XplayerPlParser *parser,
+		       const char *uri)
+{
+	XplayerPlParserWatch *watch;
+	XplayerPlParserResult retval;
+
+	g_return_val_if_fail (XPLAYER_IS_PL_PARSER (parser), XPLAYER_PL_PARSER_RESULT_UNHANDLED);
+	g_return_val_if_fail (uri != NULL, XPLAYER_PL_PARSER_RESULT_UNHANDLED);
+	g_return_val_if_fail (strstr (uri, "://") != NULL, XPLAYER_PL_PARSER_RESULT_ERROR);
+
+	watch = xplayer_pl_parser_watch_new (parser, uri, &retval);
+	if (watch == NULL)
+		return retval;
+
+	if (parser->priv->watches == NULL)
+		parser->priv->watches = g_hash_table_new_full (g_str_hash, g_str_equal,
+							       g_free, (GDestroyNotify) xplayer_pl_parser_watch_free);
+	g_hash_table_replace (parser->priv->watches, g_strdup (uri), watch);
+
+	return XPLAYER_PL_PARSER_RESULT_SUCCESS;
+}
+
+/**
+ * xplayer_pl_parser_unwatch:
+ * @parser: a #XplayerPlParser
+ * @uri: the URI passed to xplayer_pl_parser_watch()
+ *
+ * Stops watching @uri for changes.
+ **/
+void
+xplayer_pl_parser_unwatch (XplayerPlParser *parser,
+			 const char *uri)
+{
+	g_return_if_fail (XPLAYER_IS_PL_PARSER (parser));
+	g_return_if_fail (uri != NULL);
+
+	if (parser->priv->watches != NULL)
+		g_hash_table_remove (parser->priv->watches, uri);
+}
+
+/**
+ * xplayer_pl_parser_new_for_watch:
+ * @parser: a #XplayerPlParser
+ * @watch: the #XplayerPlParserWatch to report to
+ *
+ * Creates a parser with the same options as @parser, which reports
+ * the directories and playlists it parses, and their entries, to
+ * @watch instead of emitting signals.
+ *
+ * This is a private method, not exposed by the library.
+ *
+ * Return value: a new #XplayerPlParser
+ **/
+XplayerPlParser *
+xplayer_pl_parser_new_for_watch (XplayerPlParser *parser,
+			       XplayerPlParserWatch *watch)
+{
+	XplayerPlParser *recorder;
+	GHashTableIter iter;
+	gpointer key;
+
+	recorder = g_object_new (XPLAYER_TYPE_PL_PARSER,
+				 "recurse", parser->priv->recurse,
+				 "debug", parser->priv->debug,
+				 "force", parser->priv->force,
+				 "disable-unsafe", parser->priv->disable_unsafe,
+				 "sort-directories", parser->priv->sort_directories,
+				 "directory-workers", parser->priv->directory_workers,
+				 "max-items", parser->priv->max_items,
+				 "min-date", parser->priv->min_date,
+				 "http-timeout", parser->priv->http_timeout,
+				 "http-max-conns-per-host", parser->priv->http_max_conns_per_host,
+				 NULL);
+	recorder->priv->recording = watch;
+
+	g_mutex_lock (&parser->priv->http_mutex);
+	if (parser->priv->cache != NULL)
+		recorder->priv->cache = xplayer_pl_parser_cache_ref (parser->priv->cache);
+	g_mutex_unlock (&parser->priv->http_mutex);
+
+	g_mutex_lock (&parser->priv->ignore_mutex);
+	g_hash_table_iter_init (&iter, parser->priv->ignore_schemes);
+	while (g_hash_table_iter_next (&iter, &key, NULL))
+		g_hash_table_insert (recorder->priv->ignore_schemes, g_strdup (key), GINT_TO_POINTER (1));
+	g_hash_table_iter_init (&iter, parser->priv->ignore_mimetypes);
+	while (g_hash_table_iter_next (&iter, &key, NULL))
+		g_hash_table_insert (recorder->priv->ignore_mimetypes, g_strdup (key), GINT_TO_POINTER (1));
+	g_mutex_unlock (&parser->priv->ignore_mutex);
+
+	return recorder;
+}
+
 /**
  * xplayer_pl_parser_add_ignored_scheme:
  * @parser: a #XplayerPlParser
@@ -2350,6 +3846,10 @@ xplayer_pl_parser_mime_type_from_data (gconstpointer data, int len)
 	char *mime_type;
 	gboolean uncertain;
 
+	/* Our own binary playlists aren't known to the system */
+	if (xplayer_pl_parser_is_binary (data, len) != NULL)
+		return g_strdup (BINARY_PL_MIME_TYPE);
+
 #ifdef G_OS_WIN32
 	char *content_type;
 
@@ -2513,6 +4013,39 @@ xplayer_pl_parser_can_parse_from_uri (const char *uri, gboolean debug)
 }
 
 #ifndef XPLAYER_PL_PARSER_MINI
+/**
+ * xplayer_pl_parser_set_videosite_cache_file:
+ * @filename: (allow-none): the file to store the cache in, or %NULL
+ *
+ * Whether video sites are supported is remembered for a day for each
+ * host and leading path component, so that the video site helper
+ * doesn't need to be asked about every URI. This makes that cache
+ * persistent by loading it from, and saving it to, @filename.
+ *
+ * The cache is shared by all the #XplayerPlParser<!-- -->s in the process.
+ **/
+void
+xplayer_pl_parser_set_videosite_cache_file (const char *filename)
+{
+	xplayer_pl_parser_videosite_cache_set_file (filename);
+}
+
+/**
+ * xplayer_pl_parser_get_videosite_cache_stats:
+ * @hits: (out) (allow-none): return location for the number of hits, or %NULL
+ * @misses: (out) (allow-none): return location for the number of misses, or %NULL
+ *
+ * Gets the number of times the video site support cache was, or wasn't,
+ * able to answer whether a URI's site is supported, since the start of
+ * the process.
+ **/
+void
+xplayer_pl_parser_get_videosite_cache_stats (guint64 *hits,
+					   guint64 *misses)
+{
+	xplayer_pl_parser_videosite_cache_get_stats (hits, misses);
+}
+
 GType
 xplayer_pl_parser_metadata_get_type (void)
 {
@@ -2530,5 +4063,34 @@ xplayer_pl_parser_metadata_get_type (void)
 	}
 	return g_define_type_id__volatile;
 }
+
+G_DEFINE_BOXED_TYPE (XplayerPlParserStats, xplayer_pl_parser_stats,
+		     xplayer_pl_parser_stats_copy, xplayer_pl_parser_stats_free)
+
+/**
+ * xplayer_pl_parser_stats_copy:
+ * @stats: a #XplayerPlParserStats
+ *
+ * Copies @stats.
+ *
+ * Return value: (transfer full): a newly-allocated copy of @stats
+ **/
+XplayerPlParserStats *
+xplayer_pl_parser_stats_copy (const XplayerPlParserStats *stats)
+{
+	return g_memdup (stats, sizeof (XplayerPlParserStats));
+}
+
+/**
+ * xplayer_pl_parser_stats_free:
+ * @stats: a #XplayerPlParserStats
+ *
+ * Frees @stats.
+ **/
+void
+xplayer_pl_parser_stats_free (XplayerPlParserStats *stats)
+{
+	g_free (stats);
+}
 #endif /* !XPLAYER_PL_PARSER_MINI */
 
@@ -299,6 +299,7 @@ typedef struct {
  * @XPLAYER_PL_PARSER_M3U_DOS: M3U (DOS linebreaks) parser
  * @XPLAYER_PL_PARSER_XSPF: XSPF parser
  * @XPLAYER_PL_PARSER_IRIVER_PLA: iRiver PLA parser
+ * @XPLAYER_PL_PARSER_BINARY: compact binary parser, for fast loading and saving
  *
  * The type of playlist a #XplayerPlParser will parse.
  **/
@@ -308,8 +309,22 @@ typedef enum {
 	XPLAYER_PL_PARSER_M3U_DOS,
 	XPLAYER_PL_PARSER_XSPF,
 	XPLAYER_PL_PARSER_IRIVER_PLA,
+	XPLAYER_PL_PARSER_BINARY,
 } XplayerPlParserType;
 
+/**
+ * XplayerPlParserCacheEviction:
+ * @XPLAYER_PL_PARSER_CACHE_EVICTION_LRU: Remove the least recently used entries first
+ * @XPLAYER_PL_PARSER_CACHE_EVICTION_FIFO: Remove the entries which were downloaded first
+ *
+ * Which entries a #XplayerPlParser removes from its HTTP cache once it
+ * grows beyond #XplayerPlParser:cache-max-size.
+ **/
+typedef enum {
+	XPLAYER_PL_PARSER_CACHE_EVICTION_LRU,
+	XPLAYER_PL_PARSER_CACHE_EVICTION_FIFO
+} XplayerPlParserCacheEviction;
+
 /**
  * XplayerPlParserError:
  * @XPLAYER_PL_PARSER_ERROR_NO_DISC: Error attempting to open a disc device when no disc is present
@@ -334,6 +349,10 @@ GType    xplayer_pl_parser_get_type (void);
 gint64  xplayer_pl_parser_parse_duration (const char *duration, gboolean debug);
 guint64 xplayer_pl_parser_parse_date     (const char *date_str, gboolean debug);
 
+void xplayer_pl_parser_set_videosite_cache_file  (const char *filename);
+void xplayer_pl_parser_get_videosite_cache_stats (guint64 *hits,
+						guint64 *misses);
+
 gboolean xplayer_pl_parser_save (XplayerPlParser      *parser,
 			       XplayerPlPlaylist    *playlist,
 			       GFile              *dest,
@@ -367,6 +386,11 @@ void xplayer_pl_parser_parse_with_base_async (XplayerPlParser *parser,
 					    GAsyncReadyCallback callback,
                     			    gpointer user_data);
 
+XplayerPlParserResult xplayer_pl_parser_watch (XplayerPlParser *parser,
+					   const char *uri);
+void xplayer_pl_parser_unwatch (XplayerPlParser *parser,
+			      const char *uri);
+
 XplayerPlParser *xplayer_pl_parser_new (void);
 
 /**
@@ -386,6 +410,58 @@ typedef GHashTable XplayerPlParserMetadata;
 GType xplayer_pl_parser_metadata_get_type (void) G_GNUC_CONST;
 #define XPLAYER_TYPE_PL_PARSER_METADATA (xplayer_pl_parser_metadata_get_type())
 
+/**
+ * XplayerPlParserStats:
+ * @total_time: the wall time of the whole parse operation
+ * @sniff_time: the time spent working out the type of files, not counting reading them
+ * @load_time: the time spent reading files and fetching them from the network
+ * @xml_time: the time spent in the XML parsers, building trees or walking documents
+ * @resolve_time: the time spent resolving relative URIs against their playlist
+ * @dispatch_time: the time spent handing entries over to the signals, and running
+ * the signal handlers when parsing synchronously
+ * @parse_time: the time spent everywhere else, mostly in the playlist parsers themselves
+ * @bytes_read: the number of bytes read from files and from the network
+ * @files_opened: the number of files opened, locally or through GIO
+ * @http_requests: the number of HTTP requests made
+ * @playlists_visited: the number of playlists and directories parsed inside the
+ * one the parse operation was started with
+ * @entries_emitted: the number of entries reported through #XplayerPlParser::entry-parsed
+ * @entries_ignored: the number of entries dropped because of their scheme or type,
+ * see xplayer_pl_parser_add_ignored_scheme(), xplayer_pl_parser_add_ignored_mimetype()
+ * and #XplayerPlParser:disable-unsafe
+ *
+ * What a parse operation cost, as reported by #XplayerPlParser::parse-stats
+ * and xplayer_pl_parser_parse_get_stats(). Times are in microseconds.
+ *
+ * The stages don't overlap: the time spent loading a playlist found while
+ * parsing another one only counts towards @load_time, so the times of all
+ * the stages add up to @total_time.
+ */
+typedef struct {
+	gint64 total_time;
+	gint64 sniff_time;
+	gint64 load_time;
+	gint64 xml_time;
+	gint64 resolve_time;
+	gint64 dispatch_time;
+	gint64 parse_time;
+	guint64 bytes_read;
+	guint files_opened;
+	guint http_requests;
+	guint playlists_visited;
+	guint entries_emitted;
+	guint entries_ignored;
+} XplayerPlParserStats;
+
+GType xplayer_pl_parser_stats_get_type (void) G_GNUC_CONST;
+#define XPLAYER_TYPE_PL_PARSER_STATS (xplayer_pl_parser_stats_get_type())
+
+XplayerPlParserStats *xplayer_pl_parser_stats_copy (const XplayerPlParserStats *stats);
+void xplayer_pl_parser_stats_free (XplayerPlParserStats *stats);
+
+XplayerPlParserStats *xplayer_pl_parser_parse_get_stats (XplayerPlParser *parser,
+						     GAsyncResult *async_result);
+
 G_END_DECLS
 
 #endif /* XPLAYER_PL_PARSER_H */